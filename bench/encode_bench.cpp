@@ -0,0 +1,51 @@
+#include <glog/logging.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include "op/encode.h"
+//用法：encode_bench tokenizer.bin [text_file] [repeat]
+//没有给text_file时用一段重复的英文和中文混排的文本，输出encode的吞吐（MB/s）
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: %s tokenizer.bin [text_file] [repeat]\n", argv[0]);
+    return -1;
+  }
+  op::BpeEncodeLayer encoder(argv[1], true, false);
+  auto status = encoder.init();
+  if (!status) {
+    LOG(FATAL) << "Failed to load the tokenizer: " << status.get_err_msg();
+  }
+
+  std::string text;
+  if (argc >= 3) {
+    std::ifstream file(argv[2], std::ios::binary);
+    if (!file.is_open()) {
+      LOG(FATAL) << "Failed to open the text file " << argv[2];
+    }
+    text.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  } else {
+    const std::string paragraph =
+        "Once upon a time, there was a little girl named Lily. She loved to play outside "
+        "in the sunshine. 从前有一个小女孩，她喜欢在阳光下玩耍。 1234567890 !?\n";
+    while (text.size() < 64 * 1024) {
+      text += paragraph;
+    }
+  }
+  const int32_t repeat = argc >= 4 ? std::atoi(argv[3]) : 20;
+
+  //先跑一遍预热
+  size_t token_num = encoder.encode(text).size();
+  const auto start = std::chrono::steady_clock::now();
+  for (int32_t i = 0; i < repeat; ++i) {
+    token_num = encoder.encode(text).size();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const double megabytes = static_cast<double>(text.size()) * repeat / (1024.0 * 1024.0);
+  printf("text: %zu bytes, %zu tokens\n", text.size(), token_num);
+  printf("encode: %.3lf ms per call, %.2lf MB/s\n", seconds * 1000.0 / repeat,
+         megabytes / seconds);
+  return 0;
+}
@@ -1,8 +1,14 @@
 #ifndef KUIPER_INCLUDE_BASE_ALLOC_H_
 #define KUIPER_INCLUDE_BASE_ALLOC_H_
+#include <atomic>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "base.h"
+#include "huge_page.h"
+#include "numa.h"
 namespace base{
 enum class MemcpyKind {
     kMemcpyCPU2CPU = 0,
@@ -13,29 +19,109 @@ enum class MemcpyKind {
 
 /// @brief 只负责分配动作，不保存任何数据，有一个分配时候需要的数据类型。
 class DeviceAllocator{
-    
+    public:
     explicit DeviceAllocator(DeviceType device_type):device_type_(device_type){}
     virtual DeviceType device_type()const{
         return device_type_;
     }
     //这里最后没有=0，因为CPUDevice不需要
-    virtual void memcpy(const void * src, void *dst, size_t size)const;
+    virtual void memcpy(const void* src_ptr, void* dest_ptr, size_t byte_size,
+                        MemcpyKind memcpy_kind = MemcpyKind::kMemcpyCPU2CPU, void* stream = nullptr,
+                        bool need_sync = false) const;
     //= 0 表示这是一个纯虚函数（Pure Virtual Function） 。它的作用是定义一种接口规范，强制要求派生类必须实现该函数，否则派生类也会成为抽象类，无法实例化对象。
     virtual void* allocate(size_t size) const = 0;
     virtual void release(void* ptr)const=0;
     
     virtual void memset_zero(void* ptr, size_t byte_size, void* stream, bool need_sync = false);
 
+    /// @brief ptr指向的内存是不是由大页支撑的
+    virtual bool is_huge_page(const void* ptr) const;
+
     private:
         DeviceType device_type_ = DeviceType::kDeviceUnknown;
 };
 
+/// @brief CPU缓存池的统计信息
+struct CPUAllocatorStats {
+    size_t hit_cnt = 0;             //从空闲链表直接拿到的次数
+    size_t miss_cnt = 0;            //需要向系统申请的次数
+    size_t trim_cnt = 0;            //触发回收的次数
+    size_t in_use_byte_size = 0;    //正在被使用的池化内存
+    size_t cached_byte_size = 0;    //空闲链表里缓存着的内存
+};
+
+//和CUDADeviceAllocator一样对释放的内存做缓存，但不是线性扫描busy标记：
+//申请大小按2的幂每段再分4档取整成size class，每个class一个空闲链表，查找和归还都是O(1)。
+//取整带来的浪费不超过25%，同一个class的内存块可以互相复用。
+//超过kMaxPooledByteSize的大块（通常是权重）不进池子，直接向系统申请和释放。
+//缓存的空闲内存超过max_cached_byte_size_时，把空闲链表回收到一半。
+//huge_page_policy_不是kHugePageNone时，不小于kHugePageByteSize的申请直接mmap并按策略申请2M大页，
+//小块内存按64字节对齐，满足AVX-512的对齐加载。
 class CPUDeviceAllocator :public DeviceAllocator{
     public:
         explicit CPUDeviceAllocator();
+        ~CPUDeviceAllocator();
         void* allocate(size_t size) const override;
         void release(void* ptr)const override;
+
+        /// @brief 把缓存的空闲内存还给系统，直到缓存量不超过target_byte_size
+        void trim(size_t target_byte_size = 0) const;
+
+        void set_max_cached_byte_size(size_t max_cached_byte_size);
+
+        void set_huge_page_policy(HugePagePolicy policy);
+
+        HugePagePolicy huge_page_policy() const;
+
+        bool is_huge_page(const void* ptr) const override;
+
+        CPUAllocatorStats stats() const;
+
+        static constexpr size_t kMaxPooledByteSize = size_t(256) * 1024 * 1024;
+
+        static constexpr size_t kAlignment = 64;
+
+    private:
+        //池子管理的每块内存，size_class为-1的是不进池子的大块
+        struct PooledBlock {
+            int32_t size_class = -1;
+            size_t mapped_byte_size = 0;    //mmap出来的块的映射大小，posix_memalign的为0
+            bool is_explicit_huge_page = false;
+        };
+
+        static int32_t size_class(size_t byte_size);
+        static size_t class_byte_size(int32_t size_class);
+        void* system_allocate(size_t byte_size, PooledBlock& block) const;
+        void system_release(void* ptr, const PooledBlock& block) const;
+        void trim_locked(size_t target_byte_size) const;
+
+    private:
+        size_t max_cached_byte_size_ = size_t(1024) * 1024 * 1024;
+        std::atomic<HugePagePolicy> huge_page_policy_{HugePagePolicy::kHugePageNone};
+        mutable std::mutex mutex_;
+        mutable CPUAllocatorStats stats_;
+        mutable std::vector<std::vector<void*>> free_lists_;
+        mutable std::unordered_map<void*, PooledBlock> blocks_;
 };
+/// @brief 按NUMA策略放置的CPU内存分配器
+//直接mmap整页的匿名内存，在第一次写之前用mbind设置策略，所以内存落在哪个节点和谁先写无关。
+//权重这种一次分配、长期使用的大块内存才值得用它，不做缓存。
+class CPUNumaAllocator : public DeviceAllocator {
+    public:
+        explicit CPUNumaAllocator(NumaPolicy policy, int32_t node = 0);
+        void* allocate(size_t byte_size) const override;
+        void release(void* ptr) const override;
+
+        NumaPolicy policy() const;
+        int32_t node() const;
+
+    private:
+        NumaPolicy policy_ = NumaPolicy::kNumaPolicyDefault;
+        int32_t node_ = 0;
+        mutable std::mutex mutex_;
+        mutable std::unordered_map<void*, size_t> mapped_sizes_;
+};
+
 class CPUDeviceAllocatorFactory{
     public:
         static std::shared_ptr<CPUDeviceAllocator> get_instance(){
@@ -76,7 +162,7 @@ class CUDADeviceAllocator : public DeviceAllocator{
     mutable std::map<int, std::vector<CudaMemoryBuffer>> big_buffers_map_;
     mutable std::map<int, std::vector<CudaMemoryBuffer>> cuda_buffers_map_;
 };
-class CUDADeviceAllocatorFactor{
+class CUDADeviceAllocatorFactory{
     public:
         static std::shared_ptr<CUDADeviceAllocator> get_instance(){
             if(!instance){
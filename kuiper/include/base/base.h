@@ -3,6 +3,11 @@
 #include <glog/logging.h>
 #include <cstdint>
 #include <string>
+#define UNUSED(expr) \
+  do {               \
+    (void)(expr);    \
+  } while (0)
+
 namespace base{
 
 enum class DeviceType:uint8_t{
@@ -15,6 +20,17 @@ enum class DataType:uint8_t{
     kDataTypeFp32 = 1,
     kDataTypeInt8 = 2,
     kDataTypeInt32 = 3,
+    //IEEE半精度和bfloat16，只用来存权重，计算时在寄存器里转回fp32
+    kDataTypeFp16 = 4,
+    kDataTypeBf16 = 5,
+    //两个4位无符号数打包在一个字节里，按32个一块：第j个字节的低4位是第j个，高4位是第j + 16个
+    kDataTypeInt4 = 6,
+};
+//权重在内存里的排布，kernel按它选择实现
+enum class TensorLayout:uint8_t{
+    kLayoutRowMajor = 0,
+    //每16行一个panel，panel内按[dim1][16]存放，行数补齐到16的倍数；int8的每组前面还有16行各自的scale
+    kLayoutPanel16 = 1,
 };
 enum class ModelType:uint8_t{
     kModelTypeUnknown = 0,
@@ -27,9 +43,18 @@ inline size_t DataTypeSize(DataType data_type){
         return sizeof(int8_t);
       } else if (data_type == DataType::kDataTypeInt32) {
         return sizeof(int32_t);
+      } else if (data_type == DataType::kDataTypeFp16 || data_type == DataType::kDataTypeBf16) {
+        return sizeof(uint16_t);
       } else {
         return 0;
       }
+}
+//elem_num个元素占的字节数，int4两个元素一个字节，其他类型就是elem_num * DataTypeSize
+inline size_t DataTypeByteSize(DataType data_type, size_t elem_num) {
+  if (data_type == DataType::kDataTypeInt4) {
+    return (elem_num + 1) / 2;
+  }
+  return elem_num * DataTypeSize(data_type);
 }
     //这是一个 C++ 的 禁止拷贝类（Non-copyable class）的经典实现，其核心目的是通过禁用拷贝构造函数和拷贝赋值运算符，阻止类的对象被复制或赋值。以下是逐行解析：
 //核心设计目的
@@ -12,13 +12,13 @@ namespace base{
 
 //为了解决A处说到的可能导致的内存泄露问题，我们设计了一个Buffer类来管理用分配器申请到的内存资源，
 //通俗来讲，是为了管理何时进行内存分配，分配多大的内存，自动free不用的指针。
-class Buffer:public NoCopyable, std::enable_shared_from_this<Buffer>{
+class Buffer:public NoCopyable, public std::enable_shared_from_this<Buffer>{
     private:
         size_t byte_size_ = 0;
         DeviceType device_type_ = DeviceType::kDeviceUnknown;
         //2. ptr_ 这块内存的地址，主要有两种来源， 一种是外部直接赋值得到的， Buffer不需要对它进行管理，和它的关系是借用，不负责它的生命周期管理，这种情况下对应下方use_external的值置为true。
         //3. 另外一种是需要Buffer对这块内存进行管理的，所以use_external值为false，表示需要对它的生命周期进行管理，也就是没人使用该Buffer的时候会自动将ptr_指向的地址用对应类型的Allocator完成释放。
-        void * ptr_;
+        void * ptr_ = nullptr;
         bool use_external_ = false;     //是否拥有这块数据的所有权
         std::shared_ptr<DeviceAllocator> allocator_;
     public:
@@ -26,6 +26,9 @@ class Buffer:public NoCopyable, std::enable_shared_from_this<Buffer>{
 
         explicit Buffer(size_t byte_size, std::shared_ptr<DeviceAllocator> allocator = nullptr,
                     void* ptr = nullptr, bool use_external = false);
+
+        virtual ~Buffer();
+
         bool allocate();
 
         void copy_from(const Buffer& buffer) const;
@@ -46,6 +49,9 @@ class Buffer:public NoCopyable, std::enable_shared_from_this<Buffer>{
       
         bool is_external() const;
 
+        /// @brief 这块内存当前是不是由2M大页支撑的，外部传入的内存（比如mmap的权重）也会去查
+        bool is_huge_page() const;
+
 };
 
 
@@ -0,0 +1,12 @@
+#ifndef KUIPER_INCLUDE_BASE_CPU_CONFIG_H_
+#define KUIPER_INCLUDE_BASE_CPU_CONFIG_H_
+#include <memory>
+#include "base/thread_pool.h"
+namespace kernel {
+/// @brief CPU上layer的执行配置，和CudaConfig一样由外部创建，所有layer共用同一个
+//forward时thread_pool会作为kernel最后的stream参数传下去。
+struct CpuConfig {
+  std::shared_ptr<base::ThreadPool> thread_pool;
+};
+}  // namespace kernel
+#endif  // KUIPER_INCLUDE_BASE_CPU_CONFIG_H_
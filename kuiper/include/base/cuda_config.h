@@ -1,18 +1,25 @@
 #ifndef BLAS_HELPER_H
 #define BLAS_HELPER_H
+#ifdef KUIPER_USE_CUDA
 #include <cublas_v2.h>
 #include <cuda_runtime_api.h>
+#else
+//没有CUDA时只留下stream的类型，和cuda_runtime里的定义一致，接口不用跟着变
+typedef struct CUstream_st* cudaStream_t;
+#endif
 namespace kernel{
     struct CudaConfig
     {
         /* data */
         cudaStream_t stream = nullptr;
         ~CudaConfig(){
+#ifdef KUIPER_USE_CUDA
             if(stream){
                 cudaStreamDestroy(stream);
             }
+#endif
         }
     };
     
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,31 @@
+#ifndef KUIPER_INCLUDE_BASE_HUGE_PAGE_H_
+#define KUIPER_INCLUDE_BASE_HUGE_PAGE_H_
+#include <cstddef>
+#include <cstdint>
+namespace base {
+constexpr size_t kHugePageByteSize = size_t(2) * 1024 * 1024;
+
+/// @brief 大块内存用不用2M的大页
+enum class HugePagePolicy : uint8_t {
+  kHugePageNone = 0,         //普通4K页
+  kHugePageTransparent = 1,  //madvise(MADV_HUGEPAGE)，由内核的THP尽量合并成大页
+  kHugePageExplicit = 2,     //先试MAP_HUGETLB（需要预留的大页），失败了退回到THP
+};
+
+/// @brief 按policy映射一块匿名内存，起始地址按2M对齐
+//mapped_byte_size返回实际映射的大小，释放时传给huge_page_unmap；
+//is_explicit返回是否拿到了MAP_HUGETLB的大页，THP是否真的生效要用is_huge_page_backed去查。
+void* huge_page_map(size_t byte_size, HugePagePolicy policy, size_t* mapped_byte_size,
+                    bool* is_explicit);
+
+void huge_page_unmap(void* ptr, size_t mapped_byte_size);
+
+/// @brief 在[ptr, ptr + byte_size)上申请THP，失败时只打日志，内存照常可用
+bool advise_huge_page(void* ptr, size_t byte_size);
+
+/// @brief 查/proc/self/smaps，ptr所在的映射当前是不是由大页支撑的
+//MAP_HUGETLB的映射看KernelPageSize，THP看AnonHugePages/FilePmdMapped，
+//THP的页是在第一次写（或者khugepaged合并）之后才出现的，所以要在使用之后查。
+bool is_huge_page_backed(const void* ptr);
+}  // namespace base
+#endif  // KUIPER_INCLUDE_BASE_HUGE_PAGE_H_
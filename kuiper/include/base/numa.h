@@ -0,0 +1,47 @@
+#ifndef KUIPER_INCLUDE_BASE_NUMA_H_
+#define KUIPER_INCLUDE_BASE_NUMA_H_
+#include <cstdint>
+#include <vector>
+#include "base/base.h"
+namespace base {
+/// @brief 内存在NUMA节点上的放置方式
+enum class NumaPolicy : uint8_t {
+  kNumaPolicyDefault = 0,     //first-touch，哪个线程先写就落在哪个节点
+  kNumaPolicyInterleave = 1,  //按页轮流放到所有节点上，带宽是所有节点之和
+  kNumaPolicyBind = 2,        //只放在指定的节点上
+};
+
+/// @brief 从/sys/devices/system/node读出来的NUMA拓扑
+//读不到（比如非Linux或者容器里没有挂载sysfs）的时候退化成一个包含所有cpu的节点。
+class NumaTopology {
+ public:
+  static const NumaTopology& get_instance();
+
+  int32_t node_num() const;
+
+  int32_t cpu_num() const;
+
+  const std::vector<int32_t>& node_cpus(int32_t node) const;
+
+ private:
+  NumaTopology();
+
+ private:
+  std::vector<std::vector<int32_t>> node_cpus_;
+};
+
+/// @brief 当前进程实际能用的cpu数
+//取sched_getaffinity的亲和性掩码里的cpu数，再用cgroup的cpu配额（cpu.max或者cfs_quota_us）截断，
+//容器里hardware_concurrency()返回的是整机的cpu数，按它开线程会超订。
+int32_t available_cpu_num();
+
+/// @brief 给[ptr, ptr + byte_size)设置NUMA内存策略，ptr必须按页对齐，必须在第一次写之前调用
+bool numa_set_memory_policy(void* ptr, size_t byte_size, NumaPolicy policy, int32_t node = 0);
+
+/// @brief 把当前线程绑定到node上的所有cpu
+bool pin_thread_to_node(int32_t node);
+
+/// @brief 把当前线程绑定到一个cpu上
+bool pin_thread_to_cpu(int32_t cpu);
+}  // namespace base
+#endif  // KUIPER_INCLUDE_BASE_NUMA_H_
@@ -0,0 +1,107 @@
+#ifndef KUIPER_INCLUDE_BASE_THREAD_POOL_H_
+#define KUIPER_INCLUDE_BASE_THREAD_POOL_H_
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "base/base.h"
+#include "base/buffer.h"
+namespace base {
+/// @brief 整个引擎共用的work-stealing线程池，CPU上的kernel都在它上面并行
+//调用parallel_for的线程自己也算一个worker（编号0），所以thread_num个worker只创建thread_num - 1个线程。
+//任务按grain切成块，开始时每个worker分到连续的一段块，自己从前往后取，
+//取完了从别的worker那一段的后面偷走一半，块的区间用一个64位的原子变量表示，取和偷都是一次CAS。
+//decode一步里有几十个算子，每个都只有几十微秒，所以worker做完之后先自旋等下一个任务，
+//自旋spin_count次还没有新任务才睡到条件变量上，避免每个算子都付一次唤醒线程的代价。
+//pin_to_numa_nodes为true时worker 1..thread_num - 1按编号连续地分到各个NUMA节点上并绑核，
+//kernel可以通过worker_node/node_rank按节点划分任务。worker 0是没有绑核的调用线程，不属于任何节点，
+//按节点划分的任务里它什么也不做；worker数不够每个节点分一个时不分组（node_num为1）。
+class ThreadPool : public NoCopyable {
+ public:
+  //func(begin, end, worker_id)
+  using RangeFunc = std::function<void(int64_t, int64_t, int32_t)>;
+  //func(worker_id)
+  using WorkerFunc = std::function<void(int32_t)>;
+
+  static constexpr int32_t kDefaultSpinCount = 1 << 14;
+
+  //thread_num为0时使用进程能用的所有cpu（考虑亲和性掩码和cgroup配额）
+  explicit ThreadPool(int32_t thread_num = 0, bool pin_to_numa_nodes = false,
+                      int32_t spin_count = kDefaultSpinCount);
+
+  ~ThreadPool();
+
+  int32_t thread_num() const;
+
+  /// @brief 把[begin, end)按grain切块并行执行，返回时所有块都已经执行完
+  //在worker里面再调用（嵌套并行）时直接在当前线程串行执行。
+  void parallel_for(int64_t begin, int64_t end, int64_t grain, const RangeFunc& func);
+
+  /// @brief 每个worker恰好执行一次func，不做work stealing，用于需要固定划分的任务
+  void run(const WorkerFunc& func);
+
+  /// @brief worker私有的临时内存，至少byte_size字节，64字节对齐，在下一次更大的申请之前一直有效
+  void* scratch(int32_t worker_id, size_t byte_size);
+
+  int32_t node_num() const;
+
+  /// @brief worker所在的节点，分组时worker 0返回-1
+  int32_t worker_node(int32_t worker_id) const;
+
+  /// @brief worker在它所在节点的worker里的序号，不属于任何节点时返回-1
+  int32_t node_rank(int32_t worker_id) const;
+
+  int32_t node_worker_num(int32_t node) const;
+
+  /// @brief 没有通过CpuConfig设置线程池的kernel使用的默认线程池
+  static ThreadPool* default_pool();
+
+ private:
+  void worker_loop(int32_t worker_id);
+
+  void execute(int32_t worker_id);
+
+  bool pop_chunk(int32_t worker_id, int64_t& chunk);
+
+  bool steal_chunk(int32_t worker_id, int64_t& chunk);
+
+  void dispatch(int64_t chunk_num, bool steal);
+
+ private:
+  //每个worker待执行的块[begin, end)，高32位是begin，低32位是end，单独占一个cache line
+  struct alignas(64) ChunkRange {
+    std::atomic<uint64_t> range{0};
+  };
+
+  int32_t thread_num_ = 1;
+  int32_t spin_count_ = kDefaultSpinCount;
+  int32_t node_num_ = 1;
+  std::vector<int32_t> worker_nodes_;
+  std::vector<int32_t> node_first_workers_;
+
+  std::vector<std::thread> threads_;
+  std::unique_ptr<ChunkRange[]> ranges_;
+  std::vector<std::shared_ptr<Buffer>> scratches_;
+
+  //当前任务，只在dispatch_mutex_保护下由调用线程修改，generation_的release/acquire保证worker看到的是完整的任务
+  const RangeFunc* range_func_ = nullptr;
+  const WorkerFunc* worker_func_ = nullptr;
+  int64_t job_begin_ = 0;
+  int64_t job_end_ = 0;
+  int64_t job_grain_ = 1;
+  bool job_steal_ = true;
+
+  std::mutex dispatch_mutex_;
+  std::atomic<uint64_t> generation_{0};
+  std::atomic<int32_t> pending_workers_{0};
+  std::atomic<bool> stop_{false};
+
+  std::mutex park_mutex_;
+  std::condition_variable park_cv_;
+  int32_t parked_num_ = 0;
+};
+}  // namespace base
+#endif  // KUIPER_INCLUDE_BASE_THREAD_POOL_H_
@@ -0,0 +1,34 @@
+#ifndef KUIPER_INCLUDE_MODEL_CONFIG_H_
+#define KUIPER_INCLUDE_MODEL_CONFIG_H_
+#include <cstdint>
+namespace model {
+/// @brief 模型文件开头的配置头，布局和llama2.c导出的checkpoint一致，紧跟在后面的就是权重。
+struct ModelConfig {
+  int32_t dim = 0;
+  int32_t hidden_dim = 0;
+  int32_t layer_num = 0;
+  int32_t head_num = 0;
+  int32_t kv_head_num = 0;
+  //vocab_size为负数表示分类头的权重没有和embedding共享
+  int32_t vocab_size = 0;
+  int32_t seq_len = 0;
+};
+
+/// @brief 由ModelConfig推出来的、建图时真正用到的各个维度
+struct TransformerConfig {
+  int32_t dim = 0;
+  int32_t hidden_dim = 0;
+  int32_t layer_num = 0;
+  int32_t head_num = 0;
+  int32_t kv_head_num = 0;
+  int32_t head_size = 0;
+  //key/value的宽度是kv_head_num * head_size，每kv_mul个query head共用一个kv head
+  int32_t kv_dim = 0;
+  int32_t kv_mul = 0;
+  int32_t vocab_size = 0;
+  int32_t seq_len = 0;
+  //分类头是否和embedding共用一份权重
+  bool is_shared_weight = false;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_CONFIG_H_
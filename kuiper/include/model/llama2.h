@@ -0,0 +1,159 @@
+#ifndef KUIPER_INCLUDE_MODEL_LLAMA2_H_
+#define KUIPER_INCLUDE_MODEL_LLAMA2_H_
+#include <memory>
+#include <string>
+#include <vector>
+#include "base/base.h"
+#include "base/cpu_config.h"
+#include "model/config.h"
+#include "model/memory_planner.h"
+#include "model/model_loader.h"
+#include "model/pack_cache.h"
+#include "op/add.h"
+#include "op/embedding.h"
+#include "op/linear.h"
+#include "op/mha.h"
+#include "op/paged_kv_cache.h"
+#include "op/rmsnorm.h"
+#include "op/rope.h"
+#include "op/swiglu.h"
+#include "tensor/tensor.h"
+namespace model {
+/// @brief 一次forward里的一行：序列seq_id在位置pos上输入token
+struct BatchRow {
+  int32_t seq_id = 0;
+  int32_t pos = 0;
+  int32_t token = 0;
+  //这一行要不要算logits，prefill中间的行不需要，省掉分类头[vocab_size, dim]的那次乘法
+  bool need_logits = true;
+};
+
+/// @brief Llama2结构的模型，权重按llama2.c导出的顺序从ModelLoader里零拷贝地绑定。
+//forward一次处理若干行BatchRow，这些行可以来自不同的序列：
+//embedding、各个Linear、SwiGLU和norm都在堆叠起来的[rows, dim]上算，每个权重每步只读一遍；
+//RoPE对所有行一次做完，每一行用自己的位置；注意力按序列分段做，每段用这个序列在PagedKVCache里的block_table。
+//同一个序列的多行必须相邻并且位置连续，这样一段prompt（prefill）的key/value一次写进cache，
+//再带因果mask一起做注意力，Linear在这么多行上走GEMM，而不是每个token一次GEMV。
+//每一行的位置需要调用方事先在kv_cache()里reserve好。
+class LLama2Model : public base::NoCopyable {
+ public:
+  explicit LLama2Model(std::string model_path, bool is_quant_model = false);
+
+  /// @brief 加载权重、建好所有layer，并按max_rows行分配激活和logits，
+  //kv cache一共kv_block_num个block，每个block放kv_block_size个位置，
+  //kv_format选fp16/int8时同样的内存能放下2/4倍的位置，attention读cache的带宽也相应减少
+  base::Status init(base::DeviceType device_type, int32_t max_rows, int32_t kv_block_size,
+                    int32_t kv_block_num,
+                    op::KVCacheFormat kv_format = op::KVCacheFormat::kFp32);
+
+  /// @brief 跑一步，logits返回[need_logits的行数, vocab_size]，按行的顺序排列，
+  //指向模型内部的缓冲区，下次forward之前有效；没有行需要logits时返回空tensor
+  base::Status forward(const std::vector<BatchRow>& rows, tensor::Tensor& logits);
+
+  /// @brief 所有layer共用的线程池，init之前或之后设置都可以
+  void set_cpu_config(std::shared_ptr<kernel::CpuConfig> config);
+
+  /// @brief 在init之前调用：非量化模型的各个Linear（wq、wk、wv、wo、w2和分类头）在加载之后
+  //转成fp16或bf16，decode时读权重的字节数减半。模型文件还是fp32的，同一个文件可以按部署选择精度；
+  //embedding、norm和融合的SwiGLU还是fp32。fp16/bf16的权重不做prepack
+  void set_weight_data_type(base::DataType data_type);
+
+  /// @brief 在init之前调用：量化模型文件里Linear（wq、wk、wv、wo、w2和不共享的分类头）的存储格式，
+  //默认是int8；kDataTypeInt4时每组一个fp16的scale，with_min时再跟一个fp16的min，
+  //group_size要是32的倍数。融合的SwiGLU不支持int4，w1和w3在文件里还是int8
+  void set_quant_weight_type(base::DataType data_type, bool with_min = false);
+
+  /// @brief 在init之前调用：init时把所有Linear的fp32/int8权重重排成kernel原生的panel排布（kLayoutPanel16）。
+  //打包的结果写进cache_path（为空时是模型文件路径加上".packed"），之后的init直接mmap这个缓存，不再重新打包；
+  //缓存写不进去时只打印警告，这次照常使用内存里打包好的权重
+  void set_weight_prepack(bool prepack, std::string cache_path = "");
+
+  /// @brief 在init之前调用：各个Linear（wq、wk、wv、wo、w2和分类头）的权重在加载和转换之后
+  //按policy重新放到NUMA节点上，见LinearLayer::set_numa_policy。kNumaPolicyBind要配合
+  //pin_to_numa_nodes的线程池（set_cpu_config）才能让每个节点只读本地的那一段；
+  //按节点切分过的Linear不再做prepack。只有一个节点时什么也不做
+  void set_numa_policy(base::NumaPolicy policy);
+
+  /// @brief 在init之前调用：模型文件的映射和kv cache是否使用2M大页，
+  //减少decode时读权重和cache的TLB miss。文件映射只能通过THP（madvise）申请，kHugePageExplicit对它和kHugePageTransparent一样；
+  //kv cache用一个单独的CPUDeviceAllocator按policy申请，不改变全局分配器的设置
+  void set_huge_page_policy(base::HugePagePolicy policy);
+
+  const TransformerConfig& config() const;
+
+  std::shared_ptr<op::PagedKVCache> kv_cache() const;
+
+  int32_t max_rows() const;
+
+  /// @brief 激活共用的那块arena的大小，生命周期不重叠的激活（比如hidden和query/key/value）共用内存
+  size_t activation_byte_size() const;
+
+ private:
+  base::Status create_layers();
+
+  base::Status load_weights();
+
+  base::Status init_buffers();
+
+  //按固定的顺序打包所有能打包的Linear，优先使用缓存文件
+  base::Status prepack_weights();
+
+  //rows里同一个序列的每一段各做一次注意力
+  base::Status attention(const std::vector<BatchRow>& rows, int32_t layer_idx);
+
+  std::vector<op::Layer*> all_layers() const;
+
+  //顺序固定：每个block的wq、wk、wv、wo、w2，最后是分类头，打包缓存按这个顺序存放
+  std::vector<op::LinearLayer*> linear_layers() const;
+
+ private:
+  std::string model_path_;
+  bool is_quant_model_ = false;
+  base::DeviceType device_type_ = base::DeviceType::kDeviceUnknown;
+  int32_t max_rows_ = 0;
+  TransformerConfig config_;
+  std::unique_ptr<ModelLoader> loader_;
+  base::DataType weight_data_type_ = base::DataType::kDataTypeFp32;
+  base::DataType quant_weight_type_ = base::DataType::kDataTypeInt8;
+  bool quant_weight_with_min_ = false;
+  bool weight_prepack_ = false;
+  base::NumaPolicy numa_policy_ = base::NumaPolicy::kNumaPolicyDefault;
+  base::HugePagePolicy huge_page_policy_ = base::HugePagePolicy::kHugePageNone;
+  std::string pack_cache_path_;
+  //打包的权重可能指向这块映射，要比layer活得久
+  std::unique_ptr<WeightPackCache> pack_cache_;
+  std::shared_ptr<op::PagedKVCache> kv_cache_;
+  std::shared_ptr<kernel::CpuConfig> cpu_config_;
+
+  std::shared_ptr<op::EmbeddingLayer> embedding_layer_;
+  //第0个block的输入没有残差可加，用单独的RMSNorm，权重和attention_norm_layers_[0]是同一份
+  std::shared_ptr<op::RmsNormLayer> first_norm_layer_;
+  std::vector<std::shared_ptr<op::AddRMSNormLayer>> attention_norm_layers_;
+  std::vector<std::shared_ptr<op::AddRMSNormLayer>> ffn_norm_layers_;
+  std::shared_ptr<op::AddRMSNormLayer> final_norm_layer_;
+  std::vector<std::shared_ptr<op::LinearLayer>> wq_layers_;
+  std::vector<std::shared_ptr<op::LinearLayer>> wk_layers_;
+  std::vector<std::shared_ptr<op::LinearLayer>> wv_layers_;
+  std::vector<std::shared_ptr<op::LinearLayer>> wo_layers_;
+  std::vector<std::shared_ptr<op::SwiGLULayer>> ffn_layers_;
+  std::vector<std::shared_ptr<op::LinearLayer>> w2_layers_;
+  std::shared_ptr<op::LinearLayer> cls_layer_;
+  std::shared_ptr<op::RoPELayer> rope_layer_;
+  std::shared_ptr<op::MultiHeadAttention> mha_layer_;
+
+  size_t activation_byte_size_ = 0;
+  //激活都是[max_rows, ...]，每步只用前rows.size()行，内存由MemoryPlanner在一块arena里规划
+  tensor::Tensor tokens_;
+  tensor::Tensor positions_;
+  tensor::Tensor x_;
+  tensor::Tensor xb_;
+  tensor::Tensor query_;
+  tensor::Tensor key_;
+  tensor::Tensor value_;
+  tensor::Tensor attn_out_;
+  tensor::Tensor proj_out_;
+  tensor::Tensor hidden_;
+  tensor::Tensor logits_;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_LLAMA2_H_
@@ -0,0 +1,84 @@
+#ifndef KUIPER_INCLUDE_MODEL_MEMORY_PLANNER_H_
+#define KUIPER_INCLUDE_MODEL_MEMORY_PLANNER_H_
+#include <memory>
+#include <string>
+#include <vector>
+#include "base/alloc.h"
+#include "base/base.h"
+#include "base/buffer.h"
+#include "op/layer.h"
+#include "tensor/tensor.h"
+namespace model {
+/// @brief 中间激活的静态内存规划
+//用法：先add_tensor登记所有中间tensor，再按执行顺序add_step登记每个layer用到哪些tensor，
+//plan()根据第一次和最后一次被用到的step算出每个tensor的生命周期，生命周期不重叠的tensor可以共用同一段内存；
+//tensor按大小从大到小放进和它生命周期重叠的tensor之间最小的放得下的空隙（best fit）。
+//allocate()只申请一块对齐的arena，每个tensor用use_external的Buffer指向arena里自己的offset，
+//并通过set_input/set_output绑定到对应的layer上。这些Buffer都持有arena的引用，planner先析构也不影响
+//已经拿出去的tensor。这样forward过程中不再有任何内存申请，
+//常驻内存是最大同时存活的集合，而不是所有中间tensor之和。
+//同一个tensor被多个transformer block反复使用时，生命周期会覆盖第一次到最后一次使用之间的所有step。
+class MemoryPlanner : public base::NoCopyable {
+ public:
+  explicit MemoryPlanner(base::DeviceType device_type = base::DeviceType::kDeviceCPU,
+                         size_t alignment = 64);
+
+  /// @brief 登记一个中间tensor，返回它的id
+  int32_t add_tensor(const std::string& name, base::DataType data_type,
+                     const std::vector<int32_t>& dims);
+
+  /// @brief 按执行顺序登记一个layer和它的输入输出tensor，id为-1的位置不绑定（比如权重或外部传入的tensor）
+  base::Status add_step(op::Layer* layer, const std::vector<int32_t>& input_ids,
+                        const std::vector<int32_t>& output_ids);
+
+  /// @brief 标记一个tensor在整个forward期间都不能被复用，比如logits这样forward之后还要读的输出
+  void mark_persistent(int32_t id);
+
+  base::Status plan();
+
+  base::Status allocate(std::shared_ptr<base::DeviceAllocator> alloc);
+
+  tensor::Tensor& get_tensor(int32_t id);
+
+  const tensor::Tensor& get_tensor(int32_t id) const;
+
+  int32_t tensor_num() const;
+
+  size_t offset(int32_t id) const;
+
+  /// @brief 规划之后arena的大小
+  size_t arena_byte_size() const;
+
+  /// @brief 每个tensor各自分配时需要的总大小，用来和arena_byte_size比较
+  size_t total_byte_size() const;
+
+ private:
+  struct PlannedTensor {
+    std::string name;
+    tensor::Tensor tensor;
+    size_t byte_size = 0;
+    size_t offset = 0;
+    int32_t first_step = -1;
+    int32_t last_step = -1;
+    bool persistent = false;
+  };
+
+  struct PlannedStep {
+    op::Layer* layer = nullptr;
+    std::vector<int32_t> input_ids;
+    std::vector<int32_t> output_ids;
+  };
+
+  void touch(int32_t id, int32_t step);
+
+ private:
+  base::DeviceType device_type_ = base::DeviceType::kDeviceUnknown;
+  size_t alignment_ = 64;
+  bool is_planned_ = false;
+  size_t arena_byte_size_ = 0;
+  std::vector<PlannedTensor> tensors_;
+  std::vector<PlannedStep> steps_;
+  std::shared_ptr<base::Buffer> arena_;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_MEMORY_PLANNER_H_
@@ -0,0 +1,53 @@
+#ifndef KUIPER_INCLUDE_MODEL_MODEL_LOADER_H_
+#define KUIPER_INCLUDE_MODEL_MODEL_LOADER_H_
+#include <memory>
+#include <string>
+#include <vector>
+#include "base/base.h"
+#include "model/config.h"
+#include "model/raw_model_data.h"
+#include "op/layer.h"
+namespace model {
+/// @brief 零拷贝的checkpoint加载器。
+//文件被只读mmap进来，load_weight按文件中的顺序依次把下一块权重的地址交给LayerParam::set_weight，
+//set_weight再把它包成use_external_ = true的Buffer，整个过程没有任何堆上的拷贝。
+//int8模型里量化层的每个权重后面紧跟着它的fp32 scales，和set_weight里的布局一致；
+//设成int4的量化层是打包的权重加上每组一个fp16的scale（以及可选的fp16 min）；
+//不是量化层的权重（norm、embedding）在文件里仍然是fp32。
+//layer在load_weight之前用set_weight_data_type设成fp16/bf16的话，文件里这一块就按每个元素2字节读。
+//use_huge_page为true时映射的起始地址按2M对齐并madvise(MADV_HUGEPAGE)，
+//文件页能不能合并成大页取决于内核（CONFIG_READ_ONLY_THP_FOR_FS），不支持时照常使用4K页，
+//每个权重tensor的is_huge_page()可以查到实际结果。
+class ModelLoader : public base::NoCopyable {
+ public:
+  explicit ModelLoader(std::string model_path, bool is_quant_model = false,
+                       bool use_huge_page = false);
+
+  base::Status open();
+
+  //把layer的第idx个权重绑定到文件里下一块dims大小的数据上，并把游标移到这块权重（以及scales）之后
+  base::Status load_weight(op::LayerParam* layer, int32_t idx, const std::vector<int32_t>& dims);
+
+  //跳过byte_size个字节，比如不需要的freq_cis之类的权重
+  base::Status skip(size_t byte_size);
+
+  const ModelConfig& config() const;
+
+  int32_t group_size() const;
+
+  bool is_quant_model() const;
+
+  std::shared_ptr<RawModelData> raw_model_data() const;
+
+ private:
+  std::string model_path_;
+  bool is_quant_model_ = false;
+  bool use_huge_page_ = false;
+  int32_t group_size_ = 1;
+  //下一块权重离weight_data的字节数，fp32和int8模型都按字节算
+  size_t pos_ = 0;
+  ModelConfig config_;
+  std::shared_ptr<RawModelData> raw_model_data_;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_MODEL_LOADER_H_
@@ -0,0 +1,40 @@
+#ifndef KUIPER_INCLUDE_MODEL_PACK_CACHE_H_
+#define KUIPER_INCLUDE_MODEL_PACK_CACHE_H_
+#include <string>
+#include <vector>
+#include "base/base.h"
+namespace model {
+/// @brief Linear权重打包结果（kLayoutPanel16）的旁路缓存文件。
+//打包要把每个权重重排一遍，大模型上要花好几秒：第一次启动时各层在内存里打包，再按层的顺序把结果写进缓存文件，
+//之后的启动直接只读mmap这个文件，权重指向映射里的数据，和模型文件一样零拷贝，多个进程共享page cache。
+//文件头记录格式版本、排布、模型文件的大小和修改时间以及每一块的字节数，任何一项对不上都当作没有缓存。
+//映射在析构时解除，所以它必须比引用了这些权重的layer活得更久。
+class WeightPackCache : public base::NoCopyable {
+ public:
+  explicit WeightPackCache(std::string cache_path);
+
+  ~WeightPackCache();
+
+  /// @brief 映射缓存文件并校验，byte_sizes是每一块打包之后的字节数，0表示这一块没有打包
+  base::Status open(const std::string& model_path, const std::vector<size_t>& byte_sizes);
+
+  /// @brief 第idx块打包好的数据，open成功之后才有效
+  const void* data(int32_t idx) const;
+
+  /// @brief 把打包好的数据写成缓存文件，data[i]有byte_sizes[i]字节。
+  //先写到临时文件再rename，中途失败或者几个进程同时写都不会留下写了一半的缓存
+  base::Status save(const std::string& model_path, const std::vector<const void*>& data,
+                    const std::vector<size_t>& byte_sizes) const;
+
+ private:
+  void close();
+
+ private:
+  std::string cache_path_;
+  int32_t fd_ = -1;
+  void* data_ = nullptr;
+  size_t file_size_ = 0;
+  std::vector<size_t> offsets_;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_PACK_CACHE_H_
@@ -0,0 +1,33 @@
+#ifndef KUIPER_INCLUDE_MODEL_RAW_MODEL_DATA_H_
+#define KUIPER_INCLUDE_MODEL_RAW_MODEL_DATA_H_
+#include <cstddef>
+#include <cstdint>
+namespace model {
+/// @brief 对mmap映射出来的模型文件的一层薄封装。
+//data指向整个文件的起始位置，weight_data指向配置头之后第一个权重的位置。
+//所有权重都是直接指向这块只读映射的指针，不会read()到堆上再拷贝一份，
+//同一台机器上的多个进程映射同一个文件时共享page cache。
+//析构的时候munmap并关闭文件，所以它必须比所有引用了权重的layer活得更久。
+struct RawModelData {
+  virtual ~RawModelData();
+  int32_t fd = -1;
+  size_t file_size = 0;
+  void* data = nullptr;
+  void* weight_data = nullptr;
+
+  //offset的单位由子类决定，fp32是float的个数，int8是字节数
+  virtual const void* weight(size_t offset) const = 0;
+
+  //从weight_data开始还剩多少字节
+  size_t weight_byte_size() const;
+};
+
+struct RawModelDataFp32 : RawModelData {
+  const void* weight(size_t offset) const override;
+};
+
+struct RawModelDataInt8 : RawModelData {
+  const void* weight(size_t offset) const override;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_RAW_MODEL_DATA_H_
@@ -0,0 +1,110 @@
+#ifndef KUIPER_INCLUDE_MODEL_SCHEDULER_H_
+#define KUIPER_INCLUDE_MODEL_SCHEDULER_H_
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "base/base.h"
+#include "model/llama2.h"
+#include "op/prefix_cache.h"
+#include "sampler/sampler.h"
+namespace model {
+/// @brief 一个生成请求
+struct GenerationRequest {
+  int32_t request_id = 0;
+  std::vector<int32_t> prompt_tokens;
+  int32_t max_new_tokens = 0;
+  //生成出这个token就结束，-1表示不检查
+  int32_t eos_token = -1;
+  //默认贪心解码
+  sampler::SamplerConfig sampler_config;
+};
+
+/// @brief 结束的请求，output_tokens只包含新生成的部分
+struct GenerationResult {
+  int32_t request_id = 0;
+  std::vector<int32_t> output_tokens;
+};
+
+/// @brief 连续批处理的调度器
+//维护一个正在运行的batch，每次step()让batch里的每个序列出一行或者一段prompt，合成一次LLama2Model::forward，
+//这样Linear和FFN的每一行权重每步只读一遍，被所有序列共用；注意力按序列各自读自己的分页kv cache。
+//新请求在两步之间加入batch，结束的序列在这一步之后马上退出并把block还给kv cache，不用等整个batch结束。
+//prompt按块prefill：每步先给所有在decode的序列各排一行，剩下的行数（最多model的max_rows）
+//再按prefill_chunk_size切给还在读prompt的序列，长prompt分几步读完，中间不会卡住其他序列的decode。
+//kv cache不够时，最后加入的序列会被抢占：释放它的block，回到等待队列最前面，之后从头重算。
+//设置了PrefixCache时，新序列直接共享树里最长的已缓存前缀，只prefill剩下的部分；
+//读完prompt和结束时把写满的block放回树里，kv cache不够时先淘汰树里的block，再考虑抢占。
+//不是线程安全的，所有调用都应该在同一个调度线程里。
+class Scheduler : public base::NoCopyable {
+ public:
+  using TokenCallback = std::function<void(int32_t request_id, int32_t token)>;
+
+  explicit Scheduler(LLama2Model* model, int32_t max_batch_size);
+
+  base::Status add_request(GenerationRequest request);
+
+  /// @brief 接纳新请求，跑一步forward，再把结束的序列移出batch
+  base::Status step();
+
+  bool has_unfinished() const;
+
+  /// @brief 取走到目前为止已经结束的请求
+  std::vector<GenerationResult> pop_finished();
+
+  /// @brief 每个序列每步最多prefill多少个prompt token，默认是model的max_rows
+  void set_prefill_chunk_size(int32_t chunk_size);
+
+  /// @brief 每生成一个token调用一次，用来做流式输出
+  void set_token_callback(TokenCallback callback);
+
+  /// @brief 在model的kv cache上共享前缀，传nullptr关闭
+  void set_prefix_cache(std::shared_ptr<op::PrefixCache> prefix_cache);
+
+  int32_t running_num() const;
+
+  int32_t waiting_num() const;
+
+ private:
+  struct Sequence {
+    GenerationRequest request;
+    //prompt加上已经生成的token
+    std::vector<int32_t> tokens;
+    //kv cache里的序列编号，由调度器分配
+    int32_t seq_id = 0;
+    //下一个要送进模型的位置，pos < tokens.size()
+    int32_t pos = 0;
+    //这一步送进模型的行数
+    int32_t step_rows = 0;
+    //这个序列自己的采样器，随机数状态在抢占重算时保留
+    std::unique_ptr<sampler::Sampler> sampler;
+  };
+
+  //决定这一步每个序列送几行
+  void schedule_rows();
+
+  void admit();
+
+  //给每个运行中的序列reserve这一步要写的位置，不够时从后往前抢占
+  base::Status reserve();
+
+  void preempt_last();
+
+  bool is_finished(const Sequence& seq) const;
+
+ private:
+  LLama2Model* model_ = nullptr;
+  int32_t max_batch_size_ = 0;
+  int32_t prefill_chunk_size_ = 0;
+  int32_t next_seq_id_ = 0;
+  std::deque<Sequence> waiting_;
+  std::vector<Sequence> running_;
+  std::vector<GenerationResult> finished_;
+  std::vector<BatchRow> rows_;
+  TokenCallback token_callback_;
+  std::shared_ptr<op::PrefixCache> prefix_cache_;
+  //admit时prefix_cache命中的block
+  std::vector<int32_t> shared_blocks_;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_SCHEDULER_H_
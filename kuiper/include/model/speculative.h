@@ -0,0 +1,83 @@
+#ifndef KUIPER_INCLUDE_MODEL_SPECULATIVE_H_
+#define KUIPER_INCLUDE_MODEL_SPECULATIVE_H_
+#include <functional>
+#include <memory>
+#include <vector>
+#include "base/base.h"
+#include "base/cpu_config.h"
+#include "model/llama2.h"
+#include "model/scheduler.h"
+#include "sampler/random_sampler.h"
+namespace model {
+/// @brief 推测解码：小的draft模型先逐个猜出draft_len个token，target模型把它们连同上一个确定的token
+//当成一段prompt一次forward完（走prefill的GEMM和因果注意力），再从前往后逐个验证。
+//CPU上decode一个token的耗时基本就是把权重读一遍，验证draft_len + 1个token和算一个token的代价差不多，
+//draft猜得准的时候每次target的forward能确定好几个token。
+//贪心解码时接受和target的argmax一致的前缀；temperature > 0时按概率min(1, p/q)接受，
+//拒绝时从max(0, p - q)归一化后的分布里重新采样，生成结果的分布和只用target采样完全一样。
+//采样用和Scheduler一样的create_sampler，同样的seed和temperature在两边的含义一致；
+//结束条件也和Scheduler一样：eos、max_new_tokens，或者下一个token的位置到了seq_len。
+//被拒绝的位置不用清掉kv cache里的数据，回退长度并把多余的block还回池子就行，后面的token会覆盖它们。
+//两个模型各用自己的PagedKVCache，激活和kv cache都来自同一个DeviceAllocatorFactory，
+//set_cpu_config给两个模型设置同一个线程池。两个模型的词表必须一样。
+//不是线程安全的，generate期间不能有别的线程用这两个模型的kv cache。
+class SpeculativeDecoder : public base::NoCopyable {
+ public:
+  using TokenCallback = Scheduler::TokenCallback;
+
+  //Scheduler分配的序列编号都是非负的，默认用-1，和它共用kv cache时也不会撞上
+  static constexpr int32_t kDefaultSeqId = -1;
+
+  /// @brief seq_id是generate期间在两个kv cache里用的序列编号，调用方要保证别人不在用它
+  explicit SpeculativeDecoder(LLama2Model* target, LLama2Model* draft, int32_t draft_len,
+                              int32_t seq_id = kDefaultSeqId);
+
+  /// @brief 检查两个模型是否匹配，并按词表分配采样用的scratch，两个模型都要已经init过
+  base::Status init();
+
+  /// @brief 生成一个请求，直到eos、max_new_tokens或者序列长度上限。
+  //temperature > 0时不支持top_k和top_p，它们会让被接受的分布和target采样的不一致
+  base::Status generate(const GenerationRequest& request, GenerationResult& result);
+
+  /// @brief 给target和draft设置同一个线程池
+  void set_cpu_config(std::shared_ptr<kernel::CpuConfig> config);
+
+  void set_token_callback(TokenCallback callback);
+
+  /// @brief draft一共猜了多少个token，其中被target接受了多少个
+  int64_t proposed_num() const;
+
+  int64_t accepted_num() const;
+
+ private:
+  //把tokens[begin, end)送进model，位置就是下标；下标不小于logits_from的行需要logits，
+  //这些行要能放进一次forward，前面的行按max_rows分块先送进去
+  base::Status feed(LLama2Model* model, const std::vector<int32_t>& tokens, int32_t begin,
+                    int32_t end, int32_t logits_from, tensor::Tensor& logits);
+
+  //temperature <= 0时交给sampler_取argmax，否则用random_sampler_算出q写进probs再从q里采样
+  int32_t propose(const float* logits, float* probs);
+
+ private:
+  LLama2Model* target_ = nullptr;
+  LLama2Model* draft_ = nullptr;
+  int32_t draft_len_ = 0;
+  int32_t seq_id_ = kDefaultSeqId;
+  int32_t vocab_size_ = 0;
+  //两个模型seq_len的较小值
+  int32_t seq_len_ = 0;
+  int64_t proposed_num_ = 0;
+  int64_t accepted_num_ = 0;
+  //每次generate按请求的SamplerConfig重新创建，随机数状态从seed开始
+  std::unique_ptr<sampler::Sampler> sampler_;
+  //temperature > 0时sampler_就是它，接受和重新采样要用到它的分布和随机数
+  sampler::RandomSampler* random_sampler_ = nullptr;
+  //draft每个猜测位置上的分布q，[draft_len, vocab_size]
+  std::vector<float> draft_probs_;
+  //target在当前验证位置上的分布p，拒绝时原地变成max(0, p - q)
+  std::vector<float> target_probs_;
+  std::vector<BatchRow> rows_;
+  TokenCallback token_callback_;
+};
+}  // namespace model
+#endif  // KUIPER_INCLUDE_MODEL_SPECULATIVE_H_
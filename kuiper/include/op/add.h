@@ -0,0 +1,34 @@
+#ifndef KUIPER_INCLUDE_OP_ADD_H_
+#define KUIPER_INCLUDE_OP_ADD_H_
+#include "base/base.h"
+#include "layer.h"
+namespace op {
+/// @brief 残差相加 output0 = input0 + input1
+//output0可以直接传input0，这样就是原地相加，每个block不需要为结果再分配一个临时tensor。
+class VecAddLayer : public Layer {
+ public:
+  explicit VecAddLayer(base::DeviceType device_type);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+};
+
+/// @brief 融合的残差相加和RMSNorm
+//inputs：0是残差流residual，1是子层的输出delta；weight0是RMSNorm的权重[dim]。
+//outputs：0是相加之后的残差流（可以和input0是同一个tensor），1是给下一个子层用的归一化结果。
+//一次扫描同时得到两者，省掉单独的add和rmsnorm之间对隐藏状态的一次完整读写。
+class AddRMSNormLayer : public LayerParam {
+ public:
+  explicit AddRMSNormLayer(base::DeviceType device_type, int32_t dim, float eps = 1e-5f);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+
+ private:
+  int32_t dim_ = 0;
+  float eps_ = 1e-5f;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_ADD_H_
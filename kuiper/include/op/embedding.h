@@ -0,0 +1,20 @@
+#ifndef KUIPER_INCLUDE_OP_EMBEDDING_H_
+#define KUIPER_INCLUDE_OP_EMBEDDING_H_
+#include "layer.h"
+namespace op {
+/// @brief 词嵌入，input0是int32的token id[token_num]，weight0是[vocab_size, dim]，
+//output0是[token_num, dim]。token id放在CPU上，一次可以查一整个batch或者一段prompt。
+class EmbeddingLayer : public LayerParam {
+ public:
+  explicit EmbeddingLayer(base::DeviceType device_type, int32_t dim, int32_t vocab_size);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+
+ private:
+  int32_t dim_ = 0;
+  int32_t vocab_size_ = 0;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_EMBEDDING_H_
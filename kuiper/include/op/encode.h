@@ -0,0 +1,105 @@
+#ifndef KUIPER_INCLUDE_OP_ENCODE_H_
+#define KUIPER_INCLUDE_OP_ENCODE_H_
+#include <string>
+#include <vector>
+#include "layer.h"
+namespace op {
+/// @brief 分词器的公共接口，encode把文本切成token id，decode把token id还原成文本，只在CPU上跑
+class EncodeLayerBase : public Layer {
+ public:
+  explicit EncodeLayerBase(std::string token_model_path, bool has_bos, bool has_eos);
+
+  virtual std::vector<int32_t> encode(const std::string& sentence) const = 0;
+
+  /// @brief 单个token对应的原始字节，字节token（<0xXX>）还原成那一个字节
+  virtual std::string decode(int32_t token_id) const = 0;
+
+  virtual std::string decode(const std::vector<int32_t>& token_ids) const = 0;
+
+  virtual bool is_sentence_ending(int32_t token_id) const = 0;
+
+  virtual int32_t vocab_size() const = 0;
+
+ protected:
+  bool has_bos_ = true;
+  bool has_eos_ = false;
+  std::string token_model_path_;
+};
+
+/// @brief llama2.c导出的tokenizer.bin（Llama 2的SentencePiece BPE词表和分数）的原生实现。
+//文件格式：int32 max_token_length，之后每个token依次是float score、int32 len、len个字节，直到文件结尾。
+//词表建成一棵按字节展开的字典树，查一个片段是不是token只需要沿着它的字节走一遍，不用拼字符串再哈希。
+//encode先按UTF-8字符切成初始符号（不在词表里的字符退回成<0xXX>字节token），
+//再把所有相邻且能合并的符号对放进按分数排序的堆里，每次取分数最高的一对合并，
+//合并后只需要把新符号和左右邻居组成的两对放进堆，失效的堆项在弹出时丢掉，整体是O(n log n)。
+//分数相同的时候先合并靠左的一对，和SentencePiece的行为一致。
+class BpeEncodeLayer : public EncodeLayerBase {
+ public:
+  explicit BpeEncodeLayer(std::string token_model_path, bool has_bos = true,
+                          bool has_eos = false);
+
+  /// @brief 读入词表和分数并建字典树，encode/decode之前必须调用
+  base::Status init() override;
+
+  std::vector<int32_t> encode(const std::string& sentence) const override;
+
+  std::string decode(int32_t token_id) const override;
+
+  /// @brief 跳过bos/eos，紧跟在bos后面的token去掉encode时加上的前导空格
+  std::string decode(const std::vector<int32_t>& token_ids) const override;
+
+  bool is_sentence_ending(int32_t token_id) const override;
+
+  int32_t vocab_size() const override;
+
+  int32_t bos_id() const;
+
+  int32_t eos_id() const;
+
+  /// @brief 在字典树里查[str, str + len)，不是一个完整的token时返回-1
+  int32_t lookup(const char* str, int32_t len) const;
+
+ private:
+  //字典树的节点，一个节点的所有子节点在trie_nodes_里是连续的，按边上的字节从小到大排好
+  struct TrieNode {
+    int32_t token_id = -1;
+    int32_t child_begin = 0;
+    int32_t child_end = 0;
+    uint8_t byte = 0;
+  };
+
+  void build_trie();
+
+ private:
+  int32_t max_token_length_ = 0;
+  std::vector<std::string> vocab_;
+  std::vector<float> scores_;
+  //<0xXX>形式的字节token对应的那个字节，其他token是-1
+  std::vector<int16_t> byte_values_;
+  //每个字节对应的字节token，词表里没有时是unk
+  int32_t byte_tokens_[256];
+  std::vector<TrieNode> trie_nodes_;
+  //根节点的子节点按首字节直接索引，-1表示没有
+  int32_t root_children_[256];
+};
+
+/// @brief 流式解码。每生成一个token调用一次next，只返回已经凑成完整UTF-8字符的文本，
+//一个汉字被拆成几个字节token时，前面不完整的字节先留着，等后面的字节到了再一起吐出来。
+class BpeDecodeStream {
+ public:
+  explicit BpeDecodeStream(const BpeEncodeLayer* encoder);
+
+  std::string next(int32_t token_id);
+
+  /// @brief 生成结束时把剩下的字节（结尾是残缺的UTF-8）原样吐出来
+  std::string flush();
+
+  void reset();
+
+ private:
+  const BpeEncodeLayer* encoder_ = nullptr;
+  int32_t prev_token_ = -1;
+  std::string pending_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_ENCODE_H_
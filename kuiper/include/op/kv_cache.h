@@ -0,0 +1,103 @@
+#ifndef KUIPER_INCLUDE_OP_KV_CACHE_H_
+#define KUIPER_INCLUDE_OP_KV_CACHE_H_
+#include <memory>
+#include "base/alloc.h"
+#include "base/buffer.h"
+#include "tensor/tensor.h"
+namespace op {
+/// @brief KV cache里key/value的存储格式
+enum class KVCacheFormat : uint8_t {
+  kFp32 = 0,
+  //IEEE半精度，attention读的时候在寄存器里转回fp32
+  kFp16 = 1,
+  //对称int8，每个位置的每个kv head（head_size个数）一个fp32 scale
+  kInt8 = 2,
+};
+
+inline size_t KVCacheFormatSize(KVCacheFormat format) {
+  if (format == KVCacheFormat::kFp16) {
+    return sizeof(uint16_t);
+  } else if (format == KVCacheFormat::kInt8) {
+    return sizeof(int8_t);
+  } else {
+    return sizeof(float);
+  }
+}
+
+/// @brief attention kernel看到的KV cache，只描述一层的key/value怎么按位置寻址。
+//位置pos的key在 key + block_table[pos / block_size] * block_stride + layer_offset
+//+ (pos % block_size) * kv_dim（单位是元素），连续的KVCache相当于只有一个block的特例。
+//int8时scales和key/value是同样的布局，只是每行只有kv_dim / head_size个，
+//所以一个元素的scale下标就是它的下标除以head_size。
+struct KVCacheView {
+  const void* key = nullptr;
+  const void* value = nullptr;
+  const float* key_scales = nullptr;
+  const float* value_scales = nullptr;
+  const int32_t* block_table = nullptr;
+  KVCacheFormat format = KVCacheFormat::kFp32;
+  int32_t block_size = 0;
+  int32_t kv_dim = 0;
+  //int8时一个scale管多少个数
+  int32_t head_size = 0;
+  int64_t block_stride = 0;
+  int64_t layer_offset = 0;
+
+  inline int64_t row_offset(int32_t pos) const {
+    return block_table[pos / block_size] * block_stride + layer_offset +
+           static_cast<int64_t>(pos % block_size) * kv_dim;
+  }
+
+  template <typename T>
+  inline const T* key_row(int32_t pos) const {
+    return static_cast<const T*>(key) + row_offset(pos);
+  }
+
+  template <typename T>
+  inline const T* value_row(int32_t pos) const {
+    return static_cast<const T*>(value) + row_offset(pos);
+  }
+};
+
+/// @brief 预先分配好的KV cache，key和value各是一个[layer_num, seq_len, kv_dim]的tensor。
+//两者来自DeviceAllocator的同一次分配（key在前value在后），大小在init时就确定，
+//decode过程中只往里写当前pos的一行，不会再重新分配或者拼接。
+class KVCache {
+ public:
+  explicit KVCache(int32_t layer_num, int32_t seq_len, int32_t kv_dim);
+
+  base::Status init(std::shared_ptr<base::DeviceAllocator> alloc);
+
+  //某一层某个位置的key/value行，长度是kv_dim
+  float* key(int32_t layer_idx, int32_t pos);
+
+  float* value(int32_t layer_idx, int32_t pos);
+
+  //给attention kernel用的第layer_idx层的视图
+  KVCacheView view(int32_t layer_idx) const;
+
+  const tensor::Tensor& key_cache() const;
+
+  const tensor::Tensor& value_cache() const;
+
+  int32_t layer_num() const;
+
+  int32_t seq_len() const;
+
+  int32_t kv_dim() const;
+
+  //key和value一共占用的字节数，方便上层提前做容量规划
+  size_t byte_size() const;
+
+ private:
+  int32_t layer_num_ = 0;
+  int32_t seq_len_ = 0;
+  int32_t kv_dim_ = 0;
+  //连续的cache只有一个block，block_table就是{0}
+  int32_t block_table_[1] = {0};
+  std::shared_ptr<base::Buffer> buffer_;
+  tensor::Tensor key_cache_;
+  tensor::Tensor value_cache_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_KV_CACHE_H_
@@ -1,5 +1,6 @@
 #ifndef KUIPER_INCLUDE_OP_LAYER_H_
 #define KUIPER_INCLUDE_OP_LAYER_H_
+#include <base/cpu_config.h>
 #include <base/cuda_config.h>
 #include <string>
 #include <vector>
@@ -18,10 +19,15 @@ enum class LayerType: uint8_t{
     kLayerSoftmax = 8,
     kLayerAdd = 9,
     kLayerSwiGLU = 10,
+    kLayerAddRMSNorm = 11,
 };
 class BaseLayer{
+    public:
+    explicit BaseLayer(base::DeviceType device_type, LayerType layer_type, base::DataType data_type,
+                       std::string layer_name = "");
+
+    virtual ~BaseLayer() = default;
 
-    explicit BaseLayer(LayerType layer_type, base::DataType data_type, base::DeviceType device_type, std::string layer_name_ = "");
     base::DataType data_type() const;
 
     LayerType layer_type() const;
@@ -82,6 +88,9 @@ class BaseLayer{
 };
 /// @brief 不带权重的算子类型比如add和sigmod
 class Layer : public BaseLayer{
+    public:
+    explicit Layer(base::DeviceType device_type, LayerType layer_type, std::string layer_name = "");
+
     base::Status init() override;
 
     base::Status check_tensor(const tensor::Tensor& tensor, base::DeviceType device_type,
@@ -136,10 +145,19 @@ class Layer : public BaseLayer{
 
     std::shared_ptr<kernel::CudaConfig> cuda_config() const;
 
+    void set_cpu_config(std::shared_ptr<kernel::CpuConfig> config);
+
+    std::shared_ptr<kernel::CpuConfig> cpu_config() const;
+
+    protected:
+        //传给kernel的最后一个参数，CUDA上是stream，CPU上是线程池，都没有设置时为nullptr（CPU kernel使用默认线程池）
+        void* kernel_stream() const;
+
     protected:
         std::vector<tensor::Tensor> inputs_;
         std::vector<tensor::Tensor> outputs_;
         std::shared_ptr<kernel::CudaConfig> cuda_config_;
+        std::shared_ptr<kernel::CpuConfig> cpu_config_;
 };
 /// @brief 带权重类型的算子类型，多了一个类内变量用于存储权重张量
 class LayerParam : public Layer {
@@ -160,14 +178,30 @@ class LayerParam : public Layer {
         void set_scales(const tensor::Tensor& scales);
 
         void set_group_size(int32_t group_size);
+
+        //权重类型，要在按指针set_weight之前设置：非量化层是fp32（默认）、fp16或bf16，
+        //量化层是int8（默认）或int4，int4的with_min表示每组除了scale还有一个min
+        void set_weight_data_type(base::DataType data_type, bool with_min = false);
+
+        base::DataType weight_data_type() const;
+
+        bool weight_with_min() const;
         
         int32_t get_scale_num() const;
 
+        bool is_quant_layer() const;
+
+        void to_cuda() override;
+
 
     protected:
         int32_t group_size_ = 0;
         bool is_quant_layer_ = false;
+        base::DataType weight_data_type_ = base::DataType::kDataTypeFp32;
+        bool weight_with_min_ = false;
         tensor::Tensor scales_;
+        //int4带min时每组的min，和scales_一样是fp16
+        tensor::Tensor mins_;
         std::vector<tensor::Tensor> weights_;
 };
 
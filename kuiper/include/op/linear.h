@@ -0,0 +1,52 @@
+#ifndef KUIPER_INCLUDE_OP_LINEAR_H_
+#define KUIPER_INCLUDE_OP_LINEAR_H_
+#include <vector>
+#include "base/numa.h"
+#include "layer.h"
+namespace op {
+/// @brief 全连接层 output = weight * input，weight是[dim0, dim1]
+//is_quant_layer为true时weight是int8，scales_按group_size_分组，直接在int8上做计算。
+//非量化层的weight可以是fp32、fp16或bf16（set_weight_data_type），16位的权重读进寄存器再转成fp32累加，
+//decode时读的字节数减半，精度比int8好。
+//量化层的weight也可以是int4（set_weight_data_type(kDataTypeInt4, with_min)），每组一个fp16的scale，
+//可选一个fp16的min，按指针set_weight时的布局是[打包的权重][scales][mins]，大小大约是fp32的1/8。
+class LinearLayer : public LayerParam {
+ public:
+  explicit LinearLayer(base::DeviceType device_type, int32_t dim0, int32_t dim1,
+                       bool is_quant_layer = false);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+
+  /// @brief 把已经设置好的fp32权重转成fp16或bf16，放进新申请的内存，原来的权重不再被引用。
+  //只支持CPU上的非量化层，在set_numa_policy和prepack_weight之前调用
+  base::Status convert_weight(base::DataType data_type);
+
+  /// @brief 把已经设置好的权重按NUMA策略重新放置，在set_weight（和set_scales）之后调用
+  //kNumaPolicyInterleave把整块权重按页交错放到所有节点上；
+  //kNumaPolicyBind按每个节点的cpu数把输出行切成几段，每段拷到对应节点的本地内存，
+  //forward时每个节点上的线程只读本节点的那一段。
+  base::Status set_numa_policy(base::NumaPolicy policy);
+
+  base::NumaPolicy numa_policy() const;
+
+  /// @brief 权重打包成kLayoutPanel16之后的字节数，这一层不能打包时返回0：只支持CPU上的fp32和int8
+  //（dim1要是group_size的整数倍），按节点切分过的权重和已经打包过的权重也返回0
+  size_t packed_weight_byte_size() const;
+
+  /// @brief 把权重重排成kernel原生的panel排布，在set_weight（和set_numa_policy）之后调用。
+  //packed不为空时直接使用这块已经打包好的数据（比如mmap进来的缓存文件），调用方保证它比layer活得久，
+  //否则用原来权重的分配器申请一块内存自己打包。之后get_weight(0)是kLayoutPanel16的tensor，
+  //int8的scale交错在里面。
+  base::Status prepack_weight(const void* packed = nullptr);
+
+ private:
+  int32_t dim0_ = 0;
+  int32_t dim1_ = 0;
+  base::NumaPolicy numa_policy_ = base::NumaPolicy::kNumaPolicyDefault;
+  std::vector<tensor::Tensor> numa_weights_;
+  std::vector<tensor::Tensor> numa_scales_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_LINEAR_H_
@@ -0,0 +1,16 @@
+#ifndef KUIPER_INCLUDE_OP_MATMUL_H_
+#define KUIPER_INCLUDE_OP_MATMUL_H_
+#include "layer.h"
+namespace op {
+/// @brief 两个激活值之间的矩阵乘 output[M, N] = input0[M, K] * input1[N, K]^T
+//和LinearLayer用同一组fp32 GEMV/GEMM kernel，只是右边的矩阵来自输入而不是权重。
+class MatmulLayer : public Layer {
+ public:
+  explicit MatmulLayer(base::DeviceType device_type);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_MATMUL_H_
@@ -0,0 +1,49 @@
+#ifndef KUIPER_INCLUDE_OP_MHA_H_
+#define KUIPER_INCLUDE_OP_MHA_H_
+#include <memory>
+#include "layer.h"
+#include "op/kv_cache.h"
+#include "op/paged_kv_cache.h"
+namespace op {
+/// @brief 多头注意力，inputs：0是query[dim]，1和2是当前token的key/value[kv_dim]，output0是[dim]
+//forward先把key/value写进KV cache里当前layer、pos的那一行，再对0..pos做注意力。
+//prefill时inputs是一段prompt的[rows, dim]/[rows, kv_dim]，第r行在位置pos + r，
+//所有行的key/value一次写进cache，再按因果mask一起做注意力。
+//注意力是分块的online softmax，不需要score暂存区，decode时不会分配内存。
+//KV cache可以是连续的KVCache，也可以是PagedKVCache里的某个序列，后设置的那个生效。
+class MultiHeadAttention : public Layer {
+ public:
+  explicit MultiHeadAttention(base::DeviceType device_type, int32_t layer_index, int32_t kv_mul,
+                              int32_t kv_dim, int32_t seq_len, int32_t head_num,
+                              int32_t head_size);
+
+  base::Status init() override;
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+
+  //单行时是当前位置，多行时是第一行的位置
+  void set_pos(int32_t pos);
+
+  void set_layer_idx(int32_t layer_idx);
+
+  void set_kv_cache(std::shared_ptr<KVCache> kv_cache);
+
+  //使用分页cache中seq_id这个序列，pos对应的block需要事先reserve好
+  void set_paged_kv_cache(std::shared_ptr<PagedKVCache> kv_cache, int32_t seq_id);
+
+ private:
+  int32_t layer_index_ = 0;
+  int32_t pos_ = 0;
+  int32_t kv_mul_ = 0;
+  int32_t kv_dim_ = 0;
+  int32_t seq_len_ = 0;
+  int32_t head_num_ = 0;
+  int32_t head_size_ = 0;
+  int32_t seq_id_ = 0;
+  std::shared_ptr<KVCache> kv_cache_;
+  std::shared_ptr<PagedKVCache> paged_kv_cache_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_MHA_H_
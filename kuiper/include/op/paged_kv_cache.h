@@ -0,0 +1,111 @@
+#ifndef KUIPER_INCLUDE_OP_PAGED_KV_CACHE_H_
+#define KUIPER_INCLUDE_OP_PAGED_KV_CACHE_H_
+#include <map>
+#include <memory>
+#include <vector>
+#include "base/alloc.h"
+#include "base/buffer.h"
+#include "op/kv_cache.h"
+#include "tensor/tensor.h"
+namespace op {
+/// @brief 分页的KV cache，适合很多长度差别很大的序列同时在跑。
+//所有block来自DeviceAllocator分配的同一个Buffer，key池和value池都是
+//[num_blocks, layer_num, block_size, kv_dim]。每个序列有自己的block_table，
+//按需从空闲链表里拿block，序列结束后整批还回池子。
+//每个block带引用计数，写满的block可以被多个序列的block_table和PrefixCache同时引用，
+//引用全部释放后才回到空闲链表。共享的block是只读的，序列只会往自己新拿的block里写。
+//format可以选fp16或者int8来存key/value，显存/内存和attention每步要读的字节数分别减半和减到四分之一；
+//int8时每个位置的每个kv head带一个scale，和LayerParam里按group量化权重是同一个思路，
+//scale池紧跟在value池后面，布局是[num_blocks, layer_num, block_size, kv_dim / head_size]。
+//写入用kernel::kv_store_row_cpu（见mha_kernel.h），读取在attention的内积和累加里直接反量化。
+//不是线程安全的，调度线程负责增删序列，kernel只读block_table。
+class PagedKVCache {
+ public:
+  //head_size是int8时一个scale管的数的个数，0表示整行一个scale；
+  //要交给MultiHeadAttention的int8 cache必须等于attention的head_size，否则check会报错
+  explicit PagedKVCache(int32_t layer_num, int32_t kv_dim, int32_t block_size,
+                        int32_t num_blocks, KVCacheFormat format = KVCacheFormat::kFp32,
+                        int32_t head_size = 0);
+
+  base::Status init(std::shared_ptr<base::DeviceAllocator> alloc);
+
+  //shared_blocks是已经写好的前缀（比如PrefixCache命中的部分），直接放在block_table最前面并增加引用
+  base::Status add_sequence(int32_t seq_id, const std::vector<int32_t>& shared_blocks = {});
+
+  //保证seq_id可以写到位置pos（包含），不够的话从池子里取新block
+  base::Status reserve(int32_t seq_id, int32_t pos);
+
+  //序列结束，把它所有的block还回池子
+  void free_sequence(int32_t seq_id);
+
+  //只保留位置[0, len)要用的block，后面的还回池子，用来回滚推测解码里没被接受的位置
+  base::Status truncate(int32_t seq_id, int32_t len);
+
+  bool has_sequence(int32_t seq_id) const;
+
+  void retain_block(int32_t block);
+
+  //引用计数减到0时还回空闲链表
+  void release_block(int32_t block);
+
+  int32_t ref_count(int32_t block) const;
+
+  //fp32时某个位置的key/value行
+  float* key(int32_t seq_id, int32_t layer_idx, int32_t pos);
+
+  float* value(int32_t seq_id, int32_t layer_idx, int32_t pos);
+
+  //任意格式下某个位置的key/value行的起始地址，int8时scales给出这一行的scale
+  void* key_data(int32_t seq_id, int32_t layer_idx, int32_t pos);
+
+  void* value_data(int32_t seq_id, int32_t layer_idx, int32_t pos);
+
+  float* key_scales(int32_t seq_id, int32_t layer_idx, int32_t pos);
+
+  float* value_scales(int32_t seq_id, int32_t layer_idx, int32_t pos);
+
+  KVCacheView view(int32_t seq_id, int32_t layer_idx) const;
+
+  const std::vector<int32_t>& block_table(int32_t seq_id) const;
+
+  int32_t block_size() const;
+
+  int32_t num_blocks() const;
+
+  int32_t free_block_num() const;
+
+  int32_t layer_num() const;
+
+  int32_t kv_dim() const;
+
+  KVCacheFormat format() const;
+
+  int32_t head_size() const;
+
+  size_t byte_size() const;
+
+ private:
+  //相邻两个block之间隔了多少个float，也就是一个block的key（或value）的大小
+  int64_t block_stride() const;
+
+  int64_t row_offset(const std::vector<int32_t>& table, int32_t layer_idx, int32_t pos) const;
+
+ private:
+  int32_t layer_num_ = 0;
+  int32_t kv_dim_ = 0;
+  int32_t block_size_ = 0;
+  int32_t num_blocks_ = 0;
+  KVCacheFormat format_ = KVCacheFormat::kFp32;
+  int32_t head_size_ = 0;
+  std::shared_ptr<base::Buffer> buffer_;
+  //都指向buffer_里面，元素类型由format_决定
+  int8_t* key_pool_ = nullptr;
+  int8_t* value_pool_ = nullptr;
+  float* key_scale_pool_ = nullptr;
+  float* value_scale_pool_ = nullptr;
+  std::vector<int32_t> free_blocks_;
+  std::vector<int32_t> ref_counts_;
+  std::map<int32_t, std::vector<int32_t>> block_tables_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_PAGED_KV_CACHE_H_
@@ -0,0 +1,89 @@
+#ifndef KUIPER_INCLUDE_OP_PREFIX_CACHE_H_
+#define KUIPER_INCLUDE_OP_PREFIX_CACHE_H_
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+#include "base/base.h"
+#include "op/paged_kv_cache.h"
+namespace op {
+/// @brief 按token序列索引的前缀缓存，节点引用PagedKVCache里写满的block。
+//一棵以block为粒度的radix tree：每条边是若干个完整block的token和对应的block编号，
+//子节点按边上第一个block的token区分，只有在block边界上才会分裂。
+//新请求先用match找出最长的已缓存前缀，把这些block共享进自己的block_table，只需要prefill剩下的部分；
+//序列读完prompt和结束时把已经写进cache的整block部分insert回树里。
+//树对每个block持有一份引用，淘汰按LRU从叶子开始，树里的block数超过预算时自动淘汰，
+//kv cache没有空闲block时调度器也会先来这里要。只有block全部只被树引用的叶子才会被淘汰，
+//还有序列在用的叶子删掉也腾不出block，留着给后面的请求命中，等那些序列结束之后才能淘汰。
+//不是线程安全的，和PagedKVCache一样只在调度线程里用。
+class PrefixCache : public base::NoCopyable {
+ public:
+  //树里最多引用max_byte_size字节的block
+  explicit PrefixCache(std::shared_ptr<PagedKVCache> kv_cache, size_t max_byte_size);
+
+  ~PrefixCache();
+
+  /// @brief tokens前max_len个里最长的已缓存前缀，block编号写进blocks，返回匹配的token数（block_size的倍数）
+  int32_t match(const std::vector<int32_t>& tokens, int32_t max_len, std::vector<int32_t>& blocks);
+
+  /// @brief 把tokens的前len个（向下对齐到block）和block_table里对应的block插进树里，
+  //已经在树里的部分沿用树里的block
+  void insert(const std::vector<int32_t>& tokens, int32_t len,
+              const std::vector<int32_t>& block_table);
+
+  /// @brief 按LRU淘汰叶子，直到kv cache里至少有need_free_blocks个空闲block或者没有能淘汰的叶子，
+  //返回真正还回池子的block数
+  int32_t evict(int32_t need_free_blocks);
+
+  int32_t cached_block_num() const;
+
+  int32_t max_block_num() const;
+
+  /// @brief match一共查了多少token，命中了多少token
+  int64_t queried_token_num() const;
+
+  int64_t matched_token_num() const;
+
+ private:
+  struct Node {
+    Node* parent = nullptr;
+    //边上的token，长度是block_size的倍数，blocks是它们对应的block
+    std::vector<int32_t> tokens;
+    std::vector<int32_t> blocks;
+    std::vector<std::unique_ptr<Node>> children;
+    uint64_t last_access = 0;
+  };
+
+  //node下面边上第一个block和tokens[pos, pos + block_size)一样的子节点
+  Node* find_child(Node* node, const std::vector<int32_t>& tokens, int32_t pos) const;
+
+  //node边上从头开始和tokens[pos, max_len)一致的完整block数
+  int32_t common_blocks(const Node* node, const std::vector<int32_t>& tokens, int32_t pos,
+                        int32_t max_len) const;
+
+  //把node在第block_num个block处切开，返回前半段的新节点
+  Node* split(Node* node, int32_t block_num);
+
+  //把node的访问时间更新成当前的clock_，叶子同时在lru_leaves_里挪到最后
+  void touch(Node* node);
+
+  //最久没用过的、block都只被树引用的叶子，没有的话返回nullptr
+  Node* evictable_leaf() const;
+
+  //删掉一个叶子并释放它的block，返回真正回到池子的block数
+  int32_t remove_leaf(Node* leaf);
+
+ private:
+  std::shared_ptr<PagedKVCache> kv_cache_;
+  int32_t block_size_ = 0;
+  int32_t max_block_num_ = 0;
+  int32_t cached_block_num_ = 0;
+  uint64_t clock_ = 0;
+  int64_t queried_token_num_ = 0;
+  int64_t matched_token_num_ = 0;
+  std::unique_ptr<Node> root_;
+  //除了根以外所有的叶子，按(last_access, node)排序，最前面的最久没用过
+  std::set<std::pair<uint64_t, Node*>> lru_leaves_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_PREFIX_CACHE_H_
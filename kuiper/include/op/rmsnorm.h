@@ -0,0 +1,20 @@
+#ifndef KUIPER_INCLUDE_OP_RMSNORM_H_
+#define KUIPER_INCLUDE_OP_RMSNORM_H_
+#include "layer.h"
+namespace op {
+/// @brief RMSNorm output0 = input0 / rms(input0) * weight0，输入可以是[dim]或者[rows, dim]
+//残差相加之后的归一化请用AddRMSNormLayer，这个只用在没有残差可加的地方（比如第一个block的输入）。
+class RmsNormLayer : public LayerParam {
+ public:
+  explicit RmsNormLayer(base::DeviceType device_type, int32_t dim, float eps = 1e-5f);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+
+ private:
+  int32_t dim_ = 0;
+  float eps_ = 1e-5f;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_RMSNORM_H_
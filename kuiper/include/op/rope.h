@@ -0,0 +1,36 @@
+#ifndef KUIPER_INCLUDE_OP_ROPE_H_
+#define KUIPER_INCLUDE_OP_ROPE_H_
+#include "layer.h"
+namespace op {
+/// @brief 旋转位置编码，原地旋转query和key。
+//inputs：0是query[dim]，1是key[kv_dim]，2是当前位置pos(int32)。
+//prefill时query/key是[rows, dim]/[rows, kv_dim]，pos是CPU上的int32[rows]，每一行各用自己的位置。
+//init()的时候一次性算好[max_seq_len, head_size / 2]的sin/cos表，forward时只查表，
+//不会每个token再去调用sinf/cosf/powf。这两张表和其他tensor一样由allocator分配，to_cuda时一起搬走。
+class RoPELayer : public Layer {
+ public:
+  explicit RoPELayer(base::DeviceType device_type, int32_t dim, int32_t kv_dim, int32_t head_size,
+                     int32_t max_seq_len);
+
+  base::Status init() override;
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+
+  void to_cuda() override;
+
+  const tensor::Tensor& sin_cache() const;
+
+  const tensor::Tensor& cos_cache() const;
+
+ private:
+  int32_t dim_ = 0;
+  int32_t kv_dim_ = 0;
+  int32_t head_size_ = 0;
+  int32_t max_seq_len_ = 0;
+  tensor::Tensor sin_cache_;
+  tensor::Tensor cos_cache_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_ROPE_H_
@@ -0,0 +1,15 @@
+#ifndef KUIPER_INCLUDE_OP_SOFTMAX_H_
+#define KUIPER_INCLUDE_OP_SOFTMAX_H_
+#include "layer.h"
+namespace op {
+/// @brief 对input0原地做softmax，output0和input0是同一个tensor
+class SoftmaxLayer : public Layer {
+ public:
+  explicit SoftmaxLayer(base::DeviceType device_type);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_SOFTMAX_H_
@@ -0,0 +1,31 @@
+#ifndef KUIPER_INCLUDE_OP_SWIGLU_H_
+#define KUIPER_INCLUDE_OP_SWIGLU_H_
+#include "layer.h"
+namespace op {
+/// @brief 融合的SwiGLU前馈层 output = silu(w1 * input) * (w3 * input)
+//weight0是gate投影w1，weight1是up投影w3，都是[hidden_dim, dim]。
+//一次扫描同时读w1和w3的同一行，只写出一个[hidden_dim]的中间结果，下投影w2交给LinearLayer。
+//量化层的两个权重各有自己的scales，在set_weight的时候分别保存下来。
+class SwiGLULayer : public LayerParam {
+ public:
+  explicit SwiGLULayer(base::DeviceType device_type, int32_t dim, int32_t hidden_dim,
+                       bool is_quant_layer = false);
+
+  base::Status check() const override;
+
+  base::Status forward() override;
+
+  base::Status set_weight(int32_t idx, const tensor::Tensor& weight) override;
+
+  base::Status set_weight(int32_t idx, const std::vector<int32_t>& dims, const void* weight_ptr,
+                          base::DeviceType device_type = base::DeviceType::kDeviceUnknown) override;
+
+  void to_cuda() override;
+
+ private:
+  int32_t dim_ = 0;
+  int32_t hidden_dim_ = 0;
+  std::vector<tensor::Tensor> weight_scales_;
+};
+}  // namespace op
+#endif  // KUIPER_INCLUDE_OP_SWIGLU_H_
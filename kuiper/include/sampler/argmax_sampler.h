@@ -0,0 +1,13 @@
+#ifndef KUIPER_INCLUDE_SAMPLER_ARGMAX_SAMPLER_H_
+#define KUIPER_INCLUDE_SAMPLER_ARGMAX_SAMPLER_H_
+#include "sampler/sampler.h"
+namespace sampler {
+/// @brief 贪心解码，取logits最大的token
+class ArgmaxSampler : public Sampler {
+ public:
+  explicit ArgmaxSampler(base::DeviceType device_type);
+
+  int32_t sample(const float* logits, int32_t size, void* stream = nullptr) override;
+};
+}  // namespace sampler
+#endif  // KUIPER_INCLUDE_SAMPLER_ARGMAX_SAMPLER_H_
@@ -0,0 +1,52 @@
+#ifndef KUIPER_INCLUDE_SAMPLER_RANDOM_SAMPLER_H_
+#define KUIPER_INCLUDE_SAMPLER_RANDOM_SAMPLER_H_
+#include <vector>
+#include "sampler/sampler.h"
+namespace sampler {
+/// @brief 带temperature、top-k和top-p的随机采样。
+//开了top-k时先用堆从整个词表里选出k个最大的logits（不排序整个词表），softmax和top-p只在这k个上做；
+//没开top-k时一遍算完exp((logit - max) / temperature)，top-p只收集概率不小于(1 - top_p) / (n - 1)的token
+//再排序，这个阈值以下的token不可能进top-p集合，所以排序的量很小。
+//概率都不做归一化，直接用和去乘随机数。
+class RandomSampler : public Sampler {
+ public:
+  explicit RandomSampler(base::DeviceType device_type, const SamplerConfig& config,
+                         int32_t vocab_size);
+
+  int32_t sample(const float* logits, int32_t size, void* stream = nullptr) override;
+
+  /// @brief 按temperature做softmax，归一化之后写进probs，和sample在不开top-k、top-p时用的是同一个分布
+  void softmax(const float* logits, int32_t size, float* probs) const;
+
+  /// @brief 从和为1的probs里采一个token，和sample共用随机数状态
+  int32_t sample_probs(const float* probs, int32_t size);
+
+  /// @brief [0, 1)，和sample共用随机数状态
+  float random_f32();
+
+ private:
+  struct Candidate {
+    float prob = 0.f;
+    int32_t index = 0;
+  };
+
+  //candidates_的前n个已经按概率从大到小排好，先按top-p截断再采样
+  int32_t sample_candidates(int32_t n, float sum);
+
+  //xorshift64*
+  uint32_t random_u32();
+
+ private:
+  float temperature_ = 1.f;
+  int32_t top_k_ = 0;
+  float top_p_ = 1.f;
+  int32_t vocab_size_ = 0;
+  uint64_t rng_state_ = 0;
+  //没开top-k时存整个词表的exp
+  std::vector<float> probs_;
+  std::vector<float> topk_values_;
+  std::vector<int32_t> topk_indices_;
+  std::vector<Candidate> candidates_;
+};
+}  // namespace sampler
+#endif  // KUIPER_INCLUDE_SAMPLER_RANDOM_SAMPLER_H_
@@ -0,0 +1,46 @@
+#ifndef KUIPER_INCLUDE_SAMPLER_SAMPLER_H_
+#define KUIPER_INCLUDE_SAMPLER_SAMPLER_H_
+#include <memory>
+#include "base/base.h"
+#include "tensor/tensor.h"
+namespace sampler {
+/// @brief 一个会话的采样参数
+struct SamplerConfig {
+  //小于等于0表示贪心解码
+  float temperature = 0.f;
+  //只在logits最大的top_k个token里采样，0表示不限制
+  int32_t top_k = 0;
+  //只在累计概率刚超过top_p的那些token里采样，1表示不限制
+  float top_p = 1.f;
+  //同样的seed和同样的logits序列采出同样的token
+  uint64_t seed = 0;
+};
+
+/// @brief 从一行logits里选出下一个token。
+//每个会话持有自己的Sampler，随机数状态和scratch都在里面，所以不同会话之间互不影响，
+//sample的时候不分配内存。不是线程安全的。
+class Sampler : public base::NoCopyable {
+ public:
+  explicit Sampler(base::DeviceType device_type);
+
+  virtual ~Sampler() = default;
+
+  /// @brief logits是size个连续的float
+  virtual int32_t sample(const float* logits, int32_t size, void* stream = nullptr) = 0;
+
+  /// @brief logits是分类头的输出[rows, vocab_size]，在第row行上采样
+  int32_t sample_row(const tensor::Tensor& logits, int32_t row, void* stream = nullptr);
+
+ protected:
+  base::DeviceType device_type_ = base::DeviceType::kDeviceUnknown;
+};
+
+/// @brief 检查采样参数的取值范围
+base::Status check_sampler_config(const SamplerConfig& config);
+
+/// @brief temperature<=0或者top_k==1时返回ArgmaxSampler，否则返回RandomSampler，
+//scratch按vocab_size一次分配好
+std::unique_ptr<Sampler> create_sampler(base::DeviceType device_type, const SamplerConfig& config,
+                                        int32_t vocab_size);
+}  // namespace sampler
+#endif  // KUIPER_INCLUDE_SAMPLER_SAMPLER_H_
@@ -1,12 +1,11 @@
 #ifndef KUIPER_INCLUDE_TENSOR_TENSOR_H_
 #define KUIPER_INCLUDE_TENSOR_TENSOR_H_
-#include <driver_types.h>
 #include <glog/logging.h>
-#include <armadillo>
 #include <memory>
 #include <vector>
 #include "base/base.h"
 #include "base/buffer.h"
+#include "base/cuda_config.h"
 namespace tensor{
 //Tensor居然还包含了buffer。
 //张量是一个多维数组，用于在推理的流程中管理，传递数据，同时也能配合第二次课程的Buffer类来自动管理内存或者显存资源。
@@ -24,6 +23,7 @@ namespace tensor{
 // }
 //我们再举一个例子，当代码流程执行到括号外时，因为两个张量变量因为都是类内变量，所以会在第四行对两个张量都进行销毁。这是C++ RAII的内容，局部变量退出作用域后自动释放。
 class Tensor{
+    public:
     explicit Tensor() = default;
 
     explicit Tensor(base::DataType data_type, int32_t dim0, bool need_alloc = false,
@@ -66,8 +66,24 @@ class Tensor{
     const T* ptr(int64_t index) const;
 
 
+    /// @brief 原地改成dims的形状，不再分配和拷贝：tensor必须是连续的，新的大小不能超过buffer里剩下的部分
     void reshape(const std::vector<int32_t>& dims);
 
+    /// @brief 第dim维的[begin, end)，和原tensor共用同一块buffer，只记录偏移，不拷贝
+    Tensor slice(int32_t dim, int32_t begin, int32_t end) const;
+
+    /// @brief 交换dim0和dim1两维，只交换dims和strides，结果一般不再连续
+    Tensor transpose(int32_t dim0, int32_t dim1) const;
+
+    /// @brief 同样的数据换成dims的形状，元素个数必须一样，只能用在连续的tensor上
+    Tensor view(const std::vector<int32_t>& dims) const;
+
+    /// @brief strides是不是行优先的紧凑排布，只有连续的tensor才能交给按行寻址的kernel
+    bool is_contiguous() const;
+
+    /// @brief 数据在buffer里的起始位置，视图的ptr()已经加上了它
+    size_t byte_offset() const;
+
     std::shared_ptr<base::Buffer> get_buffer() const;
   
     size_t size() const;
@@ -82,7 +98,8 @@ class Tensor{
   
     const std::vector<int32_t>& dims() const;
   
-    std::vector<size_t> strides() const;
+    /// @brief 每一维相邻两个元素隔了多少个元素，视图的strides不一定是紧凑的
+    const std::vector<size_t>& strides() const;
   
     bool assign(std::shared_ptr<base::Buffer> buffer);
   
@@ -91,30 +108,56 @@ class Tensor{
     void set_device_type(base::DeviceType device_type);
   
     base::DeviceType device_type() const;
+
+    /// @brief 数据是不是由2M大页支撑的，用来确认大页的申请有没有真正生效
+    bool is_huge_page() const;
+
+    /// @brief 数据的排布，打包过的权重是kLayoutPanel16，这时dims仍然是逻辑上的[dim0, dim1]，
+    //buffer比byte_size()大，只能交给认识这种排布的kernel
+    base::TensorLayout layout() const;
+
+    void set_layout(base::TensorLayout layout);
   
     bool allocate(std::shared_ptr<base::DeviceAllocator> allocator,
                   bool need_realloc = false);
 
+    //offset是行优先的下标，按strides换算到元素的实际位置，不连续的视图也能逐个元素访问
     template <typename T>
     T& index(int64_t offset);
   
     template <typename T>
     const T& index(int64_t offset) const;
   
+    //视图clone出来的是只包含自己那部分数据的紧凑tensor
     tensor::Tensor clone() const;
     ///这里为什么不拥有DeviceAllocator
     //而上面的构造函数里有。
+    private:
+        //按dims_算紧凑的strides
+        void init_strides();
+
+        //视图只适用于普通排布的、每个元素占整数个字节的tensor
+        void check_viewable() const;
+
+        //行优先的下标按strides换算成相对ptr()的元素偏移，连续的tensor两者相等
+        int64_t element_offset(int64_t index) const;
+
     private:
         size_t size_ = 0;
         std::vector<int> dims_;
+        //slice/transpose之后不再能从dims_推出来，所以单独存
+        std::vector<size_t> strides_;
+        //视图在共享的buffer里从哪个字节开始
+        size_t byte_offset_ = 0;
         std::shared_ptr<base::Buffer> buffer_;
         base::DataType data_type_ = base::DataType::kDataTypeUnknown;
+        base::TensorLayout layout_ = base::TensorLayout::kLayoutRowMajor;
 };
 template <typename T>
 T& Tensor::index(int64_t offset) {
   CHECK_GE(offset, 0);
   CHECK_LT(offset, this->size());
-  T& val = *(reinterpret_cast<T*>(buffer_->ptr()) + offset);
+  T& val = *(this->ptr<T>() + element_offset(offset));
   return val;
 }
 
@@ -122,7 +165,7 @@ template <typename T>
 const T& Tensor::index(int64_t offset) const {
   CHECK_GE(offset, 0);
   CHECK_LT(offset, this->size());
-  const T& val = *(reinterpret_cast<T*>(buffer_->ptr()) + offset);
+  const T& val = *(this->ptr<T>() + element_offset(offset));
   return val;
 }
 //直接把最底层的ptr交出去吗，感觉有点不安全啊
@@ -132,27 +175,28 @@ const T* Tensor::ptr() const {
         return nullptr;
     }
     //这里是用const_cast给转化来的ptr指针加上了const属性。
-    return const_cast<const T*>(reinterpret_cast<T*>(buffer_->ptr()));
+    return reinterpret_cast<const T*>(static_cast<const int8_t*>(buffer_->ptr()) + byte_offset_);
 }
 template <typename T>
 T* Tensor::ptr() {
   if (!buffer_) {
     return nullptr;
   }
-  return reinterpret_cast<T*>(buffer_->ptr());
+  return reinterpret_cast<T*>(static_cast<int8_t*>(buffer_->ptr()) + byte_offset_);
 }
 template<typename T>
 T* Tensor::ptr(int64_t index){
     CHECK(buffer_ != nullptr && buffer_->ptr() != nullptr)
     << "The data area buffer of this tensor is empty or it points to a null pointer.";
-    return reinterpret_cast<T*>(buffer_->ptr())+ index;
+    return reinterpret_cast<T*>(static_cast<int8_t*>(buffer_->ptr()) + byte_offset_) + index;
 
 }
 template <typename T>
 const T* Tensor::ptr(int64_t index) const {
   CHECK(buffer_ != nullptr && buffer_->ptr() != nullptr)
       << "The data area buffer of this tensor is empty or it points to a null pointer.";
-  return const_cast<T*>(reinterpret_cast<const T*>(buffer_->ptr())) + index;
+  return reinterpret_cast<const T*>(static_cast<const int8_t*>(buffer_->ptr()) + byte_offset_) +
+         index;
 }
 
 }
@@ -1,5 +1,9 @@
 #include "base/alloc.h"
+#ifdef KUIPER_USE_CUDA
 #include <cuda_runtime_api.h>
+#endif
+#include <glog/logging.h>
+#include <cstring>
 
 namespace base{
 
@@ -11,13 +15,16 @@ void DeviceAllocator::memcpy(const void* src_ptr, void* dest_ptr, size_t byte_si
     if(!byte_size){
         return ;
     }
+    if(memcpy_kind == MemcpyKind::kMemcpyCPU2CPU){
+        std::memcpy(dest_ptr, src_ptr, byte_size);
+        return;
+    }
+#ifdef KUIPER_USE_CUDA
     cudaStream_t stream_ = nullptr;
     if(stream){
-        stream_ = static_cast<CUstream_st*>(stream_);
+        stream_ = static_cast<cudaStream_t>(stream);
     }
-    if(memcpy_kind == MemcpyKind::kMemcpyCPU2CPU){
-        std::memcpy(dest_ptr, src_ptr, byte_size);
-    }else if(memcpy_kind == MemcpyKind::kMemcpyCPU2CUDA){
+    if(memcpy_kind == MemcpyKind::kMemcpyCPU2CUDA){
         if(!stream_){
             cudaMemcpy(dest_ptr, src_ptr, byte_size, cudaMemcpyHostToDevice);
         }else{
@@ -41,14 +48,19 @@ void DeviceAllocator::memcpy(const void* src_ptr, void* dest_ptr, size_t byte_si
       if (need_sync) {
         cudaDeviceSynchronize();
       }
+#else
+    LOG(FATAL) << "The memcpy kind " << int(memcpy_kind)
+               << " needs CUDA support, which is not built in.";
+#endif
 }
 
 void DeviceAllocator::memset_zero(void* ptr, size_t byte_size, void* stream,
     bool need_sync) {
     CHECK(device_type_ != base::DeviceType::kDeviceUnknown);
     if (device_type_ == base::DeviceType::kDeviceCPU) {
-        td::memset(ptr, 0, byte_size);
+        std::memset(ptr, 0, byte_size);
     } else {
+#ifdef KUIPER_USE_CUDA
         if (stream) {
             cudaStream_t stream_ = static_cast<cudaStream_t>(stream);
             cudaMemsetAsync(ptr, 0, byte_size, stream_);
@@ -58,7 +70,17 @@ void DeviceAllocator::memset_zero(void* ptr, size_t byte_size, void* stream,
         if (need_sync) {
             cudaDeviceSynchronize();
         }
+#else
+        LOG(FATAL) << "A cuda buffer can not be cleared because CUDA support is not built in.";
+#endif
+    }
+}
+
+bool DeviceAllocator::is_huge_page(const void* ptr) const {
+    if (device_type_ != base::DeviceType::kDeviceCPU) {
+        return false;
     }
+    return is_huge_page_backed(ptr);
 }
 
 }
\ No newline at end of file
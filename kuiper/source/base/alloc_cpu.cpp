@@ -5,31 +5,199 @@
 #define KUIPER_HAVE_POSIX_MEMALIGN
 #endif
 namespace base{
+//最小的size class是64字节，之后每翻一倍分4档
+static constexpr int32_t kMinClassShift = 6;
+static constexpr int32_t kMaxClassShift = 28;
+static constexpr int32_t kNumSizeClasses = 1 + (kMaxClassShift - kMinClassShift) * 4;
+
 CPUDeviceAllocator::CPUDeviceAllocator() : DeviceAllocator(DeviceType::kDeviceCPU) {
+    static_assert(kMaxPooledByteSize == (size_t(1) << kMaxClassShift),
+                  "kMaxPooledByteSize must match the largest size class");
+    free_lists_.resize(kNumSizeClasses);
+}
+
+CPUDeviceAllocator::~CPUDeviceAllocator() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trim_locked(0);
 }
-CPUDeviceAllocator::release(void* ptr)const{
-    if(ptr!=nullptr){
+
+void* CPUDeviceAllocator::system_allocate(size_t byte_size, PooledBlock& block) const {
+    const HugePagePolicy policy = huge_page_policy_.load(std::memory_order_relaxed);
+    if (policy != HugePagePolicy::kHugePageNone && byte_size >= kHugePageByteSize) {
+        void* ptr = huge_page_map(byte_size, policy, &block.mapped_byte_size,
+                                  &block.is_explicit_huge_page);
+        if (ptr) {
+            return ptr;
+        }
+    }
+#ifdef KUIPER_HAVE_POSIX_MEMALIGN
+    void* data = nullptr;
+    int status = posix_memalign((void**)&data, kAlignment, byte_size);
+    if (status != 0) {
+        return nullptr;
+    }
+    return data;
+#else
+    return aligned_alloc(kAlignment, (byte_size + kAlignment - 1) / kAlignment * kAlignment);
+#endif
+}
+
+void CPUDeviceAllocator::system_release(void* ptr, const PooledBlock& block) const {
+    if (block.mapped_byte_size) {
+        huge_page_unmap(ptr, block.mapped_byte_size);
+    } else {
         free(ptr);
     }
 }
-CPUDeviceAllocator::allocate(size_t size)const{
+
+//(2^b, 2^(b+1)]按2^(b-2)的步长分成4档
+int32_t CPUDeviceAllocator::size_class(size_t byte_size) {
+    if (byte_size <= (size_t(1) << kMinClassShift)) {
+        return 0;
+    }
+    const size_t n = byte_size - 1;
+    const int32_t b = 63 - __builtin_clzll(static_cast<unsigned long long>(n));
+    const int32_t sub = static_cast<int32_t>(n >> (b - 2)) - 4;
+    return 1 + (b - kMinClassShift) * 4 + sub;
+}
+
+size_t CPUDeviceAllocator::class_byte_size(int32_t size_class) {
+    if (size_class == 0) {
+        return size_t(1) << kMinClassShift;
+    }
+    const int32_t b = (size_class - 1) / 4 + kMinClassShift;
+    const int32_t sub = (size_class - 1) % 4;
+    return size_t(sub + 5) << (b - 2);
+}
+
+void* CPUDeviceAllocator::allocate(size_t byte_size) const {
     if (!byte_size) {
         return nullptr;
-      }
-    #ifdef KUIPER_HAVE_POSIX_MEMALIGN
-      void * data;
-      const size_t alignment = (byte_size>=size_t(1024))? size_t(32):size_t(16);
-      int status = posix_memalign((void**)&data,
-                                  (alignment >= sizeof(void*))?alignment :sizeof(void*),
-                                   size
-                                    );
-    if(status != 0)return nullptr;
-    return data;
-    #else
-      void *data = malloc(size);
-      return data;
-    #endif
+    }
+    if (byte_size > kMaxPooledByteSize) {
+        PooledBlock block;
+        void* ptr = system_allocate(byte_size, block);
+        if (ptr) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            blocks_[ptr] = block;
+        }
+        return ptr;
+    }
+    const int32_t cls = size_class(byte_size);
+    const size_t cls_byte_size = class_byte_size(cls);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& free_list = free_lists_[cls];
+        if (!free_list.empty()) {
+            void* ptr = free_list.back();
+            free_list.pop_back();
+            stats_.hit_cnt += 1;
+            stats_.cached_byte_size -= cls_byte_size;
+            stats_.in_use_byte_size += cls_byte_size;
+            return ptr;
+        }
+        stats_.miss_cnt += 1;
+    }
+    //向系统申请的时候不持锁，避免缺页把其他线程也卡住
+    PooledBlock block;
+    block.size_class = cls;
+    void* ptr = system_allocate(cls_byte_size, block);
+    if (!ptr) {
+        LOG(ERROR) << "Error: failed to allocate " << cls_byte_size << " bytes on the cpu.";
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks_[ptr] = block;
+    stats_.in_use_byte_size += cls_byte_size;
+    return ptr;
 }
 
-std::shared_ptr<CPUDeviceAllocator> CPUDeviceAllocator::instance = nullptr;
-}
\ No newline at end of file
+void CPUDeviceAllocator::release(void* ptr) const {
+    if (ptr == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = blocks_.find(ptr);
+    if (iter == blocks_.end()) {
+        free(ptr);
+        return;
+    }
+    const int32_t cls = iter->second.size_class;
+    if (cls == -1) {
+        system_release(ptr, iter->second);
+        blocks_.erase(iter);
+        return;
+    }
+    const size_t cls_byte_size = class_byte_size(cls);
+    free_lists_[cls].push_back(ptr);
+    stats_.in_use_byte_size -= cls_byte_size;
+    stats_.cached_byte_size += cls_byte_size;
+    if (stats_.cached_byte_size > max_cached_byte_size_) {
+        trim_locked(max_cached_byte_size_ / 2);
+    }
+}
+
+void CPUDeviceAllocator::trim(size_t target_byte_size) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trim_locked(target_byte_size);
+}
+
+//从大的class开始回收，大块内存重新申请的代价（缺页）相对它的使用时间更容易摊薄
+void CPUDeviceAllocator::trim_locked(size_t target_byte_size) const {
+    if (stats_.cached_byte_size <= target_byte_size) {
+        return;
+    }
+    stats_.trim_cnt += 1;
+    for (int32_t cls = kNumSizeClasses - 1; cls >= 0; --cls) {
+        auto& free_list = free_lists_[cls];
+        const size_t cls_byte_size = class_byte_size(cls);
+        while (!free_list.empty() && stats_.cached_byte_size > target_byte_size) {
+            void* ptr = free_list.back();
+            free_list.pop_back();
+            auto iter = blocks_.find(ptr);
+            system_release(ptr, iter->second);
+            blocks_.erase(iter);
+            stats_.cached_byte_size -= cls_byte_size;
+        }
+        if (stats_.cached_byte_size <= target_byte_size) {
+            break;
+        }
+    }
+}
+
+void CPUDeviceAllocator::set_max_cached_byte_size(size_t max_cached_byte_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_cached_byte_size_ = max_cached_byte_size;
+    trim_locked(max_cached_byte_size_);
+}
+
+//只影响之后新向系统申请的内存，已经缓存在空闲链表里的块保持原样
+void CPUDeviceAllocator::set_huge_page_policy(HugePagePolicy policy) {
+    huge_page_policy_.store(policy, std::memory_order_relaxed);
+}
+
+HugePagePolicy CPUDeviceAllocator::huge_page_policy() const {
+    return huge_page_policy_.load(std::memory_order_relaxed);
+}
+
+bool CPUDeviceAllocator::is_huge_page(const void* ptr) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = blocks_.find(const_cast<void*>(ptr));
+        if (iter == blocks_.end() || !iter->second.mapped_byte_size) {
+            return false;
+        }
+        if (iter->second.is_explicit_huge_page) {
+            return true;
+        }
+    }
+    return is_huge_page_backed(ptr);
+}
+
+CPUAllocatorStats CPUDeviceAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::shared_ptr<CPUDeviceAllocator> CPUDeviceAllocatorFactory::instance = nullptr;
+}
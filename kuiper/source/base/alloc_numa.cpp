@@ -0,0 +1,42 @@
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include "base/alloc.h"
+namespace base {
+CPUNumaAllocator::CPUNumaAllocator(NumaPolicy policy, int32_t node)
+    : DeviceAllocator(DeviceType::kDeviceCPU), policy_(policy), node_(node) {}
+
+void* CPUNumaAllocator::allocate(size_t byte_size) const {
+  if (!byte_size) {
+    return nullptr;
+  }
+  void* ptr = mmap(nullptr, byte_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    LOG(ERROR) << "Error: failed to map " << byte_size << " bytes for the numa allocator.";
+    return nullptr;
+  }
+  //策略设置失败时内存仍然可用，只是退化成first-touch
+  numa_set_memory_policy(ptr, byte_size, policy_, node_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  mapped_sizes_[ptr] = byte_size;
+  return ptr;
+}
+
+void CPUNumaAllocator::release(void* ptr) const {
+  if (!ptr) {
+    return;
+  }
+  size_t byte_size = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = mapped_sizes_.find(ptr);
+    CHECK(iter != mapped_sizes_.end()) << "The pointer was not allocated by the numa allocator.";
+    byte_size = iter->second;
+    mapped_sizes_.erase(iter);
+  }
+  munmap(ptr, byte_size);
+}
+
+NumaPolicy CPUNumaAllocator::policy() const { return policy_; }
+
+int32_t CPUNumaAllocator::node() const { return node_; }
+}  // namespace base
@@ -9,11 +9,11 @@ namespace base{
 Buffer::Buffer(size_t byte_size, std::shared_ptr<DeviceAllocator> allocator,
     void* ptr , bool use_external):
     byte_size_(byte_size),
-    allocator_(allocator),
     ptr_(ptr),
-    use_external_(use_external){
+    use_external_(use_external),
+    allocator_(allocator){
   if(!ptr_ && allocator_){
-      device_type_ = allocator_->device_type_;
+      device_type_ = allocator_->device_type();
       use_external_ =false;
       ptr_ = allocator_->allocate(byte_size_);
   }
@@ -22,8 +22,8 @@ Buffer::Buffer(size_t byte_size, std::shared_ptr<DeviceAllocator> allocator,
 //那么在Buffer对象释放的时候会调用对应allocator的释放方法，自动释放这块内存。
 Buffer::~Buffer(){
     if(!use_external_){
-        if(ptr && allocator){
-            allocator->release(ptr_);
+        if(ptr_ && allocator_){
+            allocator_->release(ptr_);
             ptr_=nullptr;
         }
     }
@@ -83,7 +83,10 @@ void Buffer::copy_from(const Buffer& buffer) const{
   }
 }
 
-
+void Buffer::copy_from(const Buffer* buffer) const {
+  CHECK(buffer != nullptr);
+  copy_from(*buffer);
+}
       
 DeviceType Buffer::device_type() const {
     return device_type_;
@@ -99,4 +102,14 @@ std::shared_ptr<Buffer> Buffer::get_shared_from_this() {
 bool Buffer::is_external() const {
   return this->use_external_;
 }
-}
\ No newline at end of file
+
+bool Buffer::is_huge_page() const {
+  if (!ptr_ || device_type_ != DeviceType::kDeviceCPU) {
+    return false;
+  }
+  if (allocator_ && !use_external_) {
+    return allocator_->is_huge_page(ptr_);
+  }
+  return is_huge_page_backed(ptr_);
+}
+}
@@ -0,0 +1,121 @@
+#include "base/huge_page.h"
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+namespace base {
+static size_t round_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+//先多映射2M，再把头尾多出来的部分还回去，剩下的起始地址就是2M对齐的，THP只在对齐的2M区间上生效
+static void* map_aligned(size_t byte_size) {
+  const size_t reserve_size = byte_size + kHugePageByteSize;
+  void* reserve = mmap(nullptr, reserve_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserve == MAP_FAILED) {
+    return nullptr;
+  }
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(reserve);
+  const uintptr_t aligned = round_up(begin, kHugePageByteSize);
+  if (aligned > begin) {
+    munmap(reserve, aligned - begin);
+  }
+  const uintptr_t tail = aligned + byte_size;
+  const uintptr_t end = begin + reserve_size;
+  if (end > tail) {
+    munmap(reinterpret_cast<void*>(tail), end - tail);
+  }
+  return reinterpret_cast<void*>(aligned);
+}
+
+void* huge_page_map(size_t byte_size, HugePagePolicy policy, size_t* mapped_byte_size,
+                    bool* is_explicit) {
+  CHECK(mapped_byte_size != nullptr && is_explicit != nullptr);
+  *is_explicit = false;
+  *mapped_byte_size = 0;
+  if (!byte_size) {
+    return nullptr;
+  }
+  if (policy == HugePagePolicy::kHugePageExplicit) {
+    const size_t huge_size = round_up(byte_size, kHugePageByteSize);
+    void* ptr = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) {
+      *is_explicit = true;
+      *mapped_byte_size = huge_size;
+      return ptr;
+    }
+    //没有预留大页（vm.nr_hugepages为0）的机器上很常见，退回到THP
+  }
+  const size_t map_size = round_up(byte_size, 4096);
+  void* ptr = map_aligned(map_size);
+  if (!ptr) {
+    return nullptr;
+  }
+  if (policy != HugePagePolicy::kHugePageNone) {
+    advise_huge_page(ptr, map_size);
+  }
+  *mapped_byte_size = map_size;
+  return ptr;
+}
+
+void huge_page_unmap(void* ptr, size_t mapped_byte_size) {
+  if (ptr && mapped_byte_size) {
+    munmap(ptr, mapped_byte_size);
+  }
+}
+
+bool advise_huge_page(void* ptr, size_t byte_size) {
+#ifdef MADV_HUGEPAGE
+  if (madvise(ptr, byte_size, MADV_HUGEPAGE) == 0) {
+    return true;
+  }
+#endif
+  LOG(WARNING) << "Transparent huge pages are not available, fall back to normal pages.";
+  return false;
+}
+
+bool is_huge_page_backed(const void* ptr) {
+  if (!ptr) {
+    return false;
+  }
+  std::ifstream smaps("/proc/self/smaps");
+  if (!smaps.is_open()) {
+    return false;
+  }
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+  bool in_range = false;
+  std::string line;
+  while (std::getline(smaps, line)) {
+    std::istringstream ss(line);
+    std::string key;
+    ss >> key;
+    const size_t dash = key.find('-');
+    if (dash != std::string::npos && key.back() != ':') {
+      //每个映射的第一行是"begin-end perms offset dev inode path"
+      if (in_range) {
+        break;
+      }
+      const uintptr_t begin = std::stoull(key.substr(0, dash), nullptr, 16);
+      const uintptr_t end = std::stoull(key.substr(dash + 1), nullptr, 16);
+      in_range = addr >= begin && addr < end;
+      continue;
+    }
+    if (!in_range) {
+      continue;
+    }
+    size_t value_kb = 0;
+    ss >> value_kb;
+    if (key == "KernelPageSize:" && value_kb >= kHugePageByteSize / 1024) {
+      return true;
+    }
+    if ((key == "AnonHugePages:" || key == "FilePmdMapped:" || key == "ShmemPmdMapped:") &&
+        value_kb > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace base
@@ -0,0 +1,185 @@
+#include "base/numa.h"
+#include <glog/logging.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+namespace base {
+//解析"0-3,8-11"这种sysfs里的列表格式
+static std::vector<int32_t> parse_list(const std::string& list) {
+  std::vector<int32_t> values;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty() || item == "\n") {
+      continue;
+    }
+    const size_t dash = item.find('-');
+    const int32_t begin = std::stoi(item.substr(0, dash));
+    const int32_t end = dash == std::string::npos ? begin : std::stoi(item.substr(dash + 1));
+    for (int32_t v = begin; v <= end; ++v) {
+      values.push_back(v);
+    }
+  }
+  return values;
+}
+
+static bool read_line(const std::string& path, std::string& line) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::getline(file, line);
+  return !line.empty();
+}
+
+NumaTopology::NumaTopology() {
+  std::string line;
+  if (read_line("/sys/devices/system/node/online", line)) {
+    for (int32_t node : parse_list(line)) {
+      std::string cpulist;
+      if (!read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist",
+                     cpulist)) {
+        continue;
+      }
+      std::vector<int32_t> cpus = parse_list(cpulist);
+      //只有内存没有cpu的节点不参与计算
+      if (cpus.empty()) {
+        continue;
+      }
+      if (node_cpus_.size() <= static_cast<size_t>(node)) {
+        node_cpus_.resize(node + 1);
+      }
+      node_cpus_[node] = std::move(cpus);
+    }
+  }
+  bool has_empty = node_cpus_.empty();
+  for (const auto& cpus : node_cpus_) {
+    has_empty |= cpus.empty();
+  }
+  if (has_empty) {
+    //节点编号不连续的机器上不做NUMA优化，退化成单节点
+    node_cpus_.clear();
+    const int32_t cpu_num = std::max(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+    std::vector<int32_t> cpus(cpu_num);
+    for (int32_t i = 0; i < cpu_num; ++i) {
+      cpus[i] = i;
+    }
+    node_cpus_.push_back(std::move(cpus));
+  }
+}
+
+//cgroup限制的cpu数，向上取整，没有配额时返回0
+static int32_t cgroup_cpu_quota() {
+  std::string line;
+  int64_t quota = -1;
+  int64_t period = 0;
+  //cgroup v2：cpu.max里是"配额 周期"，没有限制时配额是max
+  if (read_line("/sys/fs/cgroup/cpu.max", line)) {
+    std::stringstream ss(line);
+    std::string quota_str;
+    ss >> quota_str >> period;
+    if (quota_str != "max" && !quota_str.empty()) {
+      quota = std::stoll(quota_str);
+    }
+  } else if (read_line("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", line)) {
+    //cgroup v1：没有限制时配额是-1
+    quota = std::stoll(line);
+    std::string period_line;
+    if (read_line("/sys/fs/cgroup/cpu/cpu.cfs_period_us", period_line)) {
+      period = std::stoll(period_line);
+    }
+  }
+  if (quota <= 0 || period <= 0) {
+    return 0;
+  }
+  return static_cast<int32_t>(std::max<int64_t>(1, (quota + period - 1) / period));
+}
+
+int32_t available_cpu_num() {
+  int32_t cpu_num = 0;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set) == 0) {
+    cpu_num = CPU_COUNT(&cpu_set);
+  }
+  if (cpu_num <= 0) {
+    cpu_num = std::max(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+  }
+  const int32_t quota = cgroup_cpu_quota();
+  if (quota > 0) {
+    cpu_num = std::min(cpu_num, quota);
+  }
+  return cpu_num;
+}
+
+const NumaTopology& NumaTopology::get_instance() {
+  static NumaTopology instance;
+  return instance;
+}
+
+int32_t NumaTopology::node_num() const { return static_cast<int32_t>(node_cpus_.size()); }
+
+int32_t NumaTopology::cpu_num() const {
+  int32_t num = 0;
+  for (const auto& cpus : node_cpus_) {
+    num += static_cast<int32_t>(cpus.size());
+  }
+  return num;
+}
+
+const std::vector<int32_t>& NumaTopology::node_cpus(int32_t node) const {
+  CHECK(node >= 0 && node < node_num());
+  return node_cpus_.at(node);
+}
+
+bool numa_set_memory_policy(void* ptr, size_t byte_size, NumaPolicy policy, int32_t node) {
+  if (policy == NumaPolicy::kNumaPolicyDefault || !ptr || !byte_size) {
+    return true;
+  }
+  const NumaTopology& topology = NumaTopology::get_instance();
+  const int32_t node_num = topology.node_num();
+  constexpr int32_t kBitsPerWord = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> node_mask((node_num + kBitsPerWord - 1) / kBitsPerWord, 0);
+  int32_t mode = MPOL_BIND;
+  if (policy == NumaPolicy::kNumaPolicyInterleave) {
+    mode = MPOL_INTERLEAVE;
+    for (int32_t i = 0; i < node_num; ++i) {
+      node_mask[i / kBitsPerWord] |= 1UL << (i % kBitsPerWord);
+    }
+  } else {
+    CHECK(node >= 0 && node < node_num);
+    node_mask[node / kBitsPerWord] |= 1UL << (node % kBitsPerWord);
+  }
+  //内核会把maxnode减一，所以这里多传一位
+  const unsigned long max_node = node_mask.size() * kBitsPerWord + 1;
+  const long ret = syscall(SYS_mbind, ptr, byte_size, mode, node_mask.data(), max_node, 0);
+  if (ret != 0) {
+    LOG(WARNING) << "Failed to set the numa memory policy, the memory will be placed by "
+                    "first-touch.";
+    return false;
+  }
+  return true;
+}
+
+static bool pin_thread(const std::vector<int32_t>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int32_t cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0;
+}
+
+bool pin_thread_to_node(int32_t node) {
+  return pin_thread(NumaTopology::get_instance().node_cpus(node));
+}
+
+bool pin_thread_to_cpu(int32_t cpu) { return pin_thread({cpu}); }
+}  // namespace base
@@ -0,0 +1,266 @@
+#include "base/thread_pool.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include "base/alloc.h"
+#include "base/numa.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+namespace base {
+//当前线程是哪个线程池的第几个worker，用来识别嵌套调用
+static thread_local ThreadPool* tls_pool = nullptr;
+static thread_local int32_t tls_worker_id = -1;
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+static inline uint64_t pack_range(int64_t begin, int64_t end) {
+  return (static_cast<uint64_t>(begin) << 32) | static_cast<uint64_t>(end);
+}
+
+static inline int64_t range_begin(uint64_t range) { return static_cast<int64_t>(range >> 32); }
+
+static inline int64_t range_end(uint64_t range) {
+  return static_cast<int64_t>(range & 0xffffffffULL);
+}
+
+ThreadPool::ThreadPool(int32_t thread_num, bool pin_to_numa_nodes, int32_t spin_count) {
+  const NumaTopology& topology = NumaTopology::get_instance();
+  thread_num_ = thread_num > 0 ? thread_num : available_cpu_num();
+  spin_count_ = std::max(0, spin_count);
+  node_num_ = 1;
+  //调用线程作为worker 0不绑核，它可能在任何节点上跑，所以只把1..thread_num - 1分到各个节点上
+  if (pin_to_numa_nodes && topology.node_num() > 1 && thread_num_ > 2) {
+    node_num_ = std::min(topology.node_num(), thread_num_ - 1);
+  }
+  const int32_t first = node_num_ > 1 ? 1 : 0;
+  const int32_t grouped = thread_num_ - first;
+  worker_nodes_.assign(thread_num_, -1);
+  for (int32_t w = first; w < thread_num_; ++w) {
+    worker_nodes_[w] = static_cast<int32_t>(static_cast<int64_t>(w - first) * node_num_ / grouped);
+  }
+  node_first_workers_.resize(node_num_ + 1);
+  for (int32_t node = 0; node <= node_num_; ++node) {
+    node_first_workers_[node] = first + (node * grouped + node_num_ - 1) / node_num_;
+  }
+
+  ranges_.reset(new ChunkRange[thread_num_]);
+  scratches_.resize(thread_num_);
+  threads_.reserve(thread_num_ - 1);
+  for (int32_t w = 1; w < thread_num_; ++w) {
+    threads_.emplace_back([this, w]() {
+      if (node_num_ > 1) {
+        pin_thread_to_node(worker_nodes_[w]);
+      }
+      worker_loop(w);
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  stop_.store(true, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    park_cv_.notify_all();
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+int32_t ThreadPool::thread_num() const { return thread_num_; }
+
+void ThreadPool::worker_loop(int32_t worker_id) {
+  tls_pool = this;
+  tls_worker_id = worker_id;
+  uint64_t seen = 0;
+  while (true) {
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    int32_t spins = 0;
+    while (generation == seen && !stop_.load(std::memory_order_acquire)) {
+      if (spins < spin_count_) {
+        cpu_relax();
+        ++spins;
+      } else {
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        parked_num_ += 1;
+        park_cv_.wait(lock, [this, seen]() {
+          return generation_.load(std::memory_order_acquire) != seen ||
+                 stop_.load(std::memory_order_acquire);
+        });
+        parked_num_ -= 1;
+      }
+      generation = generation_.load(std::memory_order_acquire);
+    }
+    if (stop_.load(std::memory_order_acquire)) {
+      return;
+    }
+    seen = generation;
+    execute(worker_id);
+    pending_workers_.fetch_sub(1, std::memory_order_acq_rel);
+  }
+}
+
+void ThreadPool::execute(int32_t worker_id) {
+  if (worker_func_) {
+    (*worker_func_)(worker_id);
+    return;
+  }
+  int64_t chunk = 0;
+  while (pop_chunk(worker_id, chunk) || (job_steal_ && steal_chunk(worker_id, chunk))) {
+    const int64_t begin = job_begin_ + chunk * job_grain_;
+    const int64_t end = std::min(job_end_, begin + job_grain_);
+    (*range_func_)(begin, end, worker_id);
+  }
+}
+
+bool ThreadPool::pop_chunk(int32_t worker_id, int64_t& chunk) {
+  std::atomic<uint64_t>& range = ranges_[worker_id].range;
+  uint64_t current = range.load(std::memory_order_acquire);
+  while (true) {
+    const int64_t begin = range_begin(current);
+    const int64_t end = range_end(current);
+    if (begin >= end) {
+      return false;
+    }
+    if (range.compare_exchange_weak(current, pack_range(begin + 1, end),
+                                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+      chunk = begin;
+      return true;
+    }
+  }
+}
+
+//从别的worker剩下的块里偷后一半，第一块马上执行，其余的放进自己的区间
+bool ThreadPool::steal_chunk(int32_t worker_id, int64_t& chunk) {
+  for (int32_t i = 1; i < thread_num_; ++i) {
+    const int32_t victim = (worker_id + i) % thread_num_;
+    std::atomic<uint64_t>& range = ranges_[victim].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (true) {
+      const int64_t begin = range_begin(current);
+      const int64_t end = range_end(current);
+      if (begin >= end) {
+        break;
+      }
+      const int64_t mid = begin + (end - begin) / 2;
+      if (range.compare_exchange_weak(current, pack_range(begin, mid),
+                                      std::memory_order_acq_rel, std::memory_order_acquire)) {
+        chunk = mid;
+        //自己的区间此时是空的，别的worker不会对它做CAS，直接写就行
+        if (mid + 1 < end) {
+          ranges_[worker_id].range.store(pack_range(mid + 1, end), std::memory_order_release);
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+//调用线程以worker 0的身份执行，期间它发起的parallel_for会被识别成嵌套调用
+template <typename F>
+static void execute_on_caller(ThreadPool* pool, F&& func) {
+  ThreadPool* prev_pool = tls_pool;
+  const int32_t prev_worker_id = tls_worker_id;
+  tls_pool = pool;
+  tls_worker_id = 0;
+  func();
+  tls_pool = prev_pool;
+  tls_worker_id = prev_worker_id;
+}
+
+void ThreadPool::dispatch(int64_t chunk_num, bool steal) {
+  CHECK_LE(chunk_num, static_cast<int64_t>(UINT32_MAX));
+  job_steal_ = steal;
+  for (int32_t w = 0; w < thread_num_; ++w) {
+    const int64_t begin = chunk_num * w / thread_num_;
+    const int64_t end = chunk_num * (w + 1) / thread_num_;
+    ranges_[w].range.store(pack_range(begin, end), std::memory_order_relaxed);
+  }
+  pending_workers_.store(thread_num_ - 1, std::memory_order_relaxed);
+  generation_.fetch_add(1, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    if (parked_num_ > 0) {
+      park_cv_.notify_all();
+    }
+  }
+
+  execute_on_caller(this, [this]() { execute(0); });
+
+  while (pending_workers_.load(std::memory_order_acquire) != 0) {
+    cpu_relax();
+  }
+  range_func_ = nullptr;
+  worker_func_ = nullptr;
+}
+
+void ThreadPool::parallel_for(int64_t begin, int64_t end, int64_t grain, const RangeFunc& func) {
+  if (end <= begin) {
+    return;
+  }
+  grain = std::max<int64_t>(grain, 1);
+  const int64_t chunk_num = (end - begin + grain - 1) / grain;
+  if (tls_pool == this) {
+    func(begin, end, tls_worker_id);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(dispatch_mutex_);
+  if (thread_num_ == 1 || chunk_num == 1) {
+    execute_on_caller(this, [&]() { func(begin, end, 0); });
+    return;
+  }
+  range_func_ = &func;
+  worker_func_ = nullptr;
+  job_begin_ = begin;
+  job_end_ = end;
+  job_grain_ = grain;
+  dispatch(chunk_num, true);
+}
+
+void ThreadPool::run(const WorkerFunc& func) {
+  CHECK(tls_pool != this) << "ThreadPool::run can not be called inside a worker of the same pool.";
+  std::lock_guard<std::mutex> lock(dispatch_mutex_);
+  if (thread_num_ == 1) {
+    execute_on_caller(this, [&]() { func(0); });
+    return;
+  }
+  range_func_ = nullptr;
+  worker_func_ = &func;
+  dispatch(thread_num_, false);
+}
+
+void* ThreadPool::scratch(int32_t worker_id, size_t byte_size) {
+  CHECK(worker_id >= 0 && worker_id < thread_num_);
+  std::shared_ptr<Buffer>& buffer = scratches_[worker_id];
+  if (!buffer || buffer->byte_size() < byte_size) {
+    buffer = std::make_shared<Buffer>(byte_size, CPUDeviceAllocatorFactory::get_instance());
+    CHECK(buffer->ptr() != nullptr) << "Failed to allocate the scratch of worker " << worker_id;
+  }
+  return buffer->ptr();
+}
+
+int32_t ThreadPool::node_num() const { return node_num_; }
+
+int32_t ThreadPool::worker_node(int32_t worker_id) const { return worker_nodes_.at(worker_id); }
+
+int32_t ThreadPool::node_rank(int32_t worker_id) const {
+  const int32_t node = worker_nodes_.at(worker_id);
+  return node < 0 ? -1 : worker_id - node_first_workers_.at(node);
+}
+
+int32_t ThreadPool::node_worker_num(int32_t node) const {
+  return node_first_workers_.at(node + 1) - node_first_workers_.at(node);
+}
+
+ThreadPool* ThreadPool::default_pool() {
+  static ThreadPool pool;
+  return &pool;
+}
+}  // namespace base
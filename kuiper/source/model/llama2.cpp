@@ -0,0 +1,510 @@
+#include "model/llama2.h"
+#include <glog/logging.h>
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+#include <utility>
+namespace model {
+//子类只重写了无参的forward()，带输入输出的重载要通过基类调用
+static base::Status run(op::Layer* layer, const tensor::Tensor& input,
+                        const tensor::Tensor& output) {
+  return layer->forward(input, output);
+}
+
+static base::Status run(op::Layer* layer, const tensor::Tensor& input1,
+                        const tensor::Tensor& input2, const tensor::Tensor& input3,
+                        const tensor::Tensor& output) {
+  return layer->forward(input1, input2, input3, output);
+}
+
+//residual += delta，normed = rmsnorm(residual)
+static base::Status add_norm(op::AddRMSNormLayer* layer, const tensor::Tensor& residual,
+                             const tensor::Tensor& delta, const tensor::Tensor& normed) {
+  layer->set_input(0, residual);
+  layer->set_input(1, delta);
+  layer->set_output(0, residual);
+  layer->set_output(1, normed);
+  return layer->forward();
+}
+
+LLama2Model::LLama2Model(std::string model_path, bool is_quant_model)
+    : model_path_(std::move(model_path)), is_quant_model_(is_quant_model) {}
+
+base::Status LLama2Model::init(base::DeviceType device_type, int32_t max_rows,
+                               int32_t kv_block_size, int32_t kv_block_num,
+                               op::KVCacheFormat kv_format) {
+  if (device_type != base::DeviceType::kDeviceCPU) {
+    return base::error::InvalidArgument("The llama2 model only supports the cpu device for now.");
+  }
+  if (max_rows <= 0) {
+    return base::error::InvalidArgument("The max rows of the llama2 model must be positive.");
+  }
+  if (weight_data_type_ != base::DataType::kDataTypeFp32 && is_quant_model_) {
+    return base::error::InvalidArgument(
+        "The fp16 and bf16 weights are only supported for a non-quantized model.");
+  }
+  if (quant_weight_type_ != base::DataType::kDataTypeInt8 && !is_quant_model_) {
+    return base::error::InvalidArgument(
+        "The int4 weights are only supported for a quantized model.");
+  }
+  device_type_ = device_type;
+  max_rows_ = max_rows;
+
+  const bool use_huge_page = huge_page_policy_ != base::HugePagePolicy::kHugePageNone;
+  loader_ = std::make_unique<ModelLoader>(model_path_, is_quant_model_, use_huge_page);
+  auto status = loader_->open();
+  if (!status) {
+    return status;
+  }
+  if (quant_weight_type_ == base::DataType::kDataTypeInt4 && loader_->group_size() % 32 != 0) {
+    return base::error::ModelParseError(
+        "The group size of an int4 model file must be a multiple of 32.");
+  }
+  const ModelConfig& model_config = loader_->config();
+  if (model_config.dim <= 0 || model_config.head_num <= 0 || model_config.kv_head_num <= 0 ||
+      model_config.layer_num <= 0 || model_config.seq_len <= 0 ||
+      model_config.dim % model_config.head_num != 0 ||
+      model_config.head_num % model_config.kv_head_num != 0) {
+    return base::error::ModelParseError("The config header of the model file is invalid.");
+  }
+  config_.dim = model_config.dim;
+  config_.hidden_dim = model_config.hidden_dim;
+  config_.layer_num = model_config.layer_num;
+  config_.head_num = model_config.head_num;
+  config_.kv_head_num = model_config.kv_head_num;
+  config_.head_size = model_config.dim / model_config.head_num;
+  config_.kv_dim = config_.head_size * model_config.kv_head_num;
+  config_.kv_mul = model_config.head_num / model_config.kv_head_num;
+  config_.vocab_size = std::abs(model_config.vocab_size);
+  config_.seq_len = model_config.seq_len;
+  config_.is_shared_weight = model_config.vocab_size > 0;
+
+  status = create_layers();
+  if (!status) {
+    return status;
+  }
+  status = load_weights();
+  if (!status) {
+    return status;
+  }
+  status = init_buffers();
+  if (!status) {
+    return status;
+  }
+
+  kv_cache_ = std::make_shared<op::PagedKVCache>(config_.layer_num, config_.kv_dim, kv_block_size,
+                                                 kv_block_num, kv_format, config_.head_size);
+  std::shared_ptr<base::DeviceAllocator> kv_alloc =
+      base::DeviceAllocatorFactory::get_instance(device_type_);
+  if (use_huge_page) {
+    auto huge_page_alloc = std::make_shared<base::CPUDeviceAllocator>();
+    huge_page_alloc->set_huge_page_policy(huge_page_policy_);
+    kv_alloc = huge_page_alloc;
+  }
+  status = kv_cache_->init(kv_alloc);
+  if (!status) {
+    return status;
+  }
+  if (cpu_config_) {
+    set_cpu_config(cpu_config_);
+  }
+  //打包放在最后，用上面设置好的线程池
+  if (weight_prepack_) {
+    return prepack_weights();
+  }
+  return base::error::Success();
+}
+
+base::Status LLama2Model::create_layers() {
+  const TransformerConfig& c = config_;
+  const bool quant = is_quant_model_;
+  embedding_layer_ = std::make_shared<op::EmbeddingLayer>(device_type_, c.dim, c.vocab_size);
+  first_norm_layer_ = std::make_shared<op::RmsNormLayer>(device_type_, c.dim);
+  for (int32_t i = 0; i < c.layer_num; ++i) {
+    attention_norm_layers_.push_back(std::make_shared<op::AddRMSNormLayer>(device_type_, c.dim));
+    ffn_norm_layers_.push_back(std::make_shared<op::AddRMSNormLayer>(device_type_, c.dim));
+    wq_layers_.push_back(std::make_shared<op::LinearLayer>(device_type_, c.dim, c.dim, quant));
+    wk_layers_.push_back(std::make_shared<op::LinearLayer>(device_type_, c.kv_dim, c.dim, quant));
+    wv_layers_.push_back(std::make_shared<op::LinearLayer>(device_type_, c.kv_dim, c.dim, quant));
+    wo_layers_.push_back(std::make_shared<op::LinearLayer>(device_type_, c.dim, c.dim, quant));
+    ffn_layers_.push_back(
+        std::make_shared<op::SwiGLULayer>(device_type_, c.dim, c.hidden_dim, quant));
+    w2_layers_.push_back(
+        std::make_shared<op::LinearLayer>(device_type_, c.dim, c.hidden_dim, quant));
+  }
+  final_norm_layer_ = std::make_shared<op::AddRMSNormLayer>(device_type_, c.dim);
+  //共享权重时分类头直接用fp32的embedding表
+  cls_layer_ = std::make_shared<op::LinearLayer>(device_type_, c.vocab_size, c.dim,
+                                                 quant && !c.is_shared_weight);
+  //权重的存储格式要在加载之前设置好，loader按它决定每一块占多少字节
+  if (quant_weight_type_ == base::DataType::kDataTypeInt4) {
+    for (int32_t i = 0; i < c.layer_num; ++i) {
+      for (auto* layers : {&wq_layers_, &wk_layers_, &wv_layers_, &wo_layers_, &w2_layers_}) {
+        layers->at(i)->set_weight_data_type(quant_weight_type_, quant_weight_with_min_);
+      }
+    }
+    if (!c.is_shared_weight) {
+      cls_layer_->set_weight_data_type(quant_weight_type_, quant_weight_with_min_);
+    }
+  }
+
+  rope_layer_ =
+      std::make_shared<op::RoPELayer>(device_type_, c.dim, c.kv_dim, c.head_size, c.seq_len);
+  auto status = rope_layer_->init();
+  if (!status) {
+    return status;
+  }
+  //所有block共用一个mha layer，forward时切换layer_idx
+  mha_layer_ = std::make_shared<op::MultiHeadAttention>(device_type_, 0, c.kv_mul, c.kv_dim,
+                                                        c.seq_len, c.head_num, c.head_size);
+  return mha_layer_->init();
+}
+
+base::Status LLama2Model::load_weights() {
+  //文件里的顺序：token_embedding, rms_att, wq, wk, wv, wo, rms_ffn, w1, w2, w3, rms_final,
+  //freq_cis_real, freq_cis_imag, (wcls)，每一项都是所有layer的权重连在一起
+  const TransformerConfig& c = config_;
+  const int32_t layer_num = c.layer_num;
+  auto status = loader_->load_weight(embedding_layer_.get(), 0, {c.vocab_size, c.dim});
+  if (!status) {
+    return status;
+  }
+
+  auto load_each = [&](auto& layers, int32_t idx, const std::vector<int32_t>& dims) {
+    for (int32_t i = 0; i < layer_num; ++i) {
+      auto layer_status = loader_->load_weight(layers.at(i).get(), idx, dims);
+      if (!layer_status) {
+        return layer_status;
+      }
+    }
+    return base::error::Success();
+  };
+  if (!(status = load_each(attention_norm_layers_, 0, {c.dim})) ||
+      !(status = load_each(wq_layers_, 0, {c.dim, c.dim})) ||
+      !(status = load_each(wk_layers_, 0, {c.kv_dim, c.dim})) ||
+      !(status = load_each(wv_layers_, 0, {c.kv_dim, c.dim})) ||
+      !(status = load_each(wo_layers_, 0, {c.dim, c.dim})) ||
+      !(status = load_each(ffn_norm_layers_, 0, {c.dim})) ||
+      !(status = load_each(ffn_layers_, 0, {c.hidden_dim, c.dim})) ||
+      !(status = load_each(w2_layers_, 0, {c.dim, c.hidden_dim})) ||
+      !(status = load_each(ffn_layers_, 1, {c.hidden_dim, c.dim}))) {
+    return status;
+  }
+  status = loader_->load_weight(final_norm_layer_.get(), 0, {c.dim});
+  if (!status) {
+    return status;
+  }
+  //RoPE的表在init里自己算，跳过文件里fp32的freq_cis
+  const size_t freq_num = static_cast<size_t>(c.seq_len) * c.head_size;
+  status = loader_->skip(freq_num * sizeof(float));
+  if (!status) {
+    return status;
+  }
+  if (c.is_shared_weight) {
+    status = cls_layer_->set_weight(0, embedding_layer_->get_weight(0));
+  } else {
+    status = loader_->load_weight(cls_layer_.get(), 0, {c.vocab_size, c.dim});
+  }
+  if (!status) {
+    return status;
+  }
+  status = first_norm_layer_->set_weight(0, attention_norm_layers_.at(0)->get_weight(0));
+  if (!status) {
+    return status;
+  }
+  //先转换精度再按NUMA策略放置，两者都要在打包之前。
+  //共享权重时分类头换成转换出来的副本，embedding还是读文件里的fp32
+  for (op::LinearLayer* layer : linear_layers()) {
+    if (weight_data_type_ != base::DataType::kDataTypeFp32) {
+      status = layer->convert_weight(weight_data_type_);
+      if (!status) {
+        return status;
+      }
+    }
+    if (numa_policy_ != base::NumaPolicy::kNumaPolicyDefault) {
+      status = layer->set_numa_policy(numa_policy_);
+      if (!status) {
+        return status;
+      }
+    }
+  }
+  return base::error::Success();
+}
+
+base::Status LLama2Model::init_buffers() {
+  const TransformerConfig& c = config_;
+  auto alloc_cpu = base::CPUDeviceAllocatorFactory::get_instance();
+  const base::DataType fp32 = base::DataType::kDataTypeFp32;
+  //token id和位置总是放在CPU上，kernel按值读取
+  tokens_ = tensor::Tensor(base::DataType::kDataTypeInt32, max_rows_, true, alloc_cpu);
+  positions_ = tensor::Tensor(base::DataType::kDataTypeInt32, max_rows_, true, alloc_cpu);
+  for (tensor::Tensor* t : {&tokens_, &positions_}) {
+    if (t->is_empty()) {
+      return base::error::InternalError("Failed to allocate the buffers of the llama2 model.");
+    }
+    t->set_device_type(base::DeviceType::kDeviceCPU);
+  }
+
+  MemoryPlanner planner(device_type_);
+  const int32_t x = planner.add_tensor("x", fp32, {max_rows_, c.dim});
+  const int32_t xb = planner.add_tensor("xb", fp32, {max_rows_, c.dim});
+  const int32_t query = planner.add_tensor("query", fp32, {max_rows_, c.dim});
+  const int32_t key = planner.add_tensor("key", fp32, {max_rows_, c.kv_dim});
+  const int32_t value = planner.add_tensor("value", fp32, {max_rows_, c.kv_dim});
+  const int32_t attn_out = planner.add_tensor("attn_out", fp32, {max_rows_, c.dim});
+  const int32_t proj_out = planner.add_tensor("proj_out", fp32, {max_rows_, c.dim});
+  const int32_t hidden = planner.add_tensor("hidden", fp32, {max_rows_, c.hidden_dim});
+  const int32_t logits = planner.add_tensor("logits", fp32, {max_rows_, c.vocab_size});
+  //forward返回之后调用方还要读logits
+  planner.mark_persistent(logits);
+
+  //每个block按同样的顺序重写同一组激活，block之间只有x和xb往下传，登记一个block就够了。
+  //hidden和query、key、value、attn_out的生命周期不重叠，共用一段内存
+  const std::vector<std::tuple<op::Layer*, std::vector<int32_t>, std::vector<int32_t>>> steps = {
+      {embedding_layer_.get(), {-1}, {x}},
+      {first_norm_layer_.get(), {x}, {xb}},
+      {wq_layers_[0].get(), {xb}, {query}},
+      {wk_layers_[0].get(), {xb}, {key}},
+      {wv_layers_[0].get(), {xb}, {value}},
+      {rope_layer_.get(), {query, key, -1}, {query}},
+      {mha_layer_.get(), {query, key, value}, {attn_out}},
+      {wo_layers_[0].get(), {attn_out}, {proj_out}},
+      {ffn_norm_layers_[0].get(), {x, proj_out}, {x, xb}},
+      {ffn_layers_[0].get(), {xb}, {hidden}},
+      {w2_layers_[0].get(), {hidden}, {proj_out}},
+      {final_norm_layer_.get(), {x, proj_out}, {x, xb}},
+      {cls_layer_.get(), {xb}, {logits}},
+  };
+  for (const auto& [layer, input_ids, output_ids] : steps) {
+    auto status = planner.add_step(layer, input_ids, output_ids);
+    if (!status) {
+      return status;
+    }
+  }
+  auto status = planner.allocate(base::DeviceAllocatorFactory::get_instance(device_type_));
+  if (!status) {
+    return status;
+  }
+  activation_byte_size_ = planner.arena_byte_size();
+  //tensor的Buffer持有arena的引用，planner析构之后它们仍然有效
+  x_ = planner.get_tensor(x);
+  xb_ = planner.get_tensor(xb);
+  query_ = planner.get_tensor(query);
+  key_ = planner.get_tensor(key);
+  value_ = planner.get_tensor(value);
+  attn_out_ = planner.get_tensor(attn_out);
+  proj_out_ = planner.get_tensor(proj_out);
+  hidden_ = planner.get_tensor(hidden);
+  logits_ = planner.get_tensor(logits);
+  return base::error::Success();
+}
+
+base::Status LLama2Model::forward(const std::vector<BatchRow>& rows, tensor::Tensor& logits) {
+  const int32_t row_num = static_cast<int32_t>(rows.size());
+  if (row_num == 0 || row_num > max_rows_) {
+    return base::error::InvalidArgument("The row number of the llama2 forward is out of range.");
+  }
+  for (int32_t i = 0; i < row_num; ++i) {
+    const BatchRow& row = rows[i];
+    if (row.token < 0 || row.token >= config_.vocab_size || row.pos < 0 ||
+        row.pos >= config_.seq_len) {
+      return base::error::InvalidArgument("The token or position of the row " +
+                                          std::to_string(i) + " is out of range.");
+    }
+    if (i > 0 && row.seq_id == rows[i - 1].seq_id && row.pos != rows[i - 1].pos + 1) {
+      return base::error::InvalidArgument("The positions of the sequence " +
+                                          std::to_string(row.seq_id) + " are not contiguous.");
+    }
+    tokens_.index<int32_t>(i) = row.token;
+    positions_.index<int32_t>(i) = row.pos;
+  }
+
+  const tensor::Tensor x = x_.slice(0, 0, row_num);
+  const tensor::Tensor xb = xb_.slice(0, 0, row_num);
+  const tensor::Tensor query = query_.slice(0, 0, row_num);
+  const tensor::Tensor key = key_.slice(0, 0, row_num);
+  const tensor::Tensor value = value_.slice(0, 0, row_num);
+  const tensor::Tensor attn_out = attn_out_.slice(0, 0, row_num);
+  const tensor::Tensor proj_out = proj_out_.slice(0, 0, row_num);
+  const tensor::Tensor hidden = hidden_.slice(0, 0, row_num);
+  auto status = run(embedding_layer_.get(), tokens_.slice(0, 0, row_num), x);
+  if (!status) {
+    return status;
+  }
+  status = run(first_norm_layer_.get(), x, xb);
+  if (!status) {
+    return status;
+  }
+
+  for (int32_t l = 0; l < config_.layer_num; ++l) {
+    if (!(status = run(wq_layers_[l].get(), xb, query)) ||
+        !(status = run(wk_layers_[l].get(), xb, key)) ||
+        !(status = run(wv_layers_[l].get(), xb, value)) ||
+        !(status = run(rope_layer_.get(), query, key, positions_.slice(0, 0, row_num), query)) ||
+        !(status = attention(rows, l)) ||
+        !(status = run(wo_layers_[l].get(), attn_out, proj_out)) ||
+        !(status = add_norm(ffn_norm_layers_[l].get(), x, proj_out, xb)) ||
+        !(status = run(ffn_layers_[l].get(), xb, hidden)) ||
+        !(status = run(w2_layers_[l].get(), hidden, proj_out))) {
+      return status;
+    }
+    //残差加完之后顺便算好下一个block（或者最后）的norm
+    op::AddRMSNormLayer* next_norm = l + 1 < config_.layer_num
+                                         ? attention_norm_layers_[l + 1].get()
+                                         : final_norm_layer_.get();
+    status = add_norm(next_norm, x, proj_out, xb);
+    if (!status) {
+      return status;
+    }
+  }
+
+  //需要logits的行挪到xb的最前面，分类头只算这几行
+  int32_t logits_num = 0;
+  const size_t row_bytes = config_.dim * sizeof(float);
+  for (int32_t i = 0; i < row_num; ++i) {
+    if (!rows[i].need_logits) {
+      continue;
+    }
+    if (logits_num != i) {
+      std::memmove(xb_.ptr<float>(static_cast<int64_t>(logits_num) * config_.dim),
+                   xb_.ptr<float>(static_cast<int64_t>(i) * config_.dim), row_bytes);
+    }
+    logits_num += 1;
+  }
+  if (logits_num == 0) {
+    logits = tensor::Tensor();
+    return base::error::Success();
+  }
+  logits = logits_.slice(0, 0, logits_num);
+  return run(cls_layer_.get(), xb_.slice(0, 0, logits_num), logits);
+}
+
+base::Status LLama2Model::attention(const std::vector<BatchRow>& rows, int32_t layer_idx) {
+  mha_layer_->set_layer_idx(layer_idx);
+  const int32_t row_num = static_cast<int32_t>(rows.size());
+  int32_t begin = 0;
+  while (begin < row_num) {
+    int32_t end = begin + 1;
+    while (end < row_num && rows[end].seq_id == rows[begin].seq_id) {
+      end += 1;
+    }
+    mha_layer_->set_paged_kv_cache(kv_cache_, rows[begin].seq_id);
+    mha_layer_->set_pos(rows[begin].pos);
+    //每条序列的行直接是共享buffer上的切片，不拷贝
+    auto status = run(mha_layer_.get(), query_.slice(0, begin, end), key_.slice(0, begin, end),
+                      value_.slice(0, begin, end), attn_out_.slice(0, begin, end));
+    if (!status) {
+      return status;
+    }
+    begin = end;
+  }
+  return base::error::Success();
+}
+
+std::vector<op::Layer*> LLama2Model::all_layers() const {
+  std::vector<op::Layer*> layers = {embedding_layer_.get(), first_norm_layer_.get(),
+                                    final_norm_layer_.get(), cls_layer_.get(), rope_layer_.get(),
+                                    mha_layer_.get()};
+  for (int32_t i = 0; i < config_.layer_num; ++i) {
+    layers.push_back(attention_norm_layers_[i].get());
+    layers.push_back(ffn_norm_layers_[i].get());
+    layers.push_back(wq_layers_[i].get());
+    layers.push_back(wk_layers_[i].get());
+    layers.push_back(wv_layers_[i].get());
+    layers.push_back(wo_layers_[i].get());
+    layers.push_back(ffn_layers_[i].get());
+    layers.push_back(w2_layers_[i].get());
+  }
+  return layers;
+}
+
+std::vector<op::LinearLayer*> LLama2Model::linear_layers() const {
+  std::vector<op::LinearLayer*> layers;
+  for (int32_t i = 0; i < config_.layer_num; ++i) {
+    layers.push_back(wq_layers_[i].get());
+    layers.push_back(wk_layers_[i].get());
+    layers.push_back(wv_layers_[i].get());
+    layers.push_back(wo_layers_[i].get());
+    layers.push_back(w2_layers_[i].get());
+  }
+  layers.push_back(cls_layer_.get());
+  return layers;
+}
+
+void LLama2Model::set_cpu_config(std::shared_ptr<kernel::CpuConfig> config) {
+  cpu_config_ = std::move(config);
+  if (!embedding_layer_) {
+    return;
+  }
+  for (op::Layer* layer : all_layers()) {
+    layer->set_cpu_config(cpu_config_);
+  }
+}
+
+void LLama2Model::set_weight_data_type(base::DataType data_type) {
+  CHECK(data_type == base::DataType::kDataTypeFp32 || data_type == base::DataType::kDataTypeFp16 ||
+        data_type == base::DataType::kDataTypeBf16);
+  weight_data_type_ = data_type;
+}
+
+void LLama2Model::set_quant_weight_type(base::DataType data_type, bool with_min) {
+  CHECK(data_type == base::DataType::kDataTypeInt8 || data_type == base::DataType::kDataTypeInt4);
+  CHECK(!with_min || data_type == base::DataType::kDataTypeInt4);
+  quant_weight_type_ = data_type;
+  quant_weight_with_min_ = with_min;
+}
+
+void LLama2Model::set_numa_policy(base::NumaPolicy policy) { numa_policy_ = policy; }
+
+void LLama2Model::set_huge_page_policy(base::HugePagePolicy policy) {
+  huge_page_policy_ = policy;
+}
+
+void LLama2Model::set_weight_prepack(bool prepack, std::string cache_path) {
+  weight_prepack_ = prepack;
+  pack_cache_path_ = std::move(cache_path);
+}
+
+base::Status LLama2Model::prepack_weights() {
+  //缓存文件里的第i块对应这里的第i层，顺序不能变
+  const std::vector<op::LinearLayer*> layers = linear_layers();
+  std::vector<size_t> byte_sizes;
+  for (op::LinearLayer* layer : layers) {
+    byte_sizes.push_back(layer->packed_weight_byte_size());
+  }
+
+  const std::string cache_path =
+      pack_cache_path_.empty() ? model_path_ + ".packed" : pack_cache_path_;
+  auto cache = std::make_unique<WeightPackCache>(cache_path);
+  const bool cached = static_cast<bool>(cache->open(model_path_, byte_sizes));
+  std::vector<const void*> packed(layers.size(), nullptr);
+  for (size_t i = 0; i < layers.size(); ++i) {
+    if (byte_sizes[i] == 0) {
+      continue;
+    }
+    const void* data = cached ? cache->data(static_cast<int32_t>(i)) : nullptr;
+    auto status = layers[i]->prepack_weight(data);
+    if (!status) {
+      return status;
+    }
+    packed[i] = layers[i]->get_weight(0).ptr<void>();
+  }
+  if (cached) {
+    pack_cache_ = std::move(cache);
+    return base::error::Success();
+  }
+  auto status = cache->save(model_path_, packed, byte_sizes);
+  if (!status) {
+    LOG(WARNING) << "Failed to write the weight pack cache: " << status.get_err_msg();
+  }
+  return base::error::Success();
+}
+
+const TransformerConfig& LLama2Model::config() const { return config_; }
+
+std::shared_ptr<op::PagedKVCache> LLama2Model::kv_cache() const { return kv_cache_; }
+
+int32_t LLama2Model::max_rows() const { return max_rows_; }
+
+size_t LLama2Model::activation_byte_size() const { return activation_byte_size_; }
+}  // namespace model
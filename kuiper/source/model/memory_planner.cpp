@@ -0,0 +1,211 @@
+#include "model/memory_planner.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+namespace model {
+static size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+MemoryPlanner::MemoryPlanner(base::DeviceType device_type, size_t alignment)
+    : device_type_(device_type), alignment_(alignment) {
+  CHECK(alignment_ > 0 && (alignment_ & (alignment_ - 1)) == 0)
+      << "The alignment of the memory planner must be a power of two.";
+}
+
+int32_t MemoryPlanner::add_tensor(const std::string& name, base::DataType data_type,
+                                  const std::vector<int32_t>& dims) {
+  PlannedTensor planned;
+  planned.name = name;
+  planned.tensor = tensor::Tensor(data_type, dims);
+  planned.byte_size = align_up(planned.tensor.byte_size(), alignment_);
+  tensors_.push_back(std::move(planned));
+  is_planned_ = false;
+  return static_cast<int32_t>(tensors_.size()) - 1;
+}
+
+void MemoryPlanner::touch(int32_t id, int32_t step) {
+  PlannedTensor& planned = tensors_.at(id);
+  if (planned.first_step == -1) {
+    planned.first_step = step;
+  }
+  planned.last_step = std::max(planned.last_step, step);
+}
+
+base::Status MemoryPlanner::add_step(op::Layer* layer, const std::vector<int32_t>& input_ids,
+                                     const std::vector<int32_t>& output_ids) {
+  if (!layer) {
+    return base::error::InvalidArgument("The layer of the planned step is a null pointer.");
+  }
+  if (input_ids.size() > layer->input_size() || output_ids.size() > layer->output_size()) {
+    return base::error::InvalidArgument("The layer " + layer->get_layer_name() +
+                                        " has fewer inputs or outputs than the planned step.");
+  }
+  const int32_t tensor_num = static_cast<int32_t>(tensors_.size());
+  for (int32_t id : input_ids) {
+    if (id < -1 || id >= tensor_num) {
+      return base::error::InvalidArgument("The input tensor id of the planned step is invalid.");
+    }
+  }
+  for (int32_t id : output_ids) {
+    if (id < -1 || id >= tensor_num) {
+      return base::error::InvalidArgument("The output tensor id of the planned step is invalid.");
+    }
+  }
+
+  const int32_t step = static_cast<int32_t>(steps_.size());
+  for (int32_t id : input_ids) {
+    if (id != -1) {
+      touch(id, step);
+    }
+  }
+  for (int32_t id : output_ids) {
+    if (id != -1) {
+      touch(id, step);
+    }
+  }
+  steps_.push_back({layer, input_ids, output_ids});
+  is_planned_ = false;
+  return base::error::Success();
+}
+
+void MemoryPlanner::mark_persistent(int32_t id) {
+  tensors_.at(id).persistent = true;
+  is_planned_ = false;
+}
+
+//按大小从大到小依次放置，每个tensor放进和它生命周期重叠的已放置tensor之间放得下的最小空隙（best fit），
+//没有放得下的空隙时接在这些tensor的最后面
+base::Status MemoryPlanner::plan() {
+  const int32_t step_num = static_cast<int32_t>(steps_.size());
+  for (PlannedTensor& planned : tensors_) {
+    if (planned.persistent || planned.first_step == -1) {
+      //没有被任何step用到的tensor也当作一直存活，保证它拿到独立的内存
+      planned.first_step = 0;
+      planned.last_step = std::max(step_num - 1, 0);
+    }
+  }
+
+  std::vector<int32_t> order(tensors_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](int32_t a, int32_t b) {
+    return tensors_[a].byte_size > tensors_[b].byte_size;
+  });
+
+  arena_byte_size_ = 0;
+  std::vector<int32_t> placed;
+  std::vector<std::pair<size_t, size_t>> conflicts;
+  for (int32_t id : order) {
+    PlannedTensor& planned = tensors_[id];
+    conflicts.clear();
+    for (int32_t other_id : placed) {
+      const PlannedTensor& other = tensors_[other_id];
+      if (other.first_step <= planned.last_step && planned.first_step <= other.last_step) {
+        conflicts.emplace_back(other.offset, other.offset + other.byte_size);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end());
+
+    //cursor是已经扫过的冲突区间的最右端，它和下一个区间起点之间就是一段空隙
+    size_t cursor = 0;
+    size_t best_offset = 0;
+    size_t best_gap = SIZE_MAX;
+    for (const auto& [begin, end] : conflicts) {
+      if (begin > cursor) {
+        const size_t gap = begin - cursor;
+        if (gap >= planned.byte_size && gap < best_gap) {
+          best_gap = gap;
+          best_offset = cursor;
+        }
+      }
+      cursor = std::max(cursor, end);
+    }
+    const size_t offset = best_gap == SIZE_MAX ? cursor : best_offset;
+    planned.offset = offset;
+    arena_byte_size_ = std::max(arena_byte_size_, offset + planned.byte_size);
+    placed.push_back(id);
+  }
+  is_planned_ = true;
+  return base::error::Success();
+}
+
+base::Status MemoryPlanner::allocate(std::shared_ptr<base::DeviceAllocator> alloc) {
+  if (!alloc) {
+    return base::error::InvalidArgument("The allocator of the memory planner is a null pointer.");
+  }
+  if (alloc->device_type() != device_type_) {
+    return base::error::InvalidArgument(
+        "The device type of the allocator is different from the memory planner.");
+  }
+  if (!is_planned_) {
+    auto status = plan();
+    if (!status) {
+      return status;
+    }
+  }
+  if (arena_byte_size_ == 0) {
+    return base::error::Success();
+  }
+
+  //多申请alignment_字节，arena的起始地址自己对齐，不依赖分配器的对齐保证
+  arena_ = std::make_shared<base::Buffer>(arena_byte_size_ + alignment_, alloc);
+  if (!arena_->ptr()) {
+    return base::error::InternalError("Failed to allocate the activation arena of " +
+                                      std::to_string(arena_byte_size_) + " bytes.");
+  }
+  const uintptr_t base_addr =
+      align_up(reinterpret_cast<uintptr_t>(arena_->ptr()), alignment_);
+  //每个tensor的Buffer借用arena里的内存，删除器里持有arena_，
+  //tensor被拷贝出去比planner活得更久时arena也不会被提前释放
+  std::shared_ptr<base::Buffer> arena = arena_;
+  for (PlannedTensor& planned : tensors_) {
+    void* ptr = reinterpret_cast<void*>(base_addr + planned.offset);
+    std::shared_ptr<base::Buffer> buffer(
+        new base::Buffer(planned.byte_size, nullptr, ptr, true),
+        [arena](base::Buffer* buffer) { delete buffer; });
+    buffer->set_device_type(device_type_);
+    if (!planned.tensor.assign(buffer)) {
+      return base::error::InternalError("Failed to bind the planned tensor " + planned.name +
+                                        " to the activation arena.");
+    }
+  }
+
+  for (const PlannedStep& step : steps_) {
+    for (size_t i = 0; i < step.input_ids.size(); ++i) {
+      if (step.input_ids[i] != -1) {
+        step.layer->set_input(static_cast<int32_t>(i), tensors_[step.input_ids[i]].tensor);
+      }
+    }
+    for (size_t i = 0; i < step.output_ids.size(); ++i) {
+      if (step.output_ids[i] != -1) {
+        step.layer->set_output(static_cast<int32_t>(i), tensors_[step.output_ids[i]].tensor);
+      }
+    }
+  }
+  return base::error::Success();
+}
+
+tensor::Tensor& MemoryPlanner::get_tensor(int32_t id) { return tensors_.at(id).tensor; }
+
+const tensor::Tensor& MemoryPlanner::get_tensor(int32_t id) const {
+  return tensors_.at(id).tensor;
+}
+
+int32_t MemoryPlanner::tensor_num() const { return static_cast<int32_t>(tensors_.size()); }
+
+size_t MemoryPlanner::offset(int32_t id) const {
+  CHECK(is_planned_);
+  return tensors_.at(id).offset;
+}
+
+size_t MemoryPlanner::arena_byte_size() const { return arena_byte_size_; }
+
+size_t MemoryPlanner::total_byte_size() const {
+  size_t total = 0;
+  for (const PlannedTensor& planned : tensors_) {
+    total += planned.byte_size;
+  }
+  return total;
+}
+}  // namespace model
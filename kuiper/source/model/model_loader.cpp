@@ -0,0 +1,165 @@
+#include "model/model_loader.h"
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <numeric>
+#include <utility>
+#include "base/huge_page.h"
+namespace model {
+ModelLoader::ModelLoader(std::string model_path, bool is_quant_model, bool use_huge_page)
+    : model_path_(std::move(model_path)),
+      is_quant_model_(is_quant_model),
+      use_huge_page_(use_huge_page) {}
+
+//先占一段比文件大2M的地址空间，再把文件MAP_FIXED到其中2M对齐的位置，多出来的头尾还回去
+static void* map_file_aligned(int32_t fd, size_t file_size) {
+  const size_t reserve_size = file_size + base::kHugePageByteSize;
+  void* reserve = mmap(nullptr, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserve == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(reserve);
+  const uintptr_t aligned =
+      (begin + base::kHugePageByteSize - 1) / base::kHugePageByteSize * base::kHugePageByteSize;
+  void* data = mmap(reinterpret_cast<void*>(aligned), file_size, PROT_READ, MAP_SHARED | MAP_FIXED,
+                    fd, 0);
+  if (data == MAP_FAILED) {
+    munmap(reserve, reserve_size);
+    return MAP_FAILED;
+  }
+  if (aligned > begin) {
+    munmap(reserve, aligned - begin);
+  }
+  //MAP_FIXED按页替换，文件最后不满一页的部分也占了一整页
+  const uintptr_t tail = (aligned + file_size + 4095) / 4096 * 4096;
+  if (begin + reserve_size > tail) {
+    munmap(reinterpret_cast<void*>(tail), begin + reserve_size - tail);
+  }
+  return data;
+}
+
+base::Status ModelLoader::open() {
+  if (model_path_.empty()) {
+    return base::error::PathNotValid("The model path is empty.");
+  }
+  if (is_quant_model_) {
+    raw_model_data_ = std::make_shared<RawModelDataInt8>();
+  } else {
+    raw_model_data_ = std::make_shared<RawModelDataFp32>();
+  }
+
+  int32_t fd = ::open(model_path_.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return base::error::PathNotValid("Failed to open the model file " + model_path_);
+  }
+  raw_model_data_->fd = fd;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    return base::error::PathNotValid("Failed to stat the model file " + model_path_);
+  }
+  raw_model_data_->file_size = static_cast<size_t>(st.st_size);
+
+  size_t header_size = sizeof(ModelConfig);
+  if (is_quant_model_) {
+    header_size += sizeof(int32_t);
+  }
+  if (raw_model_data_->file_size < header_size) {
+    return base::error::ModelParseError("The model file " + model_path_ +
+                                        " is smaller than its config header.");
+  }
+
+  //只读共享映射，页面直接来自page cache，多个进程映射同一个文件时物理内存只有一份
+  void* data = use_huge_page_
+                   ? map_file_aligned(fd, raw_model_data_->file_size)
+                   : mmap(nullptr, raw_model_data_->file_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED || data == nullptr) {
+    raw_model_data_->data = nullptr;
+    return base::error::ModelParseError("Failed to map the model file " + model_path_);
+  }
+  raw_model_data_->data = data;
+  if (use_huge_page_) {
+    base::advise_huge_page(data, raw_model_data_->file_size);
+  }
+  //权重基本是顺序扫一遍，提前让内核预读
+  madvise(data, raw_model_data_->file_size, MADV_WILLNEED);
+
+  std::memcpy(&config_, data, sizeof(ModelConfig));
+  if (is_quant_model_) {
+    std::memcpy(&group_size_, static_cast<int8_t*>(data) + sizeof(ModelConfig), sizeof(int32_t));
+    if (group_size_ <= 0) {
+      return base::error::ModelParseError("The group size in the model file is invalid.");
+    }
+  }
+  raw_model_data_->weight_data = static_cast<int8_t*>(data) + header_size;
+  pos_ = 0;
+  return base::error::Success();
+}
+
+base::Status ModelLoader::load_weight(op::LayerParam* layer, int32_t idx,
+                                      const std::vector<int32_t>& dims) {
+  if (!layer) {
+    return base::error::InvalidArgument("The layer parameter in load_weight is null.");
+  }
+  if (!raw_model_data_ || !raw_model_data_->weight_data) {
+    return base::error::InternalError("The model file has not been opened yet.");
+  }
+  const size_t num = std::accumulate(dims.begin(), dims.end(), size_t(1), std::multiplies<>());
+  //游标按字节走，每块权重占多少字节由layer实际的存储类型决定，和set_weight里的布局一致：
+  //不是量化层的权重是fp32（int8模型里的norm和embedding也是）、fp16或bf16
+  size_t step = base::DataTypeByteSize(layer->weight_data_type(), num);
+  if (layer->is_quant_layer()) {
+    if (!is_quant_model_) {
+      return base::error::ModelParseError("The quant layer " + layer->get_layer_name() +
+                                          " can not be loaded from a fp32 model file.");
+    }
+    if (num % group_size_ != 0) {
+      return base::error::ModelParseError("The weight size of layer " + layer->get_layer_name() +
+                                          " is not divisible by the group size.");
+    }
+    const size_t group_num = num / group_size_;
+    if (layer->weight_data_type() == base::DataType::kDataTypeInt4) {
+      //int4权重之后是每组一个fp16的scale，带min时再跟着每组一个fp16的min
+      step += group_num * sizeof(uint16_t) * (layer->weight_with_min() ? 2 : 1);
+    } else {
+      //int8权重之后紧跟着每组一个fp32的scale
+      step += group_num * sizeof(float);
+    }
+    layer->set_group_size(group_size_);
+  }
+  if (step > raw_model_data_->weight_byte_size() - pos_) {
+    return base::error::ModelParseError("The model file is too small for the weight of layer " +
+                                        layer->get_layer_name());
+  }
+
+  const void* weight_ptr = static_cast<const int8_t*>(raw_model_data_->weight_data) + pos_;
+  base::Status status = layer->set_weight(idx, dims, weight_ptr, base::DeviceType::kDeviceCPU);
+  if (!status) {
+    return status;
+  }
+  pos_ += step;
+  return base::error::Success();
+}
+
+base::Status ModelLoader::skip(size_t byte_size) {
+  if (!raw_model_data_) {
+    return base::error::InternalError("The model file has not been opened yet.");
+  }
+  if (byte_size > raw_model_data_->weight_byte_size() - pos_) {
+    return base::error::ModelParseError("Skip past the end of the model file.");
+  }
+  pos_ += byte_size;
+  return base::error::Success();
+}
+
+const ModelConfig& ModelLoader::config() const { return config_; }
+
+int32_t ModelLoader::group_size() const { return group_size_; }
+
+bool ModelLoader::is_quant_model() const { return is_quant_model_; }
+
+std::shared_ptr<RawModelData> ModelLoader::raw_model_data() const { return raw_model_data_; }
+}  // namespace model
@@ -0,0 +1,201 @@
+#include "model/pack_cache.h"
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+namespace model {
+//文件的格式：PackCacheHeader，entry_num个uint64的字节数，之后每一块都从页对齐的位置开始，方便直接mmap
+struct PackCacheHeader {
+  char magic[8];
+  uint32_t version = 0;
+  //打包之后的排布，base::TensorLayout
+  uint32_t layout = 0;
+  uint64_t model_file_size = 0;
+  int64_t model_mtime_ns = 0;
+  uint32_t entry_num = 0;
+  uint32_t reserved = 0;
+};
+
+static constexpr char kPackCacheMagic[8] = "KUIPACK";
+static constexpr uint32_t kPackCacheVersion = 1;
+static constexpr size_t kPackCacheAlign = 4096;
+
+static size_t align_up(size_t size) {
+  return (size + kPackCacheAlign - 1) / kPackCacheAlign * kPackCacheAlign;
+}
+
+//每一块在文件里的起始位置，最后一个元素是文件的总大小
+static std::vector<size_t> entry_offsets(const std::vector<size_t>& byte_sizes) {
+  std::vector<size_t> offsets(byte_sizes.size() + 1);
+  offsets[0] = align_up(sizeof(PackCacheHeader) + byte_sizes.size() * sizeof(uint64_t));
+  for (size_t i = 0; i < byte_sizes.size(); ++i) {
+    offsets[i + 1] = align_up(offsets[i] + byte_sizes[i]);
+  }
+  return offsets;
+}
+
+//缓存只对生成它的那个模型文件有效，用大小和修改时间识别
+static base::Status make_header(const std::string& model_path, size_t entry_num,
+                                PackCacheHeader& header) {
+  struct stat st;
+  if (stat(model_path.c_str(), &st) == -1) {
+    return base::error::PathNotValid("Failed to stat the model file " + model_path);
+  }
+  std::memcpy(header.magic, kPackCacheMagic, sizeof(header.magic));
+  header.version = kPackCacheVersion;
+  header.layout = static_cast<uint32_t>(base::TensorLayout::kLayoutPanel16);
+  header.model_file_size = static_cast<uint64_t>(st.st_size);
+  header.model_mtime_ns =
+      static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  header.entry_num = static_cast<uint32_t>(entry_num);
+  return base::error::Success();
+}
+
+//pread/pwrite一次可能只读写一部分，循环到全部完成
+static bool read_all(int32_t fd, void* data, size_t size, size_t offset) {
+  char* ptr = static_cast<char*>(data);
+  while (size > 0) {
+    const ssize_t n = pread(fd, ptr, size, static_cast<off_t>(offset));
+    if (n <= 0) {
+      return false;
+    }
+    ptr += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static bool write_all(int32_t fd, const void* data, size_t size, size_t offset) {
+  const char* ptr = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t n = pwrite(fd, ptr, size, static_cast<off_t>(offset));
+    if (n <= 0) {
+      return false;
+    }
+    ptr += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+WeightPackCache::WeightPackCache(std::string cache_path) : cache_path_(std::move(cache_path)) {}
+
+WeightPackCache::~WeightPackCache() { close(); }
+
+void WeightPackCache::close() {
+  if (data_ != nullptr) {
+    munmap(data_, file_size_);
+    data_ = nullptr;
+  }
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  file_size_ = 0;
+  offsets_.clear();
+}
+
+base::Status WeightPackCache::open(const std::string& model_path,
+                                   const std::vector<size_t>& byte_sizes) {
+  close();
+  PackCacheHeader expected{};
+  auto status = make_header(model_path, byte_sizes.size(), expected);
+  if (!status) {
+    return status;
+  }
+  fd_ = ::open(cache_path_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    return base::error::PathNotValid("Failed to open the pack cache " + cache_path_);
+  }
+  struct stat st;
+  if (fstat(fd_, &st) == -1) {
+    close();
+    return base::error::PathNotValid("Failed to stat the pack cache " + cache_path_);
+  }
+
+  PackCacheHeader header{};
+  std::vector<uint64_t> sizes(byte_sizes.size());
+  if (!read_all(fd_, &header, sizeof(header), 0) ||
+      std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+      header.version != expected.version || header.layout != expected.layout ||
+      header.model_file_size != expected.model_file_size ||
+      header.model_mtime_ns != expected.model_mtime_ns ||
+      header.entry_num != expected.entry_num ||
+      !read_all(fd_, sizes.data(), sizes.size() * sizeof(uint64_t), sizeof(header))) {
+    close();
+    return base::error::ModelParseError("The pack cache " + cache_path_ +
+                                        " does not belong to this model.");
+  }
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    if (sizes[i] != byte_sizes[i]) {
+      close();
+      return base::error::ModelParseError("The pack cache " + cache_path_ +
+                                          " has a different weight layout.");
+    }
+  }
+  std::vector<size_t> offsets = entry_offsets(byte_sizes);
+  if (static_cast<size_t>(st.st_size) < offsets.back()) {
+    close();
+    return base::error::ModelParseError("The pack cache " + cache_path_ + " is truncated.");
+  }
+
+  file_size_ = offsets.back();
+  void* data = mmap(nullptr, file_size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    close();
+    return base::error::ModelParseError("Failed to map the pack cache " + cache_path_);
+  }
+  data_ = data;
+  madvise(data_, file_size_, MADV_WILLNEED);
+  offsets_ = std::move(offsets);
+  return base::error::Success();
+}
+
+const void* WeightPackCache::data(int32_t idx) const {
+  CHECK(data_ != nullptr);
+  CHECK(idx >= 0 && idx + 1 < static_cast<int32_t>(offsets_.size()));
+  return static_cast<const int8_t*>(data_) + offsets_[idx];
+}
+
+base::Status WeightPackCache::save(const std::string& model_path,
+                                   const std::vector<const void*>& data,
+                                   const std::vector<size_t>& byte_sizes) const {
+  CHECK_EQ(data.size(), byte_sizes.size());
+  PackCacheHeader header{};
+  auto status = make_header(model_path, byte_sizes.size(), header);
+  if (!status) {
+    return status;
+  }
+  const std::vector<size_t> offsets = entry_offsets(byte_sizes);
+  const std::vector<uint64_t> sizes(byte_sizes.begin(), byte_sizes.end());
+
+  const std::string tmp_path = cache_path_ + ".tmp." + std::to_string(getpid());
+  const int32_t fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return base::error::PathNotValid("Failed to create the pack cache " + tmp_path);
+  }
+  bool ok = write_all(fd, &header, sizeof(header), 0) &&
+            write_all(fd, sizes.data(), sizes.size() * sizeof(uint64_t), sizeof(header));
+  for (size_t i = 0; ok && i < data.size(); ++i) {
+    if (byte_sizes[i] > 0) {
+      ok = data[i] != nullptr && write_all(fd, data[i], byte_sizes[i], offsets[i]);
+    }
+  }
+  //对齐产生的空洞由ftruncate补齐，文件大小和open里的检查一致
+  ok = ok && ftruncate(fd, static_cast<off_t>(offsets.back())) == 0;
+  //内容先落盘再rename，掉电之后不会留下一个名字对、内容却不全的缓存
+  ok = ok && fsync(fd) == 0;
+  ok = ::close(fd) == 0 && ok;
+  if (!ok || rename(tmp_path.c_str(), cache_path_.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+    return base::error::InternalError("Failed to write the pack cache " + cache_path_);
+  }
+  return base::error::Success();
+}
+}  // namespace model
@@ -0,0 +1,32 @@
+#include "model/raw_model_data.h"
+#include <sys/mman.h>
+#include <unistd.h>
+namespace model {
+RawModelData::~RawModelData() {
+  if (data != nullptr && data != MAP_FAILED) {
+    munmap(data, file_size);
+    data = nullptr;
+  }
+  if (fd != -1) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+size_t RawModelData::weight_byte_size() const {
+  if (!data || !weight_data) {
+    return 0;
+  }
+  const size_t header_size =
+      static_cast<const int8_t*>(weight_data) - static_cast<const int8_t*>(data);
+  return file_size - header_size;
+}
+
+const void* RawModelDataFp32::weight(size_t offset) const {
+  return static_cast<float*>(weight_data) + offset;
+}
+
+const void* RawModelDataInt8::weight(size_t offset) const {
+  return static_cast<int8_t*>(weight_data) + offset;
+}
+}  // namespace model
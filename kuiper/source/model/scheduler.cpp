@@ -0,0 +1,230 @@
+#include "model/scheduler.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <utility>
+namespace model {
+Scheduler::Scheduler(LLama2Model* model, int32_t max_batch_size)
+    : model_(model), max_batch_size_(max_batch_size) {
+  CHECK(model_ != nullptr);
+  CHECK_GT(max_batch_size_, 0);
+  CHECK_LE(max_batch_size_, model_->max_rows());
+  prefill_chunk_size_ = model_->max_rows();
+  running_.reserve(max_batch_size_);
+  rows_.reserve(model_->max_rows());
+}
+
+base::Status Scheduler::add_request(GenerationRequest request) {
+  if (request.prompt_tokens.empty() || request.max_new_tokens <= 0) {
+    return base::error::InvalidArgument("The prompt is empty or max_new_tokens is not positive.");
+  }
+  if (static_cast<int32_t>(request.prompt_tokens.size()) >= model_->config().seq_len) {
+    return base::error::InvalidArgument("The prompt is longer than the max sequence length.");
+  }
+  auto status = sampler::check_sampler_config(request.sampler_config);
+  if (!status) {
+    return status;
+  }
+  Sequence seq;
+  seq.tokens = request.prompt_tokens;
+  seq.sampler = sampler::create_sampler(base::DeviceType::kDeviceCPU, request.sampler_config,
+                                        model_->config().vocab_size);
+  seq.request = std::move(request);
+  waiting_.push_back(std::move(seq));
+  return base::error::Success();
+}
+
+void Scheduler::admit() {
+  auto kv_cache = model_->kv_cache();
+  while (!waiting_.empty() && static_cast<int32_t>(running_.size()) < max_batch_size_) {
+    Sequence& seq = waiting_.front();
+    const int32_t token_num = static_cast<int32_t>(seq.tokens.size());
+    //最后一个token总要重算一次才有logits，所以最多命中token_num - 1个
+    int32_t cached = 0;
+    shared_blocks_.clear();
+    if (prefix_cache_) {
+      cached = prefix_cache_->match(seq.tokens, token_num - 1, shared_blocks_);
+    }
+    //先把命中的block挂到序列上，后面淘汰树里的block时它们不会被还回池子
+    auto status = kv_cache->add_sequence(next_seq_id_, shared_blocks_);
+    CHECK(status) << status.get_err_msg();
+    //至少要放得下已知的所有token，否则刚加进来就会被抢占
+    const int32_t need_blocks = token_num / kv_cache->block_size() + 1 -
+                                static_cast<int32_t>(shared_blocks_.size());
+    if (!running_.empty() && need_blocks > kv_cache->free_block_num()) {
+      if (prefix_cache_) {
+        prefix_cache_->evict(need_blocks);
+      }
+      if (need_blocks > kv_cache->free_block_num()) {
+        kv_cache->free_sequence(next_seq_id_);
+        break;
+      }
+    }
+    seq.seq_id = next_seq_id_++;
+    seq.pos = cached;
+    running_.push_back(std::move(seq));
+    waiting_.pop_front();
+  }
+}
+
+void Scheduler::preempt_last() {
+  Sequence seq = std::move(running_.back());
+  running_.pop_back();
+  model_->kv_cache()->free_sequence(seq.seq_id);
+  seq.pos = 0;
+  waiting_.push_front(std::move(seq));
+}
+
+void Scheduler::schedule_rows() {
+  //decode的序列每步只要一行，先排上，保证它们的延迟不受长prompt影响
+  int32_t budget = model_->max_rows();
+  for (Sequence& seq : running_) {
+    const bool decoding = seq.pos + 1 == static_cast<int32_t>(seq.tokens.size());
+    seq.step_rows = decoding ? 1 : 0;
+    budget -= seq.step_rows;
+  }
+  for (Sequence& seq : running_) {
+    if (seq.step_rows != 0) {
+      continue;
+    }
+    const int32_t remain = static_cast<int32_t>(seq.tokens.size()) - seq.pos;
+    seq.step_rows = std::max(0, std::min({remain, prefill_chunk_size_, budget}));
+    budget -= seq.step_rows;
+  }
+}
+
+base::Status Scheduler::reserve() {
+  auto kv_cache = model_->kv_cache();
+  for (size_t i = 0; i < running_.size(); ++i) {
+    if (running_[i].step_rows == 0) {
+      continue;
+    }
+    const int32_t last_pos = running_[i].pos + running_[i].step_rows - 1;
+    while (!kv_cache->reserve(running_[i].seq_id, last_pos)) {
+      //树里还有只被缓存引用的block时先淘汰它们
+      if (prefix_cache_ && prefix_cache_->evict(kv_cache->free_block_num() + 1) > 0) {
+        continue;
+      }
+      const bool self = i + 1 == running_.size();
+      if (self && running_.size() == 1) {
+        return base::error::InternalError(
+            "The kv cache is too small for a single sequence of the batch.");
+      }
+      preempt_last();
+      if (self) {
+        break;
+      }
+    }
+  }
+  return base::error::Success();
+}
+
+bool Scheduler::is_finished(const Sequence& seq) const {
+  const int32_t generated =
+      static_cast<int32_t>(seq.tokens.size() - seq.request.prompt_tokens.size());
+  if (generated == 0) {
+    return false;
+  }
+  return seq.tokens.back() == seq.request.eos_token || generated >= seq.request.max_new_tokens ||
+         seq.pos >= model_->config().seq_len;
+}
+
+base::Status Scheduler::step() {
+  admit();
+  if (running_.empty()) {
+    return base::error::Success();
+  }
+  schedule_rows();
+  auto status = reserve();
+  if (!status) {
+    return status;
+  }
+
+  //同一个序列的行挨在一起，只有读完prompt（或者decode）的那一行需要logits
+  rows_.clear();
+  for (const Sequence& seq : running_) {
+    for (int32_t r = 0; r < seq.step_rows; ++r) {
+      const int32_t pos = seq.pos + r;
+      const bool need_logits = pos + 1 == static_cast<int32_t>(seq.tokens.size());
+      rows_.push_back({seq.seq_id, pos, seq.tokens.at(pos), need_logits});
+    }
+  }
+  if (rows_.empty()) {
+    return base::error::Success();
+  }
+  tensor::Tensor logits;
+  status = model_->forward(rows_, logits);
+  if (!status) {
+    return status;
+  }
+
+  int32_t logits_row = 0;
+  for (Sequence& seq : running_) {
+    seq.pos += seq.step_rows;
+    //刚读完prompt，把它写满的block放进前缀缓存，后面同样开头的请求马上就能共享
+    const int32_t prompt_len = static_cast<int32_t>(seq.request.prompt_tokens.size());
+    if (prefix_cache_ && seq.step_rows != 0 && seq.pos >= prompt_len &&
+        seq.pos - seq.step_rows < prompt_len) {
+      prefix_cache_->insert(seq.tokens, seq.pos, model_->kv_cache()->block_table(seq.seq_id));
+    }
+    //还在读prompt（或者抢占后重算）的时候不采样
+    if (seq.step_rows == 0 || seq.pos < static_cast<int32_t>(seq.tokens.size())) {
+      continue;
+    }
+    const int32_t next = seq.sampler->sample_row(logits, logits_row);
+    logits_row += 1;
+    seq.tokens.push_back(next);
+    if (token_callback_) {
+      token_callback_(seq.request.request_id, next);
+    }
+  }
+
+  //结束的序列马上退出batch，空出来的位置和block下一步就能给新请求用
+  size_t kept = 0;
+  for (size_t i = 0; i < running_.size(); ++i) {
+    Sequence& seq = running_[i];
+    if (is_finished(seq)) {
+      if (prefix_cache_) {
+        prefix_cache_->insert(seq.tokens, seq.pos, model_->kv_cache()->block_table(seq.seq_id));
+      }
+      model_->kv_cache()->free_sequence(seq.seq_id);
+      GenerationResult result;
+      result.request_id = seq.request.request_id;
+      result.output_tokens.assign(seq.tokens.begin() + seq.request.prompt_tokens.size(),
+                                  seq.tokens.end());
+      finished_.push_back(std::move(result));
+    } else {
+      if (kept != i) {
+        running_[kept] = std::move(seq);
+      }
+      kept += 1;
+    }
+  }
+  running_.resize(kept);
+  return base::error::Success();
+}
+
+bool Scheduler::has_unfinished() const { return !running_.empty() || !waiting_.empty(); }
+
+std::vector<GenerationResult> Scheduler::pop_finished() {
+  std::vector<GenerationResult> finished;
+  finished.swap(finished_);
+  return finished;
+}
+
+void Scheduler::set_prefill_chunk_size(int32_t chunk_size) {
+  CHECK_GT(chunk_size, 0);
+  prefill_chunk_size_ = chunk_size;
+}
+
+void Scheduler::set_token_callback(TokenCallback callback) {
+  token_callback_ = std::move(callback);
+}
+
+void Scheduler::set_prefix_cache(std::shared_ptr<op::PrefixCache> prefix_cache) {
+  prefix_cache_ = std::move(prefix_cache);
+}
+
+int32_t Scheduler::running_num() const { return static_cast<int32_t>(running_.size()); }
+
+int32_t Scheduler::waiting_num() const { return static_cast<int32_t>(waiting_.size()); }
+}  // namespace model
@@ -0,0 +1,237 @@
+#include "model/speculative.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <utility>
+namespace model {
+SpeculativeDecoder::SpeculativeDecoder(LLama2Model* target, LLama2Model* draft,
+                                       int32_t draft_len, int32_t seq_id)
+    : target_(target), draft_(draft), draft_len_(draft_len), seq_id_(seq_id) {
+  CHECK(target_ != nullptr);
+  CHECK(draft_ != nullptr);
+  CHECK_GT(draft_len_, 0);
+}
+
+base::Status SpeculativeDecoder::init() {
+  if (!target_->kv_cache() || !draft_->kv_cache()) {
+    return base::error::InvalidArgument("The target and draft models must be initialized first.");
+  }
+  if (target_->config().vocab_size != draft_->config().vocab_size) {
+    return base::error::InvalidArgument("The target and draft models have different vocabs.");
+  }
+  if (draft_len_ + 1 > target_->max_rows()) {
+    return base::error::InvalidArgument(
+        "The max rows of the target model must be larger than the draft length.");
+  }
+  vocab_size_ = target_->config().vocab_size;
+  seq_len_ = std::min(target_->config().seq_len, draft_->config().seq_len);
+  draft_probs_.resize(static_cast<size_t>(draft_len_) * vocab_size_);
+  target_probs_.resize(vocab_size_);
+  rows_.reserve(std::max(target_->max_rows(), draft_->max_rows()));
+  return base::error::Success();
+}
+
+base::Status SpeculativeDecoder::feed(LLama2Model* model, const std::vector<int32_t>& tokens,
+                                      int32_t begin, int32_t end, int32_t logits_from,
+                                      tensor::Tensor& logits) {
+  const int32_t max_rows = model->max_rows();
+  CHECK(begin <= logits_from && logits_from < end);
+  CHECK_LE(end - logits_from, max_rows);
+  auto status = model->kv_cache()->reserve(seq_id_, end - 1);
+  if (!status) {
+    return status;
+  }
+  //最后一次forward尽量装满，带上所有要logits的行
+  const int32_t tail_begin = std::max(begin, end - max_rows);
+  for (int32_t chunk = begin; chunk < end;) {
+    const int32_t chunk_end = chunk < tail_begin ? std::min(chunk + max_rows, tail_begin) : end;
+    rows_.clear();
+    for (int32_t i = chunk; i < chunk_end; ++i) {
+      BatchRow row;
+      row.seq_id = seq_id_;
+      row.pos = i;
+      row.token = tokens[i];
+      row.need_logits = i >= logits_from;
+      rows_.push_back(row);
+    }
+    status = model->forward(rows_, logits);
+    if (!status) {
+      return status;
+    }
+    chunk = chunk_end;
+  }
+  return base::error::Success();
+}
+
+int32_t SpeculativeDecoder::propose(const float* logits, float* probs) {
+  if (!random_sampler_) {
+    return sampler_->sample(logits, vocab_size_);
+  }
+  random_sampler_->softmax(logits, vocab_size_, probs);
+  return random_sampler_->sample_probs(probs, vocab_size_);
+}
+
+base::Status SpeculativeDecoder::generate(const GenerationRequest& request,
+                                          GenerationResult& result) {
+  if (vocab_size_ == 0) {
+    return base::error::InternalError("The speculative decoder is not initialized.");
+  }
+  const int32_t prompt_len = static_cast<int32_t>(request.prompt_tokens.size());
+  if (prompt_len == 0 || request.max_new_tokens <= 0) {
+    return base::error::InvalidArgument("The prompt is empty or max_new_tokens is not positive.");
+  }
+  if (prompt_len >= seq_len_) {
+    return base::error::InvalidArgument("The prompt is longer than the max sequence length.");
+  }
+  const sampler::SamplerConfig& sampler_config = request.sampler_config;
+  auto status = sampler::check_sampler_config(sampler_config);
+  if (!status) {
+    return status;
+  }
+  const float temperature = sampler_config.temperature;
+  if (temperature > 0.f && (sampler_config.top_k != 0 || sampler_config.top_p < 1.f)) {
+    return base::error::InvalidArgument(
+        "The speculative decoder does not support top_k or top_p sampling.");
+  }
+  for (const int32_t token : request.prompt_tokens) {
+    if (token < 0 || token >= vocab_size_) {
+      return base::error::InvalidArgument("The prompt has a token out of the vocab.");
+    }
+  }
+  auto target_cache = target_->kv_cache();
+  auto draft_cache = draft_->kv_cache();
+  //序列已经存在时add会失败，这时不能去free别人的序列，只回滚自己加成功的那个
+  status = target_cache->add_sequence(seq_id_);
+  if (!status) {
+    return status;
+  }
+  status = draft_cache->add_sequence(seq_id_);
+  if (!status) {
+    target_cache->free_sequence(seq_id_);
+    return status;
+  }
+  sampler_ = sampler::create_sampler(base::DeviceType::kDeviceCPU, sampler_config, vocab_size_);
+  random_sampler_ = nullptr;
+  if (temperature > 0.f) {
+    random_sampler_ = dynamic_cast<sampler::RandomSampler*>(sampler_.get());
+    CHECK(random_sampler_ != nullptr);
+  }
+
+  result.request_id = request.request_id;
+  result.output_tokens.clear();
+  std::vector<int32_t> tokens = request.prompt_tokens;
+  tokens.reserve(prompt_len + request.max_new_tokens + draft_len_ + 1);
+  //两个kv cache里前多少个位置和tokens一致
+  int32_t target_valid = 0;
+  int32_t draft_valid = 0;
+  bool finished = false;
+  tensor::Tensor logits;
+  while (!finished) {
+    const int32_t n = static_cast<int32_t>(tokens.size());
+    const int32_t remain = request.max_new_tokens - static_cast<int32_t>(result.output_tokens.size());
+    //一轮最多确定draft_len + 1个token，target验证时送进去的位置n - 1 + draft_num要小于seq_len
+    const int32_t draft_num = std::max(0, std::min({draft_len_, remain - 1, seq_len_ - n}));
+
+    //draft先补上还没见过的token，再逐个往后猜，第一轮这里就是draft的prefill
+    for (int32_t i = 0; i < draft_num; ++i) {
+      const int32_t end = static_cast<int32_t>(tokens.size());
+      status = feed(draft_, tokens, draft_valid, end, end - 1, logits);
+      if (!status) {
+        break;
+      }
+      draft_valid = end;
+      float* q = draft_probs_.data() + static_cast<int64_t>(i) * vocab_size_;
+      tokens.push_back(propose(logits.ptr<float>(), q));
+    }
+    //target把上一个确定的token和所有猜测一起过一遍，得到draft_num + 1行logits
+    if (status) {
+      status = feed(target_, tokens, target_valid, n + draft_num, n - 1, logits);
+    }
+    if (!status) {
+      break;
+    }
+
+    int32_t accepted = 0;
+    int32_t next = -1;
+    for (; accepted < draft_num; ++accepted) {
+      const float* row = logits.ptr<float>(static_cast<int64_t>(accepted) * vocab_size_);
+      const int32_t guess = tokens[n + accepted];
+      if (!random_sampler_) {
+        const int32_t best = sampler_->sample(row, vocab_size_);
+        if (best != guess) {
+          next = best;
+          break;
+        }
+        continue;
+      }
+      float* p = target_probs_.data();
+      const float* q = draft_probs_.data() + static_cast<int64_t>(accepted) * vocab_size_;
+      random_sampler_->softmax(row, vocab_size_, p);
+      const float r = random_sampler_->random_f32();
+      if (r * q[guess] < p[guess]) {
+        continue;
+      }
+      //拒绝：从max(0, p - q)里重新采样，p和q一样时这个分布是空的，直接用p
+      float residual_sum = 0.f;
+      for (int32_t i = 0; i < vocab_size_; ++i) {
+        residual_sum += std::max(0.f, p[i] - q[i]);
+      }
+      if (residual_sum > 0.f) {
+        const float inv_sum = 1.f / residual_sum;
+        for (int32_t i = 0; i < vocab_size_; ++i) {
+          p[i] = std::max(0.f, p[i] - q[i]) * inv_sum;
+        }
+      }
+      next = random_sampler_->sample_probs(p, vocab_size_);
+      break;
+    }
+    if (next == -1) {
+      //全部接受，target最后一行白送一个token
+      next = sampler_->sample(logits.ptr<float>(static_cast<int64_t>(draft_num) * vocab_size_),
+                              vocab_size_);
+    }
+    proposed_num_ += draft_num;
+    accepted_num_ += accepted;
+
+    //回滚：没被接受的位置留在cache里也不会被读到，只把多出来的block还回去
+    target_valid = n + accepted;
+    draft_valid = std::min(draft_valid, n + accepted);
+    if (!(status = target_cache->truncate(seq_id_, target_valid)) ||
+        !(status = draft_cache->truncate(seq_id_, draft_valid))) {
+      break;
+    }
+
+    tokens.resize(n + accepted);
+    tokens.push_back(next);
+    for (int32_t i = n; i < static_cast<int32_t>(tokens.size()); ++i) {
+      const int32_t token = tokens[i];
+      result.output_tokens.push_back(token);
+      if (token_callback_) {
+        token_callback_(request.request_id, token);
+      }
+      //和Scheduler::is_finished一样，tokens[i]的位置是i，到了seq_len就不能再送进模型
+      if (token == request.eos_token ||
+          static_cast<int32_t>(result.output_tokens.size()) >= request.max_new_tokens ||
+          i >= seq_len_) {
+        finished = true;
+        break;
+      }
+    }
+  }
+  target_cache->free_sequence(seq_id_);
+  draft_cache->free_sequence(seq_id_);
+  return status;
+}
+
+void SpeculativeDecoder::set_cpu_config(std::shared_ptr<kernel::CpuConfig> config) {
+  target_->set_cpu_config(config);
+  draft_->set_cpu_config(std::move(config));
+}
+
+void SpeculativeDecoder::set_token_callback(TokenCallback callback) {
+  token_callback_ = std::move(callback);
+}
+
+int64_t SpeculativeDecoder::proposed_num() const { return proposed_num_; }
+
+int64_t SpeculativeDecoder::accepted_num() const { return accepted_num_; }
+}  // namespace model
@@ -0,0 +1,92 @@
+#include "op/add.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+VecAddLayer::VecAddLayer(base::DeviceType device_type)
+    : Layer(device_type, LayerType::kLayerAdd, "Add") {
+  reset_input_size(2);
+  reset_output_size(1);
+}
+
+base::Status VecAddLayer::check() const {
+  const tensor::Tensor& input1 = get_input(0);
+  const tensor::Tensor& input2 = get_input(1);
+  const size_t size = input1.size();
+  auto status = check_tensor(input1, device_type_, data_type_);
+  if (!status) {
+    LOG(ERROR) << "The input tensor 1 error in the add layer.";
+    return status;
+  }
+  status = check_tensor(input2, device_type_, data_type_);
+  if (!status || input2.size() != size) {
+    LOG(ERROR) << "The input tensor 2 error in the add layer.";
+    return status ? base::error::InvalidArgument("The input tensor 2 has a wrong size.") : status;
+  }
+  const tensor::Tensor& output = get_output(0);
+  status = check_tensor(output, device_type_, data_type_);
+  if (!status || output.size() != size) {
+    LOG(ERROR) << "The output tensor error in the add layer.";
+    return status ? base::error::InvalidArgument("The output tensor has a wrong size.") : status;
+  }
+  return base::error::Success();
+}
+
+base::Status VecAddLayer::forward() {
+  auto status = this->check();
+  if (!status) {
+    return status;
+  }
+  kernel::get_add_kernel(device_type_)(get_input(0), get_input(1), get_output(0), kernel_stream());
+  return base::error::Success();
+}
+
+AddRMSNormLayer::AddRMSNormLayer(base::DeviceType device_type, int32_t dim, float eps)
+    : LayerParam(device_type, LayerType::kLayerAddRMSNorm, false, "AddRMSNorm"),
+      dim_(dim),
+      eps_(eps) {
+  reset_input_size(2);
+  reset_output_size(2);
+  reset_weight_size(1);
+}
+
+base::Status AddRMSNormLayer::check() const {
+  if (dim_ <= 0) {
+    return base::error::InvalidArgument("The dim of the add rmsnorm layer must be positive.");
+  }
+  const tensor::Tensor& residual = get_input(0);
+  auto status = check_tensor(residual, device_type_, data_type_);
+  if (!status || residual.size() % dim_ != 0) {
+    LOG(ERROR) << "The input tensor 0 error in the add rmsnorm layer.";
+    return status ? base::error::InvalidArgument("The residual has a wrong size.") : status;
+  }
+  const tensor::Tensor& delta = get_input(1);
+  status = check_tensor(delta, device_type_, data_type_);
+  if (!status || delta.size() != residual.size()) {
+    LOG(ERROR) << "The input tensor 1 error in the add rmsnorm layer.";
+    return status ? base::error::InvalidArgument("The delta has a wrong size.") : status;
+  }
+  status = check_tensor_with_dim(get_weight(0), device_type_, data_type_, dim_);
+  if (!status) {
+    LOG(ERROR) << "The weight tensor error in the add rmsnorm layer.";
+    return status;
+  }
+  for (int32_t i = 0; i < 2; ++i) {
+    const tensor::Tensor& output = get_output(i);
+    status = check_tensor(output, device_type_, data_type_);
+    if (!status || output.size() != residual.size()) {
+      LOG(ERROR) << "The output tensor " << std::to_string(i) << " error in the add rmsnorm layer.";
+      return status ? base::error::InvalidArgument("The output has a wrong size.") : status;
+    }
+  }
+  return base::error::Success();
+}
+
+base::Status AddRMSNormLayer::forward() {
+  auto status = this->check();
+  if (!status) {
+    return status;
+  }
+  kernel::get_add_rmsnorm_kernel(device_type_)(get_input(0), get_input(1), get_weight(0),
+                                               get_output(0), get_output(1), eps_, kernel_stream());
+  return base::error::Success();
+}
+}  // namespace op
@@ -0,0 +1,44 @@
+#include "op/embedding.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+EmbeddingLayer::EmbeddingLayer(base::DeviceType device_type, int32_t dim, int32_t vocab_size)
+    : LayerParam(device_type, LayerType::kLayerEmbedding, false, "Embedding"),
+      dim_(dim),
+      vocab_size_(vocab_size) {
+  reset_input_size(1);
+  reset_output_size(1);
+  reset_weight_size(1);
+}
+
+base::Status EmbeddingLayer::check() const {
+  const tensor::Tensor& input = get_input(0);
+  auto status = check_tensor(input, base::DeviceType::kDeviceCPU, base::DataType::kDataTypeInt32);
+  if (!status) {
+    LOG(ERROR) << "The input tensor error in the embedding layer.";
+    return status;
+  }
+  const int32_t token_num = static_cast<int32_t>(input.size());
+  status = check_tensor_with_dim(get_weight(0), device_type_, data_type_, vocab_size_, dim_);
+  if (!status) {
+    LOG(ERROR) << "The weight tensor error in the embedding layer.";
+    return status;
+  }
+  const tensor::Tensor& output = get_output(0);
+  status = check_tensor(output, device_type_, data_type_);
+  if (!status || output.size() != static_cast<size_t>(token_num) * dim_) {
+    LOG(ERROR) << "The output tensor error in the embedding layer.";
+    return status ? base::error::InvalidArgument("The output has a wrong size.") : status;
+  }
+  return base::error::Success();
+}
+
+base::Status EmbeddingLayer::forward() {
+  auto status = check();
+  if (!status) {
+    return status;
+  }
+  kernel::get_emb_kernel(device_type_)(get_input(0), get_weight(0), get_output(0), vocab_size_,
+                                       kernel_stream());
+  return base::error::Success();
+}
+}  // namespace op
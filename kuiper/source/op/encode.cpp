@@ -0,0 +1,405 @@
+#include "op/encode.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <queue>
+#include <utility>
+namespace op {
+//Llama 2词表里固定的特殊token
+static constexpr int32_t kUnkTokenId = 0;
+static constexpr int32_t kBosTokenId = 1;
+static constexpr int32_t kEosTokenId = 2;
+
+EncodeLayerBase::EncodeLayerBase(std::string token_model_path, bool has_bos, bool has_eos)
+    : Layer(base::DeviceType::kDeviceCPU, LayerType::kLayerEncode, "Encode"),
+      has_bos_(has_bos),
+      has_eos_(has_eos),
+      token_model_path_(std::move(token_model_path)) {}
+
+BpeEncodeLayer::BpeEncodeLayer(std::string token_model_path, bool has_bos, bool has_eos)
+    : EncodeLayerBase(std::move(token_model_path), has_bos, has_eos) {
+  std::fill(std::begin(byte_tokens_), std::end(byte_tokens_), kUnkTokenId);
+  std::fill(std::begin(root_children_), std::end(root_children_), -1);
+}
+
+//"<0xE4>"这样的token返回0xE4，否则返回-1
+static int16_t parse_byte_token(const std::string& piece) {
+  if (piece.size() != 6 || piece.compare(0, 3, "<0x") != 0 || piece[5] != '>') {
+    return -1;
+  }
+  int16_t value = 0;
+  for (int32_t i = 3; i < 5; ++i) {
+    const char c = piece[i];
+    int16_t digit = 0;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else {
+      return -1;
+    }
+    value = value * 16 + digit;
+  }
+  return value;
+}
+
+base::Status BpeEncodeLayer::init() {
+  if (token_model_path_.empty()) {
+    return base::error::PathNotValid("The token model path is empty.");
+  }
+  std::ifstream file(token_model_path_, std::ios::binary);
+  if (!file.is_open()) {
+    return base::error::PathNotValid("Failed to open the token model file " + token_model_path_);
+  }
+  const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  size_t offset = 0;
+  auto read = [&](void* dst, size_t size) {
+    if (offset + size > data.size()) {
+      return false;
+    }
+    std::memcpy(dst, data.data() + offset, size);
+    offset += size;
+    return true;
+  };
+  if (!read(&max_token_length_, sizeof(int32_t)) || max_token_length_ <= 0) {
+    return base::error::ModelParseError("Failed to read the header of the token model file.");
+  }
+
+  vocab_.clear();
+  scores_.clear();
+  while (offset < data.size()) {
+    float score = 0.f;
+    int32_t len = 0;
+    if (!read(&score, sizeof(float)) || !read(&len, sizeof(int32_t)) || len < 0 ||
+        offset + len > data.size()) {
+      return base::error::ModelParseError("The token model file is truncated at token " +
+                                          std::to_string(vocab_.size()) + ".");
+    }
+    scores_.push_back(score);
+    vocab_.emplace_back(data.data() + offset, len);
+    offset += len;
+  }
+  if (vocab_.size() <= static_cast<size_t>(kEosTokenId)) {
+    return base::error::ModelParseError("The token model file has too few tokens.");
+  }
+
+  byte_values_.assign(vocab_.size(), -1);
+  std::fill(std::begin(byte_tokens_), std::end(byte_tokens_), kUnkTokenId);
+  for (int32_t i = 0; i < static_cast<int32_t>(vocab_.size()); ++i) {
+    const int16_t value = parse_byte_token(vocab_[i]);
+    if (value >= 0) {
+      byte_values_[i] = value;
+      byte_tokens_[value] = i;
+    }
+  }
+  build_trie();
+  return base::error::Success();
+}
+
+void BpeEncodeLayer::build_trie() {
+  //先建一棵用map存子节点的树，再按层序展开，这样每个节点的子节点在数组里连续且有序
+  std::vector<std::map<uint8_t, int32_t>> children(1);
+  std::vector<int32_t> token_ids(1, -1);
+  for (int32_t i = 0; i < static_cast<int32_t>(vocab_.size()); ++i) {
+    int32_t node = 0;
+    for (const char c : vocab_[i]) {
+      const uint8_t byte = static_cast<uint8_t>(c);
+      auto iter = children[node].find(byte);
+      if (iter == children[node].end()) {
+        const int32_t child = static_cast<int32_t>(children.size());
+        children[node].emplace(byte, child);
+        children.emplace_back();
+        token_ids.push_back(-1);
+        node = child;
+      } else {
+        node = iter->second;
+      }
+    }
+    //词表里有重复的字符串时保留编号最小的一个
+    if (node != 0 && token_ids[node] == -1) {
+      token_ids[node] = i;
+    }
+  }
+
+  trie_nodes_.clear();
+  trie_nodes_.reserve(children.size());
+  std::vector<int32_t> order(1, 0);
+  order.reserve(children.size());
+  trie_nodes_.emplace_back();
+  for (size_t i = 0; i < order.size(); ++i) {
+    trie_nodes_[i].child_begin = static_cast<int32_t>(order.size());
+    for (const auto& [byte, child] : children[order[i]]) {
+      TrieNode node;
+      node.token_id = token_ids[child];
+      node.byte = byte;
+      order.push_back(child);
+      trie_nodes_.push_back(node);
+    }
+    trie_nodes_[i].child_end = static_cast<int32_t>(order.size());
+  }
+
+  std::fill(std::begin(root_children_), std::end(root_children_), -1);
+  for (int32_t i = trie_nodes_[0].child_begin; i < trie_nodes_[0].child_end; ++i) {
+    root_children_[trie_nodes_[i].byte] = i;
+  }
+}
+
+int32_t BpeEncodeLayer::lookup(const char* str, int32_t len) const {
+  if (len <= 0 || len > max_token_length_ || trie_nodes_.empty()) {
+    return -1;
+  }
+  int32_t node = root_children_[static_cast<uint8_t>(str[0])];
+  for (int32_t i = 1; i < len && node != -1; ++i) {
+    const uint8_t byte = static_cast<uint8_t>(str[i]);
+    const TrieNode& parent = trie_nodes_[node];
+    auto begin = trie_nodes_.begin() + parent.child_begin;
+    auto end = trie_nodes_.begin() + parent.child_end;
+    auto iter = std::lower_bound(begin, end, byte,
+                                 [](const TrieNode& n, uint8_t b) { return n.byte < b; });
+    node = (iter != end && iter->byte == byte) ? static_cast<int32_t>(iter - trie_nodes_.begin())
+                                               : -1;
+  }
+  return node == -1 ? -1 : trie_nodes_[node].token_id;
+}
+
+namespace {
+//text里的一段[offset, offset + len)，合并后右边的符号len置0，用prev/next串成双向链表
+struct Symbol {
+  int32_t prev = -1;
+  int32_t next = -1;
+  int32_t offset = 0;
+  int32_t len = 0;
+  int32_t token_id = 0;
+  //退回成字节token的符号不参与合并
+  bool can_merge = true;
+};
+
+//一对候选合并，len是合并后的长度，弹出时用它判断两边的符号有没有被别的合并改过
+struct MergeCandidate {
+  float score = 0.f;
+  int32_t left = 0;
+  int32_t right = 0;
+  int32_t len = 0;
+  int32_t token_id = 0;
+};
+
+struct MergeCompare {
+  bool operator()(const MergeCandidate& a, const MergeCandidate& b) const {
+    if (a.score != b.score) {
+      return a.score < b.score;
+    }
+    return a.left > b.left;
+  }
+};
+
+//UTF-8首字节决定的字符长度，非法的首字节按一个字节处理
+inline int32_t utf8_char_len(uint8_t c) {
+  if (c < 0x80) {
+    return 1;
+  } else if ((c & 0xE0) == 0xC0) {
+    return 2;
+  } else if ((c & 0xF0) == 0xE0) {
+    return 3;
+  } else if ((c & 0xF8) == 0xF0) {
+    return 4;
+  }
+  return 1;
+}
+}  // namespace
+
+std::vector<int32_t> BpeEncodeLayer::encode(const std::string& sentence) const {
+  CHECK(!vocab_.empty()) << "The tokenizer is not initialized.";
+  std::vector<int32_t> tokens;
+  if (has_bos_) {
+    tokens.push_back(kBosTokenId);
+  }
+  if (sentence.empty()) {
+    if (has_eos_) {
+      tokens.push_back(kEosTokenId);
+    }
+    return tokens;
+  }
+
+  //SentencePiece的add_dummy_prefix，llama2.c导出时已经把'▁'换成了空格
+  std::string text;
+  text.reserve(sentence.size() + 1);
+  text.push_back(' ');
+  text.append(sentence);
+  const int32_t text_len = static_cast<int32_t>(text.size());
+
+  std::vector<Symbol> symbols;
+  symbols.reserve(text.size());
+  for (int32_t offset = 0; offset < text_len;) {
+    int32_t len = utf8_char_len(static_cast<uint8_t>(text[offset]));
+    len = std::min(len, text_len - offset);
+    for (int32_t i = 1; i < len; ++i) {
+      if ((static_cast<uint8_t>(text[offset + i]) & 0xC0) != 0x80) {
+        len = i;
+        break;
+      }
+    }
+    const int32_t token_id = lookup(text.data() + offset, len);
+    if (token_id != -1) {
+      Symbol symbol;
+      symbol.offset = offset;
+      symbol.len = len;
+      symbol.token_id = token_id;
+      symbols.push_back(symbol);
+    } else {
+      for (int32_t i = 0; i < len; ++i) {
+        Symbol symbol;
+        symbol.offset = offset + i;
+        symbol.len = 1;
+        symbol.token_id = byte_tokens_[static_cast<uint8_t>(text[offset + i])];
+        symbol.can_merge = false;
+        symbols.push_back(symbol);
+      }
+    }
+    offset += len;
+  }
+  const int32_t symbol_num = static_cast<int32_t>(symbols.size());
+  for (int32_t i = 0; i < symbol_num; ++i) {
+    symbols[i].prev = i - 1;
+    symbols[i].next = i + 1 < symbol_num ? i + 1 : -1;
+  }
+
+  std::vector<MergeCandidate> storage;
+  storage.reserve(symbols.size() * 2);
+  std::priority_queue<MergeCandidate, std::vector<MergeCandidate>, MergeCompare> candidates(
+      MergeCompare(), std::move(storage));
+  auto try_add = [&](int32_t left, int32_t right) {
+    if (left == -1 || right == -1) {
+      return;
+    }
+    const Symbol& l = symbols[left];
+    const Symbol& r = symbols[right];
+    if (!l.can_merge || !r.can_merge) {
+      return;
+    }
+    //相邻的两个符号在text里是连续的，直接查这一段，不用拼字符串
+    const int32_t token_id = lookup(text.data() + l.offset, l.len + r.len);
+    if (token_id == -1) {
+      return;
+    }
+    candidates.push({scores_[token_id], left, right, l.len + r.len, token_id});
+  };
+  for (int32_t i = 0; i + 1 < symbol_num; ++i) {
+    try_add(i, i + 1);
+  }
+
+  while (!candidates.empty()) {
+    const MergeCandidate top = candidates.top();
+    candidates.pop();
+    Symbol& l = symbols[top.left];
+    Symbol& r = symbols[top.right];
+    //其中一边已经被合并掉了，或者已经变长了，这一项作废
+    if (l.len == 0 || r.len == 0 || l.next != top.right || l.len + r.len != top.len) {
+      continue;
+    }
+    l.len += r.len;
+    l.token_id = top.token_id;
+    l.next = r.next;
+    if (r.next != -1) {
+      symbols[r.next].prev = top.left;
+    }
+    r.len = 0;
+    try_add(l.prev, top.left);
+    try_add(top.left, l.next);
+  }
+
+  tokens.reserve(tokens.size() + symbol_num + 1);
+  for (int32_t i = 0; i != -1; i = symbols[i].next) {
+    tokens.push_back(symbols[i].token_id);
+  }
+  if (has_eos_) {
+    tokens.push_back(kEosTokenId);
+  }
+  return tokens;
+}
+
+std::string BpeEncodeLayer::decode(int32_t token_id) const {
+  CHECK(token_id >= 0 && token_id < vocab_size());
+  if (byte_values_[token_id] >= 0) {
+    return std::string(1, static_cast<char>(byte_values_[token_id]));
+  }
+  return vocab_[token_id];
+}
+
+std::string BpeEncodeLayer::decode(const std::vector<int32_t>& token_ids) const {
+  std::string text;
+  int32_t prev_token = -1;
+  for (const int32_t token_id : token_ids) {
+    if (token_id == kBosTokenId || token_id == kEosTokenId) {
+      prev_token = token_id;
+      continue;
+    }
+    const std::string piece = decode(token_id);
+    if (prev_token == kBosTokenId && !piece.empty() && piece[0] == ' ') {
+      text.append(piece, 1, std::string::npos);
+    } else {
+      text.append(piece);
+    }
+    prev_token = token_id;
+  }
+  return text;
+}
+
+bool BpeEncodeLayer::is_sentence_ending(int32_t token_id) const { return token_id == kEosTokenId; }
+
+int32_t BpeEncodeLayer::vocab_size() const { return static_cast<int32_t>(vocab_.size()); }
+
+int32_t BpeEncodeLayer::bos_id() const { return kBosTokenId; }
+
+int32_t BpeEncodeLayer::eos_id() const { return kEosTokenId; }
+
+BpeDecodeStream::BpeDecodeStream(const BpeEncodeLayer* encoder) : encoder_(encoder) {
+  CHECK(encoder_ != nullptr);
+}
+
+std::string BpeDecodeStream::next(int32_t token_id) {
+  const int32_t prev_token = prev_token_;
+  prev_token_ = token_id;
+  if (token_id == encoder_->bos_id() || token_id == encoder_->eos_id()) {
+    return std::string();
+  }
+  const std::string piece = encoder_->decode(token_id);
+  if (prev_token == encoder_->bos_id() && !piece.empty() && piece[0] == ' ') {
+    pending_.append(piece, 1, std::string::npos);
+  } else {
+    pending_.append(piece);
+  }
+
+  //从末尾往回找最后一个字符的首字节，它要是还没收全就留到下一次
+  const int32_t size = static_cast<int32_t>(pending_.size());
+  int32_t complete = size;
+  for (int32_t i = size - 1; i >= 0 && i >= size - 4; --i) {
+    const uint8_t c = static_cast<uint8_t>(pending_[i]);
+    if ((c & 0xC0) == 0x80) {
+      continue;
+    }
+    if (c >= 0xC0 && i + utf8_char_len(c) > size) {
+      complete = i;
+    }
+    break;
+  }
+  std::string text = pending_.substr(0, complete);
+  pending_.erase(0, complete);
+  return text;
+}
+
+std::string BpeDecodeStream::flush() {
+  std::string text;
+  text.swap(pending_);
+  return text;
+}
+
+void BpeDecodeStream::reset() {
+  prev_token_ = -1;
+  pending_.clear();
+}
+}  // namespace op
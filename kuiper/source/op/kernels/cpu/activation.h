@@ -0,0 +1,8 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_ACTIVATION_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_ACTIVATION_H_
+#include <cmath>
+namespace kernel {
+//SwiGLU的门控激活，逐行的FFN kernel和融合了它的GEMM共用这一份
+inline float silu(float x) { return x / (1.f + std::exp(-x)); }
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_ACTIVATION_H_
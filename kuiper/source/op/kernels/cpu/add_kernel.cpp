@@ -0,0 +1,125 @@
+#include "add_kernel.h"
+#include <glog/logging.h>
+#include <cmath>
+#include "parallel.h"
+#include "simd.h"
+namespace kernel {
+//prefill时融合残差RMSNorm每块任务处理的行数，一行就是一整个隐藏状态
+constexpr int32_t kAddRMSNormRowGrain = 4;
+
+void add_kernel_cpu(const tensor::Tensor& input1, const tensor::Tensor& input2,
+                    const tensor::Tensor& output, void* stream) {
+  UNUSED(stream);
+  CHECK(!input1.is_empty() && !input2.is_empty() && !output.is_empty());
+  CHECK(input1.is_contiguous() && input2.is_contiguous() && output.is_contiguous());
+  CHECK_EQ(input1.size(), input2.size());
+  CHECK_EQ(input1.size(), output.size());
+
+  const float* in1 = input1.ptr<float>();
+  const float* in2 = input2.ptr<float>();
+  float* out = const_cast<float*>(output.ptr<float>());
+  const int64_t size = static_cast<int64_t>(input1.size());
+  int64_t i = 0;
+#if defined(KUIPER_USE_AVX512)
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_ps(out + i, _mm512_add_ps(_mm512_loadu_ps(in1 + i), _mm512_loadu_ps(in2 + i)));
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(in1 + i), _mm256_loadu_ps(in2 + i)));
+  }
+#endif
+  for (; i < size; ++i) {
+    out[i] = in1[i] + in2[i];
+  }
+}
+
+//out = a + b，返回sum(out^2)
+static inline float add_sumsq_row(const float* a, const float* b, float* out, int32_t len) {
+  int32_t i = 0;
+  float sumsq = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc512 = _mm512_setzero_ps();
+  for (; i + 16 <= len; i += 16) {
+    const __m512 v = _mm512_add_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    _mm512_storeu_ps(out + i, v);
+    acc512 = _mm512_fmadd_ps(v, v, acc512);
+  }
+  sumsq += _mm512_reduce_add_ps(acc512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= len; i += 8) {
+    const __m256 v = _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    _mm256_storeu_ps(out + i, v);
+    acc = _mm256_fmadd_ps(v, v, acc);
+  }
+  sumsq += hsum_ps(acc);
+#endif
+  for (; i < len; ++i) {
+    out[i] = a[i] + b[i];
+    sumsq += out[i] * out[i];
+  }
+  return sumsq;
+}
+
+//out = x * scale * weight
+static inline void scale_mul_row(const float* x, const float* weight, float scale, float* out,
+                                 int32_t len) {
+  int32_t i = 0;
+#if defined(KUIPER_USE_AVX512)
+  const __m512 s512 = _mm512_set1_ps(scale);
+  for (; i + 16 <= len; i += 16) {
+    _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_mul_ps(_mm512_loadu_ps(x + i), s512),
+                                            _mm512_loadu_ps(weight + i)));
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  const __m256 s256 = _mm256_set1_ps(scale);
+  for (; i + 8 <= len; i += 8) {
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), s256),
+                                            _mm256_loadu_ps(weight + i)));
+  }
+#endif
+  for (; i < len; ++i) {
+    out[i] = x[i] * scale * weight[i];
+  }
+}
+
+void add_rmsnorm_kernel_cpu(const tensor::Tensor& residual, const tensor::Tensor& delta,
+                            const tensor::Tensor& weight, const tensor::Tensor& residual_out,
+                            const tensor::Tensor& norm_out, float eps, void* stream) {
+  CHECK(!residual.is_empty() && !delta.is_empty() && !weight.is_empty());
+  CHECK(!residual_out.is_empty() && !norm_out.is_empty());
+  CHECK(residual.is_contiguous() && delta.is_contiguous() && weight.is_contiguous() &&
+        residual_out.is_contiguous() && norm_out.is_contiguous());
+  const int32_t dim = static_cast<int32_t>(weight.size());
+  const int32_t rows = static_cast<int32_t>(residual.size() / dim);
+  CHECK_EQ(residual.size(), static_cast<size_t>(rows) * dim);
+  CHECK_EQ(delta.size(), residual.size());
+  CHECK_EQ(residual_out.size(), residual.size());
+  CHECK_EQ(norm_out.size(), residual.size());
+
+  const float* res_ptr = residual.ptr<float>();
+  const float* delta_ptr = delta.ptr<float>();
+  const float* weight_ptr = weight.ptr<float>();
+  float* res_out_ptr = const_cast<float*>(residual_out.ptr<float>());
+  float* norm_out_ptr = const_cast<float*>(norm_out.ptr<float>());
+  auto norm_rows = [&](int64_t row_begin, int64_t row_end, int32_t) {
+    for (int64_t r = row_begin; r < row_end; ++r) {
+      const int64_t offset = r * dim;
+      const float sumsq =
+          add_sumsq_row(res_ptr + offset, delta_ptr + offset, res_out_ptr + offset, dim);
+      const float scale = 1.f / std::sqrt(sumsq / static_cast<float>(dim) + eps);
+      scale_mul_row(res_out_ptr + offset, weight_ptr, scale, norm_out_ptr + offset, dim);
+    }
+  };
+  //decode时只有一行，不值得唤醒线程池
+  if (rows == 1) {
+    norm_rows(0, 1, 0);
+  } else {
+    get_thread_pool(stream)->parallel_for(0, rows, kAddRMSNormRowGrain, norm_rows);
+  }
+}
+}  // namespace kernel
@@ -0,0 +1,17 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_ADD_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_ADD_KERNEL_H_
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief output = input1 + input2，output可以和input1是同一个tensor（原地残差相加）
+void add_kernel_cpu(const tensor::Tensor& input1, const tensor::Tensor& input2,
+                    const tensor::Tensor& output, void* stream = nullptr);
+
+/// @brief 融合的残差相加和RMSNorm
+//residual_out = residual + delta，norm_out = rmsnorm(residual_out) * weight，按行（最后一维）做归一化。
+//每一行相加的时候顺便在寄存器里累加平方和，归一化时这一行还在L1里，整体只读写一遍隐藏状态。
+//residual_out可以和residual是同一个tensor。
+void add_rmsnorm_kernel_cpu(const tensor::Tensor& residual, const tensor::Tensor& delta,
+                            const tensor::Tensor& weight, const tensor::Tensor& residual_out,
+                            const tensor::Tensor& norm_out, float eps, void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_ADD_KERNEL_H_
@@ -0,0 +1,133 @@
+#include "convert_kernel.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include "parallel.h"
+#include "simd.h"
+namespace kernel {
+//一个任务转换的元素个数
+constexpr int64_t kConvertGrain = 64 * 1024;
+
+void fp32_to_fp16_cpu(const float* input, uint16_t* output, int64_t size) {
+  int64_t i = 0;
+#if defined(KUIPER_USE_AVX512)
+  for (; i + 16 <= size; i += 16) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i),
+                        _mm512_cvtps_ph(_mm512_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+#if defined(KUIPER_USE_F16C)
+  for (; i + 8 <= size; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = float_to_half(input[i]);
+  }
+}
+
+void fp16_to_fp32_cpu(const uint16_t* input, float* output, int64_t size) {
+  int64_t i = 0;
+#if defined(KUIPER_USE_AVX512)
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_ps(output + i, load_f16x16_ps(input + i));
+  }
+#endif
+#if defined(KUIPER_USE_F16C)
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(output + i, load_f16x8_ps(input + i));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = half_to_float(input[i]);
+  }
+}
+
+void fp32_to_bf16_cpu(const float* input, uint16_t* output, int64_t size) {
+  int64_t i = 0;
+#if defined(KUIPER_USE_AVX512_BF16)
+  for (; i + 16 <= size; i += 16) {
+    const __m256bh v = _mm512_cvtneps_pbh(_mm512_loadu_ps(input + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i),
+                        reinterpret_cast<const __m256i&>(v));
+  }
+#elif defined(KUIPER_USE_AVX512)
+  //没有BF16指令时用整数运算做就近舍入：bits + 0x7FFF + ((bits >> 16) & 1)，NaN另外处理
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i round = _mm512_set1_epi32(0x7FFF);
+  const __m512i quiet = _mm512_set1_epi32(0x400000);
+  for (; i + 16 <= size; i += 16) {
+    const __m512 x = _mm512_loadu_ps(input + i);
+    const __m512i bits = _mm512_castps_si512(x);
+    const __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), one);
+    __m512i rounded = _mm512_add_epi32(bits, _mm512_add_epi32(round, lsb));
+    const __mmask16 nan = _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+    rounded = _mm512_mask_or_epi32(rounded, nan, bits, quiet);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i),
+                        _mm512_cvtepi32_epi16(_mm512_srli_epi32(rounded, 16)));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = float_to_bf16(input[i]);
+  }
+}
+
+void bf16_to_fp32_cpu(const uint16_t* input, float* output, int64_t size) {
+  int64_t i = 0;
+#if defined(KUIPER_USE_AVX512)
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_ps(output + i, load_bf16x16_ps(input + i));
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(output + i, load_bf16x8_ps(input + i));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = bf16_to_float(input[i]);
+  }
+}
+
+void convert_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& output, void* stream) {
+  CHECK(!input.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && output.is_contiguous());
+  CHECK(input.device_type() == base::DeviceType::kDeviceCPU &&
+        output.device_type() == base::DeviceType::kDeviceCPU);
+  CHECK_EQ(input.size(), output.size());
+  const base::DataType from = input.data_type();
+  const base::DataType to = output.data_type();
+  void (*convert)(const void*, void*, int64_t) = nullptr;
+  if (from == base::DataType::kDataTypeFp32 && to == base::DataType::kDataTypeFp16) {
+    convert = [](const void* in, void* out, int64_t size) {
+      fp32_to_fp16_cpu(static_cast<const float*>(in), static_cast<uint16_t*>(out), size);
+    };
+  } else if (from == base::DataType::kDataTypeFp16 && to == base::DataType::kDataTypeFp32) {
+    convert = [](const void* in, void* out, int64_t size) {
+      fp16_to_fp32_cpu(static_cast<const uint16_t*>(in), static_cast<float*>(out), size);
+    };
+  } else if (from == base::DataType::kDataTypeFp32 && to == base::DataType::kDataTypeBf16) {
+    convert = [](const void* in, void* out, int64_t size) {
+      fp32_to_bf16_cpu(static_cast<const float*>(in), static_cast<uint16_t*>(out), size);
+    };
+  } else if (from == base::DataType::kDataTypeBf16 && to == base::DataType::kDataTypeFp32) {
+    convert = [](const void* in, void* out, int64_t size) {
+      bf16_to_fp32_cpu(static_cast<const uint16_t*>(in), static_cast<float*>(out), size);
+    };
+  } else {
+    LOG(FATAL) << "Unsupported conversion from data type " << int(from) << " to " << int(to);
+  }
+
+  const size_t in_elem = base::DataTypeSize(from);
+  const size_t out_elem = base::DataTypeSize(to);
+  const int8_t* in_ptr = input.ptr<int8_t>();
+  int8_t* out_ptr = const_cast<int8_t*>(output.ptr<int8_t>());
+  const int64_t size = static_cast<int64_t>(input.size());
+  const int64_t chunks = (size + kConvertGrain - 1) / kConvertGrain;
+  get_thread_pool(stream)->parallel_for(0, chunks, 1, [&](int64_t begin, int64_t end, int32_t) {
+    const int64_t first = begin * kConvertGrain;
+    const int64_t last = std::min(size, end * kConvertGrain);
+    convert(in_ptr + first * in_elem, out_ptr + first * out_elem, last - first);
+  });
+}
+}  // namespace kernel
@@ -0,0 +1,21 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_CONVERT_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_CONVERT_KERNEL_H_
+#include <cstdint>
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief size个fp32转成fp16，就近舍入到偶数；有F16C时一次转8个，AVX-512时一次16个
+void fp32_to_fp16_cpu(const float* input, uint16_t* output, int64_t size);
+
+void fp16_to_fp32_cpu(const uint16_t* input, float* output, int64_t size);
+
+/// @brief size个fp32转成bf16，就近舍入到偶数；有AVX-512-BF16时用vcvtneps2bf16，它会把fp32的非规格化数当成0
+void fp32_to_bf16_cpu(const float* input, uint16_t* output, int64_t size);
+
+void bf16_to_fp32_cpu(const uint16_t* input, float* output, int64_t size);
+
+/// @brief input和output的元素个数相同，一个是fp32另一个是fp16或bf16，按块分给线程池转换。
+//加载权重时把fp32的权重转成16位（或者反过来）用这个
+void convert_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& output,
+                        void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_CONVERT_KERNEL_H_
@@ -0,0 +1,24 @@
+#include "emb_kernel.h"
+#include <glog/logging.h>
+#include <cstring>
+namespace kernel {
+void emb_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& weight,
+                    const tensor::Tensor& output, int32_t vocab_size, void* stream) {
+  UNUSED(stream);
+  CHECK(!input.is_empty() && !weight.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && weight.is_contiguous() && output.is_contiguous());
+  const int32_t token_num = static_cast<int32_t>(input.size());
+  const int32_t dim = static_cast<int32_t>(weight.size() / vocab_size);
+  CHECK_EQ(output.size(), static_cast<size_t>(token_num) * dim);
+
+  const int32_t* tokens = input.ptr<int32_t>();
+  const float* weight_ptr = weight.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+  for (int32_t i = 0; i < token_num; ++i) {
+    const int32_t token = tokens[i];
+    CHECK(token >= 0 && token < vocab_size) << "The token id " << token << " is out of range.";
+    std::memcpy(out_ptr + static_cast<int64_t>(i) * dim,
+                weight_ptr + static_cast<int64_t>(token) * dim, dim * sizeof(float));
+  }
+}
+}  // namespace kernel
@@ -0,0 +1,9 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_EMB_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_EMB_KERNEL_H_
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief 按token id从embedding表[vocab_size, dim]里取出对应的行，output是[token_num, dim]
+void emb_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& weight,
+                    const tensor::Tensor& output, int32_t vocab_size, void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_EMB_KERNEL_H_
@@ -0,0 +1,1209 @@
+#include "matmul_kernel.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "activation.h"
+#include "parallel.h"
+#include "simd.h"
+namespace kernel {
+//GEMV一次处理4行权重，共用同一段input；K方向按4096个float分块，让这段input一直留在L1里
+constexpr int32_t kGemvRowTile = 4;
+constexpr int32_t kGemvKBlock = 4096;
+//GEMM的寄存器块是6x16，A按[MC, KC]、B按[NC, KC]打包之后交给micro kernel
+constexpr int32_t kGemmMR = 6;
+constexpr int32_t kGemmNR = 16;
+constexpr int32_t kGemmMC = 72;
+constexpr int32_t kGemmNC = 128;
+constexpr int32_t kGemmKC = 256;
+//线程池里每块任务的大小：GEMV按4行的tile计，int8按行计
+constexpr int32_t kGemvTileGrain = 8;
+constexpr int32_t kQInt8RowGrain = 16;
+//int4每块任务开头要按组算一遍输入的和，块大一些把它摊薄
+constexpr int32_t kQInt4RowGrain = 64;
+//int8/int4输入至少有这么多行时才改走反量化打包的GEMM
+constexpr int32_t kQInt8GemmMinRows = 16;
+//kLayoutPanel16一个panel的行数，和GEMM的NR一致，GEMM可以直接读打包好的权重；打包的权重每块任务的panel数
+constexpr int32_t kPanelRows = kGemmNR;
+constexpr int32_t kPanelGrain = 2;
+//fp32 panel的GEMV一次算4个panel（64行），共用x的广播
+constexpr int32_t kPanelGemvTile = 4;
+//w的[row_begin, row_end)行和M个输入做点积，结果写到out[r * ldo + i]，组号从w的第0个元素开始算
+static void qint8_rows(const float* in_ptr, int32_t m, const int8_t* weight_ptr,
+                       const float* scale_ptr, int32_t dim1, int32_t group_size,
+                       int32_t row_begin, int32_t row_end, float* out_ptr, int64_t ldo) {
+  for (int32_t i = row_begin; i < row_end; ++i) {
+    const int64_t row_offset = static_cast<int64_t>(i) * dim1;
+    const int8_t* w_row = weight_ptr + row_offset;
+    //一行权重读一次，给M个输入共用
+    for (int32_t r = 0; r < m; ++r) {
+      const float* x = in_ptr + static_cast<int64_t>(r) * dim1;
+      float sum = 0.f;
+      //量化组是按展平后的权重划分的，dim1不是group_size整数倍时一组会跨行
+      int32_t k = 0;
+      while (k < dim1) {
+        const int64_t group = (row_offset + k) / group_size;
+        const int32_t group_end =
+            static_cast<int32_t>(std::min<int64_t>(dim1, (group + 1) * group_size - row_offset));
+        sum += scale_ptr[group] * dot_qint8_ps(w_row + k, x + k, group_end - k);
+        k = group_end;
+      }
+      out_ptr[static_cast<int64_t>(r) * ldo + i] = sum;
+    }
+  }
+}
+
+//fp32、fp16和bf16权重的读法，16位的权重在寄存器里转成fp32，累加都是fp32
+template <base::DataType type>
+struct WeightTraits;
+
+template <>
+struct WeightTraits<base::DataType::kDataTypeFp32> {
+  using T = float;
+  static inline float to_float(float w) { return w; }
+  static inline float dot(const float* w, const float* x, int32_t len) { return dot_ps(w, x, len); }
+#if defined(KUIPER_USE_AVX512)
+  static inline __m512 load16(const float* w) { return _mm512_loadu_ps(w); }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  static constexpr bool kHasLoad8 = true;
+  static inline __m256 load8(const float* w) { return _mm256_loadu_ps(w); }
+#endif
+};
+
+template <>
+struct WeightTraits<base::DataType::kDataTypeFp16> {
+  using T = uint16_t;
+  static inline float to_float(uint16_t w) { return half_to_float(w); }
+  static inline float dot(const uint16_t* w, const float* x, int32_t len) {
+    return dot_f16_ps(x, w, len);
+  }
+#if defined(KUIPER_USE_AVX512)
+  static inline __m512 load16(const uint16_t* w) { return load_f16x16_ps(w); }
+#endif
+#if defined(KUIPER_USE_F16C)
+  static constexpr bool kHasLoad8 = true;
+  static inline __m256 load8(const uint16_t* w) { return load_f16x8_ps(w); }
+#elif defined(KUIPER_USE_AVX2)
+  //只有AVX2没有F16C时8个一组的尾巴走标量
+  static constexpr bool kHasLoad8 = false;
+  static inline __m256 load8(const uint16_t*) { return _mm256_setzero_ps(); }
+#endif
+};
+
+template <>
+struct WeightTraits<base::DataType::kDataTypeBf16> {
+  using T = uint16_t;
+  static inline float to_float(uint16_t w) { return bf16_to_float(w); }
+  static inline float dot(const uint16_t* w, const float* x, int32_t len) {
+    return dot_bf16_ps(x, w, len);
+  }
+#if defined(KUIPER_USE_AVX512)
+  static inline __m512 load16(const uint16_t* w) { return load_bf16x16_ps(w); }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  static constexpr bool kHasLoad8 = true;
+  static inline __m256 load8(const uint16_t* w) { return load_bf16x8_ps(w); }
+#endif
+};
+
+template <base::DataType type>
+using WeightT = typename WeightTraits<type>::T;
+
+//int4权重第group组的scale和min，没有min时是对称量化，零点在8
+static inline void q4_group_param(const uint16_t* scale_ptr, const uint16_t* min_ptr,
+                                  int64_t group, float& scale, float& min) {
+  scale = half_to_float(scale_ptr[group]);
+  min = min_ptr ? half_to_float(min_ptr[group]) : -8.f * scale;
+}
+
+//int4权重一行和x的点积，w、scales、mins都从这一行的第一组开始。
+//w = q * scale + min，所以一组的点积是scale * sum(q * x) + min * sum(x)，sum(x)预先算好放在xsum里；
+//组内的sum(q * x)留在向量寄存器里，乘上scale之后累加到整行，一行只做一次水平求和
+static inline float q4_row_dot(const uint8_t* w, const uint16_t* scales, const uint16_t* mins,
+                               const float* x, const float* xsum, int32_t dim1,
+                               int32_t group_size) {
+  const int32_t row_groups = dim1 / group_size;
+  float min_sum = 0.f;
+  float sum = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 row_acc = _mm512_setzero_ps();
+#elif defined(KUIPER_USE_AVX2)
+  __m256 row_acc = _mm256_setzero_ps();
+#endif
+  for (int32_t g = 0; g < row_groups; ++g) {
+    float scale = 0.f;
+    float min = 0.f;
+    q4_group_param(scales, mins, g, scale, min);
+    min_sum += min * xsum[g];
+    const uint8_t* wg = w + static_cast<int64_t>(g) * group_size / 2;
+    const float* xg = x + static_cast<int64_t>(g) * group_size;
+#if defined(KUIPER_USE_AVX512)
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    for (int32_t k = 0; k < group_size; k += 32) {
+      __m512 lo, hi;
+      load_q4x32_ps(wg + k / 2, lo, hi);
+      acc0 = _mm512_fmadd_ps(lo, _mm512_loadu_ps(xg + k), acc0);
+      acc1 = _mm512_fmadd_ps(hi, _mm512_loadu_ps(xg + k + 16), acc1);
+    }
+    row_acc = _mm512_fmadd_ps(_mm512_add_ps(acc0, acc1), _mm512_set1_ps(scale), row_acc);
+#elif defined(KUIPER_USE_AVX2)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (int32_t k = 0; k < group_size; k += 32) {
+      __m256 q[4];
+      load_q4x32_ps(wg + k / 2, q);
+      acc0 = _mm256_fmadd_ps(q[0], _mm256_loadu_ps(xg + k), acc0);
+      acc1 = _mm256_fmadd_ps(q[1], _mm256_loadu_ps(xg + k + 8), acc1);
+      acc0 = _mm256_fmadd_ps(q[2], _mm256_loadu_ps(xg + k + 16), acc0);
+      acc1 = _mm256_fmadd_ps(q[3], _mm256_loadu_ps(xg + k + 24), acc1);
+    }
+    row_acc = _mm256_fmadd_ps(_mm256_add_ps(acc0, acc1), _mm256_set1_ps(scale), row_acc);
+#else
+    float group_sum = 0.f;
+    for (int32_t k = 0; k < group_size; ++k) {
+      group_sum += static_cast<float>(q4_at(wg, k)) * xg[k];
+    }
+    sum += scale * group_sum;
+#endif
+  }
+#if defined(KUIPER_USE_AVX512)
+  sum += _mm512_reduce_add_ps(row_acc);
+#elif defined(KUIPER_USE_AVX2)
+  sum += hsum_ps(row_acc);
+#endif
+  return sum + min_sum;
+}
+
+//和qint8_rows一样，w是kDataTypeInt4，一组不会跨行。
+//每一段开头先把M个输入按组求和写进xsum[M, dim1 / group_size]，这一段的所有行共用
+static void q4_rows(const float* in_ptr, int32_t m, const uint8_t* weight_ptr,
+                    const uint16_t* scale_ptr, const uint16_t* min_ptr, int32_t dim1,
+                    int32_t group_size, int32_t row_begin, int32_t row_end, float* out_ptr,
+                    int64_t ldo, float* xsum) {
+  const int32_t row_groups = dim1 / group_size;
+  for (int32_t r = 0; r < m; ++r) {
+    for (int32_t g = 0; g < row_groups; ++g) {
+      xsum[r * row_groups + g] =
+          sum_ps(in_ptr + static_cast<int64_t>(r) * dim1 + g * group_size, group_size);
+    }
+  }
+  for (int32_t i = row_begin; i < row_end; ++i) {
+    const int64_t group0 = static_cast<int64_t>(i) * row_groups;
+    const uint8_t* w = weight_ptr + static_cast<int64_t>(i) * dim1 / 2;
+    //一行权重读一次，给M个输入共用
+    for (int32_t r = 0; r < m; ++r) {
+      out_ptr[static_cast<int64_t>(r) * ldo + i] =
+          q4_row_dot(w, scale_ptr + group0, min_ptr ? min_ptr + group0 : nullptr,
+                     in_ptr + static_cast<int64_t>(r) * dim1, xsum + r * row_groups, dim1,
+                     group_size);
+    }
+  }
+}
+
+//4行权重同时和x做点积，每次加载的x被4行复用
+template <base::DataType type>
+static inline void dot_x4(const WeightT<type>* w, int64_t ldw, const float* x, int32_t len,
+                          float* sums) {
+  using Traits = WeightTraits<type>;
+  const WeightT<type>* w0 = w;
+  const WeightT<type>* w1 = w + ldw;
+  const WeightT<type>* w2 = w + 2 * ldw;
+  const WeightT<type>* w3 = w + 3 * ldw;
+  int32_t k = 0;
+  float s0 = 0.f, s1 = 0.f, s2 = 0.f, s3 = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+  __m512 a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    const __m512 xv = _mm512_loadu_ps(x + k);
+    a0 = _mm512_fmadd_ps(Traits::load16(w0 + k), xv, a0);
+    a1 = _mm512_fmadd_ps(Traits::load16(w1 + k), xv, a1);
+    a2 = _mm512_fmadd_ps(Traits::load16(w2 + k), xv, a2);
+    a3 = _mm512_fmadd_ps(Traits::load16(w3 + k), xv, a3);
+  }
+  s0 += _mm512_reduce_add_ps(a0);
+  s1 += _mm512_reduce_add_ps(a1);
+  s2 += _mm512_reduce_add_ps(a2);
+  s3 += _mm512_reduce_add_ps(a3);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  if constexpr (Traits::kHasLoad8) {
+    __m256 b0 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+    __m256 b2 = _mm256_setzero_ps(), b3 = _mm256_setzero_ps();
+    for (; k + 8 <= len; k += 8) {
+      const __m256 xv = _mm256_loadu_ps(x + k);
+      b0 = _mm256_fmadd_ps(Traits::load8(w0 + k), xv, b0);
+      b1 = _mm256_fmadd_ps(Traits::load8(w1 + k), xv, b1);
+      b2 = _mm256_fmadd_ps(Traits::load8(w2 + k), xv, b2);
+      b3 = _mm256_fmadd_ps(Traits::load8(w3 + k), xv, b3);
+    }
+    s0 += hsum_ps(b0);
+    s1 += hsum_ps(b1);
+    s2 += hsum_ps(b2);
+    s3 += hsum_ps(b3);
+  }
+#endif
+  for (; k < len; ++k) {
+    s0 += Traits::to_float(w0[k]) * x[k];
+    s1 += Traits::to_float(w1[k]) * x[k];
+    s2 += Traits::to_float(w2[k]) * x[k];
+    s3 += Traits::to_float(w3[k]) * x[k];
+  }
+  sums[0] += s0;
+  sums[1] += s1;
+  sums[2] += s2;
+  sums[3] += s3;
+}
+
+//y[row_begin, row_end) = w[row_begin, row_end) * x
+template <base::DataType type>
+static void gemv_rows(const float* x, const WeightT<type>* w, float* y, int32_t row_begin,
+                      int32_t row_end, int32_t k) {
+  for (int32_t r = row_begin; r < row_end; ++r) {
+    y[r] = 0.f;
+  }
+  for (int32_t kb = 0; kb < k; kb += kGemvKBlock) {
+    const int32_t len = std::min(kGemvKBlock, k - kb);
+    for (int32_t r = row_begin; r < row_end; r += kGemvRowTile) {
+      const WeightT<type>* w_tile = w + static_cast<int64_t>(r) * k + kb;
+      if (r + kGemvRowTile <= row_end) {
+        dot_x4<type>(w_tile, k, x + kb, len, y + r);
+      } else {
+        for (int32_t i = r; i < row_end; ++i) {
+          y[i] += WeightTraits<type>::dot(w + static_cast<int64_t>(i) * k + kb, x + kb, len);
+        }
+      }
+    }
+  }
+}
+
+//把n行按kGemvRowTile对齐切成count份，返回第index份的[begin, end)
+static inline std::pair<int32_t, int32_t> split_rows(int32_t n, int32_t count, int32_t index) {
+  const int32_t tiles = (n + kGemvRowTile - 1) / kGemvRowTile;
+  const int32_t tiles_per_part = (tiles + count - 1) / count;
+  const int32_t tile_begin = std::min(tiles, index * tiles_per_part);
+  const int32_t tile_end = std::min(tiles, tile_begin + tiles_per_part);
+  return {tile_begin * kGemvRowTile, std::min(n, tile_end * kGemvRowTile)};
+}
+
+//y[n] = w[n, k] * x[k]，输出行按kGemvTileGrain个tile一块交给线程池
+template <base::DataType type>
+static void gemv(base::ThreadPool* pool, const float* x, const WeightT<type>* w, float* y,
+                 int32_t n, int32_t k) {
+  const int32_t tiles = (n + kGemvRowTile - 1) / kGemvRowTile;
+  pool->parallel_for(0, tiles, kGemvTileGrain, [&](int64_t tile_begin, int64_t tile_end, int32_t) {
+    const int32_t row_begin = static_cast<int32_t>(tile_begin) * kGemvRowTile;
+    const int32_t row_end = std::min(n, static_cast<int32_t>(tile_end) * kGemvRowTile);
+    gemv_rows<type>(x, w, y, row_begin, row_end, k);
+  });
+}
+
+//把src的rows行（每行从src + i * ld开始取kc个元素）转置打包成[kc][R]，不足R行的补0，
+//16位的权重在这里转成fp32
+template <int32_t R, base::DataType type = base::DataType::kDataTypeFp32>
+static void pack_panels(const WeightT<type>* src, int64_t ld, int32_t rows, int32_t kc,
+                        float* packed) {
+  for (int32_t i0 = 0; i0 < rows; i0 += R) {
+    float* panel = packed + static_cast<int64_t>(i0) * kc;
+    const int32_t valid = std::min(R, rows - i0);
+    for (int32_t i = 0; i < R; ++i) {
+      if (i < valid) {
+        const WeightT<type>* row = src + (i0 + i) * ld;
+        for (int32_t p = 0; p < kc; ++p) {
+          panel[p * R + i] = WeightTraits<type>::to_float(row[p]);
+        }
+      } else {
+        for (int32_t p = 0; p < kc; ++p) {
+          panel[p * R + i] = 0.f;
+        }
+      }
+    }
+  }
+}
+
+//c[mr, nr] (+)= a_panel[kc][MR] * b_panel[kc][NR]
+static inline void gemm_micro_kernel(int32_t kc, const float* a_panel, const float* b_panel,
+                                     float* c, int64_t ldc, int32_t mr, int32_t nr,
+                                     bool accumulate) {
+  alignas(64) float tile[kGemmMR][kGemmNR];
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc[kGemmMR];
+  for (int32_t i = 0; i < kGemmMR; ++i) {
+    acc[i] = _mm512_setzero_ps();
+  }
+  for (int32_t p = 0; p < kc; ++p) {
+    const __m512 b = _mm512_loadu_ps(b_panel + p * kGemmNR);
+    const float* a = a_panel + p * kGemmMR;
+    for (int32_t i = 0; i < kGemmMR; ++i) {
+      acc[i] = _mm512_fmadd_ps(_mm512_set1_ps(a[i]), b, acc[i]);
+    }
+  }
+  for (int32_t i = 0; i < kGemmMR; ++i) {
+    _mm512_store_ps(tile[i], acc[i]);
+  }
+#elif defined(KUIPER_USE_AVX2)
+  __m256 acc[kGemmMR][2];
+  for (int32_t i = 0; i < kGemmMR; ++i) {
+    acc[i][0] = _mm256_setzero_ps();
+    acc[i][1] = _mm256_setzero_ps();
+  }
+  for (int32_t p = 0; p < kc; ++p) {
+    const __m256 b0 = _mm256_loadu_ps(b_panel + p * kGemmNR);
+    const __m256 b1 = _mm256_loadu_ps(b_panel + p * kGemmNR + 8);
+    const float* a = a_panel + p * kGemmMR;
+    for (int32_t i = 0; i < kGemmMR; ++i) {
+      const __m256 av = _mm256_broadcast_ss(a + i);
+      acc[i][0] = _mm256_fmadd_ps(av, b0, acc[i][0]);
+      acc[i][1] = _mm256_fmadd_ps(av, b1, acc[i][1]);
+    }
+  }
+  for (int32_t i = 0; i < kGemmMR; ++i) {
+    _mm256_store_ps(tile[i], acc[i][0]);
+    _mm256_store_ps(tile[i] + 8, acc[i][1]);
+  }
+#else
+  for (int32_t i = 0; i < kGemmMR; ++i) {
+    for (int32_t j = 0; j < kGemmNR; ++j) {
+      tile[i][j] = 0.f;
+    }
+  }
+  for (int32_t p = 0; p < kc; ++p) {
+    const float* a = a_panel + p * kGemmMR;
+    const float* b = b_panel + p * kGemmNR;
+    for (int32_t i = 0; i < kGemmMR; ++i) {
+      for (int32_t j = 0; j < kGemmNR; ++j) {
+        tile[i][j] += a[i] * b[j];
+      }
+    }
+  }
+#endif
+  for (int32_t i = 0; i < mr; ++i) {
+    float* c_row = c + i * ldc;
+    if (accumulate) {
+      for (int32_t j = 0; j < nr; ++j) {
+        c_row[j] += tile[i][j];
+      }
+    } else {
+      for (int32_t j = 0; j < nr; ++j) {
+        c_row[j] = tile[i][j];
+      }
+    }
+  }
+}
+
+//B的[jc, jc + nc)行、[pc, pc + kc)列打包之后的位置，从第jr行开始的[kc][NR]的panel在ptr + jr * ld
+struct PackedB {
+  const float* ptr;
+  int64_t ld;
+};
+
+//c[m, n] = a[m, k] * b[n, k]^T，c的行距是ldc
+//输出按[MC, NC]切成互不重叠的块分给各个线程，每个线程在自己的块里按KC分段打包A、B再调用micro kernel。
+//pack_b(jc, pc, nc, kc, b_pack)负责把B的[jc, jc + nc)行、[pc, pc + kc)列打包成NR宽的panel并返回PackedB，
+//fp32直接转置拷贝，int8在打包的时候顺便反量化，已经是kLayoutPanel16的fp32权重直接返回原来的panel，
+//micro kernel是同一个。
+template <typename PackB>
+static void gemm_blocked(base::ThreadPool* pool, const float* a, float* c, int32_t m, int32_t n,
+                         int32_t k, int64_t ldc, const PackB& pack_b) {
+  const int32_t m_blocks = (m + kGemmMC - 1) / kGemmMC;
+  const int32_t n_blocks = (n + kGemmNC - 1) / kGemmNC;
+  pool->parallel_for(0, m_blocks * n_blocks, 1, [&](int64_t block_begin, int64_t block_end,
+                                                    int32_t worker_id) {
+    //A、B的打包缓冲区是worker私有的scratch，不会每次都重新申请
+    float* a_pack = static_cast<float*>(pool->scratch(
+        worker_id, sizeof(float) * (static_cast<size_t>(kGemmMC) + kGemmNC) * kGemmKC));
+    float* b_pack = a_pack + static_cast<size_t>(kGemmMC) * kGemmKC;
+    for (int64_t block = block_begin; block < block_end; ++block) {
+      const int32_t ic = static_cast<int32_t>(block / n_blocks) * kGemmMC;
+      const int32_t jc = static_cast<int32_t>(block % n_blocks) * kGemmNC;
+      const int32_t mc = std::min(kGemmMC, m - ic);
+      const int32_t nc = std::min(kGemmNC, n - jc);
+      for (int32_t pc = 0; pc < k; pc += kGemmKC) {
+        const int32_t kc = std::min(kGemmKC, k - pc);
+        pack_panels<kGemmMR>(a + static_cast<int64_t>(ic) * k + pc, k, mc, kc, a_pack);
+        const PackedB b_panels = pack_b(jc, pc, nc, kc, b_pack);
+        for (int32_t jr = 0; jr < nc; jr += kGemmNR) {
+          for (int32_t ir = 0; ir < mc; ir += kGemmMR) {
+            gemm_micro_kernel(kc, a_pack + static_cast<int64_t>(ir) * kc,
+                              b_panels.ptr + static_cast<int64_t>(jr) * b_panels.ld,
+                              c + static_cast<int64_t>(ic + ir) * ldc + jc + jr, ldc,
+                              std::min(kGemmMR, mc - ir), std::min(kGemmNR, nc - jr), pc != 0);
+          }
+        }
+      }
+    }
+  });
+}
+
+template <base::DataType type>
+static void gemm(base::ThreadPool* pool, const float* a, const WeightT<type>* b, float* c,
+                 int32_t m, int32_t n, int32_t k, int64_t ldc) {
+  gemm_blocked(pool, a, c, m, n, k, ldc,
+               [&](int32_t jc, int32_t pc, int32_t nc, int32_t kc, float* b_pack) {
+                 pack_panels<kGemmNR, type>(b + static_cast<int64_t>(jc) * k + pc, k, nc, kc,
+                                            b_pack);
+                 return PackedB{b_pack, kc};
+               });
+}
+
+//c[m, n] = silu(a * b1^T) * (a * b3^T)，切块和gemm_blocked一样，A每段KC只打包一次给b1、b3共用。
+//两个[MC, NC]的累加块放在worker的scratch里，K方向全部算完之后在块内做silu和乘法，只写出一次c。
+template <typename PackB1, typename PackB3>
+static void gemm_swiglu_blocked(base::ThreadPool* pool, const float* a, float* c, int32_t m,
+                                int32_t n, int32_t k, const PackB1& pack_b1,
+                                const PackB3& pack_b3) {
+  const int32_t m_blocks = (m + kGemmMC - 1) / kGemmMC;
+  const int32_t n_blocks = (n + kGemmNC - 1) / kGemmNC;
+  pool->parallel_for(0, m_blocks * n_blocks, 1, [&](int64_t block_begin, int64_t block_end,
+                                                    int32_t worker_id) {
+    float* a_pack = static_cast<float*>(pool->scratch(
+        worker_id, sizeof(float) * ((static_cast<size_t>(kGemmMC) + kGemmNC) * kGemmKC +
+                                    2 * static_cast<size_t>(kGemmMC) * kGemmNC)));
+    float* b_pack = a_pack + static_cast<size_t>(kGemmMC) * kGemmKC;
+    float* gate = b_pack + static_cast<size_t>(kGemmNC) * kGemmKC;
+    float* up = gate + static_cast<size_t>(kGemmMC) * kGemmNC;
+    for (int64_t block = block_begin; block < block_end; ++block) {
+      const int32_t ic = static_cast<int32_t>(block / n_blocks) * kGemmMC;
+      const int32_t jc = static_cast<int32_t>(block % n_blocks) * kGemmNC;
+      const int32_t mc = std::min(kGemmMC, m - ic);
+      const int32_t nc = std::min(kGemmNC, n - jc);
+      for (int32_t pc = 0; pc < k; pc += kGemmKC) {
+        const int32_t kc = std::min(kGemmKC, k - pc);
+        pack_panels<kGemmMR>(a + static_cast<int64_t>(ic) * k + pc, k, mc, kc, a_pack);
+        for (float* acc : {gate, up}) {
+          const PackedB b_panels = acc == gate ? pack_b1(jc, pc, nc, kc, b_pack)
+                                               : pack_b3(jc, pc, nc, kc, b_pack);
+          for (int32_t jr = 0; jr < nc; jr += kGemmNR) {
+            for (int32_t ir = 0; ir < mc; ir += kGemmMR) {
+              gemm_micro_kernel(kc, a_pack + static_cast<int64_t>(ir) * kc,
+                                b_panels.ptr + static_cast<int64_t>(jr) * b_panels.ld,
+                                acc + static_cast<int64_t>(ir) * kGemmNC + jr, kGemmNC,
+                                std::min(kGemmMR, mc - ir), std::min(kGemmNR, nc - jr), pc != 0);
+            }
+          }
+        }
+      }
+      for (int32_t i = 0; i < mc; ++i) {
+        const float* gate_row = gate + static_cast<int64_t>(i) * kGemmNC;
+        const float* up_row = up + static_cast<int64_t>(i) * kGemmNC;
+        float* c_row = c + static_cast<int64_t>(ic + i) * n + jc;
+        for (int32_t j = 0; j < nc; ++j) {
+          c_row[j] = silu(gate_row[j]) * up_row[j];
+        }
+      }
+    }
+  });
+}
+
+//单个token的decode是访存受限的GEMV，prompt这种多行输入才值得打包做GEMM
+template <base::DataType type>
+static void matmul(base::ThreadPool* pool, const float* in_ptr, const void* weight_ptr,
+                   float* out_ptr, int32_t m, int32_t n, int32_t k, int64_t ldc) {
+  const WeightT<type>* w = static_cast<const WeightT<type>*>(weight_ptr);
+  if (m == 1) {
+    gemv<type>(pool, in_ptr, w, out_ptr, n, k);
+  } else {
+    gemm<type>(pool, in_ptr, w, out_ptr, m, n, k, ldc);
+  }
+}
+
+static void matmul_dispatch(base::DataType type, base::ThreadPool* pool, const float* in_ptr,
+                            const void* weight_ptr, float* out_ptr, int32_t m, int32_t n,
+                            int32_t k, int64_t ldc) {
+  switch (type) {
+    case base::DataType::kDataTypeFp32:
+      matmul<base::DataType::kDataTypeFp32>(pool, in_ptr, weight_ptr, out_ptr, m, n, k, ldc);
+      break;
+    case base::DataType::kDataTypeFp16:
+      matmul<base::DataType::kDataTypeFp16>(pool, in_ptr, weight_ptr, out_ptr, m, n, k, ldc);
+      break;
+    case base::DataType::kDataTypeBf16:
+      matmul<base::DataType::kDataTypeBf16>(pool, in_ptr, weight_ptr, out_ptr, m, n, k, ldc);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported weight data type " << int(type) << " in the matmul kernel.";
+  }
+}
+
+static bool is_float_weight(base::DataType type) {
+  return type == base::DataType::kDataTypeFp32 || type == base::DataType::kDataTypeFp16 ||
+         type == base::DataType::kDataTypeBf16;
+}
+
+//int8权重的[row0, row0 + rows)行、[pc, pc + kc)列乘上各自组的scale，打包成[kc][NR]的panel
+static void pack_panels_qint8(const int8_t* w, const float* scales, int32_t k, int32_t group_size,
+                              int32_t row0, int32_t rows, int32_t pc, int32_t kc, float* packed) {
+  for (int32_t i0 = 0; i0 < rows; i0 += kGemmNR) {
+    float* panel = packed + static_cast<int64_t>(i0) * kc;
+    const int32_t valid = std::min(kGemmNR, rows - i0);
+    for (int32_t i = 0; i < kGemmNR; ++i) {
+      if (i >= valid) {
+        for (int32_t p = 0; p < kc; ++p) {
+          panel[p * kGemmNR + i] = 0.f;
+        }
+        continue;
+      }
+      const int64_t base = static_cast<int64_t>(row0 + i0 + i) * k + pc;
+      int32_t p = 0;
+      while (p < kc) {
+        const int64_t group = (base + p) / group_size;
+        const int32_t group_end =
+            static_cast<int32_t>(std::min<int64_t>(kc, (group + 1) * group_size - base));
+        const float scale = scales[group];
+        for (; p < group_end; ++p) {
+          panel[p * kGemmNR + i] = static_cast<float>(w[base + p]) * scale;
+        }
+      }
+    }
+  }
+}
+
+//int4权重的[row0, row0 + rows)行、[pc, pc + kc)列反量化之后打包成[kc][NR]的panel
+static void pack_panels_q4(const uint8_t* w, const uint16_t* scales, const uint16_t* mins,
+                           int32_t k, int32_t group_size, int32_t row0, int32_t rows, int32_t pc,
+                           int32_t kc, float* packed) {
+  for (int32_t i0 = 0; i0 < rows; i0 += kGemmNR) {
+    float* panel = packed + static_cast<int64_t>(i0) * kc;
+    const int32_t valid = std::min(kGemmNR, rows - i0);
+    for (int32_t i = 0; i < kGemmNR; ++i) {
+      if (i >= valid) {
+        for (int32_t p = 0; p < kc; ++p) {
+          panel[p * kGemmNR + i] = 0.f;
+        }
+        continue;
+      }
+      const int64_t base = static_cast<int64_t>(row0 + i0 + i) * k + pc;
+      int32_t p = 0;
+      while (p < kc) {
+        const int64_t group = (base + p) / group_size;
+        const int32_t group_end =
+            static_cast<int32_t>(std::min<int64_t>(kc, (group + 1) * group_size - base));
+        float scale = 0.f;
+        float min = 0.f;
+        q4_group_param(scales, mins, group, scale, min);
+        for (; p < group_end; ++p) {
+          panel[p * kGemmNR + i] = static_cast<float>(q4_at(w, base + p)) * scale + min;
+        }
+      }
+    }
+  }
+}
+
+//kLayoutPanel16的int8权重里一组占的字节数：16个fp32的scale，再加[group_size][16]的int8
+static inline int64_t qint8_panel_group_bytes(int32_t group_size) {
+  return static_cast<int64_t>(kPanelRows) * (sizeof(float) + group_size);
+}
+
+//tile[P][16] = P个相邻panel（间隔ld个float）分别乘x[k]。x的每个元素广播之后和16行一起乘，没有水平求和；
+//P个panel共用同一次广播，每次FMA的load和row-major的GEMV一样多
+template <int32_t P>
+static inline void gemv_panels(const float* panel, int64_t ld, const float* x, int32_t k,
+                               float* tile) {
+  //一个panel时在k方向展开，保证有4条独立的累加链
+  constexpr int32_t U = 4 / P;
+  int32_t p = 0;
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc[P][U];
+  for (int32_t j = 0; j < P; ++j) {
+    for (int32_t u = 0; u < U; ++u) {
+      acc[j][u] = _mm512_setzero_ps();
+    }
+  }
+  for (; p + U <= k; p += U) {
+    for (int32_t u = 0; u < U; ++u) {
+      const __m512 xv = _mm512_set1_ps(x[p + u]);
+      const float* w = panel + static_cast<int64_t>(p + u) * kPanelRows;
+      for (int32_t j = 0; j < P; ++j) {
+        acc[j][u] = _mm512_fmadd_ps(_mm512_loadu_ps(w + j * ld), xv, acc[j][u]);
+      }
+    }
+  }
+  for (; p < k; ++p) {
+    const __m512 xv = _mm512_set1_ps(x[p]);
+    const float* w = panel + static_cast<int64_t>(p) * kPanelRows;
+    for (int32_t j = 0; j < P; ++j) {
+      acc[j][0] = _mm512_fmadd_ps(_mm512_loadu_ps(w + j * ld), xv, acc[j][0]);
+    }
+  }
+  for (int32_t j = 0; j < P; ++j) {
+    for (int32_t u = 1; u < U; ++u) {
+      acc[j][0] = _mm512_add_ps(acc[j][0], acc[j][u]);
+    }
+    _mm512_storeu_ps(tile + j * kPanelRows, acc[j][0]);
+  }
+#elif defined(KUIPER_USE_AVX2)
+  __m256 acc[P][U][2];
+  for (int32_t j = 0; j < P; ++j) {
+    for (int32_t u = 0; u < U; ++u) {
+      acc[j][u][0] = _mm256_setzero_ps();
+      acc[j][u][1] = _mm256_setzero_ps();
+    }
+  }
+  for (; p + U <= k; p += U) {
+    for (int32_t u = 0; u < U; ++u) {
+      const __m256 xv = _mm256_broadcast_ss(x + p + u);
+      const float* w = panel + static_cast<int64_t>(p + u) * kPanelRows;
+      for (int32_t j = 0; j < P; ++j) {
+        acc[j][u][0] = _mm256_fmadd_ps(_mm256_loadu_ps(w + j * ld), xv, acc[j][u][0]);
+        acc[j][u][1] = _mm256_fmadd_ps(_mm256_loadu_ps(w + j * ld + 8), xv, acc[j][u][1]);
+      }
+    }
+  }
+  for (; p < k; ++p) {
+    const __m256 xv = _mm256_broadcast_ss(x + p);
+    const float* w = panel + static_cast<int64_t>(p) * kPanelRows;
+    for (int32_t j = 0; j < P; ++j) {
+      acc[j][0][0] = _mm256_fmadd_ps(_mm256_loadu_ps(w + j * ld), xv, acc[j][0][0]);
+      acc[j][0][1] = _mm256_fmadd_ps(_mm256_loadu_ps(w + j * ld + 8), xv, acc[j][0][1]);
+    }
+  }
+  for (int32_t j = 0; j < P; ++j) {
+    for (int32_t u = 1; u < U; ++u) {
+      acc[j][0][0] = _mm256_add_ps(acc[j][0][0], acc[j][u][0]);
+      acc[j][0][1] = _mm256_add_ps(acc[j][0][1], acc[j][u][1]);
+    }
+    _mm256_storeu_ps(tile + j * kPanelRows, acc[j][0][0]);
+    _mm256_storeu_ps(tile + j * kPanelRows + 8, acc[j][0][1]);
+  }
+#else
+  for (int32_t i = 0; i < P * kPanelRows; ++i) {
+    tile[i] = 0.f;
+  }
+  for (; p < k; ++p) {
+    for (int32_t j = 0; j < P; ++j) {
+      const float* w = panel + j * ld + static_cast<int64_t>(p) * kPanelRows;
+      for (int32_t i = 0; i < kPanelRows; ++i) {
+        tile[j * kPanelRows + i] += w[i] * x[p];
+      }
+    }
+  }
+#endif
+}
+
+//int8的panel和x相乘：每组的sum(q * x)留在寄存器里，乘上这一组16行各自的scale之后累加到结果上
+static inline void qint8_gemv_panel(const int8_t* panel, const float* x, int32_t k,
+                                    int32_t group_size, float* y, int32_t valid) {
+  const int64_t group_bytes = qint8_panel_group_bytes(group_size);
+  const int32_t group_num = k / group_size;
+  alignas(64) float tile[kPanelRows];
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc = _mm512_setzero_ps();
+#elif defined(KUIPER_USE_AVX2)
+  __m256 acc_lo = _mm256_setzero_ps(), acc_hi = _mm256_setzero_ps();
+#else
+  for (int32_t i = 0; i < kPanelRows; ++i) {
+    tile[i] = 0.f;
+  }
+#endif
+  for (int32_t g = 0; g < group_num; ++g) {
+    const int8_t* group = panel + g * group_bytes;
+    const float* scales = reinterpret_cast<const float*>(group);
+    const int8_t* q = group + kPanelRows * sizeof(float);
+    const float* xg = x + static_cast<int64_t>(g) * group_size;
+    int32_t p = 0;
+#if defined(KUIPER_USE_AVX512)
+    __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+    for (; p + 2 <= group_size; p += 2) {
+      const __m128i q0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + p * kPanelRows));
+      const __m128i q1 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + (p + 1) * kPanelRows));
+      a0 = _mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(q0)), _mm512_set1_ps(xg[p]),
+                           a0);
+      a1 = _mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(q1)),
+                           _mm512_set1_ps(xg[p + 1]), a1);
+    }
+    if (p < group_size) {
+      const __m128i q0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + p * kPanelRows));
+      a0 = _mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(q0)), _mm512_set1_ps(xg[p]),
+                           a0);
+    }
+    acc = _mm512_fmadd_ps(_mm512_add_ps(a0, a1), _mm512_loadu_ps(scales), acc);
+#elif defined(KUIPER_USE_AVX2)
+    __m256 lo = _mm256_setzero_ps(), hi = _mm256_setzero_ps();
+    for (; p < group_size; ++p) {
+      const int8_t* qp = q + p * kPanelRows;
+      const __m256 xv = _mm256_broadcast_ss(xg + p);
+      const __m128i q_lo = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(qp));
+      const __m128i q_hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(qp + 8));
+      lo = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q_lo)), xv, lo);
+      hi = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q_hi)), xv, hi);
+    }
+    acc_lo = _mm256_fmadd_ps(lo, _mm256_loadu_ps(scales), acc_lo);
+    acc_hi = _mm256_fmadd_ps(hi, _mm256_loadu_ps(scales + 8), acc_hi);
+#else
+    float part[kPanelRows] = {};
+    for (; p < group_size; ++p) {
+      for (int32_t i = 0; i < kPanelRows; ++i) {
+        part[i] += static_cast<float>(q[p * kPanelRows + i]) * xg[p];
+      }
+    }
+    for (int32_t i = 0; i < kPanelRows; ++i) {
+      tile[i] += part[i] * scales[i];
+    }
+#endif
+  }
+#if defined(KUIPER_USE_AVX512)
+  _mm512_store_ps(tile, acc);
+#elif defined(KUIPER_USE_AVX2)
+  _mm256_store_ps(tile, acc_lo);
+  _mm256_store_ps(tile + 8, acc_hi);
+#endif
+  for (int32_t i = 0; i < valid; ++i) {
+    y[i] = tile[i];
+  }
+}
+
+//打包过的int8权重的[jc, jc + nc)行、[pc, pc + kc)列反量化成[kc][NR]的panel，jc是NR的倍数
+static void unpack_panels_qint8(const int8_t* w, int32_t k, int32_t group_size, int32_t jc,
+                                int32_t nc, int32_t pc, int32_t kc, float* packed) {
+  const int64_t group_bytes = qint8_panel_group_bytes(group_size);
+  const int64_t panel_bytes = k / group_size * group_bytes;
+  for (int32_t i0 = 0; i0 < nc; i0 += kPanelRows) {
+    const int8_t* src = w + (jc + i0) / kPanelRows * panel_bytes;
+    float* panel = packed + static_cast<int64_t>(i0) * kc;
+    for (int32_t p = 0; p < kc; ++p) {
+      const int32_t col = pc + p;
+      const int8_t* group = src + col / group_size * group_bytes;
+      const float* scales = reinterpret_cast<const float*>(group);
+      const int8_t* q = group + kPanelRows * sizeof(float) + col % group_size * kPanelRows;
+      for (int32_t i = 0; i < kPanelRows; ++i) {
+        panel[p * kPanelRows + i] = static_cast<float>(q[i]) * scales[i];
+      }
+    }
+  }
+}
+
+//int8权重从row开始的rows行打包成一个panel，布局见packed_weight_byte_size，不足16行的scale和权重补0
+static void pack_panel_qint8(const int8_t* w, const float* scales, int32_t k, int32_t group_size,
+                             int32_t row, int32_t rows, int8_t* panel) {
+  const int32_t group_num = k / group_size;
+  const int64_t group_bytes = qint8_panel_group_bytes(group_size);
+  for (int32_t g = 0; g < group_num; ++g) {
+    int8_t* group = panel + g * group_bytes;
+    float* group_scales = reinterpret_cast<float*>(group);
+    int8_t* q = group + kPanelRows * sizeof(float);
+    for (int32_t i = 0; i < kPanelRows; ++i) {
+      const bool valid = i < rows;
+      const int64_t row_offset = static_cast<int64_t>(row + i) * k + g * group_size;
+      group_scales[i] = valid ? scales[static_cast<int64_t>(row + i) * group_num + g] : 0.f;
+      for (int32_t p = 0; p < group_size; ++p) {
+        q[p * kPanelRows + i] = valid ? w[row_offset + p] : 0;
+      }
+    }
+  }
+}
+
+size_t packed_weight_byte_size(base::DataType data_type, int32_t dim0, int32_t dim1,
+                               int32_t group_size) {
+  if (dim0 <= 0 || dim1 <= 0) {
+    return 0;
+  }
+  const size_t panels = (dim0 + kPanelRows - 1) / kPanelRows;
+  if (data_type == base::DataType::kDataTypeFp32) {
+    return panels * kPanelRows * dim1 * sizeof(float);
+  }
+  if (data_type == base::DataType::kDataTypeInt8 && group_size > 0 && dim1 % group_size == 0) {
+    return panels * (dim1 / group_size) * qint8_panel_group_bytes(group_size);
+  }
+  return 0;
+}
+
+void pack_weight_cpu(const tensor::Tensor& weight, const tensor::Tensor& scale, int32_t group_size,
+                     void* dst, void* stream) {
+  CHECK(!weight.is_empty() && weight.device_type() == base::DeviceType::kDeviceCPU);
+  CHECK(weight.layout() == base::TensorLayout::kLayoutRowMajor && weight.is_contiguous());
+  CHECK_EQ(weight.dims_size(), 2);
+  CHECK(dst != nullptr);
+  const base::DataType type = weight.data_type();
+  const int32_t n = weight.get_dim(0);
+  const int32_t k = weight.get_dim(1);
+  CHECK_GT(packed_weight_byte_size(type, n, k, group_size), 0);
+  if (type == base::DataType::kDataTypeInt8) {
+    CHECK(scale.data_type() == base::DataType::kDataTypeFp32);
+    CHECK_EQ(scale.size() * group_size, weight.size());
+  }
+
+  const int32_t panels = (n + kPanelRows - 1) / kPanelRows;
+  const int64_t qint8_panel_bytes =
+      type == base::DataType::kDataTypeInt8 ? k / group_size * qint8_panel_group_bytes(group_size)
+                                            : 0;
+  get_thread_pool(stream)->parallel_for(0, panels, 1, [&](int64_t begin, int64_t end, int32_t) {
+    for (int64_t i = begin; i < end; ++i) {
+      const int32_t row = static_cast<int32_t>(i) * kPanelRows;
+      const int32_t rows = std::min(kPanelRows, n - row);
+      if (type == base::DataType::kDataTypeFp32) {
+        pack_panels<kPanelRows>(weight.ptr<float>() + static_cast<int64_t>(row) * k, k, rows, k,
+                                static_cast<float*>(dst) + static_cast<int64_t>(row) * k);
+      } else {
+        pack_panel_qint8(weight.ptr<int8_t>(), scale.ptr<float>(), k, group_size, row, rows,
+                         static_cast<int8_t*>(dst) + i * qint8_panel_bytes);
+      }
+    }
+  });
+}
+
+//kLayoutPanel16的fp32权重：单行输入按panel做GEMV，多行输入的GEMM直接读panel
+static void matmul_packed(base::ThreadPool* pool, const float* in_ptr, const float* w,
+                          float* out_ptr, int32_t m, int32_t n, int32_t k) {
+  if (m > 1) {
+    gemm_blocked(pool, in_ptr, out_ptr, m, n, k, n,
+                 [&](int32_t jc, int32_t pc, int32_t, int32_t, float*) {
+                   return PackedB{w + static_cast<int64_t>(jc) * k +
+                                      static_cast<int64_t>(pc) * kPanelRows,
+                                  k};
+                 });
+    return;
+  }
+  //完整的4个panel一起算，最后不足4个的逐个算
+  const int32_t panels = (n + kPanelRows - 1) / kPanelRows;
+  const int32_t tiles = (panels + kPanelGemvTile - 1) / kPanelGemvTile;
+  const int64_t ld = static_cast<int64_t>(kPanelRows) * k;
+  pool->parallel_for(0, tiles, 1, [&](int64_t tile_begin, int64_t tile_end, int32_t) {
+    alignas(64) float tile[kPanelGemvTile * kPanelRows];
+    for (int64_t t = tile_begin; t < tile_end; ++t) {
+      const int32_t panel_begin = static_cast<int32_t>(t) * kPanelGemvTile;
+      const int32_t panel_num = std::min(kPanelGemvTile, panels - panel_begin);
+      const int32_t row = panel_begin * kPanelRows;
+      if (panel_num == kPanelGemvTile) {
+        gemv_panels<kPanelGemvTile>(w + row * static_cast<int64_t>(k), ld, in_ptr, k, tile);
+      } else {
+        for (int32_t j = 0; j < panel_num; ++j) {
+          gemv_panels<1>(w + (row + j * kPanelRows) * static_cast<int64_t>(k), ld, in_ptr, k,
+                         tile + j * kPanelRows);
+        }
+      }
+      std::copy(tile, tile + std::min(panel_num * kPanelRows, n - row), out_ptr + row);
+    }
+  });
+}
+
+//kLayoutPanel16的int8权重：行数多时反量化成GEMM的panel，否则每个panel依次和M个输入相乘
+static void matmul_packed_qint8(base::ThreadPool* pool, const float* in_ptr, const int8_t* w,
+                                float* out_ptr, int32_t m, int32_t n, int32_t k,
+                                int32_t group_size) {
+  if (m >= kQInt8GemmMinRows) {
+    gemm_blocked(pool, in_ptr, out_ptr, m, n, k, n,
+                 [&](int32_t jc, int32_t pc, int32_t nc, int32_t kc, float* b_pack) {
+                   unpack_panels_qint8(w, k, group_size, jc, nc, pc, kc, b_pack);
+                   return PackedB{b_pack, kc};
+                 });
+    return;
+  }
+  const int64_t panel_bytes = k / group_size * qint8_panel_group_bytes(group_size);
+  const int32_t panels = (n + kPanelRows - 1) / kPanelRows;
+  pool->parallel_for(0, panels, kPanelGrain, [&](int64_t begin, int64_t end, int32_t) {
+    for (int64_t i = begin; i < end; ++i) {
+      const int32_t row = static_cast<int32_t>(i) * kPanelRows;
+      //panel只有k * 16字节出头，留在L2里给M个输入共用
+      for (int32_t r = 0; r < m; ++r) {
+        qint8_gemv_panel(w + i * panel_bytes, in_ptr + static_cast<int64_t>(r) * k, k,
+                         group_size, out_ptr + static_cast<int64_t>(r) * n + row,
+                         std::min(kPanelRows, n - row));
+      }
+    }
+  });
+}
+
+void matmul_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& weight,
+                       const tensor::Tensor& output, void* stream) {
+  CHECK(!input.is_empty() && !weight.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && weight.is_contiguous() && output.is_contiguous());
+  CHECK(input.device_type() == base::DeviceType::kDeviceCPU &&
+        weight.device_type() == base::DeviceType::kDeviceCPU &&
+        output.device_type() == base::DeviceType::kDeviceCPU);
+  CHECK(is_float_weight(weight.data_type()));
+  CHECK_EQ(weight.dims_size(), 2);
+
+  const int32_t n = weight.get_dim(0);
+  const int32_t k = weight.get_dim(1);
+  const int32_t m = static_cast<int32_t>(input.size() / k);
+  CHECK_EQ(input.size(), static_cast<size_t>(m) * k);
+  CHECK_EQ(output.size(), static_cast<size_t>(m) * n);
+
+  const float* in_ptr = input.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+  if (weight.layout() == base::TensorLayout::kLayoutPanel16) {
+    CHECK(weight.data_type() == base::DataType::kDataTypeFp32);
+    matmul_packed(get_thread_pool(stream), in_ptr, weight.ptr<float>(), out_ptr, m, n, k);
+    return;
+  }
+  matmul_dispatch(weight.data_type(), get_thread_pool(stream), in_ptr, weight.ptr<void>(), out_ptr,
+                  m, n, k, n);
+}
+
+void matmul_kernel_cpu_qint8(const tensor::Tensor& input, const tensor::Tensor& weight,
+                             const tensor::Tensor& output, int32_t group_size,
+                             const tensor::Tensor& scale, void* stream) {
+  CHECK(!input.is_empty() && !weight.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && weight.is_contiguous() && output.is_contiguous());
+  CHECK(input.device_type() == base::DeviceType::kDeviceCPU &&
+        weight.device_type() == base::DeviceType::kDeviceCPU &&
+        output.device_type() == base::DeviceType::kDeviceCPU);
+  CHECK(weight.data_type() == base::DataType::kDataTypeInt8);
+  CHECK_EQ(weight.dims_size(), 2);
+  CHECK_GT(group_size, 0);
+
+  const int32_t dim0 = weight.get_dim(0);
+  const int32_t dim1 = weight.get_dim(1);
+  //input可以是[dim1]，也可以是堆叠起来的[M, dim1]
+  const int32_t m = static_cast<int32_t>(input.size() / dim1);
+  CHECK_EQ(input.size(), static_cast<size_t>(m) * dim1);
+  CHECK_EQ(output.size(), static_cast<size_t>(m) * dim0);
+  CHECK_EQ(scale.size() * group_size, weight.size());
+
+  const float* in_ptr = input.ptr<float>();
+  const int8_t* weight_ptr = weight.ptr<int8_t>();
+  const float* scale_ptr = scale.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+  if (weight.layout() == base::TensorLayout::kLayoutPanel16) {
+    CHECK_EQ(dim1 % group_size, 0);
+    matmul_packed_qint8(get_thread_pool(stream), in_ptr, weight_ptr, out_ptr, m, dim0, dim1,
+                        group_size);
+    return;
+  }
+
+  //prompt这种行数多的输入是计算受限的，权重按panel反量化之后走和fp32一样的GEMM；
+  //decode和小batch仍然直接在int8上做点积，每个权重只读一个字节
+  if (m >= kQInt8GemmMinRows) {
+    gemm_blocked(get_thread_pool(stream), in_ptr, out_ptr, m, dim0, dim1, dim0,
+                 [&](int32_t jc, int32_t pc, int32_t nc, int32_t kc, float* b_pack) {
+                   pack_panels_qint8(weight_ptr, scale_ptr, dim1, group_size, jc, nc, pc, kc,
+                                     b_pack);
+                   return PackedB{b_pack, kc};
+                 });
+    return;
+  }
+  get_thread_pool(stream)->parallel_for(
+      0, dim0, kQInt8RowGrain, [&](int64_t row_begin, int64_t row_end, int32_t) {
+        qint8_rows(in_ptr, m, weight_ptr, scale_ptr, dim1, group_size,
+                   static_cast<int32_t>(row_begin), static_cast<int32_t>(row_end), out_ptr, dim0);
+      });
+}
+
+void matmul_kernel_cpu_q4(const tensor::Tensor& input, const tensor::Tensor& weight,
+                          const tensor::Tensor& output, int32_t group_size,
+                          const tensor::Tensor& scale, const tensor::Tensor& min, void* stream) {
+  CHECK(!input.is_empty() && !weight.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && weight.is_contiguous() && output.is_contiguous());
+  CHECK(input.device_type() == base::DeviceType::kDeviceCPU &&
+        weight.device_type() == base::DeviceType::kDeviceCPU &&
+        output.device_type() == base::DeviceType::kDeviceCPU);
+  CHECK(weight.data_type() == base::DataType::kDataTypeInt4);
+  CHECK(scale.data_type() == base::DataType::kDataTypeFp16);
+  CHECK_EQ(weight.dims_size(), 2);
+  CHECK(group_size > 0 && group_size % 32 == 0);
+
+  const int32_t dim0 = weight.get_dim(0);
+  const int32_t dim1 = weight.get_dim(1);
+  CHECK_EQ(dim1 % group_size, 0);
+  const int32_t m = static_cast<int32_t>(input.size() / dim1);
+  CHECK_EQ(input.size(), static_cast<size_t>(m) * dim1);
+  CHECK_EQ(output.size(), static_cast<size_t>(m) * dim0);
+  CHECK_EQ(scale.size() * group_size, weight.size());
+  if (!min.is_empty()) {
+    CHECK(min.data_type() == base::DataType::kDataTypeFp16);
+    CHECK_EQ(min.size(), scale.size());
+  }
+
+  const float* in_ptr = input.ptr<float>();
+  const uint8_t* weight_ptr = weight.ptr<uint8_t>();
+  const uint16_t* scale_ptr = scale.ptr<uint16_t>();
+  const uint16_t* min_ptr = min.is_empty() ? nullptr : min.ptr<uint16_t>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+  if (m >= kQInt8GemmMinRows) {
+    gemm_blocked(get_thread_pool(stream), in_ptr, out_ptr, m, dim0, dim1, dim0,
+                 [&](int32_t jc, int32_t pc, int32_t nc, int32_t kc, float* b_pack) {
+                   pack_panels_q4(weight_ptr, scale_ptr, min_ptr, dim1, group_size, jc, nc, pc,
+                                  kc, b_pack);
+                   return PackedB{b_pack, kc};
+                 });
+    return;
+  }
+  base::ThreadPool* pool = get_thread_pool(stream);
+  const size_t xsum_bytes = sizeof(float) * m * (dim1 / group_size);
+  pool->parallel_for(0, dim0, kQInt4RowGrain, [&](int64_t row_begin, int64_t row_end,
+                                                   int32_t worker_id) {
+    float* xsum = static_cast<float*>(pool->scratch(worker_id, xsum_bytes));
+    q4_rows(in_ptr, m, weight_ptr, scale_ptr, min_ptr, dim1, group_size,
+            static_cast<int32_t>(row_begin), static_cast<int32_t>(row_end), out_ptr, dim0, xsum);
+  });
+}
+
+//线程池按NUMA节点分组并绑了核时，每组worker处理本节点的那一段权重，func(node, rank, group_size)，
+//调用线程（worker 0）这时不分任务
+//否则按worker编号连续地分组，worker数比节点数少时每个worker轮流处理几段
+template <typename F>
+static void for_each_numa_node(base::ThreadPool* pool, int32_t node_num, F&& func) {
+  const int32_t nthreads = pool->thread_num();
+  pool->run([&](int32_t worker_id) {
+    if (pool->node_num() == node_num) {
+      //没有绑核的调用线程不参与，免得它跨节点去读别的节点上的权重
+      const int32_t node = pool->worker_node(worker_id);
+      if (node >= 0) {
+        func(node, pool->node_rank(worker_id), pool->node_worker_num(node));
+      }
+    } else if (nthreads >= node_num) {
+      const int32_t node = worker_id * node_num / nthreads;
+      const int32_t first = (node * nthreads + node_num - 1) / node_num;
+      const int32_t last = ((node + 1) * nthreads + node_num - 1) / node_num;
+      func(node, worker_id - first, last - first);
+    } else {
+      for (int32_t node = worker_id; node < node_num; node += nthreads) {
+        func(node, 0, 1);
+      }
+    }
+  });
+}
+
+static std::vector<int32_t> numa_row_offsets(const std::vector<tensor::Tensor>& weights,
+                                             int32_t dim1) {
+  std::vector<int32_t> offsets(weights.size() + 1, 0);
+  for (size_t i = 0; i < weights.size(); ++i) {
+    CHECK(!weights[i].is_empty() && weights[i].device_type() == base::DeviceType::kDeviceCPU);
+    CHECK(weights[i].layout() == base::TensorLayout::kLayoutRowMajor &&
+          weights[i].is_contiguous());
+    CHECK_EQ(weights[i].dims_size(), 2);
+    CHECK_EQ(weights[i].get_dim(1), dim1);
+    offsets[i + 1] = offsets[i] + weights[i].get_dim(0);
+  }
+  return offsets;
+}
+
+void matmul_kernel_cpu_numa(const tensor::Tensor& input, const std::vector<tensor::Tensor>& weights,
+                            const tensor::Tensor& output, void* stream) {
+  CHECK(!input.is_empty() && !output.is_empty() && !weights.empty());
+  CHECK(input.is_contiguous() && output.is_contiguous());
+  const base::DataType type = weights.front().data_type();
+  CHECK(is_float_weight(type));
+  const int32_t node_num = static_cast<int32_t>(weights.size());
+  const int32_t k = weights.front().get_dim(1);
+  const std::vector<int32_t> row_offsets = numa_row_offsets(weights, k);
+  const int32_t n = row_offsets.back();
+  const int32_t m = static_cast<int32_t>(input.size() / k);
+  CHECK_EQ(input.size(), static_cast<size_t>(m) * k);
+  CHECK_EQ(output.size(), static_cast<size_t>(m) * n);
+
+  const float* in_ptr = input.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+  base::ThreadPool* pool = get_thread_pool(stream);
+  if (m == 1) {
+    for_each_numa_node(pool, node_num, [&](int32_t node, int32_t rank, int32_t group_size) {
+      const tensor::Tensor& weight = weights[node];
+      const auto [row_begin, row_end] = split_rows(weight.get_dim(0), group_size, rank);
+      float* y = out_ptr + row_offsets[node];
+      if (type == base::DataType::kDataTypeFp16) {
+        gemv_rows<base::DataType::kDataTypeFp16>(in_ptr, weight.ptr<uint16_t>(), y, row_begin,
+                                                 row_end, k);
+      } else if (type == base::DataType::kDataTypeBf16) {
+        gemv_rows<base::DataType::kDataTypeBf16>(in_ptr, weight.ptr<uint16_t>(), y, row_begin,
+                                                 row_end, k);
+      } else {
+        gemv_rows<base::DataType::kDataTypeFp32>(in_ptr, weight.ptr<float>(), y, row_begin,
+                                                 row_end, k);
+      }
+    });
+  } else {
+    //多行输入的GEMM是计算受限的，跨节点读权重的代价被打包之后的复用摊薄了，各段依次交给所有线程
+    for (int32_t node = 0; node < node_num; ++node) {
+      matmul_dispatch(type, pool, in_ptr, weights[node].ptr<void>(), out_ptr + row_offsets[node],
+                      m, weights[node].get_dim(0), k, n);
+    }
+  }
+}
+
+void matmul_kernel_cpu_qint8_numa(const tensor::Tensor& input,
+                                  const std::vector<tensor::Tensor>& weights,
+                                  const tensor::Tensor& output, int32_t group_size,
+                                  const std::vector<tensor::Tensor>& scales, void* stream) {
+  CHECK(!input.is_empty() && !output.is_empty() && !weights.empty());
+  CHECK(input.is_contiguous() && output.is_contiguous());
+  CHECK_EQ(weights.size(), scales.size());
+  CHECK(weights.front().data_type() == base::DataType::kDataTypeInt8);
+  CHECK_GT(group_size, 0);
+  const int32_t node_num = static_cast<int32_t>(weights.size());
+  const int32_t dim1 = weights.front().get_dim(1);
+  const std::vector<int32_t> row_offsets = numa_row_offsets(weights, dim1);
+  const int32_t dim0 = row_offsets.back();
+  const int32_t m = static_cast<int32_t>(input.size() / dim1);
+  CHECK_EQ(input.size(), static_cast<size_t>(m) * dim1);
+  CHECK_EQ(output.size(), static_cast<size_t>(m) * dim0);
+  for (int32_t node = 0; node < node_num; ++node) {
+    CHECK_EQ(scales[node].size() * group_size, weights[node].size());
+  }
+
+  const float* in_ptr = input.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+  base::ThreadPool* pool = get_thread_pool(stream);
+  for_each_numa_node(pool, node_num, [&](int32_t node, int32_t rank, int32_t group_num) {
+    const tensor::Tensor& weight = weights[node];
+    const auto [row_begin, row_end] = split_rows(weight.get_dim(0), group_num, rank);
+    qint8_rows(in_ptr, m, weight.ptr<int8_t>(), scales[node].ptr<float>(), dim1, group_size,
+               row_begin, row_end, out_ptr + row_offsets[node], dim0);
+  });
+}
+
+static void check_swiglu_gemm_shapes(const tensor::Tensor& input, const tensor::Tensor& w1,
+                                     const tensor::Tensor& w3, const tensor::Tensor& output,
+                                     int32_t* m, int32_t* n, int32_t* k) {
+  CHECK(!input.is_empty() && !w1.is_empty() && !w3.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && w1.is_contiguous() && w3.is_contiguous() &&
+        output.is_contiguous());
+  CHECK(input.device_type() == base::DeviceType::kDeviceCPU &&
+        w1.device_type() == base::DeviceType::kDeviceCPU &&
+        w3.device_type() == base::DeviceType::kDeviceCPU &&
+        output.device_type() == base::DeviceType::kDeviceCPU);
+  CHECK_EQ(w1.dims_size(), 2);
+  CHECK(w1.dims() == w3.dims() && w1.data_type() == w3.data_type());
+  CHECK(w1.layout() == base::TensorLayout::kLayoutRowMajor &&
+        w3.layout() == base::TensorLayout::kLayoutRowMajor);
+  *n = w1.get_dim(0);
+  *k = w1.get_dim(1);
+  *m = static_cast<int32_t>(input.size() / *k);
+  CHECK_EQ(input.size(), static_cast<size_t>(*m) * *k);
+  CHECK_EQ(output.size(), static_cast<size_t>(*m) * *n);
+}
+
+void swiglu_gemm_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& w1,
+                            const tensor::Tensor& w3, const tensor::Tensor& output,
+                            void* stream) {
+  int32_t m = 0, n = 0, k = 0;
+  check_swiglu_gemm_shapes(input, w1, w3, output, &m, &n, &k);
+  CHECK(w1.data_type() == base::DataType::kDataTypeFp32);
+  const float* w1_ptr = w1.ptr<float>();
+  const float* w3_ptr = w3.ptr<float>();
+  auto pack_b = [k](const float* w) {
+    return [w, k](int32_t jc, int32_t pc, int32_t nc, int32_t kc, float* b_pack) {
+      pack_panels<kGemmNR>(w + static_cast<int64_t>(jc) * k + pc, k, nc, kc, b_pack);
+      return PackedB{b_pack, kc};
+    };
+  };
+  gemm_swiglu_blocked(get_thread_pool(stream), input.ptr<float>(),
+                      const_cast<float*>(output.ptr<float>()), m, n, k, pack_b(w1_ptr),
+                      pack_b(w3_ptr));
+}
+
+void swiglu_gemm_kernel_cpu_qint8(const tensor::Tensor& input, const tensor::Tensor& w1,
+                                  const tensor::Tensor& w3, int32_t group_size,
+                                  const tensor::Tensor& scale1, const tensor::Tensor& scale3,
+                                  const tensor::Tensor& output, void* stream) {
+  int32_t m = 0, n = 0, k = 0;
+  check_swiglu_gemm_shapes(input, w1, w3, output, &m, &n, &k);
+  CHECK(w1.data_type() == base::DataType::kDataTypeInt8);
+  CHECK_GT(group_size, 0);
+  CHECK_EQ(scale1.size() * group_size, w1.size());
+  CHECK_EQ(scale3.size() * group_size, w3.size());
+  auto pack_b = [k, group_size](const int8_t* w, const float* scales) {
+    return [w, scales, k, group_size](int32_t jc, int32_t pc, int32_t nc, int32_t kc,
+                                      float* b_pack) {
+      pack_panels_qint8(w, scales, k, group_size, jc, nc, pc, kc, b_pack);
+      return PackedB{b_pack, kc};
+    };
+  };
+  gemm_swiglu_blocked(get_thread_pool(stream), input.ptr<float>(),
+                      const_cast<float*>(output.ptr<float>()), m, n, k,
+                      pack_b(w1.ptr<int8_t>(), scale1.ptr<float>()),
+                      pack_b(w3.ptr<int8_t>(), scale3.ptr<float>()));
+}
+}  // namespace kernel
@@ -0,0 +1,68 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_MATMUL_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_MATMUL_KERNEL_H_
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief fp32矩阵乘 output[M, N] = input[M, K] * weight[N, K]^T，input是一维的时候M = 1
+//M == 1走按输出行切分到各线程的寄存器分块GEMV，M > 1走打包后的分块GEMM。
+//weight是kLayoutPanel16时GEMV按panel一次算16行，GEMM直接读panel，不用每次重新打包B。
+void matmul_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& weight,
+                       const tensor::Tensor& output, void* stream = nullptr);
+
+/// @brief int8分组量化权重的矩阵向量乘，output[i] = sum_k weight[i][k] * scale[g] * input[k]
+//weight是[dim0, dim1]的int8，按行展平之后每group_size个元素共用一个scale。
+//计算直接在int8上做，每组先在寄存器里累加，最后乘一次scale，不会把整个矩阵反量化成fp32。
+//weight是kLayoutPanel16时scale已经交错在weight里，参数scale不再使用。
+void matmul_kernel_cpu_qint8(const tensor::Tensor& input, const tensor::Tensor& weight,
+                             const tensor::Tensor& output, int32_t group_size,
+                             const tensor::Tensor& scale, void* stream = nullptr);
+
+/// @brief int4分组量化权重的矩阵乘，weight是[dim0, dim1]的kDataTypeInt4，每group_size个一组，
+//每组一个fp16的scale；min不为空时每组还有一个fp16的min，w = q * scale + min，
+//否则是对称量化w = (q - 8) * scale。group_size必须是32的倍数并且整除dim1。
+//decode时每组的4位数在寄存器里拆开、反量化之后和input做fp32的点积，多行输入走反量化打包的GEMM。
+void matmul_kernel_cpu_q4(const tensor::Tensor& input, const tensor::Tensor& weight,
+                          const tensor::Tensor& output, int32_t group_size,
+                          const tensor::Tensor& scale, const tensor::Tensor& min,
+                          void* stream = nullptr);
+
+/// @brief 多行输入的融合SwiGLU，output[M, N] = silu(input * w1^T) * (input * w3^T)
+//和matmul_kernel_cpu是同一套分块和micro kernel，A每段只打包一次给w1、w3共用，
+//gate和up的累加块留在线程的scratch里，silu和乘法在写出之前做完，不写出两个[M, N]的中间结果。
+//w1、w3是行主序的fp32。
+void swiglu_gemm_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& w1,
+                            const tensor::Tensor& w3, const tensor::Tensor& output,
+                            void* stream = nullptr);
+
+/// @brief 同上，w1、w3是int8分组量化的权重，打包B的时候按scale1、scale3反量化
+void swiglu_gemm_kernel_cpu_qint8(const tensor::Tensor& input, const tensor::Tensor& w1,
+                                  const tensor::Tensor& w3, int32_t group_size,
+                                  const tensor::Tensor& scale1, const tensor::Tensor& scale3,
+                                  const tensor::Tensor& output, void* stream = nullptr);
+
+/// @brief weight打包成kLayoutPanel16之后的字节数，不支持打包的类型或形状返回0。
+//fp32：每16行一个panel，panel内是[dim1][16]，和GEMM micro kernel读B的顺序一致，GEMV一次算出16行；
+//int8：每个panel按组存放，每组先是16行各自的fp32 scale，再是[group_size][16]的int8，
+//要求dim1是group_size的整数倍，这样一组不会跨行。
+size_t packed_weight_byte_size(base::DataType data_type, int32_t dim0, int32_t dim1,
+                               int32_t group_size);
+
+/// @brief 把行主序的weight（int8时加上scale）打包进dst，dst至少有packed_weight_byte_size字节，
+//打包按panel分给线程池。打包之后的tensor可以直接交给matmul_kernel_cpu和matmul_kernel_cpu_qint8。
+void pack_weight_cpu(const tensor::Tensor& weight, const tensor::Tensor& scale, int32_t group_size,
+                     void* dst, void* stream = nullptr);
+
+/// @brief 按NUMA节点切分好的fp32权重做矩阵乘
+//weights[i]是放在第i个节点本地内存上的一段连续输出行，按顺序拼起来就是完整的[N, K]。
+//M == 1时每个节点上的一组线程只读本节点的那一段权重。
+void matmul_kernel_cpu_numa(const tensor::Tensor& input, const std::vector<tensor::Tensor>& weights,
+                            const tensor::Tensor& output, void* stream = nullptr);
+
+/// @brief 按NUMA节点切分好的int8权重做矩阵乘，scales[i]是weights[i]对应的那一段scale
+//每一段的起点都必须落在量化组的边界上。
+void matmul_kernel_cpu_qint8_numa(const tensor::Tensor& input,
+                                  const std::vector<tensor::Tensor>& weights,
+                                  const tensor::Tensor& output, int32_t group_size,
+                                  const std::vector<tensor::Tensor>& scales,
+                                  void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_MATMUL_KERNEL_H_
@@ -0,0 +1,196 @@
+#include "mha_kernel.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "parallel.h"
+#include "simd.h"
+namespace kernel {
+//一块64个位置，head_size为128时key块是32KB，和这个头的输出一起留在L1/L2里
+constexpr int32_t kMHATileSize = 64;
+//prefill时一个任务处理的query行数，这些行轮流用同一块key/value
+constexpr int32_t kMHAQueryTile = 8;
+
+/// @brief x[i] *= alpha
+static inline void scale_ps(float alpha, float* x, int32_t len) {
+  int32_t k = 0;
+#if defined(KUIPER_USE_AVX512)
+  const __m512 a512 = _mm512_set1_ps(alpha);
+  for (; k + 16 <= len; k += 16) {
+    _mm512_storeu_ps(x + k, _mm512_mul_ps(a512, _mm512_loadu_ps(x + k)));
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  const __m256 a256 = _mm256_set1_ps(alpha);
+  for (; k + 8 <= len; k += 8) {
+    _mm256_storeu_ps(x + k, _mm256_mul_ps(a256, _mm256_loadu_ps(x + k)));
+  }
+#endif
+  for (; k < len; ++k) {
+    x[k] *= alpha;
+  }
+}
+
+/// @brief q和位置pos上kv_offset开始的那个key头的内积
+template <op::KVCacheFormat format>
+static inline float key_dot(const op::KVCacheView& kv, int32_t pos, int32_t kv_offset,
+                            const float* q, int32_t head_size) {
+  if constexpr (format == op::KVCacheFormat::kFp16) {
+    return dot_f16_ps(q, kv.key_row<uint16_t>(pos) + kv_offset, head_size);
+  } else if constexpr (format == op::KVCacheFormat::kInt8) {
+    const float key_scale = kv.key_scales[(kv.row_offset(pos) + kv_offset) / head_size];
+    return dot_qint8_ps(kv.key_row<int8_t>(pos) + kv_offset, q, head_size) * key_scale;
+  } else {
+    return dot_ps(q, kv.key_row<float>(pos) + kv_offset, head_size);
+  }
+}
+
+/// @brief out += p * 位置pos上kv_offset开始的那个value头
+template <op::KVCacheFormat format>
+static inline void value_axpy(const op::KVCacheView& kv, int32_t pos, int32_t kv_offset, float p,
+                              float* out, int32_t head_size) {
+  if constexpr (format == op::KVCacheFormat::kFp16) {
+    axpy_f16_ps(p, kv.value_row<uint16_t>(pos) + kv_offset, out, head_size);
+  } else if constexpr (format == op::KVCacheFormat::kInt8) {
+    const float value_scale = kv.value_scales[(kv.row_offset(pos) + kv_offset) / head_size];
+    axpy_qint8_ps(p * value_scale, kv.value_row<int8_t>(pos) + kv_offset, out, head_size);
+  } else {
+    axpy_ps(p, kv.value_row<float>(pos) + kv_offset, out, head_size);
+  }
+}
+
+template <op::KVCacheFormat format>
+static void mha_kernel_impl(int32_t pos, int32_t head_num, int32_t kv_mul, int32_t head_size,
+                            int32_t rows, float* output, const float* query,
+                            const op::KVCacheView& kv, void* stream) {
+  const int32_t dim = head_num * head_size;
+  const float scale = 1.f / std::sqrt(static_cast<float>(head_size));
+  const int32_t query_blocks = (rows + kMHAQueryTile - 1) / kMHAQueryTile;
+  const int64_t item_num = static_cast<int64_t>(head_num) * query_blocks;
+
+  get_thread_pool(stream)->parallel_for(0, item_num, 1, [&](int64_t begin, int64_t end, int32_t) {
+    for (int64_t item = begin; item < end; ++item) {
+      const int32_t h = static_cast<int32_t>(item % head_num);
+      const int32_t r0 = static_cast<int32_t>(item / head_num) * kMHAQueryTile;
+      const int32_t r1 = std::min(rows, r0 + kMHAQueryTile);
+      //GQA：kv_mul个query头共用一个key/value头
+      const int32_t kv_offset = (h / kv_mul) * head_size;
+
+      float running_max[kMHAQueryTile];
+      float running_sum[kMHAQueryTile];
+      for (int32_t r = r0; r < r1; ++r) {
+        //输出行直接当累加器用：每来一块先按新的最大值缩放，再加上这一块的加权value
+        std::memset(output + static_cast<int64_t>(r) * dim + h * head_size, 0,
+                    head_size * sizeof(float));
+        running_max[r - r0] = -INFINITY;
+        running_sum[r - r0] = 0.f;
+      }
+
+      float tile_score[kMHATileSize];
+      //这个query块里最后一行能看到的位置最多
+      const int32_t last = pos + r1 - 1;
+      for (int32_t t0 = 0; t0 <= last; t0 += kMHATileSize) {
+        for (int32_t r = r0; r < r1; ++r) {
+          const int32_t len = std::min(kMHATileSize, pos + r + 1 - t0);
+          if (len <= 0) {
+            continue;
+          }
+          const float* q = query + static_cast<int64_t>(r) * dim + h * head_size;
+          float* out = output + static_cast<int64_t>(r) * dim + h * head_size;
+          float tile_max = -INFINITY;
+          for (int32_t j = 0; j < len; ++j) {
+            tile_score[j] = key_dot<format>(kv, t0 + j, kv_offset, q, head_size) * scale;
+            tile_max = std::max(tile_max, tile_score[j]);
+          }
+
+          const float new_max = std::max(running_max[r - r0], tile_max);
+          //之前累加的部分是按旧的最大值算的指数，要整体乘上exp(old - new)修正
+          const float correction = std::exp(running_max[r - r0] - new_max);
+          running_sum[r - r0] *= correction;
+          if (t0 != 0) {
+            scale_ps(correction, out, head_size);
+          }
+          for (int32_t j = 0; j < len; ++j) {
+            const float p = std::exp(tile_score[j] - new_max);
+            running_sum[r - r0] += p;
+            value_axpy<format>(kv, t0 + j, kv_offset, p, out, head_size);
+          }
+          running_max[r - r0] = new_max;
+        }
+      }
+      for (int32_t r = r0; r < r1; ++r) {
+        scale_ps(1.f / running_sum[r - r0], output + static_cast<int64_t>(r) * dim + h * head_size,
+                 head_size);
+      }
+    }
+  });
+}
+
+void mha_kernel_cpu(int32_t pos, int32_t head_num, int32_t kv_mul, int32_t head_size,
+                    const tensor::Tensor& mha_out, const tensor::Tensor& query_tensor,
+                    const op::KVCacheView& kv, void* stream) {
+  CHECK_GE(pos, 0);
+  CHECK_GT(kv_mul, 0);
+  CHECK(mha_out.is_contiguous() && query_tensor.is_contiguous());
+  const int32_t dim = head_num * head_size;
+  const int32_t rows = static_cast<int32_t>(query_tensor.size() / dim);
+  CHECK_EQ(query_tensor.size(), static_cast<size_t>(rows) * dim);
+  CHECK_EQ(mha_out.size(), query_tensor.size());
+
+  const float* query = query_tensor.ptr<float>();
+  float* output = const_cast<float*>(mha_out.ptr<float>());
+  switch (kv.format) {
+    case op::KVCacheFormat::kFp32:
+      mha_kernel_impl<op::KVCacheFormat::kFp32>(pos, head_num, kv_mul, head_size, rows, output,
+                                                query, kv, stream);
+      break;
+    case op::KVCacheFormat::kFp16:
+      mha_kernel_impl<op::KVCacheFormat::kFp16>(pos, head_num, kv_mul, head_size, rows, output,
+                                                query, kv, stream);
+      break;
+    case op::KVCacheFormat::kInt8:
+      //scale按head_size个数一组存，MultiHeadAttention::check保证了和attention的头对得上
+      mha_kernel_impl<op::KVCacheFormat::kInt8>(pos, head_num, kv_mul, head_size, rows, output,
+                                                query, kv, stream);
+      break;
+    default:
+      LOG(FATAL) << "Unknown kv cache format in the mha kernel.";
+  }
+}
+
+void kv_store_row_cpu(op::KVCacheFormat format, const float* src, void* dst, float* scales,
+                      int32_t kv_dim, int32_t head_size) {
+  if (format == op::KVCacheFormat::kFp32) {
+    std::memcpy(dst, src, kv_dim * sizeof(float));
+  } else if (format == op::KVCacheFormat::kFp16) {
+    uint16_t* out = static_cast<uint16_t*>(dst);
+    int32_t k = 0;
+#if defined(KUIPER_USE_F16C)
+    for (; k + 8 <= kv_dim; k += 8) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k),
+                       _mm256_cvtps_ph(_mm256_loadu_ps(src + k), _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif
+    for (; k < kv_dim; ++k) {
+      out[k] = float_to_half(src[k]);
+    }
+  } else {
+    CHECK(scales != nullptr);
+    CHECK_EQ(kv_dim % head_size, 0);
+    int8_t* out = static_cast<int8_t*>(dst);
+    for (int32_t h = 0; h * head_size < kv_dim; ++h) {
+      const float* x = src + h * head_size;
+      float absmax = 0.f;
+      for (int32_t i = 0; i < head_size; ++i) {
+        absmax = std::max(absmax, std::abs(x[i]));
+      }
+      const float scale = absmax / 127.f;
+      const float inv_scale = scale > 0.f ? 1.f / scale : 0.f;
+      for (int32_t i = 0; i < head_size; ++i) {
+        out[h * head_size + i] = static_cast<int8_t>(std::lround(x[i] * inv_scale));
+      }
+      scales[h] = scale;
+    }
+  }
+}
+}  // namespace kernel
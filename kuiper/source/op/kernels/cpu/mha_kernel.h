@@ -0,0 +1,24 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_MHA_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_MHA_KERNEL_H_
+#include "op/kv_cache.h"
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief 从pos开始的rows个连续位置对KV cache做因果多头注意力
+//query是[rows, head_num * head_size]，第r行在位置pos + r，只看0..pos + r（因果mask）；decode时rows为1。
+//kv是这一层的KV cache视图（连续的或者分页的都一样），这些位置的key/value已经写进去了，
+//kernel沿着block_table按位置取key/value。
+//按kMHATileSize个位置一块做online softmax：每个头的每一行只维护当前的最大值和指数和，
+//score只存在栈上的一小块里，不会写出完整的[head_num, rows, seq_len]矩阵，也不需要第二遍扫value。
+//prefill时kMHAQueryTile行query共用同一块key/value，这块在L1里的时候被这几行一起用完。
+//(头, query块)分给不同线程。
+//fp16/int8的cache在内积和累加时逐块转回fp32，int8的scale提到内积外面乘、合进累加的系数里。
+void mha_kernel_cpu(int32_t pos, int32_t head_num, int32_t kv_mul, int32_t head_size,
+                    const tensor::Tensor& mha_out, const tensor::Tensor& query_tensor,
+                    const op::KVCacheView& kv, void* stream = nullptr);
+
+/// @brief 把一行fp32的key或value（kv_dim个数）按format写进cache的dst，
+//int8时每head_size个数取absmax / 127作为scale写进scales，fp32和fp16时scales不用
+void kv_store_row_cpu(op::KVCacheFormat format, const float* src, void* dst, float* scales,
+                      int32_t kv_dim, int32_t head_size);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_MHA_KERNEL_H_
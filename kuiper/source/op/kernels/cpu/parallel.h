@@ -0,0 +1,10 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_PARALLEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_PARALLEL_H_
+#include "base/thread_pool.h"
+namespace kernel {
+//CPU kernel的stream参数是layer的CpuConfig里的线程池，没有设置时用默认线程池
+inline base::ThreadPool* get_thread_pool(void* stream) {
+  return stream ? static_cast<base::ThreadPool*>(stream) : base::ThreadPool::default_pool();
+}
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_PARALLEL_H_
@@ -0,0 +1,43 @@
+#include "rmsnorm_kernel.h"
+#include <glog/logging.h>
+#include <cmath>
+#include "simd.h"
+namespace kernel {
+void rmsnorm_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& weight,
+                        const tensor::Tensor& output, float eps, void* stream) {
+  UNUSED(stream);
+  CHECK(!input.is_empty() && !weight.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && weight.is_contiguous() && output.is_contiguous());
+  const int32_t dim = static_cast<int32_t>(weight.size());
+  const int32_t rows = static_cast<int32_t>(input.size() / dim);
+  CHECK_EQ(input.size(), static_cast<size_t>(rows) * dim);
+  CHECK_EQ(output.size(), input.size());
+
+  const float* in_ptr = input.ptr<float>();
+  const float* weight_ptr = weight.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+  for (int32_t r = 0; r < rows; ++r) {
+    const float* x = in_ptr + static_cast<int64_t>(r) * dim;
+    float* y = out_ptr + static_cast<int64_t>(r) * dim;
+    const float scale = 1.f / std::sqrt(dot_ps(x, x, dim) / static_cast<float>(dim) + eps);
+    int32_t i = 0;
+#if defined(KUIPER_USE_AVX512)
+    const __m512 s512 = _mm512_set1_ps(scale);
+    for (; i + 16 <= dim; i += 16) {
+      _mm512_storeu_ps(y + i, _mm512_mul_ps(_mm512_mul_ps(_mm512_loadu_ps(x + i), s512),
+                                            _mm512_loadu_ps(weight_ptr + i)));
+    }
+#endif
+#if defined(KUIPER_USE_AVX2)
+    const __m256 s256 = _mm256_set1_ps(scale);
+    for (; i + 8 <= dim; i += 8) {
+      _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), s256),
+                                            _mm256_loadu_ps(weight_ptr + i)));
+    }
+#endif
+    for (; i < dim; ++i) {
+      y[i] = x[i] * scale * weight_ptr[i];
+    }
+  }
+}
+}  // namespace kernel
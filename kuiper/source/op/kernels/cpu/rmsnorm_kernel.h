@@ -0,0 +1,9 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_RMSNORM_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_RMSNORM_KERNEL_H_
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief output = rmsnorm(input) * weight，按行（最后一维，也就是weight的长度）归一化
+void rmsnorm_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& weight,
+                        const tensor::Tensor& output, float eps, void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_RMSNORM_KERNEL_H_
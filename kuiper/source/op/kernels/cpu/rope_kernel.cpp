@@ -0,0 +1,106 @@
+#include "rope_kernel.h"
+#include <glog/logging.h>
+#include <cmath>
+#include "parallel.h"
+#include "simd.h"
+namespace kernel {
+//prefill时每块任务处理的行数
+constexpr int32_t kRoPERowGrain = 16;
+
+void sin_cos_cache_calc_cpu(int32_t head_size, int32_t max_seq_len,
+                            const tensor::Tensor& sin_cache, const tensor::Tensor& cos_cache) {
+  CHECK(!sin_cache.is_empty() && !cos_cache.is_empty());
+  const int32_t half = head_size / 2;
+  CHECK_EQ(sin_cache.size(), static_cast<size_t>(max_seq_len) * half);
+  CHECK_EQ(cos_cache.size(), static_cast<size_t>(max_seq_len) * half);
+
+  float* sin_ptr = const_cast<float*>(sin_cache.ptr<float>());
+  float* cos_ptr = const_cast<float*>(cos_cache.ptr<float>());
+  for (int32_t i = 0; i < half; ++i) {
+    const float freq = 1.0f / std::pow(10000.0f, static_cast<float>(2 * i) / head_size);
+    for (int32_t pos = 0; pos < max_seq_len; ++pos) {
+      const float val = static_cast<float>(pos) * freq;
+      sin_ptr[pos * half + i] = std::sin(val);
+      cos_ptr[pos * half + i] = std::cos(val);
+    }
+  }
+}
+
+//x是一个头，[x0, x1]看作复数x0 + i*x1，乘上cos + i*sin
+static inline void rotate_head(float* x, const float* sin_row, const float* cos_row,
+                               int32_t head_size) {
+  int32_t i = 0;
+#if defined(KUIPER_USE_AVX512)
+  //一次8对：把8个sin/cos复制成[c0, c0, c1, c1, ...]，再用fmaddsub一次算完实部和虚部
+  const __m512i dup_idx = _mm512_set_epi32(7, 7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0, 0);
+  for (; i + 16 <= head_size; i += 16) {
+    const __m512 c = _mm512_permutexvar_ps(
+        dup_idx, _mm512_castps256_ps512(_mm256_loadu_ps(cos_row + i / 2)));
+    const __m512 s = _mm512_permutexvar_ps(
+        dup_idx, _mm512_castps256_ps512(_mm256_loadu_ps(sin_row + i / 2)));
+    const __m512 v = _mm512_loadu_ps(x + i);
+    const __m512 swapped = _mm512_permute_ps(v, 0xB1);
+    _mm512_storeu_ps(x + i, _mm512_fmaddsub_ps(v, c, _mm512_mul_ps(swapped, s)));
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  for (; i + 8 <= head_size; i += 8) {
+    const __m128 c4 = _mm_loadu_ps(cos_row + i / 2);
+    const __m128 s4 = _mm_loadu_ps(sin_row + i / 2);
+    const __m256 c = _mm256_set_m128(_mm_unpackhi_ps(c4, c4), _mm_unpacklo_ps(c4, c4));
+    const __m256 s = _mm256_set_m128(_mm_unpackhi_ps(s4, s4), _mm_unpacklo_ps(s4, s4));
+    const __m256 v = _mm256_loadu_ps(x + i);
+    const __m256 swapped = _mm256_permute_ps(v, 0xB1);
+    //偶数位 x0*c - x1*s，奇数位 x1*c + x0*s
+    _mm256_storeu_ps(x + i, _mm256_fmaddsub_ps(v, c, _mm256_mul_ps(swapped, s)));
+  }
+#endif
+  for (; i < head_size; i += 2) {
+    const float fci = cos_row[i / 2];
+    const float fcr = sin_row[i / 2];
+    const float v0 = x[i];
+    const float v1 = x[i + 1];
+    x[i] = v0 * fci - v1 * fcr;
+    x[i + 1] = v0 * fcr + v1 * fci;
+  }
+}
+
+void rope_kernel_cpu(int32_t dim, int32_t kv_dim, int32_t head_size,
+                     const tensor::Tensor& input_q, const tensor::Tensor& input_k,
+                     const tensor::Tensor& input_pos, const tensor::Tensor& sin_cache,
+                     const tensor::Tensor& cos_cache, void* stream) {
+  CHECK_EQ(head_size % 2, 0);
+  CHECK(input_q.is_contiguous() && input_k.is_contiguous() && input_pos.is_contiguous());
+  const int32_t rows = static_cast<int32_t>(input_pos.size());
+  CHECK_EQ(input_q.size(), static_cast<size_t>(rows) * dim);
+  CHECK_EQ(input_k.size(), static_cast<size_t>(rows) * kv_dim);
+  const int32_t half = head_size / 2;
+  const int32_t head_num = dim / head_size;
+  const int32_t kv_head_num = kv_dim / head_size;
+  const int32_t* pos_ptr = input_pos.ptr<int32_t>();
+  float* q_ptr = const_cast<float*>(input_q.ptr<float>());
+  float* k_ptr = const_cast<float*>(input_k.ptr<float>());
+
+  auto rotate_rows = [&](int64_t row_begin, int64_t row_end, int32_t) {
+    for (int64_t r = row_begin; r < row_end; ++r) {
+      const float* sin_row = sin_cache.ptr<float>() + static_cast<int64_t>(pos_ptr[r]) * half;
+      const float* cos_row = cos_cache.ptr<float>() + static_cast<int64_t>(pos_ptr[r]) * half;
+      float* q = q_ptr + r * dim;
+      float* k = k_ptr + r * kv_dim;
+      //同一个位置所有头共用一行表，query和key在同一个循环里处理
+      for (int32_t h = 0; h < head_num; ++h) {
+        rotate_head(q + h * head_size, sin_row, cos_row, head_size);
+        if (h < kv_head_num) {
+          rotate_head(k + h * head_size, sin_row, cos_row, head_size);
+        }
+      }
+    }
+  };
+  //单行的计算量太小，不值得唤醒线程池
+  if (rows == 1) {
+    rotate_rows(0, 1, 0);
+  } else {
+    get_thread_pool(stream)->parallel_for(0, rows, kRoPERowGrain, rotate_rows);
+  }
+}
+}  // namespace kernel
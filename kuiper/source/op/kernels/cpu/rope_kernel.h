@@ -0,0 +1,17 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_ROPE_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_ROPE_KERNEL_H_
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief 预先计算sin/cos表，cache[pos][i] = sin/cos(pos / 10000^(2i / head_size))
+void sin_cos_cache_calc_cpu(int32_t head_size, int32_t max_seq_len,
+                            const tensor::Tensor& sin_cache, const tensor::Tensor& cos_cache);
+
+/// @brief 原地旋转query的所有头和key的所有头，相邻两个元素看作一个复数
+//input_q是[rows, dim]，input_k是[rows, kv_dim]，input_pos是CPU上的int32[rows]，第r行用第input_pos[r]行sin/cos表。
+//decode时rows为1，prefill时一段prompt的所有位置一次做完。
+void rope_kernel_cpu(int32_t dim, int32_t kv_dim, int32_t head_size,
+                     const tensor::Tensor& input_q, const tensor::Tensor& input_k,
+                     const tensor::Tensor& input_pos, const tensor::Tensor& sin_cache,
+                     const tensor::Tensor& cos_cache, void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_ROPE_KERNEL_H_
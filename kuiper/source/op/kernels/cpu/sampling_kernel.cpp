@@ -0,0 +1,166 @@
+#include "sampling_kernel.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include "simd.h"
+namespace kernel {
+int32_t argmax_kernel_cpu(const float* x, int32_t size) {
+  CHECK(x != nullptr);
+  CHECK_GT(size, 0);
+  //先求最大值，再找第一个等于它的位置，两遍都是连续的向量化扫描
+  const float max_value = max_ps(x, size);
+  int32_t k = 0;
+#if defined(KUIPER_USE_AVX512)
+  const __m512 m512 = _mm512_set1_ps(max_value);
+  for (; k + 16 <= size; k += 16) {
+    const __mmask16 mask = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + k), m512, _CMP_EQ_OQ);
+    if (mask) {
+      return k + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  const __m256 m256 = _mm256_set1_ps(max_value);
+  for (; k + 8 <= size; k += 8) {
+    const int mask =
+        _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + k), m256, _CMP_EQ_OQ));
+    if (mask) {
+      return k + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; k < size; ++k) {
+    if (x[k] == max_value) {
+      return k;
+    }
+  }
+  //全是NaN的时候退回第一个
+  return 0;
+}
+
+float max_kernel_cpu(const float* x, int32_t size) {
+  CHECK(x != nullptr);
+  CHECK_GT(size, 0);
+  return max_ps(x, size);
+}
+
+float exp_sum_kernel_cpu(const float* x, int32_t size, float max_value, float scale, float* out) {
+  CHECK(x != nullptr && out != nullptr);
+  int32_t k = 0;
+  float sum = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  const __m512 max512 = _mm512_set1_ps(max_value);
+  const __m512 scale512 = _mm512_set1_ps(scale);
+  __m512 acc512 = _mm512_setzero_ps();
+  for (; k + 16 <= size; k += 16) {
+    const __m512 e =
+        exp512_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(x + k), max512), scale512));
+    _mm512_storeu_ps(out + k, e);
+    acc512 = _mm512_add_ps(acc512, e);
+  }
+  sum += _mm512_reduce_add_ps(acc512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  const __m256 max256 = _mm256_set1_ps(max_value);
+  const __m256 scale256 = _mm256_set1_ps(scale);
+  __m256 acc256 = _mm256_setzero_ps();
+  for (; k + 8 <= size; k += 8) {
+    const __m256 e =
+        exp256_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + k), max256), scale256));
+    _mm256_storeu_ps(out + k, e);
+    acc256 = _mm256_add_ps(acc256, e);
+  }
+  sum += hsum_ps(acc256);
+#endif
+  for (; k < size; ++k) {
+    out[k] = std::exp((x[k] - max_value) * scale);
+    sum += out[k];
+  }
+  return sum;
+}
+
+namespace {
+//values[0]是堆顶（最小值），indices跟着values一起移动
+void sift_down(float* values, int32_t* indices, int32_t k, int32_t i) {
+  const float value = values[i];
+  const int32_t index = indices[i];
+  while (true) {
+    int32_t child = 2 * i + 1;
+    if (child >= k) {
+      break;
+    }
+    if (child + 1 < k && values[child + 1] < values[child]) {
+      child += 1;
+    }
+    if (!(values[child] < value)) {
+      break;
+    }
+    values[i] = values[child];
+    indices[i] = indices[child];
+    i = child;
+  }
+  values[i] = value;
+  indices[i] = index;
+}
+
+inline void replace_top(float* values, int32_t* indices, int32_t k, float value, int32_t index) {
+  values[0] = value;
+  indices[0] = index;
+  sift_down(values, indices, k, 0);
+}
+}  // namespace
+
+void topk_kernel_cpu(const float* x, int32_t size, int32_t k, float* values, int32_t* indices) {
+  CHECK(x != nullptr && values != nullptr && indices != nullptr);
+  CHECK_GT(k, 0);
+  CHECK_LE(k, size);
+  for (int32_t i = 0; i < k; ++i) {
+    values[i] = x[i];
+    indices[i] = i;
+  }
+  for (int32_t i = k / 2 - 1; i >= 0; --i) {
+    sift_down(values, indices, k, i);
+  }
+
+  int32_t i = k;
+#if defined(KUIPER_USE_AVX512)
+  for (; i + 16 <= size; i += 16) {
+    __mmask16 mask =
+        _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i), _mm512_set1_ps(values[0]), _CMP_GT_OQ);
+    while (mask) {
+      const int32_t j = i + __builtin_ctz(mask);
+      //前面的元素进堆以后堆顶变大了，要重新比一次
+      if (x[j] > values[0]) {
+        replace_top(values, indices, k, x[j], j);
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  for (; i + 8 <= size; i += 8) {
+    int mask = _mm256_movemask_ps(
+        _mm256_cmp_ps(_mm256_loadu_ps(x + i), _mm256_set1_ps(values[0]), _CMP_GT_OQ));
+    while (mask) {
+      const int32_t j = i + __builtin_ctz(mask);
+      if (x[j] > values[0]) {
+        replace_top(values, indices, k, x[j], j);
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    if (x[i] > values[0]) {
+      replace_top(values, indices, k, x[i], i);
+    }
+  }
+
+  //堆排序：每次把堆顶（最小的）换到末尾，最后就是从大到小
+  for (int32_t n = k - 1; n > 0; --n) {
+    std::swap(values[0], values[n]);
+    std::swap(indices[0], indices[n]);
+    sift_down(values, indices, n, 0);
+  }
+}
+}  // namespace kernel
@@ -0,0 +1,18 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_SAMPLING_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_SAMPLING_KERNEL_H_
+#include <cstdint>
+namespace kernel {
+/// @brief 最大值的下标，有多个相同的最大值时取最前面的一个，size必须大于0
+int32_t argmax_kernel_cpu(const float* x, int32_t size);
+
+/// @brief max(x[i])，size必须大于0
+float max_kernel_cpu(const float* x, int32_t size);
+
+/// @brief out[i] = exp((x[i] - max_value) * scale)，返回sum(out[i])，减最大值、乘系数和exp在同一遍里做完
+float exp_sum_kernel_cpu(const float* x, int32_t size, float max_value, float scale, float* out);
+
+/// @brief 取最大的k个数，结果从大到小写进values和indices（各k个），不排序整个x。
+//values当成大小为k的小顶堆，向量化地把x和堆顶比较，绝大多数元素一次比较就被丢掉，只有比堆顶大的才进堆
+void topk_kernel_cpu(const float* x, int32_t size, int32_t k, float* values, int32_t* indices);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_SAMPLING_KERNEL_H_
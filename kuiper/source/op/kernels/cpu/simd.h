@@ -0,0 +1,440 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_SIMD_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_SIMD_H_
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+//CPU kernel按编译时打开的指令集选择实现：-mavx512f优先，其次-mavx2 -mfma，
+//都没有的时候退回标量代码，所以任何平台都能编译通过。
+#if defined(__AVX512F__)
+#define KUIPER_USE_AVX512
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#define KUIPER_USE_AVX2
+#endif
+//fp16和fp32互转的vcvtph2ps/vcvtps2ph，AVX2路径需要额外的-mf16c，AVX-512F自带
+#if defined(KUIPER_USE_AVX2) && defined(__F16C__)
+#define KUIPER_USE_F16C
+#endif
+//fp32转bf16的vcvtneps2bf16，需要-mavx512bf16；bf16转fp32只是移位，不需要它
+#if defined(KUIPER_USE_AVX512) && defined(__AVX512BF16__)
+#define KUIPER_USE_AVX512_BF16
+#endif
+namespace kernel {
+#if defined(KUIPER_USE_AVX2)
+inline float hsum_ps(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  __m128 shuf = _mm_movehdup_ps(lo);
+  __m128 sums = _mm_add_ps(lo, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  sums = _mm_add_ss(sums, shuf);
+  return _mm_cvtss_f32(sums);
+}
+
+//8个int8扩展成8个float
+inline __m256 load_i8x8_ps(const int8_t* ptr) {
+  __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr));
+  return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v));
+}
+#endif
+
+#if defined(KUIPER_USE_AVX512)
+//16个int8扩展成16个float
+inline __m512 load_i8x16_ps(const int8_t* ptr) {
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(v));
+}
+#endif
+
+#if defined(KUIPER_USE_AVX512)
+//exp(x)，Cephes的多项式，相对误差在1e-7左右；x先截到float不溢出的范围
+inline __m512 exp512_ps(__m512 x) {
+  x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-87.3f)), _mm512_set1_ps(88.3f));
+  const __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(1.44269504089f)),
+                                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(0.693359375f), x);
+  r = _mm512_fnmadd_ps(n, _mm512_set1_ps(-2.12194440e-4f), r);
+  __m512 p = _mm512_set1_ps(1.9875691500e-4f);
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.3981999507e-3f));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(8.3334519073e-3f));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(4.1665795894e-2f));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.6666665459e-1f));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(5.0000001201e-1f));
+  p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.f)));
+  return _mm512_scalef_ps(p, n);
+}
+#endif
+
+#if defined(KUIPER_USE_AVX2)
+//同exp512_ps，2^n直接拼到指数位上
+inline __m256 exp256_ps(__m256 x) {
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+  const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504089f)),
+                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+  __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+  p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.f)));
+  const __m256i e = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+#endif
+
+/// @brief IEEE半精度转单精度，有F16C时用vcvtph2ps，否则是标量实现，非规格化数、inf和NaN都能正确处理
+inline float half_to_float(uint16_t h) {
+#if defined(KUIPER_USE_F16C) || defined(KUIPER_USE_AVX512)
+  return _cvtsh_ss(h);
+#else
+  const uint32_t shifted_exp = 0x7C00u << 13;
+  uint32_t bits = static_cast<uint32_t>(h & 0x7FFF) << 13;
+  const uint32_t exp = bits & shifted_exp;
+  bits += (127 - 15) << 23;
+  float f = 0.f;
+  if (exp == shifted_exp) {
+    bits += (128 - 16) << 23;
+  } else if (exp == 0) {
+    //非规格化数：借一个隐含的1再减掉
+    bits += 1 << 23;
+    std::memcpy(&f, &bits, sizeof(float));
+    const uint32_t magic_bits = 113u << 23;
+    float magic = 0.f;
+    std::memcpy(&magic, &magic_bits, sizeof(float));
+    f -= magic;
+    std::memcpy(&bits, &f, sizeof(float));
+  }
+  bits |= static_cast<uint32_t>(h & 0x8000) << 16;
+  std::memcpy(&f, &bits, sizeof(float));
+  return f;
+#endif
+}
+
+/// @brief 单精度转IEEE半精度，就近舍入到偶数，超出范围的变成inf
+inline uint16_t float_to_half(float f) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &f, sizeof(float));
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint16_t h = 0;
+  if (bits >= (127u + 16) << 23) {
+    h = bits > (255u << 23) ? 0x7E00 : 0x7C00;
+  } else if (bits < (113u << 23)) {
+    //结果是非规格化数，加一个magic数让硬件的浮点加法完成移位和舍入
+    const uint32_t magic_bits = ((127u - 15) + (23 - 10) + 1) << 23;
+    float magic = 0.f;
+    std::memcpy(&magic, &magic_bits, sizeof(float));
+    float value = 0.f;
+    std::memcpy(&value, &bits, sizeof(float));
+    value += magic;
+    std::memcpy(&bits, &value, sizeof(float));
+    h = static_cast<uint16_t>(bits - magic_bits);
+  } else {
+    const uint32_t mant_odd = (bits >> 13) & 1;
+    bits += 0xC8000FFFu;
+    bits += mant_odd;
+    h = static_cast<uint16_t>(bits >> 13);
+  }
+  return h | static_cast<uint16_t>(sign >> 16);
+}
+
+/// @brief bfloat16转单精度，bf16就是fp32的高16位
+inline float bf16_to_float(uint16_t h) {
+  const uint32_t bits = static_cast<uint32_t>(h) << 16;
+  float f = 0.f;
+  std::memcpy(&f, &bits, sizeof(float));
+  return f;
+}
+
+/// @brief 单精度转bfloat16，就近舍入到偶数，NaN保持是NaN
+inline uint16_t float_to_bf16(float f) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &f, sizeof(float));
+  if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+    return static_cast<uint16_t>((bits >> 16) | 0x40);
+  }
+  bits += 0x7FFFu + ((bits >> 16) & 1);
+  return static_cast<uint16_t>(bits >> 16);
+}
+
+#if defined(KUIPER_USE_F16C)
+//8个fp16扩展成8个float
+inline __m256 load_f16x8_ps(const uint16_t* ptr) {
+  return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)));
+}
+#endif
+
+#if defined(KUIPER_USE_AVX2)
+//8个bf16扩展成8个float，零扩展到32位再左移16位
+inline __m256 load_bf16x8_ps(const uint16_t* ptr) {
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(v), 16));
+}
+#endif
+
+#if defined(KUIPER_USE_AVX512)
+//16个fp16扩展成16个float
+inline __m512 load_f16x16_ps(const uint16_t* ptr) {
+  return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)));
+}
+
+//16个bf16扩展成16个float
+inline __m512 load_bf16x16_ps(const uint16_t* ptr) {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(v), 16));
+}
+#endif
+
+/// @brief sum(a[i] * b[i])
+inline float dot_ps(const float* a, const float* b, int32_t len) {
+  int32_t k = 0;
+  float sum = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc512 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    acc512 = _mm512_fmadd_ps(_mm512_loadu_ps(a + k), _mm512_loadu_ps(b + k), acc512);
+  }
+  sum += _mm512_reduce_add_ps(acc512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  __m256 acc = _mm256_setzero_ps();
+  for (; k + 8 <= len; k += 8) {
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k), acc);
+  }
+  sum += hsum_ps(acc);
+#endif
+  for (; k < len; ++k) {
+    sum += a[k] * b[k];
+  }
+  return sum;
+}
+
+/// @brief sum(w[i] * x[i])，w是int8，在寄存器里扩展成float再乘
+inline float dot_qint8_ps(const int8_t* w, const float* x, int32_t len) {
+  int32_t k = 0;
+  float sum = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc512 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    acc512 = _mm512_fmadd_ps(load_i8x16_ps(w + k), _mm512_loadu_ps(x + k), acc512);
+  }
+  sum += _mm512_reduce_add_ps(acc512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    acc0 = _mm256_fmadd_ps(load_i8x8_ps(w + k), _mm256_loadu_ps(x + k), acc0);
+    acc1 = _mm256_fmadd_ps(load_i8x8_ps(w + k + 8), _mm256_loadu_ps(x + k + 8), acc1);
+  }
+  for (; k + 8 <= len; k += 8) {
+    acc0 = _mm256_fmadd_ps(load_i8x8_ps(w + k), _mm256_loadu_ps(x + k), acc0);
+  }
+  sum += hsum_ps(_mm256_add_ps(acc0, acc1));
+#endif
+  for (; k < len; ++k) {
+    sum += static_cast<float>(w[k]) * x[k];
+  }
+  return sum;
+}
+
+/// @brief kDataTypeInt4打包的第i个4位数
+inline int32_t q4_at(const uint8_t* q, int64_t i) {
+  const int32_t j = static_cast<int32_t>(i & 31);
+  const uint8_t byte = q[(i >> 5) * 16 + (j & 15)];
+  return j < 16 ? (byte & 0x0F) : (byte >> 4);
+}
+
+#if defined(KUIPER_USE_AVX512)
+//kDataTypeInt4的一个块（32个数，16个字节）扩展成float，lo是前16个，hi是后16个
+inline void load_q4x32_ps(const uint8_t* ptr, __m512& lo, __m512& hi) {
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  lo = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_and_si128(v, mask)));
+  hi = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_and_si128(_mm_srli_epi16(v, 4), mask)));
+}
+#elif defined(KUIPER_USE_AVX2)
+//kDataTypeInt4的一个块（32个数，16个字节）扩展成4组8个float
+inline void load_q4x32_ps(const uint8_t* ptr, __m256* out) {
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  const __m128i lo = _mm_and_si128(v, mask);
+  const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+  out[0] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(lo));
+  out[1] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+  out[2] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(hi));
+  out[3] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+}
+#endif
+
+/// @brief sum(a[i] * b[i])，b是fp16
+inline float dot_f16_ps(const float* a, const uint16_t* b, int32_t len) {
+  int32_t k = 0;
+  float sum = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc512 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    acc512 = _mm512_fmadd_ps(_mm512_loadu_ps(a + k), load_f16x16_ps(b + k), acc512);
+  }
+  sum += _mm512_reduce_add_ps(acc512);
+#endif
+#if defined(KUIPER_USE_F16C)
+  __m256 acc = _mm256_setzero_ps();
+  for (; k + 8 <= len; k += 8) {
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + k), load_f16x8_ps(b + k), acc);
+  }
+  sum += hsum_ps(acc);
+#endif
+  for (; k < len; ++k) {
+    sum += a[k] * half_to_float(b[k]);
+  }
+  return sum;
+}
+
+/// @brief sum(a[i] * b[i])，b是bf16
+inline float dot_bf16_ps(const float* a, const uint16_t* b, int32_t len) {
+  int32_t k = 0;
+  float sum = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc512 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    acc512 = _mm512_fmadd_ps(_mm512_loadu_ps(a + k), load_bf16x16_ps(b + k), acc512);
+  }
+  sum += _mm512_reduce_add_ps(acc512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  __m256 acc = _mm256_setzero_ps();
+  for (; k + 8 <= len; k += 8) {
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + k), load_bf16x8_ps(b + k), acc);
+  }
+  sum += hsum_ps(acc);
+#endif
+  for (; k < len; ++k) {
+    sum += a[k] * bf16_to_float(b[k]);
+  }
+  return sum;
+}
+
+/// @brief y[i] += alpha * x[i]
+inline void axpy_ps(float alpha, const float* x, float* y, int32_t len) {
+  int32_t k = 0;
+#if defined(KUIPER_USE_AVX512)
+  const __m512 a512 = _mm512_set1_ps(alpha);
+  for (; k + 16 <= len; k += 16) {
+    _mm512_storeu_ps(y + k, _mm512_fmadd_ps(a512, _mm512_loadu_ps(x + k), _mm512_loadu_ps(y + k)));
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  const __m256 a256 = _mm256_set1_ps(alpha);
+  for (; k + 8 <= len; k += 8) {
+    _mm256_storeu_ps(y + k, _mm256_fmadd_ps(a256, _mm256_loadu_ps(x + k), _mm256_loadu_ps(y + k)));
+  }
+#endif
+  for (; k < len; ++k) {
+    y[k] += alpha * x[k];
+  }
+}
+
+/// @brief y[i] += alpha * x[i]，x是fp16
+inline void axpy_f16_ps(float alpha, const uint16_t* x, float* y, int32_t len) {
+  int32_t k = 0;
+#if defined(KUIPER_USE_AVX512)
+  const __m512 a512 = _mm512_set1_ps(alpha);
+  for (; k + 16 <= len; k += 16) {
+    _mm512_storeu_ps(y + k, _mm512_fmadd_ps(a512, load_f16x16_ps(x + k), _mm512_loadu_ps(y + k)));
+  }
+#endif
+#if defined(KUIPER_USE_F16C)
+  const __m256 a256 = _mm256_set1_ps(alpha);
+  for (; k + 8 <= len; k += 8) {
+    _mm256_storeu_ps(y + k, _mm256_fmadd_ps(a256, load_f16x8_ps(x + k), _mm256_loadu_ps(y + k)));
+  }
+#endif
+  for (; k < len; ++k) {
+    y[k] += alpha * half_to_float(x[k]);
+  }
+}
+
+/// @brief y[i] += alpha * x[i]，x是int8，反量化的scale乘进alpha里
+inline void axpy_qint8_ps(float alpha, const int8_t* x, float* y, int32_t len) {
+  int32_t k = 0;
+#if defined(KUIPER_USE_AVX512)
+  const __m512 a512 = _mm512_set1_ps(alpha);
+  for (; k + 16 <= len; k += 16) {
+    _mm512_storeu_ps(y + k, _mm512_fmadd_ps(a512, load_i8x16_ps(x + k), _mm512_loadu_ps(y + k)));
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  const __m256 a256 = _mm256_set1_ps(alpha);
+  for (; k + 8 <= len; k += 8) {
+    _mm256_storeu_ps(y + k, _mm256_fmadd_ps(a256, load_i8x8_ps(x + k), _mm256_loadu_ps(y + k)));
+  }
+#endif
+  for (; k < len; ++k) {
+    y[k] += alpha * static_cast<float>(x[k]);
+  }
+}
+
+/// @brief max(x[i])，len必须大于0
+inline float max_ps(const float* x, int32_t len) {
+  int32_t k = 0;
+  float max_val = x[0];
+#if defined(KUIPER_USE_AVX512)
+  if (len >= 16) {
+    __m512 m512 = _mm512_loadu_ps(x);
+    for (k = 16; k + 16 <= len; k += 16) {
+      m512 = _mm512_max_ps(m512, _mm512_loadu_ps(x + k));
+    }
+    max_val = _mm512_reduce_max_ps(m512);
+  }
+#endif
+#if defined(KUIPER_USE_AVX2)
+  if (len - k >= 8) {
+    __m256 m256 = _mm256_set1_ps(max_val);
+    for (; k + 8 <= len; k += 8) {
+      m256 = _mm256_max_ps(m256, _mm256_loadu_ps(x + k));
+    }
+    __m128 m128 = _mm_max_ps(_mm256_castps256_ps128(m256), _mm256_extractf128_ps(m256, 1));
+    m128 = _mm_max_ps(m128, _mm_movehl_ps(m128, m128));
+    m128 = _mm_max_ss(m128, _mm_movehdup_ps(m128));
+    max_val = _mm_cvtss_f32(m128);
+  }
+#endif
+  for (; k < len; ++k) {
+    max_val = x[k] > max_val ? x[k] : max_val;
+  }
+  return max_val;
+}
+
+/// @brief sum(x[i])
+inline float sum_ps(const float* x, int32_t len) {
+  int32_t k = 0;
+  float sum = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 acc512 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    acc512 = _mm512_add_ps(acc512, _mm512_loadu_ps(x + k));
+  }
+  sum += _mm512_reduce_add_ps(acc512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  __m256 acc = _mm256_setzero_ps();
+  for (; k + 8 <= len; k += 8) {
+    acc = _mm256_add_ps(acc, _mm256_loadu_ps(x + k));
+  }
+  sum += hsum_ps(acc);
+#endif
+  for (; k < len; ++k) {
+    sum += x[k];
+  }
+  return sum;
+}
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_SIMD_H_
@@ -0,0 +1,28 @@
+#include "softmax_kernel.h"
+#include <glog/logging.h>
+#include <cmath>
+#include "simd.h"
+namespace kernel {
+void softmax_inplace_cpu(float* x, int32_t size) {
+  if (size <= 0) {
+    return;
+  }
+  const float max_value = max_ps(x, size);
+  float sum = 0.f;
+  for (int32_t i = 0; i < size; ++i) {
+    x[i] = std::exp(x[i] - max_value);
+    sum += x[i];
+  }
+  const float inv_sum = 1.f / sum;
+  for (int32_t i = 0; i < size; ++i) {
+    x[i] *= inv_sum;
+  }
+}
+
+void softmax_inplace_cpu(const tensor::Tensor& input, void* stream) {
+  UNUSED(stream);
+  CHECK(!input.is_empty() && input.is_contiguous());
+  CHECK(input.device_type() == base::DeviceType::kDeviceCPU);
+  softmax_inplace_cpu(const_cast<float*>(input.ptr<float>()), static_cast<int32_t>(input.size()));
+}
+}  // namespace kernel
@@ -0,0 +1,10 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_SOFTMAX_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_SOFTMAX_KERNEL_H_
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief 对x的前size个元素原地做softmax
+void softmax_inplace_cpu(float* x, int32_t size);
+
+void softmax_inplace_cpu(const tensor::Tensor& input, void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_SOFTMAX_KERNEL_H_
@@ -0,0 +1,182 @@
+#include "swiglu_kernel.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include "activation.h"
+#include "matmul_kernel.h"
+#include "parallel.h"
+#include "simd.h"
+namespace kernel {
+//线程池里每块任务包含的hidden行数
+constexpr int32_t kFFNRowGrain = 16;
+//输入至少有这么多行时w1、w3改走matmul_kernel里融合了silu的分块GEMM，行数少时逐行点积。
+//这两个是估计值：GEMM要先打包A，行数太少时摊不开；int8的点积要逐组乘scale，估计更早划算
+constexpr int32_t kFFNGemmMinRows = 32;
+constexpr int32_t kFFNQInt8GemmMinRows = 16;
+
+//同时算gate = w1 . x和up = w3 . x，x的每个分量只加载一次
+static inline void dot2_ps(const float* w1, const float* w3, const float* x, int32_t len,
+                           float* gate, float* up) {
+  int32_t k = 0;
+  float g = 0.f;
+  float u = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 g512 = _mm512_setzero_ps();
+  __m512 u512 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    const __m512 xv = _mm512_loadu_ps(x + k);
+    g512 = _mm512_fmadd_ps(_mm512_loadu_ps(w1 + k), xv, g512);
+    u512 = _mm512_fmadd_ps(_mm512_loadu_ps(w3 + k), xv, u512);
+  }
+  g += _mm512_reduce_add_ps(g512);
+  u += _mm512_reduce_add_ps(u512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  __m256 g256 = _mm256_setzero_ps();
+  __m256 u256 = _mm256_setzero_ps();
+  for (; k + 8 <= len; k += 8) {
+    const __m256 xv = _mm256_loadu_ps(x + k);
+    g256 = _mm256_fmadd_ps(_mm256_loadu_ps(w1 + k), xv, g256);
+    u256 = _mm256_fmadd_ps(_mm256_loadu_ps(w3 + k), xv, u256);
+  }
+  g += hsum_ps(g256);
+  u += hsum_ps(u256);
+#endif
+  for (; k < len; ++k) {
+    g += w1[k] * x[k];
+    u += w3[k] * x[k];
+  }
+  *gate = g;
+  *up = u;
+}
+
+static inline void dot2_qint8_ps(const int8_t* w1, const int8_t* w3, const float* x, int32_t len,
+                                 float* gate, float* up) {
+  int32_t k = 0;
+  float g = 0.f;
+  float u = 0.f;
+#if defined(KUIPER_USE_AVX512)
+  __m512 g512 = _mm512_setzero_ps();
+  __m512 u512 = _mm512_setzero_ps();
+  for (; k + 16 <= len; k += 16) {
+    const __m512 xv = _mm512_loadu_ps(x + k);
+    g512 = _mm512_fmadd_ps(load_i8x16_ps(w1 + k), xv, g512);
+    u512 = _mm512_fmadd_ps(load_i8x16_ps(w3 + k), xv, u512);
+  }
+  g += _mm512_reduce_add_ps(g512);
+  u += _mm512_reduce_add_ps(u512);
+#endif
+#if defined(KUIPER_USE_AVX2)
+  __m256 g256 = _mm256_setzero_ps();
+  __m256 u256 = _mm256_setzero_ps();
+  for (; k + 8 <= len; k += 8) {
+    const __m256 xv = _mm256_loadu_ps(x + k);
+    g256 = _mm256_fmadd_ps(load_i8x8_ps(w1 + k), xv, g256);
+    u256 = _mm256_fmadd_ps(load_i8x8_ps(w3 + k), xv, u256);
+  }
+  g += hsum_ps(g256);
+  u += hsum_ps(u256);
+#endif
+  for (; k < len; ++k) {
+    g += static_cast<float>(w1[k]) * x[k];
+    u += static_cast<float>(w3[k]) * x[k];
+  }
+  *gate = g;
+  *up = u;
+}
+
+static void check_ffn_shapes(const tensor::Tensor& input, const tensor::Tensor& w1,
+                             const tensor::Tensor& w3, const tensor::Tensor& output,
+                             int32_t* rows, int32_t* hidden_dim, int32_t* dim) {
+  CHECK(!input.is_empty() && !w1.is_empty() && !w3.is_empty() && !output.is_empty());
+  CHECK(input.is_contiguous() && w1.is_contiguous() && w3.is_contiguous() &&
+        output.is_contiguous());
+  CHECK(input.device_type() == base::DeviceType::kDeviceCPU &&
+        w1.device_type() == base::DeviceType::kDeviceCPU &&
+        w3.device_type() == base::DeviceType::kDeviceCPU &&
+        output.device_type() == base::DeviceType::kDeviceCPU);
+  CHECK_EQ(w1.dims_size(), 2);
+  CHECK(w1.dims() == w3.dims());
+  *hidden_dim = w1.get_dim(0);
+  *dim = w1.get_dim(1);
+  *rows = static_cast<int32_t>(input.size() / *dim);
+  CHECK_EQ(input.size(), static_cast<size_t>(*rows) * *dim);
+  CHECK_EQ(output.size(), static_cast<size_t>(*rows) * *hidden_dim);
+}
+
+void swiglu_ffn_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& w1,
+                           const tensor::Tensor& w3, const tensor::Tensor& output,
+                           void* stream) {
+  int32_t rows = 0, hidden_dim = 0, dim = 0;
+  check_ffn_shapes(input, w1, w3, output, &rows, &hidden_dim, &dim);
+  if (rows >= kFFNGemmMinRows) {
+    swiglu_gemm_kernel_cpu(input, w1, w3, output, stream);
+    return;
+  }
+  const float* in_ptr = input.ptr<float>();
+  const float* w1_ptr = w1.ptr<float>();
+  const float* w3_ptr = w3.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+
+  base::ThreadPool* pool = get_thread_pool(stream);
+  pool->parallel_for(0, hidden_dim, kFFNRowGrain, [&](int64_t begin, int64_t end, int32_t) {
+    for (int32_t i = static_cast<int32_t>(begin); i < end; ++i) {
+      const float* w1_row = w1_ptr + static_cast<int64_t>(i) * dim;
+      const float* w3_row = w3_ptr + static_cast<int64_t>(i) * dim;
+      for (int32_t r = 0; r < rows; ++r) {
+        float gate = 0.f, up = 0.f;
+        dot2_ps(w1_row, w3_row, in_ptr + static_cast<int64_t>(r) * dim, dim, &gate, &up);
+        out_ptr[static_cast<int64_t>(r) * hidden_dim + i] = silu(gate) * up;
+      }
+    }
+  });
+}
+
+void swiglu_ffn_kernel_cpu_qint8(const tensor::Tensor& input, const tensor::Tensor& w1,
+                                 const tensor::Tensor& w3, int32_t group_size,
+                                 const tensor::Tensor& scale1, const tensor::Tensor& scale3,
+                                 const tensor::Tensor& output, void* stream) {
+  int32_t rows = 0, hidden_dim = 0, dim = 0;
+  check_ffn_shapes(input, w1, w3, output, &rows, &hidden_dim, &dim);
+  CHECK(w1.data_type() == base::DataType::kDataTypeInt8 &&
+        w3.data_type() == base::DataType::kDataTypeInt8);
+  CHECK_GT(group_size, 0);
+  CHECK_EQ(scale1.size() * group_size, w1.size());
+  CHECK_EQ(scale3.size() * group_size, w3.size());
+  if (rows >= kFFNQInt8GemmMinRows) {
+    swiglu_gemm_kernel_cpu_qint8(input, w1, w3, group_size, scale1, scale3, output, stream);
+    return;
+  }
+  const float* in_ptr = input.ptr<float>();
+  const int8_t* w1_ptr = w1.ptr<int8_t>();
+  const int8_t* w3_ptr = w3.ptr<int8_t>();
+  const float* s1_ptr = scale1.ptr<float>();
+  const float* s3_ptr = scale3.ptr<float>();
+  float* out_ptr = const_cast<float*>(output.ptr<float>());
+
+  base::ThreadPool* pool = get_thread_pool(stream);
+  pool->parallel_for(0, hidden_dim, kFFNRowGrain, [&](int64_t begin, int64_t end, int32_t) {
+    for (int32_t i = static_cast<int32_t>(begin); i < end; ++i) {
+      const int64_t row_begin = static_cast<int64_t>(i) * dim;
+      for (int32_t r = 0; r < rows; ++r) {
+        const float* x = in_ptr + static_cast<int64_t>(r) * dim;
+        float gate = 0.f, up = 0.f;
+        //w1和w3形状相同，量化组的边界也相同
+        int32_t k = 0;
+        while (k < dim) {
+          const int64_t group = (row_begin + k) / group_size;
+          const int32_t group_end =
+              static_cast<int32_t>(std::min<int64_t>(dim, (group + 1) * group_size - row_begin));
+          float g = 0.f, u = 0.f;
+          dot2_qint8_ps(w1_ptr + row_begin + k, w3_ptr + row_begin + k, x + k, group_end - k, &g,
+                        &u);
+          gate += s1_ptr[group] * g;
+          up += s3_ptr[group] * u;
+          k = group_end;
+        }
+        out_ptr[static_cast<int64_t>(r) * hidden_dim + i] = silu(gate) * up;
+      }
+    }
+  });
+}
+}  // namespace kernel
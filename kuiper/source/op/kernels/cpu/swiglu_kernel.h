@@ -0,0 +1,20 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_CPU_SWIGLU_KERNEL_H_
+#define KUIPER_SOURCE_OP_KERNELS_CPU_SWIGLU_KERNEL_H_
+#include "tensor/tensor.h"
+namespace kernel {
+/// @brief 融合的FFN前半段 output = silu(w1 * input) * (w3 * input)
+//w1、w3都是[hidden_dim, dim]，每个输出行在同一个循环里同时扫w1和w3的对应行，
+//input只加载一次，silu和乘法在寄存器里做完，只写出一个[hidden_dim]的中间结果给下投影用。
+//input可以是[dim]或者堆叠起来的[rows, dim]，行数多的prompt交给swiglu_gemm_kernel_cpu，
+//w1、w3走和Linear一样的分块GEMM，silu和乘法在GEMM的写出阶段做。
+void swiglu_ffn_kernel_cpu(const tensor::Tensor& input, const tensor::Tensor& w1,
+                           const tensor::Tensor& w3, const tensor::Tensor& output,
+                           void* stream = nullptr);
+
+/// @brief 同上，w1、w3是int8分组量化的权重，scale1、scale3分别是它们的scales
+void swiglu_ffn_kernel_cpu_qint8(const tensor::Tensor& input, const tensor::Tensor& w1,
+                                 const tensor::Tensor& w3, int32_t group_size,
+                                 const tensor::Tensor& scale1, const tensor::Tensor& scale3,
+                                 const tensor::Tensor& output, void* stream = nullptr);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_CPU_SWIGLU_KERNEL_H_
@@ -0,0 +1,137 @@
+#include "kernels_interface.h"
+#include <glog/logging.h>
+#include "cpu/add_kernel.h"
+#include "cpu/emb_kernel.h"
+#include "cpu/matmul_kernel.h"
+#include "cpu/mha_kernel.h"
+#include "cpu/rmsnorm_kernel.h"
+#include "cpu/rope_kernel.h"
+#include "cpu/softmax_kernel.h"
+#include "cpu/swiglu_kernel.h"
+namespace kernel {
+AddKernel get_add_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return add_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get an add kernel.";
+    return nullptr;
+  }
+}
+
+AddRMSNormKernel get_add_rmsnorm_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return add_rmsnorm_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get an add rmsnorm kernel.";
+    return nullptr;
+  }
+}
+
+EmbeddingKernel get_emb_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return emb_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get an embedding kernel.";
+    return nullptr;
+  }
+}
+
+RMSNormKernel get_rmsnorm_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return rmsnorm_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a rmsnorm kernel.";
+    return nullptr;
+  }
+}
+
+MatmulKernel get_matmul_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return matmul_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a matmul kernel.";
+    return nullptr;
+  }
+}
+
+MatmulKernelQuant get_matmul_kernel_quant8(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return matmul_kernel_cpu_qint8;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a quantized matmul kernel.";
+    return nullptr;
+  }
+}
+
+MatmulKernelQuant4 get_matmul_kernel_quant4(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return matmul_kernel_cpu_q4;
+  } else {
+    LOG(FATAL) << "Unknown device type for get an int4 matmul kernel.";
+    return nullptr;
+  }
+}
+
+MatmulKernelNuma get_matmul_kernel_numa(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return matmul_kernel_cpu_numa;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a numa matmul kernel.";
+    return nullptr;
+  }
+}
+
+MatmulKernelQuantNuma get_matmul_kernel_quant8_numa(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return matmul_kernel_cpu_qint8_numa;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a quantized numa matmul kernel.";
+    return nullptr;
+  }
+}
+
+RoPEKernel get_rope_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return rope_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a rope kernel.";
+    return nullptr;
+  }
+}
+
+MHAKernel get_mha_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return mha_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a mha kernel.";
+    return nullptr;
+  }
+}
+
+SoftmaxInplaceKernel get_softmax_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return softmax_inplace_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a softmax kernel.";
+    return nullptr;
+  }
+}
+
+SwiGLUFFNKernel get_swiglu_ffn_kernel(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return swiglu_ffn_kernel_cpu;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a swiglu ffn kernel.";
+    return nullptr;
+  }
+}
+
+SwiGLUFFNKernelQuant get_swiglu_ffn_kernel_quant8(base::DeviceType device_type) {
+  if (device_type == base::DeviceType::kDeviceCPU) {
+    return swiglu_ffn_kernel_cpu_qint8;
+  } else {
+    LOG(FATAL) << "Unknown device type for get a quantized swiglu ffn kernel.";
+    return nullptr;
+  }
+}
+}  // namespace kernel
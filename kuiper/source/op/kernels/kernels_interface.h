@@ -0,0 +1,89 @@
+#ifndef KUIPER_SOURCE_OP_KERNELS_KERNELS_INTERFACE_H_
+#define KUIPER_SOURCE_OP_KERNELS_KERNELS_INTERFACE_H_
+#include "op/kv_cache.h"
+#include "tensor/tensor.h"
+namespace kernel {
+//layer只通过这里拿到对应设备的kernel函数，不直接依赖cpu/下面的具体实现
+typedef void (*AddKernel)(const tensor::Tensor& input1, const tensor::Tensor& input2,
+                          const tensor::Tensor& output, void* stream);
+
+typedef void (*AddRMSNormKernel)(const tensor::Tensor& residual, const tensor::Tensor& delta,
+                                 const tensor::Tensor& weight, const tensor::Tensor& residual_out,
+                                 const tensor::Tensor& norm_out, float eps, void* stream);
+
+typedef void (*EmbeddingKernel)(const tensor::Tensor& input, const tensor::Tensor& weight,
+                                const tensor::Tensor& output, int32_t vocab_size, void* stream);
+
+typedef void (*RMSNormKernel)(const tensor::Tensor& input, const tensor::Tensor& weight,
+                              const tensor::Tensor& output, float eps, void* stream);
+
+typedef void (*MatmulKernel)(const tensor::Tensor& input, const tensor::Tensor& weight,
+                             const tensor::Tensor& output, void* stream);
+
+typedef void (*MatmulKernelQuant)(const tensor::Tensor& input, const tensor::Tensor& weight,
+                                  const tensor::Tensor& output, int32_t group_size,
+                                  const tensor::Tensor& scale, void* stream);
+
+typedef void (*MatmulKernelQuant4)(const tensor::Tensor& input, const tensor::Tensor& weight,
+                                   const tensor::Tensor& output, int32_t group_size,
+                                   const tensor::Tensor& scale, const tensor::Tensor& min,
+                                   void* stream);
+
+typedef void (*MatmulKernelNuma)(const tensor::Tensor& input,
+                                 const std::vector<tensor::Tensor>& weights,
+                                 const tensor::Tensor& output, void* stream);
+
+typedef void (*MatmulKernelQuantNuma)(const tensor::Tensor& input,
+                                      const std::vector<tensor::Tensor>& weights,
+                                      const tensor::Tensor& output, int32_t group_size,
+                                      const std::vector<tensor::Tensor>& scales, void* stream);
+
+typedef void (*RoPEKernel)(int32_t dim, int32_t kv_dim, int32_t head_size,
+                           const tensor::Tensor& input_q, const tensor::Tensor& input_k,
+                           const tensor::Tensor& input_pos, const tensor::Tensor& sin_cache,
+                           const tensor::Tensor& cos_cache, void* stream);
+
+typedef void (*MHAKernel)(int32_t pos, int32_t head_num, int32_t kv_mul, int32_t head_size,
+                          const tensor::Tensor& mha_out, const tensor::Tensor& query_tensor,
+                          const op::KVCacheView& kv, void* stream);
+
+typedef void (*SoftmaxInplaceKernel)(const tensor::Tensor& input, void* stream);
+
+typedef void (*SwiGLUFFNKernel)(const tensor::Tensor& input, const tensor::Tensor& w1,
+                                const tensor::Tensor& w3, const tensor::Tensor& output,
+                                void* stream);
+
+typedef void (*SwiGLUFFNKernelQuant)(const tensor::Tensor& input, const tensor::Tensor& w1,
+                                     const tensor::Tensor& w3, int32_t group_size,
+                                     const tensor::Tensor& scale1, const tensor::Tensor& scale3,
+                                     const tensor::Tensor& output, void* stream);
+
+AddKernel get_add_kernel(base::DeviceType device_type);
+
+AddRMSNormKernel get_add_rmsnorm_kernel(base::DeviceType device_type);
+
+EmbeddingKernel get_emb_kernel(base::DeviceType device_type);
+
+RMSNormKernel get_rmsnorm_kernel(base::DeviceType device_type);
+
+MatmulKernel get_matmul_kernel(base::DeviceType device_type);
+
+MatmulKernelQuant get_matmul_kernel_quant8(base::DeviceType device_type);
+
+MatmulKernelQuant4 get_matmul_kernel_quant4(base::DeviceType device_type);
+
+MatmulKernelNuma get_matmul_kernel_numa(base::DeviceType device_type);
+
+MatmulKernelQuantNuma get_matmul_kernel_quant8_numa(base::DeviceType device_type);
+
+RoPEKernel get_rope_kernel(base::DeviceType device_type);
+
+MHAKernel get_mha_kernel(base::DeviceType device_type);
+
+SoftmaxInplaceKernel get_softmax_kernel(base::DeviceType device_type);
+
+SwiGLUFFNKernel get_swiglu_ffn_kernel(base::DeviceType device_type);
+
+SwiGLUFFNKernelQuant get_swiglu_ffn_kernel_quant8(base::DeviceType device_type);
+}  // namespace kernel
+#endif  // KUIPER_SOURCE_OP_KERNELS_KERNELS_INTERFACE_H_
@@ -33,6 +33,10 @@ base::Status Layer::check_tensor(const tensor::Tensor& tensor, base::DeviceType
   if (tensor.data_type() != data_type) {
     return base::error::InvalidArgument("The tensor has a wrong data type.");
   }
+  //kernel都按行优先的紧凑排布直接读写指针，transpose这样不连续的视图要先clone
+  if (!tensor.is_contiguous()) {
+    return base::error::InvalidArgument("The tensor is not contiguous.");
+  }
   return base::error::Success();
 }
 const std::string& BaseLayer::get_layer_name() const { return layer_name_; }
@@ -55,6 +59,9 @@ base::Status Layer::check_tensor_with_dim(const tensor::Tensor& tensor, base::De
     if (tensor.data_type() != data_type) {
         return base::error::InvalidArgument("The tensor has a wrong data type.");
     }
+    if (!tensor.is_contiguous()) {
+        return base::error::InvalidArgument("The tensor is not contiguous.");
+    }
     //va_start 是C/C++中用于处理可变参数函数的宏，需配合 va_arg 和 va_end 使用。
     //使用 va_start 初始化参数列表指针，使其指向最后一个固定参数：
     std::va_list args;
@@ -133,20 +140,44 @@ void Layer::set_cuda_config(std::shared_ptr<kernel::CudaConfig> config) {
 }
 
 std::shared_ptr<kernel::CudaConfig> Layer::cuda_config() const { return cuda_config_; }
+
+void Layer::set_cpu_config(std::shared_ptr<kernel::CpuConfig> config) {
+  if (!config) {
+    return;
+  }
+  this->cpu_config_ = config;
+}
+
+std::shared_ptr<kernel::CpuConfig> Layer::cpu_config() const { return cpu_config_; }
+
+void* Layer::kernel_stream() const {
+  if (device_type_ == base::DeviceType::kDeviceCUDA) {
+    return cuda_config_ ? cuda_config_->stream : nullptr;
+  }
+  return cpu_config_ ? cpu_config_->thread_pool.get() : nullptr;
+}
 size_t Layer::input_size() const { return inputs_.size(); }
 
 size_t Layer::output_size() const { return outputs_.size(); }
 LayerParam::LayerParam(base::DeviceType device_type, LayerType layer_type, bool is_quant_layer,
   std::string layer_name)
-: Layer(device_type, layer_type, std::move(layer_name)), is_quant_layer_(is_quant_layer) {}
+: Layer(device_type, layer_type, std::move(layer_name)),
+  is_quant_layer_(is_quant_layer),
+  weight_data_type_(is_quant_layer ? base::DataType::kDataTypeInt8
+                                   : base::DataType::kDataTypeFp32) {}
 //weight还有顺序吗
 base::Status LayerParam::set_weight(int32_t idx, const tensor::Tensor& weight) {
   CHECK_GE(idx, 0);
   CHECK_LT(idx, weights_.size());
-  CHECK(weight.data_type() == base::DataType::kDataTypeFp32);
+  CHECK(weight.data_type() == base::DataType::kDataTypeFp32 ||
+        weight.data_type() == base::DataType::kDataTypeFp16 ||
+        weight.data_type() == base::DataType::kDataTypeBf16);
   if (!weight.is_empty()) {
     CHECK(weight.device_type() == device_type_);
   }
+  if (!is_quant_layer_) {
+    weight_data_type_ = weight.data_type();
+  }
   weights_.at(idx) = weight;
   return base::error::Success();
 }
@@ -164,6 +195,9 @@ void LayerParam::to_cuda() {
   if (!scales_.is_empty()) {
     scales_.to_cuda(cuda_config_ ? cuda_config_->stream : nullptr);
   }
+  if (!mins_.is_empty()) {
+    mins_.to_cuda(cuda_config_ ? cuda_config_->stream : nullptr);
+  }
 }
 ///这个看不太懂
 base::Status LayerParam::set_weight(int32_t idx, const std::vector<int32_t>& dims,
@@ -172,7 +206,10 @@ base::Status LayerParam::set_weight(int32_t idx, const std::vector<int32_t>& dim
   CHECK_LT(idx, weights_.size());
   CHECK_NE(weight_ptr, nullptr);
 
-  size_t size = std::accumulate(dims.begin(), dims.end(), sizeof(float), std::multiplies<>());
+  //int8权重一个元素只占一个字节，int4两个元素一个字节，scales另外单独包成一个tensor；fp16/bf16两个字节
+  const size_t elem_num =
+      std::accumulate(dims.begin(), dims.end(), size_t(1), std::multiplies<>());
+  const size_t size = base::DataTypeByteSize(weight_data_type_, elem_num);
   std::shared_ptr<base::Buffer> buffer =
   std::make_shared<base::Buffer>(size, nullptr, const_cast<void*>(weight_ptr), true);
   if (device_type != base::DeviceType::kDeviceUnknown) {
@@ -180,10 +217,29 @@ base::Status LayerParam::set_weight(int32_t idx, const std::vector<int32_t>& dim
   }
 
   if (!is_quant_layer_) {
-    tensor::Tensor weight(base::DataType::kDataTypeFp32, dims);
+    tensor::Tensor weight(weight_data_type_, dims);
     weight.set_device_type(device_type);
     CHECK(weight.assign(buffer));
     weights_.at(idx) = weight;
+  } else if (weight_data_type_ == base::DataType::kDataTypeInt4) {
+    //int4：权重后面是每组一个fp16的scale，带min时再跟着每组一个fp16的min
+    tensor::Tensor weight(base::DataType::kDataTypeInt4, dims);
+    weight.set_device_type(device_type);
+    CHECK(weight.assign(buffer));
+    weights_.at(idx) = weight;
+
+    CHECK(elem_num % group_size_ == 0);
+    const int32_t scale_nums = static_cast<int32_t>(elem_num / group_size_);
+    uint16_t* scale_ptr = reinterpret_cast<uint16_t*>((int8_t*)weight_ptr + size);
+    scales_ = tensor::Tensor{base::DataType::kDataTypeFp16, scale_nums, false, nullptr, scale_ptr};
+    scales_.set_device_type(device_type);
+    if (weight_with_min_) {
+      mins_ = tensor::Tensor{base::DataType::kDataTypeFp16, scale_nums, false, nullptr,
+                             scale_ptr + scale_nums};
+      mins_.set_device_type(device_type);
+    } else {
+      mins_ = tensor::Tensor();
+    }
   } else {
   // is quant layer
     tensor::Tensor weight(base::DataType::kDataTypeInt8, dims);
@@ -210,11 +266,29 @@ void LayerParam::set_scales(const tensor::Tensor& scales) {
 
 void LayerParam::set_group_size(int32_t group_size) { this->group_size_ = group_size; }
 
+void LayerParam::set_weight_data_type(base::DataType data_type, bool with_min) {
+  if (is_quant_layer_) {
+    CHECK(data_type == base::DataType::kDataTypeInt8 || data_type == base::DataType::kDataTypeInt4);
+  } else {
+    CHECK(data_type == base::DataType::kDataTypeFp32 ||
+          data_type == base::DataType::kDataTypeFp16 || data_type == base::DataType::kDataTypeBf16);
+  }
+  CHECK(!with_min || data_type == base::DataType::kDataTypeInt4);
+  this->weight_data_type_ = data_type;
+  this->weight_with_min_ = with_min;
+}
+
+base::DataType LayerParam::weight_data_type() const { return weight_data_type_; }
+
+bool LayerParam::weight_with_min() const { return weight_with_min_; }
+
 int32_t LayerParam::get_scale_num() const {
   CHECK(!scales_.is_empty());
   return static_cast<int32_t>(scales_.size());
 }
 
+bool LayerParam::is_quant_layer() const { return is_quant_layer_; }
+
 void LayerParam::reset_weight_size(size_t size) { weights_.resize(size); }
 
 size_t LayerParam::weight_size() const { return weights_.size(); }
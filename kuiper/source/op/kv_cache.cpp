@@ -0,0 +1,74 @@
+#include "op/kv_cache.h"
+#include <glog/logging.h>
+namespace op {
+KVCache::KVCache(int32_t layer_num, int32_t seq_len, int32_t kv_dim)
+    : layer_num_(layer_num), seq_len_(seq_len), kv_dim_(kv_dim) {}
+
+base::Status KVCache::init(std::shared_ptr<base::DeviceAllocator> alloc) {
+  if (!alloc) {
+    return base::error::InvalidArgument("The allocator of the kv cache is null.");
+  }
+  if (layer_num_ <= 0 || seq_len_ <= 0 || kv_dim_ <= 0) {
+    return base::error::InvalidArgument("The shape of the kv cache is invalid.");
+  }
+  buffer_ = std::make_shared<base::Buffer>(byte_size(), alloc);
+  if (!buffer_->ptr()) {
+    return base::error::InternalError("Failed to allocate the kv cache.");
+  }
+  alloc->memset_zero(buffer_->ptr(), byte_size(), nullptr);
+
+  //key和value是[2, layer_num, seq_len, kv_dim]在第0维上的两个切片，都共享buffer_，不另外借用内存
+  tensor::Tensor cache(base::DataType::kDataTypeFp32,
+                       std::vector<int32_t>{2, layer_num_, seq_len_, kv_dim_});
+  if (!cache.assign(buffer_)) {
+    return base::error::InternalError("Failed to assign the kv cache buffer.");
+  }
+  key_cache_ = cache.slice(0, 0, 1).view({layer_num_, seq_len_, kv_dim_});
+  value_cache_ = cache.slice(0, 1, 2).view({layer_num_, seq_len_, kv_dim_});
+  return base::error::Success();
+}
+
+float* KVCache::key(int32_t layer_idx, int32_t pos) {
+  CHECK_GE(layer_idx, 0);
+  CHECK_LT(layer_idx, layer_num_);
+  CHECK_GE(pos, 0);
+  CHECK_LT(pos, seq_len_);
+  return key_cache_.ptr<float>((static_cast<int64_t>(layer_idx) * seq_len_ + pos) * kv_dim_);
+}
+
+float* KVCache::value(int32_t layer_idx, int32_t pos) {
+  CHECK_GE(layer_idx, 0);
+  CHECK_LT(layer_idx, layer_num_);
+  CHECK_GE(pos, 0);
+  CHECK_LT(pos, seq_len_);
+  return value_cache_.ptr<float>((static_cast<int64_t>(layer_idx) * seq_len_ + pos) * kv_dim_);
+}
+
+KVCacheView KVCache::view(int32_t layer_idx) const {
+  CHECK_GE(layer_idx, 0);
+  CHECK_LT(layer_idx, layer_num_);
+  KVCacheView view;
+  view.key = key_cache_.ptr<float>();
+  view.value = value_cache_.ptr<float>();
+  view.block_table = block_table_;
+  view.block_size = seq_len_;
+  view.kv_dim = kv_dim_;
+  view.block_stride = static_cast<int64_t>(layer_num_) * seq_len_ * kv_dim_;
+  view.layer_offset = static_cast<int64_t>(layer_idx) * seq_len_ * kv_dim_;
+  return view;
+}
+
+const tensor::Tensor& KVCache::key_cache() const { return key_cache_; }
+
+const tensor::Tensor& KVCache::value_cache() const { return value_cache_; }
+
+int32_t KVCache::layer_num() const { return layer_num_; }
+
+int32_t KVCache::seq_len() const { return seq_len_; }
+
+int32_t KVCache::kv_dim() const { return kv_dim_; }
+
+size_t KVCache::byte_size() const {
+  return 2 * static_cast<size_t>(layer_num_) * seq_len_ * kv_dim_ * sizeof(float);
+}
+}  // namespace op
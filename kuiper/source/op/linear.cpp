@@ -0,0 +1,269 @@
+#include "op/linear.h"
+#include <cstring>
+#include <numeric>
+#include "kernels/cpu/convert_kernel.h"
+#include "kernels/cpu/matmul_kernel.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+LinearLayer::LinearLayer(base::DeviceType device_type, int32_t dim0, int32_t dim1,
+                         bool is_quant_layer)
+    : LayerParam(device_type, LayerType::kLayerLinear, is_quant_layer, "Linear"),
+      dim0_(dim0),
+      dim1_(dim1) {
+  reset_input_size(1);
+  reset_output_size(1);
+  reset_weight_size(1);
+}
+
+base::Status LinearLayer::check() const {
+  //输入可以是单个token的[dim1]，也可以是堆叠起来的[rows, dim1]
+  const tensor::Tensor& input = get_input(0);
+  const int32_t rows = input.dims_size() == 2 ? input.get_dim(0) : 1;
+  base::Status status;
+  if (input.dims_size() == 2) {
+    status = check_tensor_with_dim(input, device_type_, data_type_, rows, dim1_);
+  } else {
+    status = check_tensor_with_dim(input, device_type_, data_type_, dim1_);
+  }
+  if (!status) {
+    LOG(ERROR) << "The input tensor error in the linear layer.";
+    return status;
+  }
+
+  if (!is_quant_layer_) {
+    if (weight_data_type_ != base::DataType::kDataTypeFp32 &&
+        device_type_ != base::DeviceType::kDeviceCPU) {
+      return base::error::InvalidArgument("The 16-bit weights are only supported on the cpu.");
+    }
+    status = check_tensor_with_dim(get_weight(0), device_type_, weight_data_type_, dim0_, dim1_);
+    if (!status) {
+      LOG(ERROR) << "The weight tensor error in the linear layer.";
+      return status;
+    }
+  } else {
+    const bool int4 = weight_data_type_ == base::DataType::kDataTypeInt4;
+    if (int4 && device_type_ != base::DeviceType::kDeviceCPU) {
+      return base::error::InvalidArgument("The int4 weights are only supported on the cpu.");
+    }
+    status = check_tensor_with_dim(get_weight(0), device_type_, weight_data_type_, dim0_, dim1_);
+    if (!status) {
+      LOG(ERROR) << "The weight tensor error in the linear layer.";
+      return status;
+    }
+    //int8的scale是fp32，int4的scale和min是fp16
+    const base::DataType scale_type =
+        int4 ? base::DataType::kDataTypeFp16 : base::DataType::kDataTypeFp32;
+    status = check_tensor(scales_, device_type_, scale_type);
+    if (!status) {
+      LOG(ERROR) << "The scale tensor error in the linear layer.";
+      return status;
+    }
+    if (int4 && weight_with_min_) {
+      status = check_tensor_with_dim(mins_, device_type_, scale_type,
+                                     static_cast<int32_t>(scales_.size()));
+      if (!status) {
+        LOG(ERROR) << "The min tensor error in the linear layer.";
+        return status;
+      }
+    }
+    if (int4 && (group_size_ % 32 != 0 || dim1_ % group_size_ != 0)) {
+      return base::error::InvalidArgument(
+          "The group size of the int4 linear layer must be a multiple of 32 and divide dim1.");
+    }
+  }
+
+  if (input.dims_size() == 2) {
+    status = check_tensor_with_dim(get_output(0), device_type_, data_type_, rows, dim0_);
+  } else {
+    status = check_tensor_with_dim(get_output(0), device_type_, data_type_, dim0_);
+  }
+  if (!status) {
+    LOG(ERROR) << "The output tensor error in the linear layer.";
+    return status;
+  }
+  return base::error::Success();
+}
+
+base::Status LinearLayer::forward() {
+  auto status = check();
+  if (!status) {
+    return status;
+  }
+  if (!numa_weights_.empty()) {
+    if (is_quant_layer_) {
+      kernel::get_matmul_kernel_quant8_numa(device_type_)(
+          get_input(0), numa_weights_, get_output(0), group_size_, numa_scales_, kernel_stream());
+    } else {
+      kernel::get_matmul_kernel_numa(device_type_)(get_input(0), numa_weights_, get_output(0),
+                                                   kernel_stream());
+    }
+  } else if (weight_data_type_ == base::DataType::kDataTypeInt4) {
+    kernel::get_matmul_kernel_quant4(device_type_)(get_input(0), get_weight(0), get_output(0),
+                                                   group_size_, scales_, mins_, kernel_stream());
+  } else if (is_quant_layer_) {
+    kernel::get_matmul_kernel_quant8(device_type_)(get_input(0), get_weight(0), get_output(0),
+                                                   group_size_, scales_, kernel_stream());
+  } else {
+    kernel::get_matmul_kernel(device_type_)(get_input(0), get_weight(0), get_output(0),
+                                            kernel_stream());
+  }
+  return base::error::Success();
+}
+
+base::Status LinearLayer::convert_weight(base::DataType data_type) {
+  if (device_type_ != base::DeviceType::kDeviceCPU || is_quant_layer_) {
+    return base::error::InvalidArgument(
+        "Only the fp32 weight of a non-quantized linear layer on the cpu can be converted.");
+  }
+  if (data_type != base::DataType::kDataTypeFp16 && data_type != base::DataType::kDataTypeBf16) {
+    return base::error::InvalidArgument("The linear weight can only be converted to fp16 or bf16.");
+  }
+  const tensor::Tensor weight = get_weight(0);
+  auto status = check_tensor_with_dim(weight, device_type_, base::DataType::kDataTypeFp32, dim0_,
+                                      dim1_);
+  if (!status) {
+    return status;
+  }
+  if (weight.layout() != base::TensorLayout::kLayoutRowMajor || !numa_weights_.empty()) {
+    return base::error::InvalidArgument(
+        "The weight of the linear layer must be converted before the numa placement and prepack.");
+  }
+  tensor::Tensor converted(data_type, dim0_, dim1_, true,
+                           base::CPUDeviceAllocatorFactory::get_instance());
+  if (converted.is_empty()) {
+    return base::error::InternalError("Failed to allocate the converted linear weight.");
+  }
+  kernel::convert_kernel_cpu(weight, converted, kernel_stream());
+  return set_weight(0, converted);
+}
+
+//新申请一块按policy放置的内存，把src从offset开始的byte_size字节拷过去
+static tensor::Tensor copy_to_numa(const tensor::Tensor& src, const std::vector<int32_t>& dims,
+                                   size_t byte_offset,
+                                   const std::shared_ptr<base::DeviceAllocator>& alloc) {
+  tensor::Tensor dst(src.data_type(), dims, true, alloc);
+  CHECK(!dst.is_empty());
+  std::memcpy(dst.ptr<int8_t>(), src.ptr<int8_t>() + byte_offset, dst.byte_size());
+  return dst;
+}
+
+base::Status LinearLayer::set_numa_policy(base::NumaPolicy policy) {
+  if (device_type_ != base::DeviceType::kDeviceCPU) {
+    return base::error::InvalidArgument("The numa placement is only supported on the cpu.");
+  }
+  const tensor::Tensor weight = get_weight(0);
+  if (weight.is_empty() || (is_quant_layer_ && scales_.is_empty())) {
+    return base::error::InvalidArgument(
+        "The weight of the linear layer must be set before the numa placement.");
+  }
+  if (weight.layout() != base::TensorLayout::kLayoutRowMajor) {
+    return base::error::InvalidArgument(
+        "The numa placement of the linear layer must be set before the weight prepack.");
+  }
+  numa_weights_.clear();
+  numa_scales_.clear();
+  numa_policy_ = policy;
+
+  const base::NumaTopology& topology = base::NumaTopology::get_instance();
+  const int32_t node_num = topology.node_num();
+  //每一段的起点要对齐到4行，int8还要落在量化组的边界上
+  int32_t row_align = 4;
+  if (is_quant_layer_) {
+    row_align = std::lcm(row_align, group_size_ / std::gcd(dim1_, group_size_));
+  }
+  //int4的kernel没有按节点切分的版本，只做交错放置
+  const bool int4 = weight_data_type_ == base::DataType::kDataTypeInt4;
+  if (policy == base::NumaPolicy::kNumaPolicyBind && (int4 || dim0_ < row_align * node_num)) {
+    numa_policy_ = base::NumaPolicy::kNumaPolicyInterleave;
+  }
+  if (numa_policy_ == base::NumaPolicy::kNumaPolicyDefault || node_num == 1) {
+    return base::error::Success();
+  }
+
+  const size_t elem_size = base::DataTypeSize(weight.data_type());
+  if (numa_policy_ == base::NumaPolicy::kNumaPolicyInterleave) {
+    auto alloc = std::make_shared<base::CPUNumaAllocator>(numa_policy_);
+    weights_.at(0) = copy_to_numa(weight, {dim0_, dim1_}, 0, alloc);
+    if (is_quant_layer_) {
+      scales_ = copy_to_numa(scales_, scales_.dims(), 0, alloc);
+    }
+    if (!mins_.is_empty()) {
+      mins_ = copy_to_numa(mins_, mins_.dims(), 0, alloc);
+    }
+    return base::error::Success();
+  }
+
+  //按每个节点的cpu数分配行数，cpu多的节点多算一些。中间的切分点都向下对齐到row_align，
+  //每个节点至少row_align行，dim0不是row_align倍数时多出来的行都给最后一个节点
+  const int32_t cpu_num = topology.cpu_num();
+  const int32_t align_num = dim0_ / row_align;
+  int32_t cpu_prefix = 0;
+  int32_t row_begin = 0;
+  for (int32_t node = 0; node < node_num; ++node) {
+    cpu_prefix += static_cast<int32_t>(topology.node_cpus(node).size());
+    int32_t row_end = dim0_;
+    if (node != node_num - 1) {
+      row_end = static_cast<int32_t>(static_cast<int64_t>(dim0_) * cpu_prefix / cpu_num);
+      row_end = row_end / row_align * row_align;
+      row_end = std::max(row_end, row_begin + row_align);
+      row_end = std::min(row_end, (align_num - (node_num - 1 - node)) * row_align);
+    }
+    const int32_t rows = row_end - row_begin;
+    auto alloc = std::make_shared<base::CPUNumaAllocator>(base::NumaPolicy::kNumaPolicyBind, node);
+    const int64_t elem_offset = static_cast<int64_t>(row_begin) * dim1_;
+    numa_weights_.push_back(copy_to_numa(weight, {rows, dim1_}, elem_offset * elem_size, alloc));
+    if (is_quant_layer_) {
+      const int32_t scale_num =
+          static_cast<int32_t>(static_cast<int64_t>(rows) * dim1_ / group_size_);
+      numa_scales_.push_back(copy_to_numa(scales_, {scale_num},
+                                          elem_offset / group_size_ * sizeof(float), alloc));
+    }
+    row_begin = row_end;
+  }
+  return base::error::Success();
+}
+
+base::NumaPolicy LinearLayer::numa_policy() const { return numa_policy_; }
+
+size_t LinearLayer::packed_weight_byte_size() const {
+  const tensor::Tensor& weight = get_weight(0);
+  if (device_type_ != base::DeviceType::kDeviceCPU || weight.is_empty() ||
+      !numa_weights_.empty() || weight.layout() != base::TensorLayout::kLayoutRowMajor) {
+    return 0;
+  }
+  return kernel::packed_weight_byte_size(weight.data_type(), dim0_, dim1_,
+                                         is_quant_layer_ ? group_size_ : 0);
+}
+
+base::Status LinearLayer::prepack_weight(const void* packed) {
+  const size_t byte_size = packed_weight_byte_size();
+  if (byte_size == 0) {
+    return base::error::InvalidArgument("The weight of the linear layer can not be prepacked.");
+  }
+  const tensor::Tensor& weight = get_weight(0);
+  std::shared_ptr<base::Buffer> buffer;
+  if (packed) {
+    buffer = std::make_shared<base::Buffer>(byte_size, nullptr, const_cast<void*>(packed), true);
+    buffer->set_device_type(base::DeviceType::kDeviceCPU);
+  } else {
+    //沿用原来权重的分配器，交错放置过的权重打包之后还是交错的
+    auto alloc = weight.get_buffer()->allocator();
+    if (!alloc) {
+      alloc = base::CPUDeviceAllocatorFactory::get_instance();
+    }
+    buffer = std::make_shared<base::Buffer>(byte_size, alloc);
+    if (!buffer->ptr()) {
+      return base::error::InternalError(
+          "Failed to allocate the packed weight of the linear layer.");
+    }
+    kernel::pack_weight_cpu(weight, scales_, group_size_, buffer->ptr(), kernel_stream());
+  }
+  //dims仍然是逻辑上的[dim0, dim1]，check不需要区分排布
+  tensor::Tensor packed_weight;
+  packed_weight.reset(weight.data_type(), {dim0_, dim1_});
+  packed_weight.assign(buffer);
+  packed_weight.set_layout(base::TensorLayout::kLayoutPanel16);
+  weights_.at(0) = packed_weight;
+  return base::error::Success();
+}
+}  // namespace op
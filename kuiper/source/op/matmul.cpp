@@ -0,0 +1,46 @@
+#include "op/matmul.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+MatmulLayer::MatmulLayer(base::DeviceType device_type)
+    : Layer(device_type, LayerType::kLayerMatmul, "Matmul") {
+  reset_input_size(2);
+  reset_output_size(1);
+}
+
+base::Status MatmulLayer::check() const {
+  const tensor::Tensor& input0 = get_input(0);
+  const tensor::Tensor& input1 = get_input(1);
+  if (input0.dims_size() != 2 || input1.dims_size() != 2) {
+    return base::error::InvalidArgument("The inputs of the matmul layer must be 2-D.");
+  }
+  const int32_t m = input0.get_dim(0);
+  const int32_t k = input0.get_dim(1);
+  const int32_t n = input1.get_dim(0);
+  auto status = check_tensor_with_dim(input0, device_type_, data_type_, m, k);
+  if (!status) {
+    LOG(ERROR) << "The input tensor 0 error in the matmul layer.";
+    return status;
+  }
+  status = check_tensor_with_dim(input1, device_type_, data_type_, n, k);
+  if (!status) {
+    LOG(ERROR) << "The input tensor 1 error in the matmul layer.";
+    return status;
+  }
+  status = check_tensor_with_dim(get_output(0), device_type_, data_type_, m, n);
+  if (!status) {
+    LOG(ERROR) << "The output tensor error in the matmul layer.";
+    return status;
+  }
+  return base::error::Success();
+}
+
+base::Status MatmulLayer::forward() {
+  auto status = check();
+  if (!status) {
+    return status;
+  }
+  kernel::get_matmul_kernel(device_type_)(get_input(0), get_input(1), get_output(0),
+                                          kernel_stream());
+  return base::error::Success();
+}
+}  // namespace op
@@ -0,0 +1,144 @@
+#include "op/mha.h"
+#include "kernels/cpu/mha_kernel.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+MultiHeadAttention::MultiHeadAttention(base::DeviceType device_type, int32_t layer_index,
+                                       int32_t kv_mul, int32_t kv_dim, int32_t seq_len,
+                                       int32_t head_num, int32_t head_size)
+    : Layer(device_type, LayerType::kLayerMHA, "MultiHead"),
+      layer_index_(layer_index),
+      kv_mul_(kv_mul),
+      kv_dim_(kv_dim),
+      seq_len_(seq_len),
+      head_num_(head_num),
+      head_size_(head_size) {
+  reset_input_size(3);
+  reset_output_size(1);
+}
+
+base::Status MultiHeadAttention::init() {
+  if (kv_mul_ <= 0 || head_num_ % kv_mul_ != 0) {
+    return base::error::InvalidArgument("The head num is not divisible by kv_mul in the mha layer.");
+  }
+  return base::error::Success();
+}
+
+base::Status MultiHeadAttention::check() const {
+  //单个token是一维的，一段prompt是[rows, ...]
+  const tensor::Tensor& query = get_input(0);
+  const int32_t rows = query.dims_size() == 2 ? query.get_dim(0) : 1;
+  auto check_rows = [&](const tensor::Tensor& tensor, int32_t width) {
+    if (query.dims_size() == 2) {
+      return check_tensor_with_dim(tensor, device_type_, data_type_, rows, width);
+    }
+    return check_tensor_with_dim(tensor, device_type_, data_type_, width);
+  };
+  auto status = check_rows(query, head_num_ * head_size_);
+  if (!status) {
+    LOG(ERROR) << "The query tensor error in the mha layer.";
+    return status;
+  }
+  for (int32_t i = 1; i < 3; ++i) {
+    status = check_rows(get_input(i), kv_dim_);
+    if (!status) {
+      LOG(ERROR) << "The input tensor " << std::to_string(i) << " error in the mha layer.";
+      return status;
+    }
+  }
+  status = check_rows(get_output(0), head_num_ * head_size_);
+  if (!status) {
+    LOG(ERROR) << "The output tensor error in the mha layer.";
+    return status;
+  }
+  if (layer_index_ < 0) {
+    return base::error::InvalidArgument("The layer index of the mha layer is negative.");
+  }
+  const int32_t last_pos = pos_ + rows - 1;
+  if (paged_kv_cache_) {
+    if (paged_kv_cache_->kv_dim() != kv_dim_ || layer_index_ >= paged_kv_cache_->layer_num() ||
+        !paged_kv_cache_->has_sequence(seq_id_)) {
+      return base::error::InvalidArgument("The paged kv cache of the mha layer is mismatched.");
+    }
+    //int8的scale按head_size个数一组存，attention按头反量化，两边的head_size必须一样
+    if (paged_kv_cache_->format() == KVCacheFormat::kInt8 &&
+        paged_kv_cache_->head_size() != head_size_) {
+      return base::error::InvalidArgument(
+          "The scale group of the int8 paged kv cache is not the head size of the mha layer.");
+    }
+    const int64_t reserved = static_cast<int64_t>(paged_kv_cache_->block_table(seq_id_).size()) *
+                             paged_kv_cache_->block_size();
+    if (last_pos >= reserved) {
+      return base::error::InvalidArgument("The position of the mha layer is not reserved.");
+    }
+  } else if (!kv_cache_ || kv_cache_->kv_dim() != kv_dim_ || kv_cache_->seq_len() != seq_len_ ||
+             layer_index_ >= kv_cache_->layer_num()) {
+    return base::error::InvalidArgument("The kv cache of the mha layer is not set or mismatched.");
+  }
+  if (pos_ < 0 || last_pos >= seq_len_) {
+    return base::error::InvalidArgument("The position of the mha layer is out of range.");
+  }
+  return base::error::Success();
+}
+
+base::Status MultiHeadAttention::forward() {
+  auto status = check();
+  if (!status) {
+    return status;
+  }
+  //当前这些token的key/value写进cache里对应的行，分页cache里相邻位置可能不在同一个block，按行拷
+  auto alloc = base::DeviceAllocatorFactory::get_instance(device_type_);
+  const int32_t rows = static_cast<int32_t>(get_input(1).size() / kv_dim_);
+  const size_t row_bytes = kv_dim_ * sizeof(float);
+  const float* key = get_input(1).ptr<float>();
+  const float* value = get_input(2).ptr<float>();
+  for (int32_t r = 0; r < rows; ++r) {
+    const int32_t pos = pos_ + r;
+    const int64_t offset = static_cast<int64_t>(r) * kv_dim_;
+    if (paged_kv_cache_ && paged_kv_cache_->format() != KVCacheFormat::kFp32) {
+      //fp16/int8的cache边写边转换，只在cpu上
+      const KVCacheFormat format = paged_kv_cache_->format();
+      const int32_t group = paged_kv_cache_->head_size();
+      kernel::kv_store_row_cpu(format, key + offset,
+                               paged_kv_cache_->key_data(seq_id_, layer_index_, pos),
+                               format == KVCacheFormat::kInt8
+                                   ? paged_kv_cache_->key_scales(seq_id_, layer_index_, pos)
+                                   : nullptr,
+                               kv_dim_, group);
+      kernel::kv_store_row_cpu(format, value + offset,
+                               paged_kv_cache_->value_data(seq_id_, layer_index_, pos),
+                               format == KVCacheFormat::kInt8
+                                   ? paged_kv_cache_->value_scales(seq_id_, layer_index_, pos)
+                                   : nullptr,
+                               kv_dim_, group);
+    } else if (paged_kv_cache_) {
+      alloc->memcpy(key + offset, paged_kv_cache_->key(seq_id_, layer_index_, pos), row_bytes);
+      alloc->memcpy(value + offset, paged_kv_cache_->value(seq_id_, layer_index_, pos), row_bytes);
+    } else {
+      alloc->memcpy(key + offset, kv_cache_->key(layer_index_, pos), row_bytes);
+      alloc->memcpy(value + offset, kv_cache_->value(layer_index_, pos), row_bytes);
+    }
+  }
+  const KVCacheView view = paged_kv_cache_ ? paged_kv_cache_->view(seq_id_, layer_index_)
+                                           : kv_cache_->view(layer_index_);
+
+  kernel::get_mha_kernel(device_type_)(pos_, head_num_, kv_mul_, head_size_, get_output(0),
+                                       get_input(0), view, kernel_stream());
+  return base::error::Success();
+}
+
+void MultiHeadAttention::set_pos(int32_t pos) { this->pos_ = pos; }
+
+void MultiHeadAttention::set_layer_idx(int32_t layer_idx) { this->layer_index_ = layer_idx; }
+
+void MultiHeadAttention::set_kv_cache(std::shared_ptr<KVCache> kv_cache) {
+  this->kv_cache_ = std::move(kv_cache);
+  this->paged_kv_cache_.reset();
+}
+
+void MultiHeadAttention::set_paged_kv_cache(std::shared_ptr<PagedKVCache> kv_cache,
+                                            int32_t seq_id) {
+  this->paged_kv_cache_ = std::move(kv_cache);
+  this->seq_id_ = seq_id;
+  this->kv_cache_.reset();
+}
+}  // namespace op
@@ -0,0 +1,238 @@
+#include "op/paged_kv_cache.h"
+#include <glog/logging.h>
+namespace op {
+PagedKVCache::PagedKVCache(int32_t layer_num, int32_t kv_dim, int32_t block_size,
+                           int32_t num_blocks, KVCacheFormat format, int32_t head_size)
+    : layer_num_(layer_num),
+      kv_dim_(kv_dim),
+      block_size_(block_size),
+      num_blocks_(num_blocks),
+      format_(format),
+      head_size_(head_size > 0 ? head_size : kv_dim) {}
+
+base::Status PagedKVCache::init(std::shared_ptr<base::DeviceAllocator> alloc) {
+  if (!alloc) {
+    return base::error::InvalidArgument("The allocator of the paged kv cache is null.");
+  }
+  if (layer_num_ <= 0 || kv_dim_ <= 0 || block_size_ <= 0 || num_blocks_ <= 0 ||
+      kv_dim_ % head_size_ != 0) {
+    return base::error::InvalidArgument("The shape of the paged kv cache is invalid.");
+  }
+  if (format_ != KVCacheFormat::kFp32 && alloc->device_type() != base::DeviceType::kDeviceCPU) {
+    return base::error::InvalidArgument("The quantized paged kv cache only supports the cpu.");
+  }
+  buffer_ = std::make_shared<base::Buffer>(byte_size(), alloc);
+  if (!buffer_->ptr()) {
+    return base::error::InternalError("Failed to allocate the paged kv cache.");
+  }
+  const size_t pool_bytes = num_blocks_ * block_stride() * KVCacheFormatSize(format_);
+  key_pool_ = static_cast<int8_t*>(buffer_->ptr());
+  value_pool_ = key_pool_ + pool_bytes;
+  if (format_ == KVCacheFormat::kInt8) {
+    key_scale_pool_ = reinterpret_cast<float*>(value_pool_ + pool_bytes);
+    value_scale_pool_ = key_scale_pool_ + num_blocks_ * block_stride() / head_size_;
+  } else {
+    key_scale_pool_ = nullptr;
+    value_scale_pool_ = nullptr;
+  }
+
+  //空闲链表当栈用，先拿编号小的block
+  free_blocks_.clear();
+  free_blocks_.reserve(num_blocks_);
+  for (int32_t i = num_blocks_ - 1; i >= 0; --i) {
+    free_blocks_.push_back(i);
+  }
+  ref_counts_.assign(num_blocks_, 0);
+  block_tables_.clear();
+  return base::error::Success();
+}
+
+base::Status PagedKVCache::add_sequence(int32_t seq_id,
+                                        const std::vector<int32_t>& shared_blocks) {
+  if (block_tables_.count(seq_id)) {
+    return base::error::KeyHasExits("The sequence " + std::to_string(seq_id) +
+                                    " already exists in the paged kv cache.");
+  }
+  for (int32_t block : shared_blocks) {
+    if (block < 0 || block >= num_blocks_ || ref_counts_[block] <= 0) {
+      return base::error::InvalidArgument("The shared block " + std::to_string(block) +
+                                          " is not in use.");
+    }
+  }
+  auto& table = block_tables_[seq_id];
+  table = shared_blocks;
+  for (int32_t block : table) {
+    retain_block(block);
+  }
+  return base::error::Success();
+}
+
+base::Status PagedKVCache::reserve(int32_t seq_id, int32_t pos) {
+  auto iter = block_tables_.find(seq_id);
+  if (iter == block_tables_.end()) {
+    return base::error::InvalidArgument("The sequence " + std::to_string(seq_id) +
+                                        " is not in the paged kv cache.");
+  }
+  if (pos < 0) {
+    return base::error::InvalidArgument("The position to reserve is negative.");
+  }
+  auto& table = iter->second;
+  const size_t need = static_cast<size_t>(pos / block_size_ + 1);
+  if (need > table.size() && need - table.size() > free_blocks_.size()) {
+    return base::error::InternalError("The paged kv cache has no free block left.");
+  }
+  while (table.size() < need) {
+    const int32_t block = free_blocks_.back();
+    free_blocks_.pop_back();
+    ref_counts_[block] = 1;
+    table.push_back(block);
+  }
+  return base::error::Success();
+}
+
+void PagedKVCache::free_sequence(int32_t seq_id) {
+  auto iter = block_tables_.find(seq_id);
+  if (iter == block_tables_.end()) {
+    return;
+  }
+  for (int32_t block : iter->second) {
+    release_block(block);
+  }
+  block_tables_.erase(iter);
+}
+
+base::Status PagedKVCache::truncate(int32_t seq_id, int32_t len) {
+  auto iter = block_tables_.find(seq_id);
+  if (iter == block_tables_.end()) {
+    return base::error::InvalidArgument("The sequence " + std::to_string(seq_id) +
+                                        " is not in the paged kv cache.");
+  }
+  if (len < 0) {
+    return base::error::InvalidArgument("The length to truncate to is negative.");
+  }
+  //留在block里的旧key/value不用清，注意力只读到当前位置，之后会被新的token覆盖
+  auto& table = iter->second;
+  const size_t keep = static_cast<size_t>((len + block_size_ - 1) / block_size_);
+  while (table.size() > keep) {
+    release_block(table.back());
+    table.pop_back();
+  }
+  return base::error::Success();
+}
+
+bool PagedKVCache::has_sequence(int32_t seq_id) const { return block_tables_.count(seq_id) > 0; }
+
+void PagedKVCache::retain_block(int32_t block) {
+  CHECK(block >= 0 && block < num_blocks_);
+  CHECK_GT(ref_counts_[block], 0) << "The block " << block << " is free.";
+  ref_counts_[block] += 1;
+}
+
+void PagedKVCache::release_block(int32_t block) {
+  CHECK(block >= 0 && block < num_blocks_);
+  CHECK_GT(ref_counts_[block], 0) << "The block " << block << " is released twice.";
+  ref_counts_[block] -= 1;
+  if (ref_counts_[block] == 0) {
+    free_blocks_.push_back(block);
+  }
+}
+
+int32_t PagedKVCache::ref_count(int32_t block) const {
+  CHECK(block >= 0 && block < num_blocks_);
+  return ref_counts_[block];
+}
+
+int64_t PagedKVCache::block_stride() const {
+  return static_cast<int64_t>(layer_num_) * block_size_ * kv_dim_;
+}
+
+int64_t PagedKVCache::row_offset(const std::vector<int32_t>& table, int32_t layer_idx,
+                                 int32_t pos) const {
+  CHECK_GE(layer_idx, 0);
+  CHECK_LT(layer_idx, layer_num_);
+  CHECK_GE(pos, 0);
+  CHECK_LT(pos / block_size_, static_cast<int32_t>(table.size()))
+      << "The position " << pos << " has not been reserved in the paged kv cache.";
+  return table[pos / block_size_] * block_stride() +
+         static_cast<int64_t>(layer_idx) * block_size_ * kv_dim_ +
+         static_cast<int64_t>(pos % block_size_) * kv_dim_;
+}
+
+float* PagedKVCache::key(int32_t seq_id, int32_t layer_idx, int32_t pos) {
+  CHECK(format_ == KVCacheFormat::kFp32);
+  return static_cast<float*>(key_data(seq_id, layer_idx, pos));
+}
+
+float* PagedKVCache::value(int32_t seq_id, int32_t layer_idx, int32_t pos) {
+  CHECK(format_ == KVCacheFormat::kFp32);
+  return static_cast<float*>(value_data(seq_id, layer_idx, pos));
+}
+
+void* PagedKVCache::key_data(int32_t seq_id, int32_t layer_idx, int32_t pos) {
+  return key_pool_ +
+         row_offset(block_table(seq_id), layer_idx, pos) * KVCacheFormatSize(format_);
+}
+
+void* PagedKVCache::value_data(int32_t seq_id, int32_t layer_idx, int32_t pos) {
+  return value_pool_ +
+         row_offset(block_table(seq_id), layer_idx, pos) * KVCacheFormatSize(format_);
+}
+
+float* PagedKVCache::key_scales(int32_t seq_id, int32_t layer_idx, int32_t pos) {
+  CHECK(format_ == KVCacheFormat::kInt8);
+  return key_scale_pool_ + row_offset(block_table(seq_id), layer_idx, pos) / head_size_;
+}
+
+float* PagedKVCache::value_scales(int32_t seq_id, int32_t layer_idx, int32_t pos) {
+  CHECK(format_ == KVCacheFormat::kInt8);
+  return value_scale_pool_ + row_offset(block_table(seq_id), layer_idx, pos) / head_size_;
+}
+
+KVCacheView PagedKVCache::view(int32_t seq_id, int32_t layer_idx) const {
+  CHECK_GE(layer_idx, 0);
+  CHECK_LT(layer_idx, layer_num_);
+  KVCacheView view;
+  view.key = key_pool_;
+  view.value = value_pool_;
+  view.key_scales = key_scale_pool_;
+  view.value_scales = value_scale_pool_;
+  view.block_table = block_table(seq_id).data();
+  view.format = format_;
+  view.head_size = head_size_;
+  view.block_size = block_size_;
+  view.kv_dim = kv_dim_;
+  view.block_stride = block_stride();
+  view.layer_offset = static_cast<int64_t>(layer_idx) * block_size_ * kv_dim_;
+  return view;
+}
+
+const std::vector<int32_t>& PagedKVCache::block_table(int32_t seq_id) const {
+  auto iter = block_tables_.find(seq_id);
+  CHECK(iter != block_tables_.end())
+      << "The sequence " << seq_id << " is not in the paged kv cache.";
+  return iter->second;
+}
+
+int32_t PagedKVCache::block_size() const { return block_size_; }
+
+int32_t PagedKVCache::num_blocks() const { return num_blocks_; }
+
+int32_t PagedKVCache::free_block_num() const { return static_cast<int32_t>(free_blocks_.size()); }
+
+int32_t PagedKVCache::layer_num() const { return layer_num_; }
+
+int32_t PagedKVCache::kv_dim() const { return kv_dim_; }
+
+KVCacheFormat PagedKVCache::format() const { return format_; }
+
+int32_t PagedKVCache::head_size() const { return head_size_; }
+
+size_t PagedKVCache::byte_size() const {
+  const size_t elem_num = static_cast<size_t>(num_blocks_) * block_stride();
+  size_t bytes = 2 * elem_num * KVCacheFormatSize(format_);
+  if (format_ == KVCacheFormat::kInt8) {
+    bytes += 2 * elem_num / head_size_ * sizeof(float);
+  }
+  return bytes;
+}
+}  // namespace op
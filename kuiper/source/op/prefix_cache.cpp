@@ -0,0 +1,213 @@
+#include "op/prefix_cache.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <utility>
+namespace op {
+PrefixCache::PrefixCache(std::shared_ptr<PagedKVCache> kv_cache, size_t max_byte_size)
+    : kv_cache_(std::move(kv_cache)), root_(std::make_unique<Node>()) {
+  CHECK(kv_cache_ != nullptr);
+  block_size_ = kv_cache_->block_size();
+  const size_t block_byte_size = kv_cache_->byte_size() / kv_cache_->num_blocks();
+  max_block_num_ = static_cast<int32_t>(
+      std::min(max_byte_size / block_byte_size, static_cast<size_t>(kv_cache_->num_blocks())));
+}
+
+PrefixCache::~PrefixCache() {
+  //树里的引用还给kv cache，它可能比这棵树活得更久
+  while (!lru_leaves_.empty()) {
+    remove_leaf(lru_leaves_.begin()->second);
+  }
+}
+
+PrefixCache::Node* PrefixCache::find_child(Node* node, const std::vector<int32_t>& tokens,
+                                           int32_t pos) const {
+  for (const auto& child : node->children) {
+    if (std::equal(child->tokens.begin(), child->tokens.begin() + block_size_,
+                   tokens.begin() + pos)) {
+      return child.get();
+    }
+  }
+  return nullptr;
+}
+
+int32_t PrefixCache::common_blocks(const Node* node, const std::vector<int32_t>& tokens,
+                                   int32_t pos, int32_t max_len) const {
+  const int32_t edge_blocks = static_cast<int32_t>(node->blocks.size());
+  int32_t num = 0;
+  while (num < edge_blocks && pos + (num + 1) * block_size_ <= max_len) {
+    const auto edge = node->tokens.begin() + static_cast<size_t>(num) * block_size_;
+    if (!std::equal(edge, edge + block_size_, tokens.begin() + pos + num * block_size_)) {
+      break;
+    }
+    num += 1;
+  }
+  return num;
+}
+
+int32_t PrefixCache::match(const std::vector<int32_t>& tokens, int32_t max_len,
+                           std::vector<int32_t>& blocks) {
+  blocks.clear();
+  max_len = std::min(max_len, static_cast<int32_t>(tokens.size()));
+  queried_token_num_ += std::max(0, max_len);
+  clock_ += 1;
+  Node* node = root_.get();
+  int32_t pos = 0;
+  while (pos + block_size_ <= max_len) {
+    Node* child = find_child(node, tokens, pos);
+    if (!child) {
+      break;
+    }
+    const int32_t num = common_blocks(child, tokens, pos, max_len);
+    touch(child);
+    blocks.insert(blocks.end(), child->blocks.begin(), child->blocks.begin() + num);
+    pos += num * block_size_;
+    if (num < static_cast<int32_t>(child->blocks.size())) {
+      break;
+    }
+    node = child;
+  }
+  matched_token_num_ += pos;
+  return pos;
+}
+
+PrefixCache::Node* PrefixCache::split(Node* node, int32_t block_num) {
+  Node* parent = node->parent;
+  auto mid = std::make_unique<Node>();
+  mid->parent = parent;
+  mid->last_access = node->last_access;
+  const size_t token_num = static_cast<size_t>(block_num) * block_size_;
+  mid->tokens.assign(node->tokens.begin(), node->tokens.begin() + token_num);
+  mid->blocks.assign(node->blocks.begin(), node->blocks.begin() + block_num);
+  node->tokens.erase(node->tokens.begin(), node->tokens.begin() + token_num);
+  node->blocks.erase(node->blocks.begin(), node->blocks.begin() + block_num);
+
+  auto iter = std::find_if(parent->children.begin(), parent->children.end(),
+                           [node](const std::unique_ptr<Node>& child) {
+                             return child.get() == node;
+                           });
+  CHECK(iter != parent->children.end());
+  std::unique_ptr<Node> lower = std::move(*iter);
+  lower->parent = mid.get();
+  mid->children.push_back(std::move(lower));
+  *iter = std::move(mid);
+  return iter->get();
+}
+
+void PrefixCache::insert(const std::vector<int32_t>& tokens, int32_t len,
+                         const std::vector<int32_t>& block_table) {
+  len = std::min(len, static_cast<int32_t>(tokens.size())) / block_size_ * block_size_;
+  len = std::min(len, static_cast<int32_t>(block_table.size()) * block_size_);
+  clock_ += 1;
+  Node* node = root_.get();
+  int32_t pos = 0;
+  while (pos < len) {
+    Node* child = find_child(node, tokens, pos);
+    if (!child && node != root_.get() && node->children.empty()) {
+      //接在叶子后面的直接并进叶子的边里，保持路径压缩
+      node->tokens.insert(node->tokens.end(), tokens.begin() + pos, tokens.begin() + len);
+      for (int32_t i = pos / block_size_; i < len / block_size_; ++i) {
+        kv_cache_->retain_block(block_table[i]);
+        node->blocks.push_back(block_table[i]);
+        cached_block_num_ += 1;
+      }
+      touch(node);
+      break;
+    }
+    if (!child) {
+      auto leaf = std::make_unique<Node>();
+      leaf->parent = node;
+      leaf->last_access = clock_;
+      leaf->tokens.assign(tokens.begin() + pos, tokens.begin() + len);
+      leaf->blocks.assign(block_table.begin() + pos / block_size_,
+                          block_table.begin() + len / block_size_);
+      for (int32_t block : leaf->blocks) {
+        kv_cache_->retain_block(block);
+      }
+      cached_block_num_ += static_cast<int32_t>(leaf->blocks.size());
+      //node是根或者本来就有子节点，不在lru_leaves_里
+      lru_leaves_.emplace(leaf->last_access, leaf.get());
+      node->children.push_back(std::move(leaf));
+      break;
+    }
+    const int32_t num = common_blocks(child, tokens, pos, len);
+    if (num < static_cast<int32_t>(child->blocks.size())) {
+      child = split(child, num);
+    }
+    touch(child);
+    pos += num * block_size_;
+    node = child;
+  }
+
+  while (cached_block_num_ > max_block_num_) {
+    Node* leaf = evictable_leaf();
+    if (!leaf) {
+      break;
+    }
+    remove_leaf(leaf);
+  }
+}
+
+void PrefixCache::touch(Node* node) {
+  const bool is_leaf = node->children.empty() && node != root_.get();
+  if (is_leaf) {
+    lru_leaves_.erase({node->last_access, node});
+  }
+  node->last_access = clock_;
+  if (is_leaf) {
+    lru_leaves_.emplace(node->last_access, node);
+  }
+}
+
+PrefixCache::Node* PrefixCache::evictable_leaf() const {
+  for (const auto& [last_access, leaf] : lru_leaves_) {
+    const bool held_alone =
+        std::all_of(leaf->blocks.begin(), leaf->blocks.end(),
+                    [this](int32_t block) { return kv_cache_->ref_count(block) == 1; });
+    if (held_alone) {
+      return leaf;
+    }
+  }
+  return nullptr;
+}
+
+int32_t PrefixCache::remove_leaf(Node* leaf) {
+  CHECK(leaf != nullptr && leaf->children.empty() && leaf->parent != nullptr);
+  const int32_t free_before = kv_cache_->free_block_num();
+  for (int32_t block : leaf->blocks) {
+    kv_cache_->release_block(block);
+  }
+  cached_block_num_ -= static_cast<int32_t>(leaf->blocks.size());
+  lru_leaves_.erase({leaf->last_access, leaf});
+  Node* parent = leaf->parent;
+  auto& siblings = parent->children;
+  siblings.erase(std::find_if(siblings.begin(), siblings.end(),
+                              [leaf](const std::unique_ptr<Node>& child) {
+                                return child.get() == leaf;
+                              }));
+  //最后一个子节点删掉之后父节点变成了叶子
+  if (siblings.empty() && parent != root_.get()) {
+    lru_leaves_.emplace(parent->last_access, parent);
+  }
+  return kv_cache_->free_block_num() - free_before;
+}
+
+int32_t PrefixCache::evict(int32_t need_free_blocks) {
+  int32_t freed = 0;
+  while (kv_cache_->free_block_num() < need_free_blocks) {
+    Node* leaf = evictable_leaf();
+    if (!leaf) {
+      break;
+    }
+    freed += remove_leaf(leaf);
+  }
+  return freed;
+}
+
+int32_t PrefixCache::cached_block_num() const { return cached_block_num_; }
+
+int32_t PrefixCache::max_block_num() const { return max_block_num_; }
+
+int64_t PrefixCache::queried_token_num() const { return queried_token_num_; }
+
+int64_t PrefixCache::matched_token_num() const { return matched_token_num_; }
+}  // namespace op
@@ -0,0 +1,41 @@
+#include "op/rmsnorm.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+RmsNormLayer::RmsNormLayer(base::DeviceType device_type, int32_t dim, float eps)
+    : LayerParam(device_type, LayerType::kLayerRMSNorm, false, "RMSNorm"), dim_(dim), eps_(eps) {
+  reset_input_size(1);
+  reset_output_size(1);
+  reset_weight_size(1);
+}
+
+base::Status RmsNormLayer::check() const {
+  const tensor::Tensor& input = get_input(0);
+  auto status = check_tensor(input, device_type_, data_type_);
+  if (!status || input.size() % dim_ != 0) {
+    LOG(ERROR) << "The input tensor error in the rmsnorm layer.";
+    return status ? base::error::InvalidArgument("The input has a wrong size.") : status;
+  }
+  status = check_tensor_with_dim(get_weight(0), device_type_, data_type_, dim_);
+  if (!status) {
+    LOG(ERROR) << "The weight tensor error in the rmsnorm layer.";
+    return status;
+  }
+  const tensor::Tensor& output = get_output(0);
+  status = check_tensor(output, device_type_, data_type_);
+  if (!status || output.size() != input.size()) {
+    LOG(ERROR) << "The output tensor error in the rmsnorm layer.";
+    return status ? base::error::InvalidArgument("The output has a wrong size.") : status;
+  }
+  return base::error::Success();
+}
+
+base::Status RmsNormLayer::forward() {
+  auto status = this->check();
+  if (!status) {
+    return status;
+  }
+  kernel::get_rmsnorm_kernel(device_type_)(get_input(0), get_weight(0), get_output(0), eps_,
+                                           kernel_stream());
+  return base::error::Success();
+}
+}  // namespace op
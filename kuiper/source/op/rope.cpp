@@ -0,0 +1,117 @@
+#include "op/rope.h"
+#include "kernels/cpu/rope_kernel.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+RoPELayer::RoPELayer(base::DeviceType device_type, int32_t dim, int32_t kv_dim, int32_t head_size,
+                     int32_t max_seq_len)
+    : Layer(device_type, LayerType::kLayerRoPe, "RoPe"),
+      dim_(dim),
+      kv_dim_(kv_dim),
+      head_size_(head_size),
+      max_seq_len_(max_seq_len) {
+  reset_input_size(3);
+  reset_output_size(1);
+}
+
+base::Status RoPELayer::init() {
+  if (head_size_ <= 0 || head_size_ % 2 != 0) {
+    return base::error::InvalidArgument(
+        "The head size of the rope layer must be positive and even.");
+  }
+  if (max_seq_len_ <= 0) {
+    return base::error::InvalidArgument("The max seq len of the rope layer must be positive.");
+  }
+  if (dim_ % head_size_ != 0 || kv_dim_ % head_size_ != 0) {
+    return base::error::InvalidArgument("The dim of the rope layer is not divisible by head size.");
+  }
+  //表总是先在CPU上算好，需要的话再由to_cuda搬过去
+  auto alloc = base::CPUDeviceAllocatorFactory::get_instance();
+  sin_cache_ = tensor::Tensor(base::DataType::kDataTypeFp32, max_seq_len_, head_size_ / 2, true,
+                              alloc);
+  cos_cache_ = tensor::Tensor(base::DataType::kDataTypeFp32, max_seq_len_, head_size_ / 2, true,
+                              alloc);
+  if (sin_cache_.is_empty() || cos_cache_.is_empty()) {
+    return base::error::InternalError("Failed to allocate the sin/cos cache of the rope layer.");
+  }
+  sin_cache_.set_device_type(base::DeviceType::kDeviceCPU);
+  cos_cache_.set_device_type(base::DeviceType::kDeviceCPU);
+  kernel::sin_cos_cache_calc_cpu(head_size_, max_seq_len_, sin_cache_, cos_cache_);
+  if (device_type_ == base::DeviceType::kDeviceCUDA) {
+    to_cuda();
+  }
+  return base::error::Success();
+}
+
+base::Status RoPELayer::check() const {
+  const tensor::Tensor& input_pos = get_input(2);
+  auto status =
+      check_tensor(input_pos, base::DeviceType::kDeviceCPU, base::DataType::kDataTypeInt32);
+  if (!status) {
+    LOG(ERROR) << "The input tensor 2 error in the rope layer.";
+    return status;
+  }
+  const int32_t rows = static_cast<int32_t>(input_pos.size());
+  if (rows == 1 && get_input(0).dims_size() == 1) {
+    status = check_tensor_with_dim(get_input(0), device_type_, data_type_, dim_);
+  } else {
+    status = check_tensor_with_dim(get_input(0), device_type_, data_type_, rows, dim_);
+  }
+  if (!status) {
+    LOG(ERROR) << "The input tensor 0 error in the rope layer.";
+    return status;
+  }
+  if (rows == 1 && get_input(1).dims_size() == 1) {
+    status = check_tensor_with_dim(get_input(1), device_type_, data_type_, kv_dim_);
+  } else {
+    status = check_tensor_with_dim(get_input(1), device_type_, data_type_, rows, kv_dim_);
+  }
+  if (!status) {
+    LOG(ERROR) << "The input tensor 1 error in the rope layer.";
+    return status;
+  }
+  status = check_tensor_with_dim(sin_cache_, device_type_, data_type_, max_seq_len_,
+                                 head_size_ / 2);
+  if (!status) {
+    LOG(ERROR) << "The sin cache of the rope layer is not initialized.";
+    return status;
+  }
+  status = check_tensor_with_dim(cos_cache_, device_type_, data_type_, max_seq_len_,
+                                 head_size_ / 2);
+  if (!status) {
+    LOG(ERROR) << "The cos cache of the rope layer is not initialized.";
+    return status;
+  }
+  return base::error::Success();
+}
+
+base::Status RoPELayer::forward() {
+  auto status = check();
+  if (!status) {
+    return status;
+  }
+  const tensor::Tensor& input_pos = get_input(2);
+  for (size_t i = 0; i < input_pos.size(); ++i) {
+    const int32_t pos = input_pos.index<int32_t>(i);
+    if (pos < 0 || pos >= max_seq_len_) {
+      return base::error::InvalidArgument("The position of the rope layer is out of range.");
+    }
+  }
+  kernel::get_rope_kernel(device_type_)(dim_, kv_dim_, head_size_, get_input(0), get_input(1),
+                                        input_pos, sin_cache_, cos_cache_, kernel_stream());
+  return base::error::Success();
+}
+
+void RoPELayer::to_cuda() {
+  Layer::to_cuda();
+  if (!sin_cache_.is_empty()) {
+    sin_cache_.to_cuda(cuda_config_ ? cuda_config_->stream : nullptr);
+  }
+  if (!cos_cache_.is_empty()) {
+    cos_cache_.to_cuda(cuda_config_ ? cuda_config_->stream : nullptr);
+  }
+}
+
+const tensor::Tensor& RoPELayer::sin_cache() const { return sin_cache_; }
+
+const tensor::Tensor& RoPELayer::cos_cache() const { return cos_cache_; }
+}  // namespace op
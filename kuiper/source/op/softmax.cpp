@@ -0,0 +1,27 @@
+#include "op/softmax.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+SoftmaxLayer::SoftmaxLayer(base::DeviceType device_type)
+    : Layer(device_type, LayerType::kLayerSoftmax, "Softmax") {
+  reset_input_size(1);
+  reset_output_size(1);
+}
+
+base::Status SoftmaxLayer::check() const {
+  auto status = check_tensor(get_input(0), device_type_, data_type_);
+  if (!status) {
+    LOG(ERROR) << "The input tensor error in the softmax layer.";
+    return status;
+  }
+  return base::error::Success();
+}
+
+base::Status SoftmaxLayer::forward() {
+  auto status = check();
+  if (!status) {
+    return status;
+  }
+  kernel::get_softmax_kernel(device_type_)(get_input(0), kernel_stream());
+  return base::error::Success();
+}
+}  // namespace op
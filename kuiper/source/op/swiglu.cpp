@@ -0,0 +1,99 @@
+#include "op/swiglu.h"
+#include "kernels/kernels_interface.h"
+namespace op {
+SwiGLULayer::SwiGLULayer(base::DeviceType device_type, int32_t dim, int32_t hidden_dim,
+                         bool is_quant_layer)
+    : LayerParam(device_type, LayerType::kLayerSwiGLU, is_quant_layer, "SwiGLU"),
+      dim_(dim),
+      hidden_dim_(hidden_dim) {
+  reset_input_size(1);
+  reset_output_size(1);
+  reset_weight_size(2);
+  weight_scales_.resize(2);
+}
+
+base::Status SwiGLULayer::check() const {
+  const tensor::Tensor& input = get_input(0);
+  const int32_t rows = input.dims_size() == 2 ? input.get_dim(0) : 1;
+  base::Status status;
+  if (input.dims_size() == 2) {
+    status = check_tensor_with_dim(input, device_type_, data_type_, rows, dim_);
+  } else {
+    status = check_tensor_with_dim(input, device_type_, data_type_, dim_);
+  }
+  if (!status) {
+    LOG(ERROR) << "The input tensor error in the swiglu layer.";
+    return status;
+  }
+
+  const base::DataType weight_type =
+      is_quant_layer_ ? base::DataType::kDataTypeInt8 : base::DataType::kDataTypeFp32;
+  for (int32_t i = 0; i < 2; ++i) {
+    status = check_tensor_with_dim(get_weight(i), device_type_, weight_type, hidden_dim_, dim_);
+    if (!status) {
+      LOG(ERROR) << "The weight tensor " << std::to_string(i) << " error in the swiglu layer.";
+      return status;
+    }
+    if (is_quant_layer_) {
+      status = check_tensor(weight_scales_.at(i), device_type_, base::DataType::kDataTypeFp32);
+      if (!status) {
+        LOG(ERROR) << "The scale tensor " << std::to_string(i) << " error in the swiglu layer.";
+        return status;
+      }
+    }
+  }
+
+  if (input.dims_size() == 2) {
+    status = check_tensor_with_dim(get_output(0), device_type_, data_type_, rows, hidden_dim_);
+  } else {
+    status = check_tensor_with_dim(get_output(0), device_type_, data_type_, hidden_dim_);
+  }
+  if (!status) {
+    LOG(ERROR) << "The output tensor error in the swiglu layer.";
+    return status;
+  }
+  return base::error::Success();
+}
+
+base::Status SwiGLULayer::forward() {
+  auto status = check();
+  if (!status) {
+    return status;
+  }
+  if (is_quant_layer_) {
+    kernel::get_swiglu_ffn_kernel_quant8(device_type_)(
+        get_input(0), get_weight(0), get_weight(1), group_size_, weight_scales_.at(0),
+        weight_scales_.at(1), get_output(0), kernel_stream());
+  } else {
+    kernel::get_swiglu_ffn_kernel(device_type_)(get_input(0), get_weight(0), get_weight(1),
+                                                get_output(0), kernel_stream());
+  }
+  return base::error::Success();
+}
+
+base::Status SwiGLULayer::set_weight(int32_t idx, const tensor::Tensor& weight) {
+  return LayerParam::set_weight(idx, weight);
+}
+
+base::Status SwiGLULayer::set_weight(int32_t idx, const std::vector<int32_t>& dims,
+                                     const void* weight_ptr, base::DeviceType device_type) {
+  auto status = LayerParam::set_weight(idx, dims, weight_ptr, device_type);
+  if (!status) {
+    return status;
+  }
+  //LayerParam只有一个scales_，每次set_weight都会被覆盖，所以这里按权重分别存一份
+  if (is_quant_layer_) {
+    weight_scales_.at(idx) = scales_;
+  }
+  return base::error::Success();
+}
+
+void SwiGLULayer::to_cuda() {
+  LayerParam::to_cuda();
+  for (auto& scale : weight_scales_) {
+    if (!scale.is_empty()) {
+      scale.to_cuda(cuda_config_ ? cuda_config_->stream : nullptr);
+    }
+  }
+}
+}  // namespace op
@@ -0,0 +1,11 @@
+#include "sampler/argmax_sampler.h"
+#include "../op/kernels/cpu/sampling_kernel.h"
+namespace sampler {
+ArgmaxSampler::ArgmaxSampler(base::DeviceType device_type) : Sampler(device_type) {}
+
+int32_t ArgmaxSampler::sample(const float* logits, int32_t size, void* stream) {
+  UNUSED(stream);
+  CHECK(device_type_ == base::DeviceType::kDeviceCPU);
+  return kernel::argmax_kernel_cpu(logits, size);
+}
+}  // namespace sampler
@@ -0,0 +1,144 @@
+#include "sampler/random_sampler.h"
+#include <algorithm>
+#include "../op/kernels/cpu/sampling_kernel.h"
+namespace sampler {
+RandomSampler::RandomSampler(base::DeviceType device_type, const SamplerConfig& config,
+                             int32_t vocab_size)
+    : Sampler(device_type),
+      temperature_(config.temperature),
+      top_k_(config.top_k),
+      top_p_(config.top_p),
+      vocab_size_(vocab_size) {
+  CHECK_GT(temperature_, 0.f);
+  CHECK_GT(vocab_size_, 0);
+  CHECK(check_sampler_config(config));
+  //xorshift的状态不能是0，seed先打散一下
+  rng_state_ = config.seed * 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL;
+  if (rng_state_ == 0) {
+    rng_state_ = 0x2545F4914F6CDD1DULL;
+  }
+  //scratch在这里一次分配好，sample的时候只复用
+  if (top_k_ > 0 && top_k_ < vocab_size_) {
+    topk_values_.resize(top_k_);
+    topk_indices_.resize(top_k_);
+    candidates_.resize(top_k_);
+  } else {
+    probs_.resize(vocab_size_);
+    if (top_p_ < 1.f) {
+      candidates_.resize(vocab_size_);
+    }
+  }
+}
+
+uint32_t RandomSampler::random_u32() {
+  rng_state_ ^= rng_state_ >> 12;
+  rng_state_ ^= rng_state_ << 25;
+  rng_state_ ^= rng_state_ >> 27;
+  return static_cast<uint32_t>((rng_state_ * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+float RandomSampler::random_f32() { return (random_u32() >> 8) / 16777216.f; }
+
+void RandomSampler::softmax(const float* logits, int32_t size, float* probs) const {
+  CHECK(logits != nullptr && probs != nullptr);
+  CHECK_EQ(size, vocab_size_);
+  const float max_value = kernel::max_kernel_cpu(logits, size);
+  const float sum = kernel::exp_sum_kernel_cpu(logits, size, max_value, 1.f / temperature_, probs);
+  const float inv_sum = 1.f / sum;
+  for (int32_t i = 0; i < size; ++i) {
+    probs[i] *= inv_sum;
+  }
+}
+
+int32_t RandomSampler::sample_probs(const float* probs, int32_t size) {
+  CHECK(probs != nullptr);
+  CHECK_EQ(size, vocab_size_);
+  const float r = random_f32();
+  float cumulative = 0.f;
+  for (int32_t i = 0; i < size; ++i) {
+    cumulative += probs[i];
+    if (r < cumulative) {
+      return i;
+    }
+  }
+  //浮点舍入让总和略小于1时落到这里
+  return kernel::argmax_kernel_cpu(probs, size);
+}
+
+int32_t RandomSampler::sample_candidates(int32_t n, float sum) {
+  if (top_p_ < 1.f) {
+    const float limit = top_p_ * sum;
+    float cumulative = 0.f;
+    for (int32_t i = 0; i < n; ++i) {
+      cumulative += candidates_[i].prob;
+      if (cumulative >= limit) {
+        n = i + 1;
+        break;
+      }
+    }
+    sum = cumulative;
+  }
+  const float r = random_f32() * sum;
+  float cumulative = 0.f;
+  for (int32_t i = 0; i < n; ++i) {
+    cumulative += candidates_[i].prob;
+    if (r < cumulative) {
+      return candidates_[i].index;
+    }
+  }
+  //浮点舍入可能让r落在最后
+  return candidates_[n - 1].index;
+}
+
+int32_t RandomSampler::sample(const float* logits, int32_t size, void* stream) {
+  UNUSED(stream);
+  CHECK(device_type_ == base::DeviceType::kDeviceCPU);
+  CHECK(logits != nullptr);
+  CHECK_EQ(size, vocab_size_);
+  const float inv_temperature = 1.f / temperature_;
+
+  if (top_k_ > 0 && top_k_ < size) {
+    //top-k的结果已经从大到小排好，第0个就是最大值
+    kernel::topk_kernel_cpu(logits, size, top_k_, topk_values_.data(), topk_indices_.data());
+    const float sum = kernel::exp_sum_kernel_cpu(topk_values_.data(), top_k_, topk_values_[0],
+                                                 inv_temperature, topk_values_.data());
+    for (int32_t i = 0; i < top_k_; ++i) {
+      candidates_[i].prob = topk_values_[i];
+      candidates_[i].index = topk_indices_[i];
+    }
+    return sample_candidates(top_k_, sum);
+  }
+
+  const float max_value = kernel::max_kernel_cpu(logits, size);
+  const float sum =
+      kernel::exp_sum_kernel_cpu(logits, size, max_value, inv_temperature, probs_.data());
+  if (top_p_ >= 1.f) {
+    const float r = random_f32() * sum;
+    float cumulative = 0.f;
+    for (int32_t i = 0; i < size; ++i) {
+      cumulative += probs_[i];
+      if (r < cumulative) {
+        return i;
+      }
+    }
+    return kernel::argmax_kernel_cpu(probs_.data(), size);
+  }
+
+  //概率小于这个阈值的token就算把比它大的都加上也凑不够top_p，不用参与排序。
+  //这个界对最大的token不成立（top_p很小、概率又很平的时候阈值会超过它），
+  //而最大的token总在集合里，它的概率是exp(0) = 1，所以阈值不能超过1
+  const float cutoff =
+      size > 1 ? std::min(1.f, (1.f - top_p_) / static_cast<float>(size - 1) * sum) : 0.f;
+  int32_t n = 0;
+  for (int32_t i = 0; i < size; ++i) {
+    if (probs_[i] >= cutoff) {
+      candidates_[n].prob = probs_[i];
+      candidates_[n].index = i;
+      n += 1;
+    }
+  }
+  std::sort(candidates_.begin(), candidates_.begin() + n,
+            [](const Candidate& a, const Candidate& b) { return a.prob > b.prob; });
+  return sample_candidates(n, sum);
+}
+}  // namespace sampler
@@ -0,0 +1,34 @@
+#include "sampler/sampler.h"
+#include <glog/logging.h>
+#include "sampler/argmax_sampler.h"
+#include "sampler/random_sampler.h"
+namespace sampler {
+Sampler::Sampler(base::DeviceType device_type) : device_type_(device_type) {}
+
+int32_t Sampler::sample_row(const tensor::Tensor& logits, int32_t row, void* stream) {
+  CHECK(!logits.is_empty());
+  CHECK_EQ(logits.dims_size(), 2);
+  CHECK(logits.data_type() == base::DataType::kDataTypeFp32);
+  CHECK(row >= 0 && row < logits.get_dim(0));
+  const int32_t vocab_size = logits.get_dim(1);
+  return sample(logits.ptr<float>(static_cast<int64_t>(row) * vocab_size), vocab_size, stream);
+}
+
+base::Status check_sampler_config(const SamplerConfig& config) {
+  if (config.top_k < 0) {
+    return base::error::InvalidArgument("The top_k of the sampler must not be negative.");
+  }
+  if (!(config.top_p > 0.f && config.top_p <= 1.f)) {
+    return base::error::InvalidArgument("The top_p of the sampler must be in (0, 1].");
+  }
+  return base::error::Success();
+}
+
+std::unique_ptr<Sampler> create_sampler(base::DeviceType device_type, const SamplerConfig& config,
+                                        int32_t vocab_size) {
+  if (config.temperature <= 0.f || config.top_k == 1) {
+    return std::make_unique<ArgmaxSampler>(device_type);
+  }
+  return std::make_unique<RandomSampler>(device_type, config, vocab_size);
+}
+}  // namespace sampler
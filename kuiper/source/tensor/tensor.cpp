@@ -1,15 +1,15 @@
 #include "tensor/tensor.h"
-#include <cuda_device_runtime_api.h>
-#include <cuda_runtime.h>
 #include <glog/logging.h>
+#include <cstring>
 #include <numeric>
+#include <utility>
 
 namespace tensor{
 
 
 //这里为什么有两种类型
 //init是累积结果的初始值（决定最终结果的类型Tp）
-template<typenameT, typename Tp>
+template<typename T, typename Tp>
 static size_t reduce_dimension(T begin, T end, Tp init){
   if(begin>=end){
     return 0;
@@ -19,26 +19,6 @@ static size_t reduce_dimension(T begin, T end, Tp init){
 }
 
 
-static size_t data_type_size(base::DataType data_type){
-  switch (data_type){
-    case base::DataType::kDataTypeFp32:{
-      return 4;
-    }
-    case base::DataType::kDataTypeInt8:{
-      return 1;
-    }
-    case base::DataType::kDataTypeInt32{
-      return 4;
-    }
-
-    default:{
-      LOG(FATAL) << "Unknown data type size for " << int(data_type);
-      return 0;
-    }
-  }
-}
-
-
 //总感觉这样设计怪怪的
 bool Tensor::allocate(std::shared_ptr<base::DeviceAllocator> allocator, bool need_realloc){
   //allocator是什么时候初始化的呢？
@@ -54,12 +34,15 @@ bool Tensor::allocate(std::shared_ptr<base::DeviceAllocator> allocator, bool nee
     return false;
   }
 
-  if (buffer_ && byte_size <= buffer_->byte_size()) {
+  if (buffer_ && byte_offset_ + byte_size <= buffer_->byte_size()) {
     if (!need_realloc) {
       return true;
     }
   }
   buffer_ = std::make_shared<base::Buffer>(byte_size, allocator, nullptr);
+  //新的buffer只属于自己，视图的偏移和strides都要回到紧凑的排布
+  byte_offset_ = 0;
+  init_strides();
   if (!buffer_->ptr()) {
     LOG(ERROR) << "The memory allocated is a null pointer!";
     return false;
@@ -76,7 +59,7 @@ void Tensor::init_buffer(std::shared_ptr<base::DeviceAllocator>alloc, base::Data
       
 
       //  如果传入一个空的allocator，表示该tensor不会对该显存进行管理
-      std::shared_ptr buffer =  std::make_shared<base::Buffer>(data_type_size(data_type)*size_,nullptr,ptr,true);
+      std::shared_ptr buffer =  std::make_shared<base::Buffer>(base::DataTypeByteSize(data_type,size_),nullptr,ptr,true);
       this->buffer_ = buffer;
     }else{
        // 反之，如果传入一个非空的allocator，表示该tensor会对该显存进行管理，
@@ -99,8 +82,9 @@ void Tensor::init_buffer(std::shared_ptr<base::DeviceAllocator>alloc, base::Data
 Tensor::Tensor(base::DataType data_type, int32_t dim0, bool need_alloc,
   std::shared_ptr<base::DeviceAllocator> alloc, void* ptr)
     :data_type_(data_type) {
-  dim_.push_back(dim0);
+  dims_.push_back(dim0);
   size_ = dim0;
+  init_strides();
   if(need_alloc && alloc){
     allocate(alloc);
   } else {
@@ -108,7 +92,7 @@ Tensor::Tensor(base::DataType data_type, int32_t dim0, bool need_alloc,
     if(ptr != nullptr){
       CHECK(need_alloc == false)
           << "The need_alloc is is true when ptr parameter is not a null pointer.";
-      init_buffer(alloc, data_type_, need_alloc, ptr)
+      init_buffer(alloc, data_type_, need_alloc, ptr);
     }
   }
 }
@@ -118,6 +102,7 @@ Tensor::Tensor(base::DataType data_type, int32_t dim0, int32_t dim1, bool need_a
   dims_.push_back(dim0);
   dims_.push_back(dim1);
   size_ = dim0 * dim1;
+  init_strides();
   if (need_alloc && alloc) {
     allocate(alloc);
   } else {
@@ -132,6 +117,7 @@ Tensor::Tensor(base::DataType data_type, int32_t dim0, int32_t dim1, int32_t dim
   dims_.push_back(dim1);
   dims_.push_back(dim2);
   size_ = dim0 * dim1 * dim2;
+  init_strides();
   if (need_alloc && alloc) {
     allocate(alloc);
   } else {
@@ -146,6 +132,7 @@ Tensor::Tensor(base::DataType data_type, int32_t dim0, int32_t dim1, int32_t dim
   dims_.push_back(dim2);
   dims_.push_back(dim3);
   size_ = dim0 * dim1 * dim2 * dim3;
+  init_strides();
   if (need_alloc && alloc) {
     allocate(alloc);
   } else {
@@ -156,6 +143,7 @@ Tensor::Tensor(base::DataType data_type, std::vector<int32_t> dims, bool need_al
   std::shared_ptr<base::DeviceAllocator> alloc, void* ptr)
 : dims_(std::move(dims)), data_type_(data_type) {
   size_ = reduce_dimension(dims_.begin(), dims_.end(), 1);
+  init_strides();
   if (need_alloc && alloc) {
     allocate(alloc);
   } else {
@@ -169,12 +157,20 @@ void Tensor::to_cuda(cudaStream_t stream){
   const base::DeviceType device_type = this->device_type();
   if(device_type == base::DeviceType::kDeviceUnknown){
     LOG(ERROR) << "The device type of the tensor is unknown.";
-  }else if(device_type == base::DeviceType::kDeviceGPU){
-    size_t byte_site = this->byte_size();
-    auto cu_alloc = base::CUDADeviceAllocatorFactor::get_instance();
+  }else if(device_type == base::DeviceType::kDeviceCPU){
+#ifdef KUIPER_USE_CUDA
+    //拷过去的是紧凑的一份，视图的偏移随之清零
+    CHECK(is_contiguous()) << "Only a contiguous tensor can be moved to cuda.";
+    size_t byte_size = this->byte_size();
+    auto cu_alloc = base::CUDADeviceAllocatorFactory::get_instance();
     auto cu_buffer = std::make_shared<base::Buffer>(byte_size, cu_alloc);
-    cu_alloc->memcpy(buffer_.ptr(),cu_buffer.ptr(),byte_size, base::MemcpyKind::kMemcpyCPU2CUDA,stream);
+    cu_alloc->memcpy(this->ptr<int8_t>(), cu_buffer->ptr(), byte_size,
+                     base::MemcpyKind::kMemcpyCPU2CUDA, stream);
     this->buffer_ = cu_buffer;
+    this->byte_offset_ = 0;
+#else
+    LOG(FATAL) << "The tensor can not be moved to cuda because CUDA support is not built in.";
+#endif
   }else {
     LOG(INFO) << "The device type of the tensor is already cuda.";
   }
@@ -184,12 +180,15 @@ void Tensor::to_cpu() {
   const base::DeviceType device_type = this->device_type();
   if(device_type == base::DeviceType::kDeviceUnknown){
     LOG(ERROR) << "The device type of the tensor is unknown.";
-  }else if(device_type == base::DeviceType::kDeviceCPU){
-    size_t byte_site = this->byte_size();
+  }else if(device_type == base::DeviceType::kDeviceCUDA){
+    CHECK(is_contiguous()) << "Only a contiguous tensor can be moved to cpu.";
+    size_t byte_size = this->byte_size();
     auto cpu_alloc = base::CPUDeviceAllocatorFactory::get_instance();
     auto cpu_buffer = std::make_shared<base::Buffer>(byte_size, cpu_alloc);
-    cpu_alloc->memcpy(buffer_.ptr(),cu_buffer.ptr(),byte_size, base::MemcpyKind::kMemcpyCUDA2CPU);
+    cpu_alloc->memcpy(this->ptr<int8_t>(), cpu_buffer->ptr(), byte_size,
+                      base::MemcpyKind::kMemcpyCUDA2CPU);
     this->buffer_ = cpu_buffer;
+    this->byte_offset_ = 0;
   }else {
     LOG(INFO) << "The device type of the tensor is already cpu.";
   }
@@ -225,26 +224,87 @@ bool Tensor::assign(std::shared_ptr<base::Buffer> buffer) {
     return false;
   }
   buffer_ = buffer;
+  //新buffer按紧凑排布解释，之前作为视图留下的strides也要一起复位
+  byte_offset_ = 0;
+  init_strides();
   return true;
 }
 void Tensor::reshape(const std::vector<int32_t>& dims) {
   size_t size = reduce_dimension(dims.begin(), dims.end(), 1);
-  if (!buffer_) {
-    this->dims_ = dims;
-    this->size_ = size;
-    return;
-  }
-
-  if (size > size_) {
-    auto new_buffer = std::make_shared<base::Buffer>(size * base::DataTypeSize(this->data_type_),
-                                                     buffer_->allocator());
-    CHECK(new_buffer->allocate());
-    new_buffer->copy_from(buffer_.get());
-    this->buffer_ = new_buffer;
+  if (buffer_) {
+    //原来变大时会重新分配再拷贝，共享这块buffer的视图就悄悄和它分开了；现在要变大只能先reset再allocate
+    CHECK(is_contiguous()) << "Only a contiguous tensor can be reshaped.";
+    CHECK_LE(byte_offset_ + base::DataTypeByteSize(this->data_type_, size), buffer_->byte_size())
+        << "The buffer is too small for the new shape.";
   }
   this->dims_ = dims;
   this->size_ = size;
+  init_strides();
+}
+
+void Tensor::check_viewable() const {
+  CHECK(layout_ == base::TensorLayout::kLayoutRowMajor) << "A packed tensor can not be viewed.";
+  CHECK(data_type_ != base::DataType::kDataTypeInt4)
+      << "An int4 tensor can not be viewed because its elements are not byte aligned.";
+}
+
+Tensor Tensor::slice(int32_t dim, int32_t begin, int32_t end) const {
+  check_viewable();
+  CHECK_GE(dim, 0);
+  CHECK_LT(dim, this->dims_size());
+  CHECK(0 <= begin && begin <= end && end <= dims_[dim])
+      << "The slice [" << begin << ", " << end << ") is out of the range of dim " << dim;
+  Tensor view = *this;
+  view.dims_[dim] = end - begin;
+  view.size_ = reduce_dimension(view.dims_.begin(), view.dims_.end(), 1);
+  view.byte_offset_ += static_cast<size_t>(begin) * strides_[dim] * base::DataTypeSize(data_type_);
+  return view;
+}
+
+Tensor Tensor::transpose(int32_t dim0, int32_t dim1) const {
+  check_viewable();
+  CHECK(dim0 >= 0 && dim0 < this->dims_size());
+  CHECK(dim1 >= 0 && dim1 < this->dims_size());
+  Tensor view = *this;
+  std::swap(view.dims_[dim0], view.dims_[dim1]);
+  std::swap(view.strides_[dim0], view.strides_[dim1]);
+  return view;
+}
+
+Tensor Tensor::view(const std::vector<int32_t>& dims) const {
+  check_viewable();
+  CHECK(is_contiguous()) << "Only a contiguous tensor can be viewed as another shape.";
+  CHECK_EQ(reduce_dimension(dims.begin(), dims.end(), 1), size_)
+      << "The new shape has a different number of elements.";
+  Tensor view = *this;
+  view.dims_ = dims;
+  view.init_strides();
+  return view;
+}
+
+bool Tensor::is_contiguous() const {
+  size_t expected = 1;
+  for (int32_t i = this->dims_size() - 1; i >= 0; --i) {
+    //长度为1的维不会真正跨过去，它的stride是多少都可以
+    if (dims_[i] != 1 && strides_[i] != expected) {
+      return false;
+    }
+    expected *= dims_[i];
+  }
+  return true;
 }
+
+int64_t Tensor::element_offset(int64_t index) const {
+  int64_t offset = 0;
+  for (int32_t i = this->dims_size() - 1; i >= 0; --i) {
+    offset += index % dims_[i] * static_cast<int64_t>(strides_[i]);
+    index /= dims_[i];
+  }
+  return offset;
+}
+
+size_t Tensor::byte_offset() const { return byte_offset_; }
+
 std::shared_ptr<base::Buffer> Tensor::get_buffer() const { return buffer_; }
 
 Tensor Tensor::clone() const {
@@ -253,24 +313,84 @@ Tensor Tensor::clone() const {
 
   auto allocator = buffer_->allocator();
   new_tensor.buffer_ = std::make_shared<base::Buffer>(byte_size, allocator);
-  new_tensor.buffer_->copy_from(buffer_.get());
+  new_tensor.byte_offset_ = 0;
+  new_tensor.init_strides();
+  if (byte_offset_ == 0 && is_contiguous()) {
+    new_tensor.buffer_->copy_from(buffer_.get());
+  } else if (is_contiguous()) {
+    //copy_from只认buffer的起点，偏移过的视图借一个指向自己那一段的外部buffer
+    auto src = std::make_shared<base::Buffer>(byte_size, nullptr,
+                                              const_cast<int8_t*>(this->ptr<int8_t>()), true);
+    src->set_device_type(this->device_type());
+    new_tensor.buffer_->copy_from(src.get());
+  } else {
+    //不连续的视图逐个元素按strides收集，只在cpu上
+    CHECK(this->device_type() == base::DeviceType::kDeviceCPU)
+        << "Only a cpu tensor can be cloned from a non contiguous view.";
+    const size_t elem_size = base::DataTypeSize(data_type_);
+    const int8_t* src = this->ptr<int8_t>();
+    int8_t* dst = new_tensor.ptr<int8_t>();
+    std::vector<int32_t> coord(dims_.size(), 0);
+    for (size_t i = 0; i < size_; ++i) {
+      size_t offset = 0;
+      for (size_t d = 0; d < dims_.size(); ++d) {
+        offset += coord[d] * strides_[d];
+      }
+      std::memcpy(dst + i * elem_size, src + offset * elem_size, elem_size);
+      for (int32_t d = this->dims_size() - 1; d >= 0; --d) {
+        if (++coord[d] < dims_[d]) {
+          break;
+        }
+        coord[d] = 0;
+      }
+    }
+  }
   return new_tensor;
 }
-size_t Tensor::byte_size() const { return this->size() * DataTypeSize(data_type_); }
+size_t Tensor::byte_size() const { return base::DataTypeByteSize(data_type_, this->size()); }
 
 //这是干什么的
 //dim = （4，5，2，6）
 //stride = （5*2*6，2*6，6，1）
-std::vector<size_t> Tensor::strides() const {
-  std::vector<size_t> strides;
-  if (!dims_.empty()) {
-    for (int32_t i = 0; i < dims_.size() - 1; ++i) {
-      size_t stride = reduce_dimension(dims_.begin() + i + 1, dims_.end(), 1);
-      strides.push_back(stride);
-    }
-    strides.push_back(1);
+void Tensor::init_strides() {
+  strides_.assign(dims_.size(), 1);
+  for (int32_t i = this->dims_size() - 2; i >= 0; --i) {
+    strides_[i] = strides_[i + 1] * dims_[i + 1];
   }
-  return strides;
+}
+
+const std::vector<size_t>& Tensor::strides() const { return strides_; }
+
+bool Tensor::is_empty() const {
+  return size_ == 0 || buffer_ == nullptr || buffer_->ptr() == nullptr;
+}
+
+int32_t Tensor::dims_size() const { return static_cast<int32_t>(dims_.size()); }
+
+base::DataType Tensor::data_type() const { return data_type_; }
+
+const std::vector<int32_t>& Tensor::dims() const { return this->dims_; }
+
+bool Tensor::is_huge_page() const { return buffer_ && buffer_->is_huge_page(); }
+
+base::TensorLayout Tensor::layout() const { return layout_; }
+
+void Tensor::set_layout(base::TensorLayout layout) { layout_ = layout; }
+
+void Tensor::set_device_type(base::DeviceType device_type) {
+  if (buffer_) {
+    buffer_->set_device_type(device_type);
+  }
+}
+
+void Tensor::reset(base::DataType data_type, const std::vector<int32_t>& dims) {
+  this->data_type_ = data_type;
+  this->dims_ = dims;
+  this->size_ = reduce_dimension(dims.begin(), dims.end(), 1);
+  this->buffer_ = nullptr;
+  this->byte_offset_ = 0;
+  this->layout_ = base::TensorLayout::kLayoutRowMajor;
+  init_strides();
 }
 
 
@@ -0,0 +1,42 @@
+#ifndef KUIPER_TEST_TEST_MODEL_MODEL_UTILS_H_
+#define KUIPER_TEST_TEST_MODEL_MODEL_UTILS_H_
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "model/config.h"
+namespace test {
+const model::ModelConfig kConfig = {32, 48, 2, 4, 2, 40, 64};
+
+//按llama2.c导出的顺序写一个随机权重的fp32小模型，seed不同权重就不同
+inline void write_model(const std::string& path, uint32_t seed = 1) {
+  const int32_t dim = kConfig.dim;
+  const int32_t hidden_dim = kConfig.hidden_dim;
+  const int32_t layer_num = kConfig.layer_num;
+  const int32_t kv_dim = dim / kConfig.head_num * kConfig.kv_head_num;
+  std::mt19937 rng(seed);
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&kConfig), sizeof(model::ModelConfig));
+  auto write = [&](int64_t num, float stddev, float mean) {
+    std::normal_distribution<float> dist(mean, stddev);
+    std::vector<float> weights(num);
+    for (float& w : weights) {
+      w = dist(rng);
+    }
+    file.write(reinterpret_cast<const char*>(weights.data()), num * sizeof(float));
+  };
+  write(static_cast<int64_t>(kConfig.vocab_size) * dim, 1.f, 0.f);
+  write(layer_num * dim, 0.1f, 1.f);
+  write(static_cast<int64_t>(layer_num) * dim * dim, 0.3f, 0.f);
+  write(static_cast<int64_t>(layer_num) * kv_dim * dim, 0.3f, 0.f);
+  write(static_cast<int64_t>(layer_num) * kv_dim * dim, 0.3f, 0.f);
+  write(static_cast<int64_t>(layer_num) * dim * dim, 0.3f, 0.f);
+  write(layer_num * dim, 0.1f, 1.f);
+  write(static_cast<int64_t>(layer_num) * hidden_dim * dim, 0.3f, 0.f);
+  write(static_cast<int64_t>(layer_num) * dim * hidden_dim, 0.3f, 0.f);
+  write(static_cast<int64_t>(layer_num) * hidden_dim * dim, 0.3f, 0.f);
+  write(dim, 0.1f, 1.f);
+  write(static_cast<int64_t>(kConfig.seq_len) * (dim / kConfig.head_num), 0.f, 0.f);
+}
+}  // namespace test
+#endif  // KUIPER_TEST_TEST_MODEL_MODEL_UTILS_H_
@@ -0,0 +1,267 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+#include "../utils.h"
+#include "model/llama2.h"
+#include "model_utils.h"
+
+namespace {
+using test::kConfig;
+
+//int4要求每一层的dim1都是group_size（32的倍数）的整数倍，hidden_dim换成64
+const model::ModelConfig kQuantConfig = {32, 64, 2, 4, 2, 40, 64};
+const int32_t kGroupSize = 32;
+
+//同时写一个量化模型和一个fp32模型，fp32模型的权重就是量化权重反量化之后的值，
+//两者的logits应该只差计算误差。
+//Linear是int4，融合的SwiGLU的w1、w3是int8，embedding和norm是fp32
+void write_quant_model(const std::string& quant_path, const std::string& fp32_path,
+                       bool with_min) {
+  const model::ModelConfig& c = kQuantConfig;
+  const int32_t kv_dim = c.dim / c.head_num * c.kv_head_num;
+  std::mt19937 rng(7);
+  std::ofstream quant(quant_path, std::ios::binary);
+  std::ofstream fp32(fp32_path, std::ios::binary);
+  quant.write(reinterpret_cast<const char*>(&c), sizeof(model::ModelConfig));
+  quant.write(reinterpret_cast<const char*>(&kGroupSize), sizeof(int32_t));
+  fp32.write(reinterpret_cast<const char*>(&c), sizeof(model::ModelConfig));
+  auto write = [](std::ofstream& file, const auto& data) {
+    file.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(data[0]));
+  };
+  auto write_fp32 = [&](int64_t num, float stddev, float mean) {
+    std::normal_distribution<float> dist(mean, stddev);
+    std::vector<float> weights(num);
+    for (float& w : weights) {
+      w = dist(rng);
+    }
+    write(quant, weights);
+    write(fp32, weights);
+  };
+  auto write_int8 = [&](int64_t num) {
+    std::vector<int8_t> q(num);
+    std::vector<float> scales(num / kGroupSize);
+    std::vector<float> weights(num);
+    for (float& scale : scales) {
+      scale = 0.3f / 127.f * (0.5f + static_cast<float>(rng() % 100) / 100.f);
+    }
+    for (int64_t i = 0; i < num; ++i) {
+      q[i] = static_cast<int8_t>(static_cast<int32_t>(rng() % 255) - 127);
+      weights[i] = q[i] * scales[i / kGroupSize];
+    }
+    write(quant, q);
+    write(quant, scales);
+    write(fp32, weights);
+  };
+  auto write_int4 = [&](int64_t num) {
+    std::vector<uint8_t> q(num);
+    std::vector<uint8_t> packed(num / 2);
+    std::vector<uint16_t> scales(num / kGroupSize);
+    std::vector<uint16_t> mins(num / kGroupSize);
+    std::vector<float> weights(num);
+    for (int64_t g = 0; g < num / kGroupSize; ++g) {
+      const float scale = 0.3f / 8.f * (0.5f + static_cast<float>(rng() % 100) / 100.f);
+      scales[g] = test::fp32_to_fp16_ref(scale);
+      mins[g] = test::fp32_to_fp16_ref(-0.05f * static_cast<float>(rng() % 10));
+    }
+    for (int64_t i = 0; i < num; ++i) {
+      q[i] = static_cast<uint8_t>(rng() % 16);
+      const float scale = test::fp16_to_fp32_ref(scales[i / kGroupSize]);
+      weights[i] = with_min ? q[i] * scale + test::fp16_to_fp32_ref(mins[i / kGroupSize])
+                            : (static_cast<int32_t>(q[i]) - 8) * scale;
+    }
+    //每32个一块，第j个字节的低4位是块里的第j个，高4位是第j + 16个
+    for (int64_t block = 0; block < num / 32; ++block) {
+      for (int32_t j = 0; j < 16; ++j) {
+        packed[block * 16 + j] =
+            static_cast<uint8_t>(q[block * 32 + j] | (q[block * 32 + j + 16] << 4));
+      }
+    }
+    write(quant, packed);
+    write(quant, scales);
+    if (with_min) {
+      write(quant, mins);
+    }
+    write(fp32, weights);
+  };
+  auto each_layer = [&](auto&& write_layer, int64_t num) {
+    for (int32_t i = 0; i < c.layer_num; ++i) {
+      write_layer(num);
+    }
+  };
+  write_fp32(static_cast<int64_t>(c.vocab_size) * c.dim, 1.f, 0.f);
+  write_fp32(c.layer_num * c.dim, 0.1f, 1.f);
+  each_layer(write_int4, c.dim * c.dim);
+  each_layer(write_int4, kv_dim * c.dim);
+  each_layer(write_int4, kv_dim * c.dim);
+  each_layer(write_int4, c.dim * c.dim);
+  write_fp32(c.layer_num * c.dim, 0.1f, 1.f);
+  each_layer(write_int8, c.hidden_dim * c.dim);
+  each_layer(write_int4, c.dim * c.hidden_dim);
+  each_layer(write_int8, c.hidden_dim * c.dim);
+  write_fp32(c.dim, 0.1f, 1.f);
+  write_fp32(static_cast<int64_t>(c.seq_len) * (c.dim / c.head_num), 0.f, 0.f);
+}
+
+class LLama2Test : public testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    path_ = testing::TempDir() + "kuiper_test_llama2.bin";
+    test::write_model(path_);
+  }
+
+  static void TearDownTestSuite() { std::remove(path_.c_str()); }
+
+  //一次prefill完prompt，返回每一行的logits
+  static std::vector<float> prefill(model::LLama2Model& llama, const std::vector<int32_t>& prompt) {
+    const int32_t seq_id = 0;
+    auto kv_cache = llama.kv_cache();
+    CHECK(kv_cache->add_sequence(seq_id));
+    CHECK(kv_cache->reserve(seq_id, static_cast<int32_t>(prompt.size()) - 1));
+    std::vector<model::BatchRow> rows;
+    for (int32_t pos = 0; pos < static_cast<int32_t>(prompt.size()); ++pos) {
+      rows.push_back({seq_id, pos, prompt[pos], true});
+    }
+    tensor::Tensor logits;
+    CHECK(llama.forward(rows, logits));
+    std::vector<float> result(logits.ptr<float>(), logits.ptr<float>() + logits.size());
+    kv_cache->free_sequence(seq_id);
+    return result;
+  }
+
+  static std::vector<float> prefill_with(base::DataType weight_type) {
+    model::LLama2Model llama(path_);
+    llama.set_weight_data_type(weight_type);
+    CHECK(llama.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+    return prefill(llama, kPrompt);
+  }
+
+  static const std::vector<int32_t> kPrompt;
+  static std::string path_;
+};
+
+const std::vector<int32_t> LLama2Test::kPrompt = {3, 17, 22, 8, 8, 39, 0, 25, 33};
+std::string LLama2Test::path_;
+
+void expect_close(const std::vector<float>& output, const std::vector<float>& ref, float rel_tol) {
+  ASSERT_EQ(output.size(), ref.size());
+  float max_abs = 0.f;
+  for (float x : ref) {
+    max_abs = std::max(max_abs, std::abs(x));
+  }
+  for (size_t i = 0; i < ref.size(); ++i) {
+    ASSERT_NEAR(output[i], ref[i], rel_tol * max_abs) << "index " << i;
+  }
+}
+}  // namespace
+
+TEST_F(LLama2Test, fp16_and_bf16_weights_track_fp32) {
+  const std::vector<float> ref = prefill_with(base::DataType::kDataTypeFp32);
+  ASSERT_EQ(ref.size(), kPrompt.size() * kConfig.vocab_size);
+  //fp16有10位尾数，bf16只有7位
+  expect_close(prefill_with(base::DataType::kDataTypeFp16), ref, 1e-2f);
+  expect_close(prefill_with(base::DataType::kDataTypeBf16), ref, 5e-2f);
+}
+
+TEST_F(LLama2Test, rejects_16bit_weights_for_a_quantized_model) {
+  model::LLama2Model llama(path_, true);
+  llama.set_weight_data_type(base::DataType::kDataTypeFp16);
+  ASSERT_FALSE(llama.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+}
+
+TEST_F(LLama2Test, int4_weights_match_their_dequantized_values) {
+  const std::string quant_path = testing::TempDir() + "kuiper_test_llama2_q4.bin";
+  const std::string fp32_path = testing::TempDir() + "kuiper_test_llama2_q4_ref.bin";
+  for (bool with_min : {false, true}) {
+    write_quant_model(quant_path, fp32_path, with_min);
+    model::LLama2Model ref_model(fp32_path);
+    ASSERT_TRUE(ref_model.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+    model::LLama2Model quant_model(quant_path, true);
+    quant_model.set_quant_weight_type(base::DataType::kDataTypeInt4, with_min);
+    ASSERT_TRUE(quant_model.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+    expect_close(prefill(quant_model, kPrompt), prefill(ref_model, kPrompt), 1e-4f);
+  }
+  //不设置int4时按int8的布局去读，文件大小对不上
+  model::LLama2Model int8_model(quant_path, true);
+  ASSERT_FALSE(int8_model.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+  std::remove(quant_path.c_str());
+  std::remove(fp32_path.c_str());
+
+  model::LLama2Model fp32_model(path_);
+  fp32_model.set_quant_weight_type(base::DataType::kDataTypeInt4);
+  ASSERT_FALSE(fp32_model.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+}
+
+TEST_F(LLama2Test, prepacked_weights_match_row_major) {
+  const std::vector<float> ref = prefill_with(base::DataType::kDataTypeFp32);
+  const std::string cache_path = testing::TempDir() + "kuiper_test_llama2.packed";
+  std::remove(cache_path.c_str());
+  //第一次打包之后写缓存，第二次直接映射缓存
+  for (int32_t i = 0; i < 2; ++i) {
+    model::LLama2Model llama(path_);
+    llama.set_weight_prepack(true, cache_path);
+    ASSERT_TRUE(llama.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+    expect_close(prefill(llama, kPrompt), ref, 1e-5f);
+    std::ifstream cache(cache_path, std::ios::binary);
+    ASSERT_TRUE(cache.good());
+  }
+  std::remove(cache_path.c_str());
+}
+
+TEST_F(LLama2Test, numa_placement_matches_default) {
+  const std::vector<float> ref = prefill_with(base::DataType::kDataTypeFp32);
+  for (auto policy : {base::NumaPolicy::kNumaPolicyInterleave, base::NumaPolicy::kNumaPolicyBind}) {
+    model::LLama2Model llama(path_);
+    llama.set_numa_policy(policy);
+    //按节点切分过的Linear跳过打包，其余的照常打包
+    llama.set_weight_prepack(true, testing::TempDir() + "kuiper_test_llama2_numa.packed");
+    ASSERT_TRUE(llama.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+    expect_close(prefill(llama, kPrompt), ref, 1e-5f);
+  }
+  std::remove((testing::TempDir() + "kuiper_test_llama2_numa.packed").c_str());
+}
+
+TEST_F(LLama2Test, huge_pages_match_normal_pages) {
+  const std::vector<float> ref = prefill_with(base::DataType::kDataTypeFp32);
+  //没有预留大页或者不支持THP的机器上会退回到4K页，结果都不变
+  for (auto policy :
+       {base::HugePagePolicy::kHugePageTransparent, base::HugePagePolicy::kHugePageExplicit}) {
+    model::LLama2Model llama(path_);
+    llama.set_huge_page_policy(policy);
+    ASSERT_TRUE(llama.init(base::DeviceType::kDeviceCPU, 16, 4, 16));
+    expect_close(prefill(llama, kPrompt), ref, 1e-5f);
+  }
+}
+
+TEST_F(LLama2Test, activations_share_the_planned_arena) {
+  const int32_t max_rows = 16;
+  model::LLama2Model llama(path_);
+  ASSERT_TRUE(llama.init(base::DeviceType::kDeviceCPU, max_rows, 4, 16));
+  const model::TransformerConfig& c = llama.config();
+  const size_t row_bytes = max_rows * sizeof(float);
+  //x、xb、query、attn_out、proj_out是dim，key、value是kv_dim
+  const size_t live = (2 * c.dim + c.vocab_size) * row_bytes;
+  const size_t total = (5 * c.dim + 2 * c.kv_dim + c.hidden_dim + c.vocab_size) * row_bytes;
+  ASSERT_GE(llama.activation_byte_size(), live);
+  ASSERT_LT(llama.activation_byte_size(), total);
+
+  //arena里的激活被不同的行数反复重写，一次prefill和逐行decode的logits一样
+  const std::vector<float> batched = prefill(llama, kPrompt);
+  auto kv_cache = llama.kv_cache();
+  ASSERT_TRUE(kv_cache->add_sequence(1));
+  for (int32_t pos = 0; pos < static_cast<int32_t>(kPrompt.size()); ++pos) {
+    ASSERT_TRUE(kv_cache->reserve(1, pos));
+    tensor::Tensor logits;
+    ASSERT_TRUE(llama.forward({{1, pos, kPrompt[pos], true}}, logits));
+    const std::vector<float> row(logits.ptr<float>(), logits.ptr<float>() + c.vocab_size);
+    expect_close(row,
+                 std::vector<float>(batched.begin() + pos * c.vocab_size,
+                                    batched.begin() + (pos + 1) * c.vocab_size),
+                 1e-5f);
+  }
+  kv_cache->free_sequence(1);
+}
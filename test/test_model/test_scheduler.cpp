@@ -0,0 +1,200 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+#include "model/scheduler.h"
+#include "model_utils.h"
+
+namespace {
+using test::kConfig;
+
+class SchedulerTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    path_ = testing::TempDir() + "kuiper_test_model.bin";
+    test::write_model(path_);
+  }
+
+  static void TearDownTestSuite() { std::remove(path_.c_str()); }
+
+  static std::unique_ptr<model::LLama2Model> make_model(int32_t kv_block_num) {
+    auto llama = std::make_unique<model::LLama2Model>(path_);
+    CHECK(llama->init(base::DeviceType::kDeviceCPU, 16, 4, kv_block_num));
+    return llama;
+  }
+
+  //不经过调度器，一行一行地forward同一个序列，贪心地取logits最大的token
+  static std::vector<int32_t> generate_alone(model::LLama2Model& llama,
+                                             const std::vector<int32_t>& prompt,
+                                             int32_t max_new_tokens, int32_t eos_token = -1) {
+    const int32_t seq_id = 1 << 20;
+    auto kv_cache = llama.kv_cache();
+    CHECK(kv_cache->add_sequence(seq_id));
+    std::vector<int32_t> tokens = prompt;
+    std::vector<int32_t> output;
+    for (int32_t pos = 0; static_cast<int32_t>(output.size()) < max_new_tokens; ++pos) {
+      CHECK(kv_cache->reserve(seq_id, pos));
+      const bool need_logits = pos + 1 == static_cast<int32_t>(tokens.size());
+      tensor::Tensor logits;
+      CHECK(llama.forward({{seq_id, pos, tokens[pos], need_logits}}, logits));
+      if (!need_logits) {
+        continue;
+      }
+      const float* row = logits.ptr<float>();
+      const int32_t next = static_cast<int32_t>(
+          std::max_element(row, row + kConfig.vocab_size) - row);
+      tokens.push_back(next);
+      output.push_back(next);
+      if (next == eos_token) {
+        break;
+      }
+    }
+    kv_cache->free_sequence(seq_id);
+    return output;
+  }
+
+  static std::vector<model::GenerationRequest> make_requests(int32_t num, uint32_t seed,
+                                                             int32_t shared_prefix = 0) {
+    std::mt19937 rng(seed);
+    std::vector<int32_t> prefix(shared_prefix);
+    for (int32_t& token : prefix) {
+      token = static_cast<int32_t>(rng() % kConfig.vocab_size);
+    }
+    std::vector<model::GenerationRequest> requests(num);
+    for (int32_t i = 0; i < num; ++i) {
+      requests[i].request_id = 100 + i;
+      requests[i].prompt_tokens = prefix;
+      const int32_t len = 1 + static_cast<int32_t>(rng() % 20);
+      for (int32_t j = 0; j < len; ++j) {
+        requests[i].prompt_tokens.push_back(static_cast<int32_t>(rng() % kConfig.vocab_size));
+      }
+      requests[i].max_new_tokens = 1 + static_cast<int32_t>(rng() % 12);
+    }
+    return requests;
+  }
+
+  //跑完所有请求，检查每个请求的输出和在另一个模型上单独跑时一样，
+  //返回过程中waiting_num增加过几次（被抢占）
+  static int32_t run_and_check(model::Scheduler& scheduler,
+                               const std::vector<model::GenerationRequest>& requests) {
+    std::map<int32_t, std::vector<int32_t>> streamed;
+    scheduler.set_token_callback(
+        [&](int32_t request_id, int32_t token) { streamed[request_id].push_back(token); });
+    for (const auto& request : requests) {
+      CHECK(scheduler.add_request(request));
+    }
+    std::map<int32_t, std::vector<int32_t>> outputs;
+    int32_t preempted = 0;
+    int32_t steps = 0;
+    while (scheduler.has_unfinished()) {
+      const int32_t waiting = scheduler.waiting_num();
+      EXPECT_TRUE(scheduler.step());
+      preempted += scheduler.waiting_num() > waiting;
+      for (auto& result : scheduler.pop_finished()) {
+        EXPECT_EQ(outputs.count(result.request_id), 0u);
+        outputs[result.request_id] = std::move(result.output_tokens);
+      }
+      CHECK_LT(++steps, 10000);
+    }
+    EXPECT_EQ(outputs.size(), requests.size());
+    auto alone = make_model(64);
+    for (const auto& request : requests) {
+      const std::vector<int32_t> ref = generate_alone(*alone, request.prompt_tokens,
+                                                      request.max_new_tokens, request.eos_token);
+      EXPECT_EQ(outputs[request.request_id], ref) << "request " << request.request_id;
+      EXPECT_EQ(streamed[request.request_id], ref) << "request " << request.request_id;
+    }
+    return preempted;
+  }
+
+  static std::string path_;
+};
+
+std::string SchedulerTest::path_;
+}  // namespace
+
+TEST_F(SchedulerTest, batched_greedy_matches_single_sequence) {
+  auto llama = make_model(64);
+  model::Scheduler scheduler(llama.get(), 4);
+  //prompt分成几块prefill，和decode的行混在同一步里
+  scheduler.set_prefill_chunk_size(5);
+  ASSERT_EQ(run_and_check(scheduler, make_requests(9, 1)), 0);
+  ASSERT_EQ(scheduler.running_num(), 0);
+  ASSERT_EQ(scheduler.waiting_num(), 0);
+  ASSERT_EQ(llama->kv_cache()->free_block_num(), 64);
+}
+
+TEST_F(SchedulerTest, eos_finishes_early) {
+  auto llama = make_model(64);
+  model::Scheduler scheduler(llama.get(), 4);
+  auto requests = make_requests(3, 2);
+  for (auto& request : requests) {
+    request.max_new_tokens = 12;
+    //单独跑时第三个生成的token当成eos
+    request.eos_token = generate_alone(*llama, request.prompt_tokens, 3)[2];
+  }
+  run_and_check(scheduler, requests);
+  ASSERT_EQ(llama->kv_cache()->free_block_num(), 64);
+}
+
+TEST_F(SchedulerTest, preemption_recomputes_the_same_tokens) {
+  //12个block只够放48个位置，4个序列一起跑一定会有被抢占的
+  auto llama = make_model(12);
+  model::Scheduler scheduler(llama.get(), 4);
+  scheduler.set_prefill_chunk_size(3);
+  auto requests = make_requests(8, 3);
+  for (auto& request : requests) {
+    request.max_new_tokens = 12;
+  }
+  ASSERT_GT(run_and_check(scheduler, requests), 0);
+  ASSERT_EQ(llama->kv_cache()->free_block_num(), 12);
+}
+
+TEST_F(SchedulerTest, prefix_cache_shares_blocks) {
+  auto llama = make_model(48);
+  auto kv_cache = llama->kv_cache();
+  auto prefix_cache = std::make_shared<op::PrefixCache>(kv_cache, kv_cache->byte_size());
+  model::Scheduler scheduler(llama.get(), 3);
+  scheduler.set_prefill_chunk_size(6);
+  scheduler.set_prefix_cache(prefix_cache);
+  //前缀17个token，写满4个block。前3个请求同时进batch，都还没读完prompt，
+  //后面5个请求应该都能命中
+  run_and_check(scheduler, make_requests(8, 4, 17));
+  ASSERT_GE(prefix_cache->matched_token_num(), 5 * 16);
+  //结束之后只剩树里还引用着block
+  ASSERT_GT(prefix_cache->cached_block_num(), 0);
+  ASSERT_EQ(kv_cache->free_block_num() + prefix_cache->cached_block_num(), 48);
+
+  //树占着的block在kv cache不够时会被淘汰，不会卡住新的请求
+  auto requests = make_requests(6, 5);
+  for (auto& request : requests) {
+    request.max_new_tokens = 20;
+  }
+  run_and_check(scheduler, requests);
+  ASSERT_EQ(kv_cache->free_block_num() + prefix_cache->cached_block_num(), 48);
+
+  scheduler.set_prefix_cache(nullptr);
+  prefix_cache.reset();
+  ASSERT_EQ(kv_cache->free_block_num(), 48);
+}
+
+TEST_F(SchedulerTest, rejects_invalid_requests) {
+  auto llama = make_model(16);
+  model::Scheduler scheduler(llama.get(), 2);
+  model::GenerationRequest request;
+  request.max_new_tokens = 4;
+  ASSERT_FALSE(scheduler.add_request(request));
+  request.prompt_tokens = {1, 2, 3};
+  request.max_new_tokens = 0;
+  ASSERT_FALSE(scheduler.add_request(request));
+  request.max_new_tokens = 4;
+  request.prompt_tokens.assign(kConfig.seq_len, 1);
+  ASSERT_FALSE(scheduler.add_request(request));
+  request.prompt_tokens = {1, 2, 3};
+  request.sampler_config.top_p = 2.f;
+  ASSERT_FALSE(scheduler.add_request(request));
+  ASSERT_FALSE(scheduler.has_unfinished());
+}
@@ -0,0 +1,122 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <vector>
+#include "model/speculative.h"
+#include "model_utils.h"
+
+namespace {
+using test::kConfig;
+
+class SpeculativeTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    target_path_ = testing::TempDir() + "kuiper_test_target.bin";
+    draft_path_ = testing::TempDir() + "kuiper_test_draft.bin";
+    test::write_model(target_path_, 1);
+    test::write_model(draft_path_, 2);
+  }
+
+  static void TearDownTestSuite() {
+    std::remove(target_path_.c_str());
+    std::remove(draft_path_.c_str());
+  }
+
+  static std::unique_ptr<model::LLama2Model> make_model(const std::string& path) {
+    auto llama = std::make_unique<model::LLama2Model>(path);
+    CHECK(llama->init(base::DeviceType::kDeviceCPU, 16, 4, 32));
+    return llama;
+  }
+
+  //只有target、经过Scheduler生成的结果
+  static std::vector<int32_t> generate_scheduled(const model::GenerationRequest& request) {
+    auto llama = make_model(target_path_);
+    model::Scheduler scheduler(llama.get(), 1);
+    CHECK(scheduler.add_request(request));
+    std::vector<int32_t> output;
+    while (scheduler.has_unfinished()) {
+      CHECK(scheduler.step());
+      for (auto& result : scheduler.pop_finished()) {
+        output = std::move(result.output_tokens);
+      }
+    }
+    return output;
+  }
+
+  static model::GenerationRequest make_request(int32_t prompt_len, int32_t max_new_tokens) {
+    model::GenerationRequest request;
+    request.request_id = 7;
+    for (int32_t i = 0; i < prompt_len; ++i) {
+      request.prompt_tokens.push_back((i * 13 + 5) % kConfig.vocab_size);
+    }
+    request.max_new_tokens = max_new_tokens;
+    return request;
+  }
+
+  static std::string target_path_;
+  static std::string draft_path_;
+};
+
+std::string SpeculativeTest::target_path_;
+std::string SpeculativeTest::draft_path_;
+}  // namespace
+
+TEST_F(SpeculativeTest, greedy_matches_target_alone) {
+  auto target = make_model(target_path_);
+  auto draft = make_model(draft_path_);
+  model::SpeculativeDecoder decoder(target.get(), draft.get(), 4);
+  ASSERT_TRUE(decoder.init());
+  const model::GenerationRequest request = make_request(9, 20);
+  std::vector<int32_t> streamed;
+  decoder.set_token_callback([&](int32_t, int32_t token) { streamed.push_back(token); });
+  model::GenerationResult result;
+  ASSERT_TRUE(decoder.generate(request, result));
+  const std::vector<int32_t> ref = generate_scheduled(request);
+  ASSERT_EQ(ref.size(), 20u);
+  ASSERT_EQ(result.output_tokens, ref);
+  ASSERT_EQ(streamed, ref);
+  ASSERT_GT(decoder.proposed_num(), 0);
+  ASSERT_EQ(target->kv_cache()->free_block_num(), 32);
+  ASSERT_EQ(draft->kv_cache()->free_block_num(), 32);
+}
+
+TEST_F(SpeculativeTest, stops_at_seq_len_like_the_scheduler) {
+  auto target = make_model(target_path_);
+  auto draft = make_model(draft_path_);
+  model::SpeculativeDecoder decoder(target.get(), draft.get(), 4);
+  ASSERT_TRUE(decoder.init());
+  //prompt占了前58个位置，最后一个生成的token正好落在位置seq_len上，不用再送进模型
+  const model::GenerationRequest request = make_request(kConfig.seq_len - 6, 20);
+  model::GenerationResult result;
+  ASSERT_TRUE(decoder.generate(request, result));
+  const std::vector<int32_t> ref = generate_scheduled(request);
+  ASSERT_EQ(ref.size(), 7u);
+  ASSERT_EQ(result.output_tokens, ref);
+}
+
+TEST_F(SpeculativeTest, sampling_is_reproducible) {
+  auto target = make_model(target_path_);
+  auto draft = make_model(draft_path_);
+  model::SpeculativeDecoder decoder(target.get(), draft.get(), 3);
+  ASSERT_TRUE(decoder.init());
+  model::GenerationRequest request = make_request(5, 24);
+  request.sampler_config.temperature = 0.8f;
+  request.sampler_config.seed = 42;
+  model::GenerationResult first;
+  model::GenerationResult second;
+  ASSERT_TRUE(decoder.generate(request, first));
+  ASSERT_TRUE(decoder.generate(request, second));
+  ASSERT_EQ(first.output_tokens.size(), 24u);
+  ASSERT_EQ(first.output_tokens, second.output_tokens);
+
+  //draft和target是同一个模型时p == q，每个猜测都会被接受
+  auto same = make_model(target_path_);
+  model::SpeculativeDecoder self(target.get(), same.get(), 3);
+  ASSERT_TRUE(self.init());
+  ASSERT_TRUE(self.generate(request, first));
+  ASSERT_GT(self.proposed_num(), 0);
+  ASSERT_EQ(self.accepted_num(), self.proposed_num());
+
+  request.sampler_config.top_k = 5;
+  ASSERT_FALSE(decoder.generate(request, first));
+}
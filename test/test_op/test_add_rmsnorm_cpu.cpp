@@ -0,0 +1,77 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "../utils.h"
+#include "op/add.h"
+
+namespace {
+const int32_t kRows = 3;
+const int32_t kDim = 40;
+const float kEps = 1e-5f;
+}  // namespace
+
+TEST(test_add_rmsnorm_cpu, matches_add_then_rmsnorm) {
+  auto alloc = test::cpu_alloc();
+  tensor::Tensor residual(base::DataType::kDataTypeFp32, kRows, kDim, true, alloc);
+  tensor::Tensor delta(base::DataType::kDataTypeFp32, kRows, kDim, true, alloc);
+  tensor::Tensor weight(base::DataType::kDataTypeFp32, kDim, true, alloc);
+  tensor::Tensor normed(base::DataType::kDataTypeFp32, kRows, kDim, true, alloc);
+  test::fill_normal(residual, 1);
+  test::fill_normal(delta, 2);
+  test::fill_normal(weight, 3);
+
+  std::vector<double> sum(residual.size());
+  std::vector<double> ref(residual.size());
+  for (int32_t r = 0; r < kRows; ++r) {
+    double mean_square = 0.0;
+    for (int32_t i = 0; i < kDim; ++i) {
+      const int32_t idx = r * kDim + i;
+      sum[idx] = residual.index<float>(idx) + delta.index<float>(idx);
+      mean_square += sum[idx] * sum[idx] / kDim;
+    }
+    for (int32_t i = 0; i < kDim; ++i) {
+      const int32_t idx = r * kDim + i;
+      ref[idx] = sum[idx] / std::sqrt(mean_square + kEps) * weight.index<float>(i);
+    }
+  }
+
+  op::AddRMSNormLayer layer(base::DeviceType::kDeviceCPU, kDim, kEps);
+  ASSERT_EQ(layer.layer_type(), op::LayerType::kLayerAddRMSNorm);
+  ASSERT_TRUE(layer.set_weight(0, weight));
+  //残差流原地更新
+  layer.set_input(0, residual);
+  layer.set_input(1, delta);
+  layer.set_output(0, residual);
+  layer.set_output(1, normed);
+  ASSERT_TRUE(layer.forward());
+  for (size_t i = 0; i < ref.size(); ++i) {
+    ASSERT_NEAR(residual.index<float>(i), sum[i], 1e-5) << "index " << i;
+    ASSERT_NEAR(normed.index<float>(i), ref[i], 1e-4 * (1.0 + std::abs(ref[i]))) << "index " << i;
+  }
+}
+
+TEST(test_add_rmsnorm_cpu, rejects_invalid_shapes) {
+  auto alloc = test::cpu_alloc();
+  tensor::Tensor residual(base::DataType::kDataTypeFp32, kRows, kDim, true, alloc);
+  tensor::Tensor delta(base::DataType::kDataTypeFp32, kRows, kDim, true, alloc);
+  tensor::Tensor normed(base::DataType::kDataTypeFp32, kRows, kDim, true, alloc);
+
+  //dim为0时不能拿residual的大小去取模
+  op::AddRMSNormLayer empty(base::DeviceType::kDeviceCPU, 0);
+  empty.set_input(0, residual);
+  empty.set_input(1, delta);
+  empty.set_output(0, residual);
+  empty.set_output(1, normed);
+  ASSERT_FALSE(empty.check());
+
+  //residual的大小不是dim的整数倍
+  op::AddRMSNormLayer layer(base::DeviceType::kDeviceCPU, kDim + 1);
+  tensor::Tensor weight(base::DataType::kDataTypeFp32, kDim + 1, true, alloc);
+  ASSERT_TRUE(layer.set_weight(0, weight));
+  layer.set_input(0, residual);
+  layer.set_input(1, delta);
+  layer.set_output(0, residual);
+  layer.set_output(1, normed);
+  ASSERT_FALSE(layer.check());
+}
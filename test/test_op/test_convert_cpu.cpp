@@ -0,0 +1,125 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "../utils.h"
+#include "op/kernels/cpu/convert_kernel.h"
+
+//覆盖各个指数段、舍入的平局、非规格化数、溢出和特殊值，长度不是16的倍数，向量和标量的尾部都会走到
+static std::vector<float> convert_inputs() {
+  std::vector<float> inputs = {0.f,
+                               -0.f,
+                               1.f,
+                               -1.f,
+                               65504.f,
+                               65519.f,
+                               65520.f,
+                               -70000.f,
+                               6.1035156e-05f,
+                               5.9604645e-08f,
+                               2.9802322e-08f,
+                               2.9802326e-08f,
+                               1e-10f,
+                               1.00048828125f,
+                               1.00146484375f,
+                               1.0009765625f,
+                               1.00390625f,
+                               1.01171875f,
+                               std::numeric_limits<float>::infinity(),
+                               -std::numeric_limits<float>::infinity(),
+                               3.4028235e38f};
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> exponent(-30.f, 20.f);
+  std::uniform_int_distribution<uint32_t> mantissa(0, 0x7FFFFF);
+  while (inputs.size() < 1003) {
+    const float x = std::exp2(exponent(rng));
+    //随机改低位，让舍入位和粘滞位都出现
+    const uint32_t bits = (test::float_bits(x) & 0xFF800000) | mantissa(rng);
+    inputs.push_back((inputs.size() % 2 ? -1.f : 1.f) * test::bits_float(bits));
+  }
+  return inputs;
+}
+
+TEST(test_convert_cpu, fp32_to_fp16_round_to_nearest_even) {
+  const std::vector<float> inputs = convert_inputs();
+  std::vector<uint16_t> output(inputs.size());
+  kernel::fp32_to_fp16_cpu(inputs.data(), output.data(), static_cast<int64_t>(inputs.size()));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ(output[i], test::fp32_to_fp16_ref(inputs[i])) << "input " << inputs[i];
+  }
+}
+
+TEST(test_convert_cpu, fp16_to_fp32_all_values) {
+  std::vector<uint16_t> inputs(65536);
+  for (int32_t i = 0; i < 65536; ++i) {
+    inputs[i] = static_cast<uint16_t>(i);
+  }
+  std::vector<float> output(inputs.size());
+  kernel::fp16_to_fp32_cpu(inputs.data(), output.data(), static_cast<int64_t>(inputs.size()));
+  for (int32_t i = 0; i < 65536; ++i) {
+    const float ref = test::fp16_to_fp32_ref(inputs[i]);
+    if (std::isnan(ref)) {
+      ASSERT_TRUE(std::isnan(output[i])) << "half " << i;
+    } else {
+      ASSERT_EQ(test::float_bits(output[i]), test::float_bits(ref)) << "half " << i;
+    }
+  }
+}
+
+TEST(test_convert_cpu, fp32_to_bf16_round_to_nearest_even) {
+  std::vector<float> inputs = convert_inputs();
+  //有AVX-512-BF16时fp32的非规格化数会被当成0，这里不比较它们
+  for (float& x : inputs) {
+    if (std::fpclassify(x) == FP_SUBNORMAL) {
+      x = 0.f;
+    }
+  }
+  inputs.push_back(std::numeric_limits<float>::quiet_NaN());
+  std::vector<uint16_t> output(inputs.size());
+  kernel::fp32_to_bf16_cpu(inputs.data(), output.data(), static_cast<int64_t>(inputs.size()));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (std::isnan(inputs[i])) {
+      ASSERT_TRUE(std::isnan(test::bf16_to_fp32_ref(output[i])));
+      continue;
+    }
+    ASSERT_EQ(output[i], test::fp32_to_bf16_ref(inputs[i])) << "input " << inputs[i];
+  }
+}
+
+TEST(test_convert_cpu, bf16_round_trip) {
+  std::vector<uint16_t> inputs(1000);
+  std::mt19937 rng(11);
+  for (auto& x : inputs) {
+    //避开NaN和非规格化数
+    do {
+      x = static_cast<uint16_t>(rng());
+    } while (((x & 0x7F80) == 0x7F80 || (x & 0x7F80) == 0) && (x & 0x7F));
+  }
+  std::vector<float> fp32(inputs.size());
+  std::vector<uint16_t> output(inputs.size());
+  kernel::bf16_to_fp32_cpu(inputs.data(), fp32.data(), static_cast<int64_t>(inputs.size()));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ(test::float_bits(fp32[i]), test::float_bits(test::bf16_to_fp32_ref(inputs[i])));
+  }
+  kernel::fp32_to_bf16_cpu(fp32.data(), output.data(), static_cast<int64_t>(fp32.size()));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ(output[i], inputs[i]);
+  }
+}
+
+TEST(test_convert_cpu, convert_tensor) {
+  auto alloc = test::cpu_alloc();
+  const int32_t size = 200003;
+  tensor::Tensor input(base::DataType::kDataTypeFp32, size, true, alloc);
+  tensor::Tensor half(base::DataType::kDataTypeFp16, size, true, alloc);
+  tensor::Tensor output(base::DataType::kDataTypeFp32, size, true, alloc);
+  test::fill_normal(input, 3);
+  //跨过多个kConvertGrain，分块的边界上不能漏也不能重
+  kernel::convert_kernel_cpu(input, half);
+  kernel::convert_kernel_cpu(half, output);
+  for (int32_t i = 0; i < size; ++i) {
+    ASSERT_EQ(half.index<uint16_t>(i), test::fp32_to_fp16_ref(input.index<float>(i)));
+    ASSERT_EQ(output.index<float>(i), test::fp16_to_fp32_ref(half.index<uint16_t>(i)));
+  }
+}
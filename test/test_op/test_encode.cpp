@@ -0,0 +1,161 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "op/encode.h"
+
+namespace {
+//除了<unk>、<s>、</s>和256个字节token以外的词表，分数里有故意相同的，用来检查平局时先合并靠左的一对
+const std::vector<std::pair<std::string, float>> kPieces = {
+    {" ", -1.f},    {"a", -2.f},    {"b", -2.f},     {"c", -3.f},    {"\xC3\xA9", -3.f},
+    {"ab", -4.f},   {"ba", -4.f},   {"aa", -5.f},    {"bc", -3.5f},  {"ca", -6.f},
+    {" a", -4.5f},  {" b", -7.f},   {"abc", -8.f},   {"aab", -5.f},  {"aba", -9.f},
+    {" ab", -6.f},  {"cab", -6.f},  {"bca", -10.f},  {"abab", -4.f}, {" c", -8.f},
+    {"cc", -5.f},   {"aa ", -2.f},  {"\xC3\xA9" "a", -4.f},          {"a\xC3\xA9", -5.f},
+    {"bb", -3.f},   {"bbb", -2.5f}, {"  ", -9.f}};
+
+class BpeEncodeTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = testing::TempDir() + "kuiper_test_tokenizer.bin";
+    vocab_ = {"<unk>", "<s>", "</s>"};
+    scores_ = {0.f, 0.f, 0.f};
+    for (int32_t byte = 0; byte < 256; ++byte) {
+      char piece[8];
+      std::snprintf(piece, sizeof(piece), "<0x%02X>", byte);
+      vocab_.emplace_back(piece);
+      scores_.push_back(0.f);
+    }
+    for (const auto& [piece, score] : kPieces) {
+      vocab_.push_back(piece);
+      scores_.push_back(score);
+    }
+    //llama2.c导出的格式：int32 max_token_length，之后每个token是float score、int32 len、len个字节
+    std::ofstream file(path_, std::ios::binary);
+    const int32_t max_token_length = 8;
+    file.write(reinterpret_cast<const char*>(&max_token_length), sizeof(int32_t));
+    for (size_t i = 0; i < vocab_.size(); ++i) {
+      const int32_t len = static_cast<int32_t>(vocab_[i].size());
+      file.write(reinterpret_cast<const char*>(&scores_[i]), sizeof(float));
+      file.write(reinterpret_cast<const char*>(&len), sizeof(int32_t));
+      file.write(vocab_[i].data(), len);
+    }
+  }
+
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  int32_t id(const std::string& piece) const {
+    for (size_t i = 3 + 256; i < vocab_.size(); ++i) {
+      if (vocab_[i] == piece) {
+        return static_cast<int32_t>(i);
+      }
+    }
+    return -1;
+  }
+
+  //llama2.c里的朴素BPE：每一轮扫一遍所有相邻的一对，合并分数最高的（相同时取最左边的），
+  //直到没有能合并的。不在词表里的字符退回成字节token，不参与合并
+  std::vector<int32_t> encode_ref(const std::string& sentence) const {
+    const std::string text = " " + sentence;
+    std::vector<std::string> pieces;
+    std::vector<int32_t> tokens;
+    for (size_t offset = 0; offset < text.size();) {
+      const uint8_t c = static_cast<uint8_t>(text[offset]);
+      const size_t len = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : 4;
+      const std::string ch = text.substr(offset, len);
+      if (id(ch) != -1) {
+        pieces.push_back(ch);
+        tokens.push_back(id(ch));
+      } else {
+        for (const char byte : ch) {
+          pieces.emplace_back();
+          tokens.push_back(3 + static_cast<uint8_t>(byte));
+        }
+      }
+      offset += len;
+    }
+    while (true) {
+      float best_score = -1e10f;
+      int32_t best = -1;
+      for (size_t i = 0; i + 1 < tokens.size(); ++i) {
+        if (pieces[i].empty() || pieces[i + 1].empty()) {
+          continue;
+        }
+        const int32_t merged = id(pieces[i] + pieces[i + 1]);
+        if (merged != -1 && scores_[merged] > best_score) {
+          best_score = scores_[merged];
+          best = static_cast<int32_t>(i);
+        }
+      }
+      if (best == -1) {
+        break;
+      }
+      pieces[best] += pieces[best + 1];
+      tokens[best] = id(pieces[best]);
+      pieces.erase(pieces.begin() + best + 1);
+      tokens.erase(tokens.begin() + best + 1);
+    }
+    tokens.insert(tokens.begin(), 1);
+    return tokens;
+  }
+
+  std::string path_;
+  std::vector<std::string> vocab_;
+  std::vector<float> scores_;
+};
+}  // namespace
+
+TEST_F(BpeEncodeTest, merge_order) {
+  op::BpeEncodeLayer encoder(path_, true, false);
+  ASSERT_TRUE(encoder.init());
+  ASSERT_EQ(encoder.vocab_size(), static_cast<int32_t>(vocab_.size()));
+  //" aab"：ab(-4)比" a"(-4.5)和aa(-5)先合并，之后只剩" a"能合并
+  const std::vector<int32_t> aab = {1, id(" a"), id("ab")};
+  ASSERT_EQ(encoder.encode("aab"), aab);
+  //" bbbb"：三个bb平局，先合并最左边的，再合成bbb；先合并右边的话会得到b、bbb
+  const std::vector<int32_t> bbbb = {1, id(" "), id("bbb"), id("b")};
+  ASSERT_EQ(encoder.encode("bbbb"), bbbb);
+  //"abab"：ab的两次合并之后还能再合成一个abab
+  const std::vector<int32_t> abab = {1, id(" "), id("abab")};
+  ASSERT_EQ(encoder.encode("abab"), abab);
+}
+
+TEST_F(BpeEncodeTest, matches_naive_bpe) {
+  op::BpeEncodeLayer encoder(path_, true, false);
+  ASSERT_TRUE(encoder.init());
+  //随机拼出来的文本，带一个在词表里的两字节字符和一个不在词表里、要退回成字节的汉字
+  const std::vector<std::string> alphabet = {"a", "b", "c", " ", "\xC3\xA9", "\xE4\xB8\xAD"};
+  std::mt19937 rng(1);
+  for (int32_t round = 0; round < 2000; ++round) {
+    std::string text;
+    const int32_t len = 1 + static_cast<int32_t>(rng() % 24);
+    for (int32_t i = 0; i < len; ++i) {
+      text += alphabet[rng() % alphabet.size()];
+    }
+    const std::vector<int32_t> tokens = encoder.encode(text);
+    ASSERT_EQ(tokens, encode_ref(text)) << "text \"" << text << "\"";
+    ASSERT_EQ(encoder.decode(tokens), text);
+  }
+}
+
+TEST_F(BpeEncodeTest, decode_stream_holds_partial_utf8) {
+  op::BpeEncodeLayer encoder(path_, true, false);
+  ASSERT_TRUE(encoder.init());
+  const std::string text = "ab\xE4\xB8\xAD" "c";
+  const std::vector<int32_t> tokens = encoder.encode(text);
+  op::BpeDecodeStream stream(&encoder);
+  std::string decoded;
+  for (int32_t token : tokens) {
+    const std::string piece = stream.next(token);
+    //汉字的三个字节token没收全之前不吐出来
+    ASSERT_TRUE(piece.find('\xE4') == std::string::npos || piece.find('\xAD') != std::string::npos);
+    decoded += piece;
+  }
+  decoded += stream.flush();
+  ASSERT_EQ(decoded, text);
+}
@@ -0,0 +1,212 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "../utils.h"
+#include "op/kernels/cpu/matmul_kernel.h"
+
+namespace {
+//output[r][i] = sum_j w(i, j) * input[r][j]，w按行主序给出反量化之后的值，用double累加
+template <typename WeightFunc>
+std::vector<double> matmul_ref(const tensor::Tensor& input, int32_t m, int32_t n, int32_t k,
+                               WeightFunc weight) {
+  std::vector<double> output(static_cast<size_t>(m) * n, 0.0);
+  for (int32_t i = 0; i < n; ++i) {
+    for (int32_t j = 0; j < k; ++j) {
+      const double w = weight(i, j);
+      for (int32_t r = 0; r < m; ++r) {
+        output[static_cast<size_t>(r) * n + i] += w * input.index<float>(r * k + j);
+      }
+    }
+  }
+  return output;
+}
+
+void expect_near(const tensor::Tensor& output, const std::vector<double>& ref, double tol) {
+  ASSERT_EQ(output.size(), ref.size());
+  for (size_t i = 0; i < ref.size(); ++i) {
+    ASSERT_NEAR(output.index<float>(i), ref[i], tol * (1.0 + std::abs(ref[i]))) << "index " << i;
+  }
+}
+
+tensor::Tensor make_input(int32_t m, int32_t k, uint32_t seed) {
+  auto alloc = test::cpu_alloc();
+  tensor::Tensor input = m == 1 ? tensor::Tensor(base::DataType::kDataTypeFp32, k, true, alloc)
+                                : tensor::Tensor(base::DataType::kDataTypeFp32, m, k, true, alloc);
+  test::fill_normal(input, seed);
+  return input;
+}
+
+tensor::Tensor make_output(int32_t m, int32_t n) {
+  return tensor::Tensor(base::DataType::kDataTypeFp32, m, n, true, test::cpu_alloc());
+}
+
+//和Linear::prepack_weight一样把weight打包成kLayoutPanel16
+tensor::Tensor pack(const tensor::Tensor& weight, const tensor::Tensor& scale, int32_t group_size) {
+  const int32_t n = weight.get_dim(0);
+  const int32_t k = weight.get_dim(1);
+  const size_t byte_size = kernel::packed_weight_byte_size(weight.data_type(), n, k, group_size);
+  EXPECT_GT(byte_size, 0);
+  auto buffer = std::make_shared<base::Buffer>(byte_size, test::cpu_alloc());
+  kernel::pack_weight_cpu(weight, scale, group_size, buffer->ptr());
+  tensor::Tensor packed;
+  packed.reset(weight.data_type(), {n, k});
+  packed.assign(buffer);
+  packed.set_layout(base::TensorLayout::kLayoutPanel16);
+  return packed;
+}
+
+//M == 1走GEMV，3走多行GEMV，40超过所有GEMM的阈值；N不是16的倍数，K不是分块的倍数
+const int32_t kRows[] = {1, 3, 40};
+const int32_t kN = 75;
+const int32_t kK = 320;
+}  // namespace
+
+TEST(test_matmul_cpu, fp32) {
+  auto alloc = test::cpu_alloc();
+  tensor::Tensor weight(base::DataType::kDataTypeFp32, kN, kK, true, alloc);
+  test::fill_normal(weight, 1);
+  const tensor::Tensor packed = pack(weight, tensor::Tensor(), 0);
+  for (int32_t m : kRows) {
+    const tensor::Tensor input = make_input(m, kK, 100 + m);
+    const auto ref = matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+      return weight.index<float>(i * kK + j);
+    });
+    tensor::Tensor output = make_output(m, kN);
+    kernel::matmul_kernel_cpu(input, weight, output);
+    expect_near(output, ref, 1e-4);
+
+    tensor::Tensor packed_output = make_output(m, kN);
+    kernel::matmul_kernel_cpu(input, packed, packed_output);
+    expect_near(packed_output, ref, 1e-4);
+  }
+}
+
+TEST(test_matmul_cpu, fp16_and_bf16) {
+  auto alloc = test::cpu_alloc();
+  tensor::Tensor fp32(base::DataType::kDataTypeFp32, kN, kK, true, alloc);
+  test::fill_normal(fp32, 2);
+  tensor::Tensor fp16(base::DataType::kDataTypeFp16, kN, kK, true, alloc);
+  tensor::Tensor bf16(base::DataType::kDataTypeBf16, kN, kK, true, alloc);
+  for (size_t i = 0; i < fp32.size(); ++i) {
+    fp16.index<uint16_t>(i) = test::fp32_to_fp16_ref(fp32.index<float>(i));
+    bf16.index<uint16_t>(i) = test::fp32_to_bf16_ref(fp32.index<float>(i));
+  }
+  for (int32_t m : kRows) {
+    const tensor::Tensor input = make_input(m, kK, 200 + m);
+    tensor::Tensor output = make_output(m, kN);
+    kernel::matmul_kernel_cpu(input, fp16, output);
+    expect_near(output, matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+                  return test::fp16_to_fp32_ref(fp16.index<uint16_t>(i * kK + j));
+                }),
+                1e-4);
+
+    kernel::matmul_kernel_cpu(input, bf16, output);
+    expect_near(output, matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+                  return test::bf16_to_fp32_ref(bf16.index<uint16_t>(i * kK + j));
+                }),
+                1e-4);
+  }
+}
+
+TEST(test_matmul_cpu, int8_group_quant) {
+  auto alloc = test::cpu_alloc();
+  const int32_t group_size = 64;
+  tensor::Tensor weight(base::DataType::kDataTypeInt8, kN, kK, true, alloc);
+  tensor::Tensor scale(base::DataType::kDataTypeFp32, kN * kK / group_size, true, alloc);
+  std::mt19937 rng(3);
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight.index<int8_t>(i) = static_cast<int8_t>(static_cast<int32_t>(rng() % 255) - 127);
+  }
+  for (size_t i = 0; i < scale.size(); ++i) {
+    scale.index<float>(i) = 0.001f + 0.01f * static_cast<float>(rng() % 100) / 100.f;
+  }
+  const tensor::Tensor packed = pack(weight, scale, group_size);
+  for (int32_t m : kRows) {
+    const tensor::Tensor input = make_input(m, kK, 300 + m);
+    const auto ref = matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+      const int64_t idx = static_cast<int64_t>(i) * kK + j;
+      return weight.index<int8_t>(idx) * static_cast<double>(scale.index<float>(idx / group_size));
+    });
+    tensor::Tensor output = make_output(m, kN);
+    kernel::matmul_kernel_cpu_qint8(input, weight, output, group_size, scale);
+    expect_near(output, ref, 1e-4);
+
+    tensor::Tensor packed_output = make_output(m, kN);
+    kernel::matmul_kernel_cpu_qint8(input, packed, packed_output, group_size, scale);
+    expect_near(packed_output, ref, 1e-4);
+  }
+}
+
+TEST(test_matmul_cpu, int4_group_quant) {
+  auto alloc = test::cpu_alloc();
+  const int32_t group_size = 64;
+  const int32_t group_num = kN * kK / group_size;
+  tensor::Tensor weight(base::DataType::kDataTypeInt4, kN, kK, true, alloc);
+  tensor::Tensor scale(base::DataType::kDataTypeFp16, group_num, true, alloc);
+  tensor::Tensor min(base::DataType::kDataTypeFp16, group_num, true, alloc);
+  std::mt19937 rng(4);
+  std::vector<uint8_t> q(weight.size());
+  for (auto& v : q) {
+    v = static_cast<uint8_t>(rng() % 16);
+  }
+  //每32个一块，第j个字节的低4位是块里的第j个，高4位是第j + 16个
+  uint8_t* packed_q = weight.ptr<uint8_t>();
+  for (size_t block = 0; block < q.size() / 32; ++block) {
+    for (int32_t j = 0; j < 16; ++j) {
+      packed_q[block * 16 + j] =
+          static_cast<uint8_t>(q[block * 32 + j] | (q[block * 32 + j + 16] << 4));
+    }
+  }
+  for (int32_t g = 0; g < group_num; ++g) {
+    scale.index<uint16_t>(g) = test::fp32_to_fp16_ref(0.002f + 0.001f * (rng() % 20));
+    min.index<uint16_t>(g) = test::fp32_to_fp16_ref(-0.01f * (rng() % 10));
+  }
+
+  for (int32_t m : kRows) {
+    const tensor::Tensor input = make_input(m, kK, 400 + m);
+    auto dequant = [&](int32_t i, int32_t j, bool with_min) {
+      const int64_t idx = static_cast<int64_t>(i) * kK + j;
+      const double s = test::fp16_to_fp32_ref(scale.index<uint16_t>(idx / group_size));
+      if (with_min) {
+        return q[idx] * s + test::fp16_to_fp32_ref(min.index<uint16_t>(idx / group_size));
+      }
+      return (static_cast<int32_t>(q[idx]) - 8) * s;
+    };
+    tensor::Tensor output = make_output(m, kN);
+    kernel::matmul_kernel_cpu_q4(input, weight, output, group_size, scale, tensor::Tensor());
+    expect_near(output, matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+                  return dequant(i, j, false);
+                }),
+                1e-4);
+
+    kernel::matmul_kernel_cpu_q4(input, weight, output, group_size, scale, min);
+    expect_near(output, matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+                  return dequant(i, j, true);
+                }),
+                1e-4);
+  }
+}
+
+TEST(test_matmul_cpu, swiglu_gemm) {
+  auto alloc = test::cpu_alloc();
+  const int32_t m = 40;
+  tensor::Tensor w1(base::DataType::kDataTypeFp32, kN, kK, true, alloc);
+  tensor::Tensor w3(base::DataType::kDataTypeFp32, kN, kK, true, alloc);
+  test::fill_normal(w1, 5, 0.1f);
+  test::fill_normal(w3, 6, 0.1f);
+  const tensor::Tensor input = make_input(m, kK, 500);
+  const auto gate = matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+    return w1.index<float>(i * kK + j);
+  });
+  const auto up = matmul_ref(input, m, kN, kK, [&](int32_t i, int32_t j) {
+    return w3.index<float>(i * kK + j);
+  });
+  std::vector<double> ref(gate.size());
+  for (size_t i = 0; i < ref.size(); ++i) {
+    ref[i] = gate[i] / (1.0 + std::exp(-gate[i])) * up[i];
+  }
+  tensor::Tensor output = make_output(m, kN);
+  kernel::swiglu_gemm_kernel_cpu(input, w1, w3, output);
+  expect_near(output, ref, 1e-4);
+}
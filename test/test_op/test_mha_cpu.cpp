@@ -0,0 +1,183 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <vector>
+#include "../utils.h"
+#include "op/kernels/cpu/mha_kernel.h"
+#include "op/mha.h"
+#include "op/paged_kv_cache.h"
+
+namespace {
+const int32_t kLayerNum = 2;
+const int32_t kLayer = 1;
+const int32_t kHeadNum = 4;
+const int32_t kKVHeadNum = 2;
+const int32_t kHeadSize = 32;
+const int32_t kKVDim = kKVHeadNum * kHeadSize;
+const int32_t kBlockSize = 16;
+
+//cache里某个位置的key或value，按format反量化回来
+std::vector<float> read_row(op::PagedKVCache& cache, int32_t seq_id, int32_t pos, bool is_key) {
+  std::vector<float> row(kKVDim);
+  const void* data = is_key ? cache.key_data(seq_id, kLayer, pos)
+                            : cache.value_data(seq_id, kLayer, pos);
+  for (int32_t i = 0; i < kKVDim; ++i) {
+    if (cache.format() == op::KVCacheFormat::kFp32) {
+      row[i] = static_cast<const float*>(data)[i];
+    } else if (cache.format() == op::KVCacheFormat::kFp16) {
+      row[i] = test::fp16_to_fp32_ref(static_cast<const uint16_t*>(data)[i]);
+    } else {
+      const float* scales = is_key ? cache.key_scales(seq_id, kLayer, pos)
+                                   : cache.value_scales(seq_id, kLayer, pos);
+      row[i] = static_cast<const int8_t*>(data)[i] * scales[i / kHeadSize];
+    }
+  }
+  return row;
+}
+
+//两遍softmax的朴素实现：query第r行在位置pos + r，看0..pos + r
+std::vector<double> attention_ref(op::PagedKVCache& cache, int32_t seq_id, int32_t pos,
+                                  int32_t rows, const tensor::Tensor& query) {
+  const int32_t dim = kHeadNum * kHeadSize;
+  const int32_t kv_mul = kHeadNum / kKVHeadNum;
+  std::vector<double> output(static_cast<size_t>(rows) * dim, 0.0);
+  for (int32_t r = 0; r < rows; ++r) {
+    const int32_t len = pos + r + 1;
+    for (int32_t h = 0; h < kHeadNum; ++h) {
+      const int32_t kv_offset = (h / kv_mul) * kHeadSize;
+      std::vector<double> score(len);
+      double max_score = -INFINITY;
+      for (int32_t t = 0; t < len; ++t) {
+        const std::vector<float> key = read_row(cache, seq_id, t, true);
+        double dot = 0.0;
+        for (int32_t i = 0; i < kHeadSize; ++i) {
+          dot += query.index<float>(r * dim + h * kHeadSize + i) * key[kv_offset + i];
+        }
+        score[t] = dot / std::sqrt(static_cast<double>(kHeadSize));
+        max_score = std::max(max_score, score[t]);
+      }
+      double sum = 0.0;
+      for (int32_t t = 0; t < len; ++t) {
+        score[t] = std::exp(score[t] - max_score);
+        sum += score[t];
+      }
+      for (int32_t t = 0; t < len; ++t) {
+        const std::vector<float> value = read_row(cache, seq_id, t, false);
+        for (int32_t i = 0; i < kHeadSize; ++i) {
+          output[static_cast<size_t>(r) * dim + h * kHeadSize + i] +=
+              score[t] / sum * value[kv_offset + i];
+        }
+      }
+    }
+  }
+  return output;
+}
+
+void check_attention(op::KVCacheFormat format) {
+  auto cache = std::make_shared<op::PagedKVCache>(kLayerNum, kKVDim, kBlockSize, 32, format,
+                                                  kHeadSize);
+  ASSERT_TRUE(cache->init(test::cpu_alloc()));
+  //两个序列交替拿block，block_table不是连续的
+  const int32_t seq_len = 150;
+  ASSERT_TRUE(cache->add_sequence(0));
+  ASSERT_TRUE(cache->add_sequence(1));
+  for (int32_t pos = 0; pos < seq_len; pos += kBlockSize) {
+    ASSERT_TRUE(cache->reserve(1, pos));
+    ASSERT_TRUE(cache->reserve(0, pos));
+  }
+  ASSERT_TRUE(cache->reserve(0, seq_len - 1));
+
+  std::mt19937 rng(static_cast<uint32_t>(format) + 1);
+  std::normal_distribution<float> dist(0.f, 1.f);
+  std::vector<float> row(kKVDim);
+  for (int32_t pos = 0; pos < seq_len; ++pos) {
+    for (int32_t is_key = 0; is_key < 2; ++is_key) {
+      for (float& x : row) {
+        x = dist(rng);
+      }
+      void* dst = is_key ? cache->key_data(0, kLayer, pos) : cache->value_data(0, kLayer, pos);
+      float* scales = nullptr;
+      if (format == op::KVCacheFormat::kInt8) {
+        scales = is_key ? cache->key_scales(0, kLayer, pos) : cache->value_scales(0, kLayer, pos);
+      }
+      kernel::kv_store_row_cpu(format, row.data(), dst, scales, kKVDim, kHeadSize);
+    }
+  }
+
+  const int32_t dim = kHeadNum * kHeadSize;
+  //decode跨过多个kMHATileSize，prefill的行数不是kMHAQueryTile的倍数
+  const std::vector<std::pair<int32_t, int32_t>> cases = {{0, 1}, {63, 1}, {149, 1}, {20, 11},
+                                                          {100, 50}};
+  for (const auto& [pos, rows] : cases) {
+    tensor::Tensor query(base::DataType::kDataTypeFp32, rows, dim, true, test::cpu_alloc());
+    tensor::Tensor output(base::DataType::kDataTypeFp32, rows, dim, true, test::cpu_alloc());
+    test::fill_normal(query, pos * 7 + rows);
+    kernel::mha_kernel_cpu(pos, kHeadNum, kHeadNum / kKVHeadNum, kHeadSize, output, query,
+                           cache->view(0, kLayer));
+    const std::vector<double> ref = attention_ref(*cache, 0, pos, rows, query);
+    for (size_t i = 0; i < ref.size(); ++i) {
+      ASSERT_NEAR(output.index<float>(i), ref[i], 1e-4) << "pos " << pos << " rows " << rows;
+    }
+  }
+}
+}  // namespace
+
+TEST(test_mha_cpu, online_softmax_fp32_cache) { check_attention(op::KVCacheFormat::kFp32); }
+
+TEST(test_mha_cpu, online_softmax_fp16_cache) { check_attention(op::KVCacheFormat::kFp16); }
+
+TEST(test_mha_cpu, online_softmax_int8_cache) { check_attention(op::KVCacheFormat::kInt8); }
+
+TEST(test_mha_cpu, kv_store_row_int8) {
+  std::vector<float> row(kKVDim);
+  std::mt19937 rng(9);
+  std::normal_distribution<float> dist(0.f, 3.f);
+  for (float& x : row) {
+    x = dist(rng);
+  }
+  std::vector<int8_t> quant(kKVDim);
+  std::vector<float> scales(kKVHeadNum);
+  kernel::kv_store_row_cpu(op::KVCacheFormat::kInt8, row.data(), quant.data(), scales.data(),
+                           kKVDim, kHeadSize);
+  for (int32_t h = 0; h < kKVHeadNum; ++h) {
+    float absmax = 0.f;
+    for (int32_t i = 0; i < kHeadSize; ++i) {
+      absmax = std::max(absmax, std::abs(row[h * kHeadSize + i]));
+    }
+    ASSERT_FLOAT_EQ(scales[h], absmax / 127.f);
+    for (int32_t i = 0; i < kHeadSize; ++i) {
+      //对称量化的误差不超过半个scale
+      ASSERT_LE(std::abs(quant[h * kHeadSize + i] * scales[h] - row[h * kHeadSize + i]),
+                0.5f * scales[h] + 1e-6f);
+    }
+  }
+}
+
+TEST(test_mha_cpu, layer_rejects_invalid_layer_index) {
+  auto cache = std::make_shared<op::PagedKVCache>(kLayerNum, kKVDim, kBlockSize, 4);
+  ASSERT_TRUE(cache->init(test::cpu_alloc()));
+  ASSERT_TRUE(cache->add_sequence(0));
+  ASSERT_TRUE(cache->reserve(0, 0));
+  auto alloc = test::cpu_alloc();
+  tensor::Tensor query(base::DataType::kDataTypeFp32, kHeadNum * kHeadSize, true, alloc);
+  tensor::Tensor key(base::DataType::kDataTypeFp32, kKVDim, true, alloc);
+  tensor::Tensor value(base::DataType::kDataTypeFp32, kKVDim, true, alloc);
+  tensor::Tensor output(base::DataType::kDataTypeFp32, kHeadNum * kHeadSize, true, alloc);
+
+  op::MultiHeadAttention mha(base::DeviceType::kDeviceCPU, 0, kHeadNum / kKVHeadNum, kKVDim, 64,
+                             kHeadNum, kHeadSize);
+  ASSERT_TRUE(mha.init());
+  mha.set_input(0, query);
+  mha.set_input(1, key);
+  mha.set_input(2, value);
+  mha.set_output(0, output);
+  mha.set_paged_kv_cache(cache, 0);
+  mha.set_pos(0);
+  for (int32_t layer = 0; layer < kLayerNum; ++layer) {
+    mha.set_layer_idx(layer);
+    ASSERT_TRUE(mha.check()) << "layer " << layer;
+  }
+  for (int32_t layer : {-1, kLayerNum}) {
+    mha.set_layer_idx(layer);
+    ASSERT_FALSE(mha.check()) << "layer " << layer;
+  }
+}
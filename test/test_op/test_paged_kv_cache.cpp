@@ -0,0 +1,242 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+#include "../utils.h"
+#include "op/paged_kv_cache.h"
+
+namespace {
+const int32_t kLayerNum = 2;
+const int32_t kKVDim = 8;
+const int32_t kBlockSize = 4;
+const int32_t kNumBlocks = 10;
+
+std::shared_ptr<op::PagedKVCache> make_cache() {
+  auto cache = std::make_shared<op::PagedKVCache>(kLayerNum, kKVDim, kBlockSize, kNumBlocks);
+  CHECK(cache->init(test::cpu_alloc()));
+  return cache;
+}
+
+//某个序列、某一层、某个位置上写进去的值，用来检查不同位置的行互不覆盖
+float tag(int32_t seq_id, int32_t layer, int32_t pos, int32_t i) {
+  return static_cast<float>(seq_id * 100000 + layer * 10000 + pos * 10 + i % 10);
+}
+
+void write_rows(op::PagedKVCache& cache, int32_t seq_id, int32_t begin, int32_t end) {
+  for (int32_t layer = 0; layer < kLayerNum; ++layer) {
+    for (int32_t pos = begin; pos < end; ++pos) {
+      for (int32_t i = 0; i < kKVDim; ++i) {
+        cache.key(seq_id, layer, pos)[i] = tag(seq_id, layer, pos, i);
+        cache.value(seq_id, layer, pos)[i] = -tag(seq_id, layer, pos, i);
+      }
+    }
+  }
+}
+
+void check_rows(op::PagedKVCache& cache, int32_t seq_id, int32_t begin, int32_t end,
+                int32_t written_by) {
+  for (int32_t layer = 0; layer < kLayerNum; ++layer) {
+    for (int32_t pos = begin; pos < end; ++pos) {
+      for (int32_t i = 0; i < kKVDim; ++i) {
+        ASSERT_EQ(cache.key(seq_id, layer, pos)[i], tag(written_by, layer, pos, i));
+        ASSERT_EQ(cache.value(seq_id, layer, pos)[i], -tag(written_by, layer, pos, i));
+      }
+    }
+  }
+}
+}  // namespace
+
+TEST(test_paged_kv_cache, reserve_and_free_round_trip) {
+  auto cache = make_cache();
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks);
+  ASSERT_TRUE(cache->add_sequence(0));
+  ASSERT_TRUE(cache->add_sequence(1));
+  ASSERT_FALSE(cache->add_sequence(0));
+  ASSERT_TRUE(cache->has_sequence(1));
+  ASSERT_FALSE(cache->has_sequence(2));
+
+  //pos是最后一个要写的位置，block边界两边各试一次
+  ASSERT_TRUE(cache->reserve(0, kBlockSize - 1));
+  ASSERT_EQ(cache->block_table(0).size(), 1);
+  ASSERT_TRUE(cache->reserve(0, kBlockSize));
+  ASSERT_EQ(cache->block_table(0).size(), 2);
+  ASSERT_TRUE(cache->reserve(1, 10));
+  ASSERT_EQ(cache->block_table(1).size(), 3);
+  ASSERT_TRUE(cache->reserve(0, 11));
+  ASSERT_EQ(cache->block_table(0).size(), 3);
+  //已经够了的时候不再拿新的
+  ASSERT_TRUE(cache->reserve(0, 3));
+  ASSERT_EQ(cache->block_table(0).size(), 3);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks - 6);
+
+  std::set<int32_t> used;
+  for (int32_t seq_id : {0, 1}) {
+    for (int32_t block : cache->block_table(seq_id)) {
+      ASSERT_TRUE(used.insert(block).second) << "block " << block << " is handed out twice";
+      ASSERT_EQ(cache->ref_count(block), 1);
+    }
+  }
+
+  write_rows(*cache, 0, 0, 12);
+  write_rows(*cache, 1, 0, 11);
+  check_rows(*cache, 0, 0, 12, 0);
+  check_rows(*cache, 1, 0, 11, 1);
+
+  cache->free_sequence(0);
+  ASSERT_FALSE(cache->has_sequence(0));
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks - 3);
+  check_rows(*cache, 1, 0, 11, 1);
+  //重复free和free不存在的序列都什么也不做
+  cache->free_sequence(0);
+  cache->free_sequence(5);
+  cache->free_sequence(1);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks);
+  for (int32_t block = 0; block < kNumBlocks; ++block) {
+    ASSERT_EQ(cache->ref_count(block), 0);
+  }
+}
+
+TEST(test_paged_kv_cache, reserve_fails_without_taking_blocks) {
+  auto cache = make_cache();
+  ASSERT_TRUE(cache->add_sequence(0));
+  ASSERT_TRUE(cache->add_sequence(1));
+  ASSERT_TRUE(cache->reserve(0, 7 * kBlockSize - 1));
+  ASSERT_EQ(cache->free_block_num(), 3);
+  //要4个只剩3个，失败时不能拿走一部分
+  ASSERT_FALSE(cache->reserve(1, 4 * kBlockSize - 1));
+  ASSERT_EQ(cache->free_block_num(), 3);
+  ASSERT_TRUE(cache->block_table(1).empty());
+  ASSERT_TRUE(cache->reserve(1, 3 * kBlockSize - 1));
+  ASSERT_EQ(cache->free_block_num(), 0);
+  ASSERT_FALSE(cache->reserve(0, 7 * kBlockSize));
+
+  ASSERT_FALSE(cache->reserve(2, 0));
+  ASSERT_FALSE(cache->reserve(0, -1));
+  cache->free_sequence(0);
+  cache->free_sequence(1);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks);
+}
+
+TEST(test_paged_kv_cache, truncate_keeps_the_prefix) {
+  auto cache = make_cache();
+  ASSERT_TRUE(cache->add_sequence(0));
+  ASSERT_TRUE(cache->reserve(0, 13));
+  ASSERT_EQ(cache->block_table(0).size(), 4);
+  write_rows(*cache, 0, 0, 14);
+  const std::vector<int32_t> table = cache->block_table(0);
+
+  //9个位置要3个block，第4个还回去
+  ASSERT_TRUE(cache->truncate(0, 9));
+  ASSERT_EQ(cache->block_table(0),
+            std::vector<int32_t>(table.begin(), table.begin() + 3));
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks - 3);
+  ASSERT_EQ(cache->ref_count(table[3]), 0);
+  check_rows(*cache, 0, 0, 9, 0);
+  //正好在block边界上时不多留
+  ASSERT_TRUE(cache->truncate(0, 8));
+  ASSERT_EQ(cache->block_table(0).size(), 2);
+  //比现在长的truncate什么也不做
+  ASSERT_TRUE(cache->truncate(0, 100));
+  ASSERT_EQ(cache->block_table(0).size(), 2);
+
+  ASSERT_TRUE(cache->reserve(0, 13));
+  write_rows(*cache, 0, 8, 14);
+  check_rows(*cache, 0, 0, 14, 0);
+
+  ASSERT_TRUE(cache->truncate(0, 0));
+  ASSERT_TRUE(cache->block_table(0).empty());
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks);
+  ASSERT_FALSE(cache->truncate(0, -1));
+  ASSERT_FALSE(cache->truncate(1, 0));
+  cache->free_sequence(0);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks);
+}
+
+TEST(test_paged_kv_cache, shared_blocks_are_ref_counted) {
+  auto cache = make_cache();
+  ASSERT_TRUE(cache->add_sequence(0));
+  ASSERT_TRUE(cache->reserve(0, 2 * kBlockSize + 1));
+  write_rows(*cache, 0, 0, 2 * kBlockSize + 2);
+  const std::vector<int32_t> table = cache->block_table(0);
+
+  //序列1共享序列0写满的前两个block，接着往自己的新block里写
+  const std::vector<int32_t> shared(table.begin(), table.begin() + 2);
+  ASSERT_TRUE(cache->add_sequence(1, shared));
+  ASSERT_EQ(cache->ref_count(shared[0]), 2);
+  ASSERT_EQ(cache->ref_count(shared[1]), 2);
+  ASSERT_EQ(cache->ref_count(table[2]), 1);
+  ASSERT_TRUE(cache->reserve(1, 3 * kBlockSize - 1));
+  ASSERT_EQ(cache->block_table(1).size(), 3);
+  ASSERT_NE(cache->block_table(1)[2], table[2]);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks - 4);
+  check_rows(*cache, 1, 0, 2 * kBlockSize, 0);
+  write_rows(*cache, 1, 2 * kBlockSize, 3 * kBlockSize);
+  check_rows(*cache, 0, 2 * kBlockSize, 2 * kBlockSize + 2, 0);
+
+  //没在用的block不能共享
+  ASSERT_FALSE(cache->add_sequence(2, {kNumBlocks - 1}));
+  ASSERT_FALSE(cache->add_sequence(2, {kNumBlocks}));
+  ASSERT_FALSE(cache->has_sequence(2));
+
+  //先结束的序列只放掉自己的引用，共享的block要等另一个也结束
+  cache->free_sequence(0);
+  ASSERT_EQ(cache->ref_count(shared[0]), 1);
+  ASSERT_EQ(cache->ref_count(table[2]), 0);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks - 3);
+  check_rows(*cache, 1, 0, 2 * kBlockSize, 0);
+
+  //外部持有的引用，比如PrefixCache
+  cache->retain_block(shared[1]);
+  cache->free_sequence(1);
+  ASSERT_EQ(cache->ref_count(shared[0]), 0);
+  ASSERT_EQ(cache->ref_count(shared[1]), 1);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks - 1);
+  cache->release_block(shared[1]);
+  ASSERT_EQ(cache->free_block_num(), kNumBlocks);
+}
+
+TEST(test_paged_kv_cache, quantized_pools_do_not_overlap) {
+  //int8时key、value和两个scale池挨着放，写满所有block之后逐个读回来
+  const int32_t head_size = 4;
+  op::PagedKVCache cache(kLayerNum, kKVDim, kBlockSize, kNumBlocks, op::KVCacheFormat::kInt8,
+                         head_size);
+  ASSERT_TRUE(cache.init(test::cpu_alloc()));
+  ASSERT_TRUE(cache.add_sequence(0));
+  const int32_t len = kNumBlocks * kBlockSize;
+  ASSERT_TRUE(cache.reserve(0, len - 1));
+  ASSERT_EQ(cache.free_block_num(), 0);
+  const int32_t scale_num = kKVDim / head_size;
+  auto fill = [&](bool check) {
+    for (int32_t layer = 0; layer < kLayerNum; ++layer) {
+      for (int32_t pos = 0; pos < len; ++pos) {
+        auto* key = static_cast<int8_t*>(cache.key_data(0, layer, pos));
+        auto* value = static_cast<int8_t*>(cache.value_data(0, layer, pos));
+        float* key_scales = cache.key_scales(0, layer, pos);
+        float* value_scales = cache.value_scales(0, layer, pos);
+        const int32_t seed = layer * len + pos;
+        for (int32_t i = 0; i < kKVDim; ++i) {
+          const auto k = static_cast<int8_t>((seed + i) % 127);
+          const auto v = static_cast<int8_t>(-((seed * 3 + i) % 127));
+          if (check) {
+            ASSERT_EQ(key[i], k);
+            ASSERT_EQ(value[i], v);
+          } else {
+            key[i] = k;
+            value[i] = v;
+          }
+        }
+        for (int32_t h = 0; h < scale_num; ++h) {
+          if (check) {
+            ASSERT_EQ(key_scales[h], seed + h * 0.25f);
+            ASSERT_EQ(value_scales[h], -seed - h * 0.25f);
+          } else {
+            key_scales[h] = seed + h * 0.25f;
+            value_scales[h] = -seed - h * 0.25f;
+          }
+        }
+      }
+    }
+  };
+  fill(false);
+  fill(true);
+}
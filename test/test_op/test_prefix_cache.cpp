@@ -0,0 +1,248 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <vector>
+#include "../utils.h"
+#include "op/prefix_cache.h"
+
+namespace {
+const int32_t kLayerNum = 1;
+const int32_t kKVDim = 2;
+const int32_t kBlockSize = 4;
+
+class PrefixCacheTest : public testing::Test {
+ protected:
+  void init(int32_t num_blocks, int32_t max_cached_blocks) {
+    kv_cache_ = std::make_shared<op::PagedKVCache>(kLayerNum, kKVDim, kBlockSize, num_blocks);
+    ASSERT_TRUE(kv_cache_->init(test::cpu_alloc()));
+    block_byte_size_ = kv_cache_->byte_size() / num_blocks;
+    prefix_cache_ = std::make_unique<op::PrefixCache>(kv_cache_,
+                                                      max_cached_blocks * block_byte_size_);
+    ASSERT_EQ(prefix_cache_->max_block_num(), max_cached_blocks);
+  }
+
+  //和调度器一样：先查前缀，共享命中的block，剩下的位置自己写，写完插回树里
+  int32_t run(int32_t seq_id, const std::vector<int32_t>& tokens) {
+    const int32_t len = static_cast<int32_t>(tokens.size());
+    std::vector<int32_t> blocks;
+    const int32_t matched = prefix_cache_->match(tokens, len - 1, blocks);
+    EXPECT_EQ(matched % kBlockSize, 0);
+    EXPECT_EQ(static_cast<int32_t>(blocks.size()), matched / kBlockSize);
+    EXPECT_TRUE(kv_cache_->add_sequence(seq_id, blocks));
+    const int32_t need = (len + kBlockSize - 1) / kBlockSize - matched / kBlockSize;
+    if (kv_cache_->free_block_num() < need) {
+      prefix_cache_->evict(need);
+    }
+    EXPECT_TRUE(kv_cache_->reserve(seq_id, len - 1));
+    //命中的部分一定是之前别的序列在同样的位置上为同样的token写的
+    for (int32_t pos = 0; pos < matched; ++pos) {
+      EXPECT_EQ(kv_cache_->key(seq_id, 0, pos)[0], tokens[pos]) << "pos " << pos;
+      EXPECT_EQ(kv_cache_->key(seq_id, 0, pos)[1], pos);
+    }
+    for (int32_t pos = matched; pos < len; ++pos) {
+      kv_cache_->key(seq_id, 0, pos)[0] = static_cast<float>(tokens[pos]);
+      kv_cache_->key(seq_id, 0, pos)[1] = static_cast<float>(pos);
+    }
+    prefix_cache_->insert(tokens, len, kv_cache_->block_table(seq_id));
+    return matched;
+  }
+
+  //每个block的引用计数等于引用它的block_table和树里的个数之和，空闲的block正好是没人引用的
+  void check_ref_counts(const std::vector<int32_t>& live_seqs) {
+    int64_t refs = 0;
+    int32_t free_num = 0;
+    for (int32_t block = 0; block < kv_cache_->num_blocks(); ++block) {
+      refs += kv_cache_->ref_count(block);
+      free_num += kv_cache_->ref_count(block) == 0;
+    }
+    int64_t expected = prefix_cache_->cached_block_num();
+    for (int32_t seq_id : live_seqs) {
+      expected += static_cast<int64_t>(kv_cache_->block_table(seq_id).size());
+    }
+    ASSERT_EQ(refs, expected);
+    ASSERT_EQ(kv_cache_->free_block_num(), free_num);
+  }
+
+  static std::vector<int32_t> iota_tokens(int32_t first, int32_t len) {
+    std::vector<int32_t> tokens(len);
+    for (int32_t i = 0; i < len; ++i) {
+      tokens[i] = first + i;
+    }
+    return tokens;
+  }
+
+  std::shared_ptr<op::PagedKVCache> kv_cache_;
+  std::unique_ptr<op::PrefixCache> prefix_cache_;
+  size_t block_byte_size_ = 0;
+};
+}  // namespace
+
+TEST_F(PrefixCacheTest, match_whole_blocks_only) {
+  init(16, 16);
+  const std::vector<int32_t> tokens = iota_tokens(100, 14);
+  ASSERT_EQ(run(0, tokens), 0);
+  //14个token里只有3个写满的block进了树
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 3);
+  const std::vector<int32_t> table = kv_cache_->block_table(0);
+  for (int32_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(kv_cache_->ref_count(table[i]), 2);
+  }
+  ASSERT_EQ(kv_cache_->ref_count(table[3]), 1);
+
+  std::vector<int32_t> blocks;
+  ASSERT_EQ(prefix_cache_->match(tokens, 14, blocks), 12);
+  ASSERT_EQ(blocks, std::vector<int32_t>(table.begin(), table.begin() + 3));
+  ASSERT_EQ(prefix_cache_->match(tokens, 11, blocks), 8);
+  ASSERT_EQ(blocks.size(), 2u);
+  ASSERT_EQ(prefix_cache_->match(tokens, 3, blocks), 0);
+  ASSERT_TRUE(blocks.empty());
+
+  std::vector<int32_t> diverged = tokens;
+  diverged[5] = -1;
+  ASSERT_EQ(prefix_cache_->match(diverged, 14, blocks), 4);
+  ASSERT_EQ(blocks, std::vector<int32_t>(table.begin(), table.begin() + 1));
+  ASSERT_EQ(prefix_cache_->match(iota_tokens(0, 14), 14, blocks), 0);
+  ASSERT_EQ(prefix_cache_->queried_token_num(), 13 + 14 + 11 + 3 + 14 + 14);
+  ASSERT_EQ(prefix_cache_->matched_token_num(), 12 + 8 + 4);
+  check_ref_counts({0});
+}
+
+TEST_F(PrefixCacheTest, branches_share_the_common_prefix) {
+  init(32, 32);
+  const std::vector<int32_t> a = iota_tokens(0, 17);
+  std::vector<int32_t> b = a;
+  b[9] = -1;
+  ASSERT_EQ(run(0, a), 0);
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 4);
+  //b和a前两个block一样，第三个block开始分叉，树在block边界上分裂
+  ASSERT_EQ(run(1, b), 8);
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 6);
+  const auto& table_a = kv_cache_->block_table(0);
+  const auto& table_b = kv_cache_->block_table(1);
+  ASSERT_EQ(table_a[0], table_b[0]);
+  ASSERT_EQ(table_a[1], table_b[1]);
+  ASSERT_NE(table_a[2], table_b[2]);
+  ASSERT_EQ(kv_cache_->ref_count(table_a[0]), 3);
+
+  std::vector<int32_t> blocks;
+  ASSERT_EQ(prefix_cache_->match(a, 17, blocks), 16);
+  ASSERT_EQ(blocks, std::vector<int32_t>(table_a.begin(), table_a.begin() + 4));
+  ASSERT_EQ(prefix_cache_->match(b, 17, blocks), 16);
+  ASSERT_EQ(blocks, std::vector<int32_t>(table_b.begin(), table_b.begin() + 4));
+
+  //同样的前缀用另一批block再插一次，树里沿用原来的block，不重复计数
+  ASSERT_TRUE(kv_cache_->add_sequence(2));
+  ASSERT_TRUE(kv_cache_->reserve(2, 16));
+  prefix_cache_->insert(a, 17, kv_cache_->block_table(2));
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 6);
+  ASSERT_EQ(kv_cache_->ref_count(kv_cache_->block_table(2)[0]), 1);
+  check_ref_counts({0, 1, 2});
+
+  //一个叶子后面接着插更长的，边直接延长
+  const std::vector<int32_t> longer = iota_tokens(0, 25);
+  ASSERT_EQ(run(3, longer), 16);
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 8);
+  ASSERT_EQ(prefix_cache_->match(longer, 25, blocks), 24);
+  check_ref_counts({0, 1, 2, 3});
+}
+
+TEST_F(PrefixCacheTest, evict_only_blocks_held_by_the_tree) {
+  init(16, 16);
+  ASSERT_EQ(run(0, iota_tokens(0, 8)), 0);
+  ASSERT_EQ(run(1, iota_tokens(100, 8)), 0);
+  ASSERT_EQ(kv_cache_->free_block_num(), 12);
+  //两个序列都还在用，删掉叶子也腾不出block，一个都不淘汰
+  ASSERT_EQ(prefix_cache_->evict(16), 0);
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 4);
+
+  kv_cache_->free_sequence(0);
+  kv_cache_->free_sequence(1);
+  ASSERT_EQ(kv_cache_->free_block_num(), 12);
+  //序列0的前缀刚被用过，先淘汰序列1的
+  std::vector<int32_t> blocks;
+  ASSERT_EQ(prefix_cache_->match(iota_tokens(0, 8), 8, blocks), 8);
+  ASSERT_EQ(prefix_cache_->evict(13), 2);
+  ASSERT_EQ(prefix_cache_->match(iota_tokens(100, 8), 8, blocks), 0);
+  ASSERT_EQ(prefix_cache_->match(iota_tokens(0, 8), 8, blocks), 8);
+  //已经够了的时候不淘汰
+  ASSERT_EQ(prefix_cache_->evict(14), 0);
+  ASSERT_EQ(prefix_cache_->evict(16), 2);
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 0);
+  ASSERT_EQ(kv_cache_->free_block_num(), 16);
+  ASSERT_EQ(prefix_cache_->evict(16), 0);
+}
+
+TEST_F(PrefixCacheTest, evict_from_the_leaves_up) {
+  init(16, 16);
+  const std::vector<int32_t> a = iota_tokens(0, 12);
+  std::vector<int32_t> b = a;
+  b[8] = -1;
+  run(0, a);
+  run(1, b);
+  kv_cache_->free_sequence(0);
+  kv_cache_->free_sequence(1);
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 4);
+  //公共前缀的两个block要等两个分支都淘汰之后才变成叶子
+  ASSERT_EQ(prefix_cache_->evict(13), 1);
+  ASSERT_EQ(prefix_cache_->evict(14), 1);
+  std::vector<int32_t> blocks;
+  ASSERT_EQ(prefix_cache_->match(a, 12, blocks), 8);
+  ASSERT_EQ(prefix_cache_->evict(16), 2);
+  ASSERT_EQ(prefix_cache_->match(a, 12, blocks), 0);
+}
+
+TEST_F(PrefixCacheTest, budget_trims_unused_leaves) {
+  init(16, 3);
+  run(0, iota_tokens(0, 8));
+  kv_cache_->free_sequence(0);
+  //超过3个block的预算，插入时把最久没用过、又没人在用的叶子淘汰掉
+  run(1, iota_tokens(100, 8));
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 2);
+  std::vector<int32_t> blocks;
+  ASSERT_EQ(prefix_cache_->match(iota_tokens(0, 8), 8, blocks), 0);
+  ASSERT_EQ(prefix_cache_->match(iota_tokens(100, 8), 8, blocks), 8);
+  //还在用的叶子淘汰不了，暂时超过预算
+  run(2, iota_tokens(200, 8));
+  ASSERT_EQ(prefix_cache_->cached_block_num(), 4);
+  check_ref_counts({1, 2});
+  kv_cache_->free_sequence(1);
+  kv_cache_->free_sequence(2);
+  prefix_cache_.reset();
+  ASSERT_EQ(kv_cache_->free_block_num(), 16);
+}
+
+TEST_F(PrefixCacheTest, random_requests_round_trip) {
+  init(40, 20);
+  std::mt19937 rng(1);
+  //只有两个token，前缀经常重合
+  std::vector<int32_t> live;
+  int64_t matched = 0;
+  for (int32_t seq_id = 0; seq_id < 500; ++seq_id) {
+    std::vector<int32_t> tokens(3 + rng() % 28);
+    for (int32_t& token : tokens) {
+      token = static_cast<int32_t>(rng() % 2);
+    }
+    if (rng() % 4 == 0) {
+      tokens.assign(tokens.size(), 1);
+    }
+    matched += run(seq_id, tokens);
+    ASSERT_FALSE(HasFailure()) << "seq " << seq_id;
+    live.push_back(seq_id);
+    while (live.size() > 3 || (!live.empty() && rng() % 2)) {
+      const size_t i = rng() % live.size();
+      kv_cache_->free_sequence(live[i]);
+      live.erase(live.begin() + i);
+    }
+    check_ref_counts(live);
+  }
+  ASSERT_GT(matched, 0);
+  for (int32_t seq_id : live) {
+    kv_cache_->free_sequence(seq_id);
+  }
+  ASSERT_LE(prefix_cache_->cached_block_num(), prefix_cache_->max_block_num());
+  ASSERT_EQ(kv_cache_->free_block_num() + prefix_cache_->cached_block_num(), 40);
+  //树析构时把它持有的引用还回去
+  prefix_cache_.reset();
+  ASSERT_EQ(kv_cache_->free_block_num(), 40);
+}
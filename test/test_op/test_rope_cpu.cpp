@@ -0,0 +1,19 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <string>
+#include "op/rope.h"
+
+TEST(test_rope_cpu, init_reports_each_invalid_argument) {
+  const base::DeviceType cpu = base::DeviceType::kDeviceCPU;
+  ASSERT_TRUE(op::RoPELayer(cpu, 64, 32, 16, 8).init());
+
+  //奇数的head size和非正的max_seq_len各自报自己的错误
+  const auto odd_head = op::RoPELayer(cpu, 60, 30, 15, 8).init();
+  ASSERT_FALSE(odd_head);
+  ASSERT_NE(odd_head.get_err_msg().find("head size"), std::string::npos);
+  const auto no_seq = op::RoPELayer(cpu, 64, 32, 16, 0).init();
+  ASSERT_FALSE(no_seq);
+  ASSERT_NE(no_seq.get_err_msg().find("max seq len"), std::string::npos);
+  ASSERT_FALSE(op::RoPELayer(cpu, 64, 32, 0, 8).init());
+  ASSERT_FALSE(op::RoPELayer(cpu, 64, 24, 16, 8).init());
+}
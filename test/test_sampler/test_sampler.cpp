@@ -0,0 +1,196 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <set>
+#include <vector>
+#include "../utils.h"
+#include "op/kernels/cpu/sampling_kernel.h"
+#include "sampler/sampler.h"
+
+namespace {
+std::vector<float> random_logits(int32_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> dist(0.f, 2.f);
+  std::vector<float> logits(size);
+  for (float& x : logits) {
+    x = dist(rng);
+  }
+  return logits;
+}
+
+//按logits从大到小排好的下标，相同时下标小的在前
+std::vector<int32_t> sorted_indices(const std::vector<float>& logits) {
+  std::vector<int32_t> indices(logits.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::stable_sort(indices.begin(), indices.end(),
+                   [&](int32_t a, int32_t b) { return logits[a] > logits[b]; });
+  return indices;
+}
+
+//top-k之后的top-p集合：从大到小累加softmax概率，刚到top_p为止
+std::set<int32_t> nucleus_ref(const std::vector<float>& logits, float temperature, int32_t top_k,
+                              float top_p) {
+  std::vector<int32_t> indices = sorted_indices(logits);
+  if (top_k > 0 && top_k < static_cast<int32_t>(indices.size())) {
+    indices.resize(top_k);
+  }
+  std::vector<double> probs;
+  double sum = 0.0;
+  for (int32_t i : indices) {
+    probs.push_back(std::exp((logits[i] - logits[indices[0]]) / temperature));
+    sum += probs.back();
+  }
+  std::set<int32_t> nucleus;
+  double cumulative = 0.0;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    nucleus.insert(indices[i]);
+    cumulative += probs[i];
+    if (cumulative >= top_p * sum) {
+      break;
+    }
+  }
+  return nucleus;
+}
+
+std::vector<int32_t> draw(sampler::Sampler& sampler, const std::vector<float>& logits,
+                          int32_t times) {
+  std::vector<int32_t> tokens;
+  for (int32_t i = 0; i < times; ++i) {
+    tokens.push_back(sampler.sample(logits.data(), static_cast<int32_t>(logits.size())));
+  }
+  return tokens;
+}
+}  // namespace
+
+TEST(test_sampler, topk_kernel) {
+  const std::vector<float> logits = random_logits(1037, 1);
+  const std::vector<int32_t> ref = sorted_indices(logits);
+  for (int32_t k : {1, 5, 40, 1037}) {
+    std::vector<float> values(k);
+    std::vector<int32_t> indices(k);
+    kernel::topk_kernel_cpu(logits.data(), static_cast<int32_t>(logits.size()), k, values.data(),
+                            indices.data());
+    for (int32_t i = 0; i < k; ++i) {
+      ASSERT_EQ(indices[i], ref[i]) << "k " << k << " rank " << i;
+      ASSERT_EQ(values[i], logits[ref[i]]);
+    }
+  }
+}
+
+TEST(test_sampler, argmax_and_exp_sum_kernel) {
+  std::vector<float> logits = random_logits(301, 2);
+  //有两个相同的最大值时取前面的
+  const int32_t max_index = sorted_indices(logits)[0];
+  logits[250] = logits[max_index];
+  ASSERT_EQ(kernel::argmax_kernel_cpu(logits.data(), 301), std::min(max_index, 250));
+  ASSERT_EQ(kernel::max_kernel_cpu(logits.data(), 301), logits[max_index]);
+
+  std::vector<float> out(logits.size());
+  const float scale = 1.f / 0.7f;
+  const float sum = kernel::exp_sum_kernel_cpu(logits.data(), 301, logits[max_index], scale,
+                                               out.data());
+  double ref_sum = 0.0;
+  for (size_t i = 0; i < logits.size(); ++i) {
+    const double ref = std::exp((logits[i] - logits[max_index]) * scale);
+    ASSERT_NEAR(out[i], ref, 1e-6 + 1e-5 * ref);
+    ref_sum += ref;
+  }
+  ASSERT_NEAR(sum, ref_sum, 1e-4 * ref_sum);
+}
+
+TEST(test_sampler, greedy) {
+  const std::vector<float> logits = random_logits(500, 3);
+  sampler::SamplerConfig config;
+  auto sampler = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, 500);
+  ASSERT_EQ(sampler->sample(logits.data(), 500), sorted_indices(logits)[0]);
+}
+
+TEST(test_sampler, top_k_only_samples_the_k_largest) {
+  const int32_t vocab_size = 1000;
+  std::vector<float> logits = random_logits(vocab_size, 4);
+  const std::vector<int32_t> order = sorted_indices(logits);
+  //前5个拉开和其他的差距，并且彼此接近，每个都应该被采到
+  for (int32_t i = 0; i < 5; ++i) {
+    logits[order[i]] = 20.f - 0.1f * i;
+  }
+  sampler::SamplerConfig config;
+  config.temperature = 1.f;
+  config.top_k = 5;
+  config.seed = 1;
+  auto sampler = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, vocab_size);
+  const std::set<int32_t> ref = nucleus_ref(logits, 1.f, 5, 1.f);
+  const std::vector<int32_t> tokens = draw(*sampler, logits, 2000);
+  ASSERT_EQ(std::set<int32_t>(tokens.begin(), tokens.end()), ref);
+}
+
+TEST(test_sampler, top_p_only_samples_the_nucleus) {
+  const int32_t vocab_size = 1000;
+  const std::vector<float> logits = random_logits(vocab_size, 5);
+  for (int32_t top_k : {0, 50}) {
+    for (float top_p : {0.3f, 0.9f}) {
+      sampler::SamplerConfig config;
+      config.temperature = 0.8f;
+      config.top_k = top_k;
+      config.top_p = top_p;
+      config.seed = 2;
+      auto sampler = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, vocab_size);
+      const std::set<int32_t> ref = nucleus_ref(logits, 0.8f, top_k, top_p);
+      for (int32_t token : draw(*sampler, logits, 3000)) {
+        ASSERT_TRUE(ref.count(token)) << "top_k " << top_k << " top_p " << top_p;
+      }
+    }
+  }
+}
+
+TEST(test_sampler, frequencies_follow_the_softmax) {
+  //top-k和只用temperature两条路径，采样频率都应该接近softmax的概率
+  const std::vector<float> probs = {0.4f, 0.3f, 0.2f, 0.1f};
+  std::vector<float> logits(64, -100.f);
+  for (size_t i = 0; i < probs.size(); ++i) {
+    logits[i * 7] = std::log(probs[i]);
+  }
+  for (int32_t top_k : {0, 4}) {
+    sampler::SamplerConfig config;
+    config.temperature = 1.f;
+    config.top_k = top_k;
+    config.seed = 3;
+    auto sampler = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, 64);
+    const int32_t times = 20000;
+    std::vector<int32_t> counts(64, 0);
+    for (int32_t token : draw(*sampler, logits, times)) {
+      counts[token] += 1;
+    }
+    for (size_t i = 0; i < probs.size(); ++i) {
+      ASSERT_NEAR(counts[i * 7] / static_cast<double>(times), probs[i], 0.02) << "top_k " << top_k;
+    }
+  }
+}
+
+TEST(test_sampler, near_flat_logits_with_a_small_top_p) {
+  //概率都差不多、top_p小于1 / vocab_size时，top-p集合只有最大的那个token，但不能是空的
+  std::vector<float> logits(8, 0.5f);
+  logits[3] = 0.55f;
+  sampler::SamplerConfig config;
+  config.temperature = 1.f;
+  config.top_p = 0.05f;
+  auto sampler = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, 8);
+  for (int32_t token : draw(*sampler, logits, 100)) {
+    ASSERT_EQ(token, 3);
+  }
+}
+
+TEST(test_sampler, same_seed_same_tokens) {
+  const std::vector<float> logits = random_logits(256, 6);
+  sampler::SamplerConfig config;
+  config.temperature = 1.2f;
+  config.top_p = 0.95f;
+  config.seed = 42;
+  auto a = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, 256);
+  auto b = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, 256);
+  config.seed = 43;
+  auto c = sampler::create_sampler(base::DeviceType::kDeviceCPU, config, 256);
+  const std::vector<int32_t> tokens_a = draw(*a, logits, 200);
+  ASSERT_EQ(tokens_a, draw(*b, logits, 200));
+  ASSERT_NE(tokens_a, draw(*c, logits, 200));
+}
@@ -0,0 +1,58 @@
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "../utils.h"
+#include "op/add.h"
+#include "tensor/tensor.h"
+
+namespace {
+//[2, 3, 4]，元素的值就是它行优先的下标
+tensor::Tensor make_iota() {
+  tensor::Tensor t(base::DataType::kDataTypeFp32, 2, 3, 4, true, test::cpu_alloc());
+  for (size_t i = 0; i < t.size(); ++i) {
+    t.index<float>(i) = static_cast<float>(i);
+  }
+  return t;
+}
+}  // namespace
+
+TEST(test_tensor, index_follows_the_strides_of_a_view) {
+  const tensor::Tensor t = make_iota();
+  const tensor::Tensor rows = t.slice(1, 1, 3);
+  ASSERT_FALSE(rows.is_contiguous());
+  ASSERT_EQ(rows.size(), 16u);
+  for (int32_t a = 0; a < 2; ++a) {
+    for (int32_t b = 0; b < 2; ++b) {
+      for (int32_t c = 0; c < 4; ++c) {
+        ASSERT_EQ(rows.index<float>((a * 2 + b) * 4 + c), (a * 3 + b + 1) * 4 + c);
+      }
+    }
+  }
+
+  const tensor::Tensor transposed = t.transpose(1, 2);
+  ASSERT_FALSE(transposed.is_contiguous());
+  for (int32_t a = 0; a < 2; ++a) {
+    for (int32_t c = 0; c < 4; ++c) {
+      for (int32_t b = 0; b < 3; ++b) {
+        ASSERT_EQ(transposed.index<float>((a * 4 + c) * 3 + b), (a * 3 + b) * 4 + c);
+      }
+    }
+  }
+  //clone把视图收拢成紧凑的tensor，按下标读出来的值不变
+  const tensor::Tensor packed = transposed.clone();
+  ASSERT_TRUE(packed.is_contiguous());
+  for (size_t i = 0; i < packed.size(); ++i) {
+    ASSERT_EQ(packed.index<float>(i), transposed.index<float>(i));
+  }
+}
+
+TEST(test_tensor, layers_reject_non_contiguous_views) {
+  const tensor::Tensor t = make_iota();
+  tensor::Tensor output(base::DataType::kDataTypeFp32, 2, 4, 3, true, test::cpu_alloc());
+  op::VecAddLayer add_layer(base::DeviceType::kDeviceCPU);
+  //子类只重写了无参的forward()，带输入输出的重载要通过基类调用
+  op::Layer& add = add_layer;
+  ASSERT_FALSE(add.forward(t.transpose(1, 2), t.transpose(1, 2), output));
+  const tensor::Tensor contiguous = t.transpose(1, 2).clone();
+  ASSERT_TRUE(add.forward(contiguous, contiguous, output));
+  ASSERT_EQ(output.index<float>(5), 2 * contiguous.index<float>(5));
+}
@@ -0,0 +1,87 @@
+#ifndef KUIPER_TEST_UTILS_H_
+#define KUIPER_TEST_UTILS_H_
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include "base/alloc.h"
+#include "tensor/tensor.h"
+//测试里共用的标量参考实现，kernel的结果都和这些逐元素、不做向量化的写法比
+namespace test {
+inline std::shared_ptr<base::DeviceAllocator> cpu_alloc() {
+  return base::CPUDeviceAllocatorFactory::get_instance();
+}
+
+//按正态分布填满一个fp32的tensor，seed相同时结果相同
+inline void fill_normal(tensor::Tensor& tensor, uint32_t seed, float stddev = 1.f) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> dist(0.f, stddev);
+  for (size_t i = 0; i < tensor.size(); ++i) {
+    tensor.index<float>(i) = dist(rng);
+  }
+}
+
+inline uint32_t float_bits(float f) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &f, sizeof(float));
+  return bits;
+}
+
+inline float bits_float(uint32_t bits) {
+  float f = 0.f;
+  std::memcpy(&f, &bits, sizeof(float));
+  return f;
+}
+
+//IEEE半精度，就近舍入到偶数，溢出变成inf
+inline uint16_t fp32_to_fp16_ref(float f) {
+  const uint32_t bits = float_bits(f);
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const uint32_t abs_bits = bits & 0x7FFFFFFF;
+  if (abs_bits > 0x7F800000) {
+    return sign | 0x7E00;
+  }
+  //不小于65520的数舍入之后超过了半精度的最大值65504
+  if (abs_bits >= 0x477FF000) {
+    return sign | 0x7C00;
+  }
+  //小于2^-14的是半精度的非规格化数，按2^-24的整数倍舍入
+  if (abs_bits < 0x38800000) {
+    const float scaled = bits_float(abs_bits) * 16777216.f;
+    return sign | static_cast<uint16_t>(std::nearbyint(scaled));
+  }
+  const uint32_t exponent = (abs_bits >> 23) - 127 + 15;
+  const uint32_t mantissa = abs_bits & 0x7FFFFF;
+  uint32_t half = (exponent << 10) | (mantissa >> 13);
+  const uint32_t rest = mantissa & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    half += 1;
+  }
+  return sign | static_cast<uint16_t>(half);
+}
+
+inline float fp16_to_fp32_ref(uint16_t h) {
+  const float sign = (h & 0x8000) ? -1.f : 1.f;
+  const int32_t exponent = (h >> 10) & 0x1F;
+  const int32_t mantissa = h & 0x3FF;
+  if (exponent == 0) {
+    return sign * std::ldexp(static_cast<float>(mantissa), -24);
+  }
+  if (exponent == 31) {
+    return mantissa ? NAN : sign * INFINITY;
+  }
+  return sign * std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+}
+
+//bfloat16，就近舍入到偶数
+inline uint16_t fp32_to_bf16_ref(float f) {
+  const uint32_t bits = float_bits(f);
+  if ((bits & 0x7FFFFFFF) > 0x7F800000) {
+    return static_cast<uint16_t>((bits >> 16) | 0x40);
+  }
+  return static_cast<uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+inline float bf16_to_fp32_ref(uint16_t b) { return bits_float(static_cast<uint32_t>(b) << 16); }
+}  // namespace test
+#endif  // KUIPER_TEST_UTILS_H_